@@ -24,6 +24,22 @@ const vector<T>& ColumnMatrix<T>::operator[](const int i) const
 	return _matrix[i];
 }
 
+/*
+Returns the bytes allocated by the matrix' storage. Since Resize() never shrinks it, this can exceed the
+size of the current representation.
+*/
+template<typename T>
+unsigned long long ColumnMatrix<T>::Bytes()
+{
+	unsigned long long bytes = _matrix.capacity() * sizeof(vector<T>);
+
+	for(int i = 0; i < _matrix.size(); i++){
+		bytes += _matrix[i].capacity() * sizeof(T);
+	}
+
+	return bytes;
+}
+
 template<typename T>
 void ColumnMatrix<T>::GetSize(int& rows, int& cols)
 {
@@ -40,7 +56,7 @@ template<typename T>
 void ColumnMatrix<T>::Clear()
 {
 	if(_matrix.size() > 0){
-		for(int i = 0; i < _matrix[0].size(); i++){
+		for(int i = 0; i < _matrix.size(); i++){
 			_matrix[i].clear();
 		}
 		_matrix.clear();
@@ -107,9 +123,9 @@ void ColumnMatrix<T>::Resize(const int rows, const int cols)
 		_matrix.resize(cols);
 		_matrix.shrink_to_fit();
 	}
-	//check row size is sufficient
-	if(_matrix[0].size() < rows){
-		for(int i = 0; i < _matrix.size(); i++){
+	//check row size is sufficient; columns added above are empty, so each column is checked
+	for(int i = 0; i < _matrix.size(); i++){
+		if(_matrix[i].size() < rows){
 			_matrix[i].resize(rows);
 			_matrix[i].shrink_to_fit();
 		}
@@ -0,0 +1,522 @@
+#include "DatasetReader.hpp"
+#include "Profiler.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char binaryMagic[8] = {'H','M','M','S','E','Q','0','1'};
+
+DatasetReader::DatasetReader(const int batchSize, const int queueDepth, const int chunkBytes)
+{
+	_batchSize = batchSize > 0 ? batchSize : 1;
+	_queueDepth = queueDepth > 0 ? queueDepth : 1;
+	_chunkBytes = chunkBytes > 0 ? chunkBytes : (1 << 20);
+	_fd = -1;
+	_isBinary = false;
+	_fixedVocabulary = false;
+	_done = true;
+	_stop = false;
+	_numSequences = _numObservations = _numSkipped = 0;
+	_stallSeconds = _producerWaitSeconds = 0;
+}
+
+DatasetReader::~DatasetReader()
+{
+	Close();
+}
+
+/*
+Opens a text or binary dataset (detected from the binary header), assigning symbol ids as they appear,
+and starts reading it in the background.
+*/
+bool DatasetReader::Open(const string& path)
+{
+	return _open(path, NULL);
+}
+
+/*
+As Open(), but with ids given by @vocabulary: symbol i of the vocabulary has id i.
+*/
+bool DatasetReader::Open(const string& path, const vector<string>& vocabulary)
+{
+	return _open(path, &vocabulary);
+}
+
+bool DatasetReader::_open(const string& path, const vector<string>* vocabulary)
+{
+	char magic[8];
+
+	Close();
+	_fd = open(path.c_str(), O_RDONLY);
+	if(_fd < 0){
+		cout << "ERROR could not open dataset file: " << path << endl;
+		return false;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	_symbolIds.clear();
+	_symbols.clear();
+	_fixedVocabulary = vocabulary != NULL;
+	if(_fixedVocabulary){
+		for(int i = 0; i < vocabulary->size(); i++){
+			_symbolIds[ (*vocabulary)[i] ] = i;
+		}
+		_symbols = *vocabulary;
+	}
+
+	_buffer.resize(_chunkBytes);
+	_bufferPos = _bufferEnd = 0;
+	_fileOffset = 0;
+	_isBinary = _readBytes(magic, sizeof(magic)) && memcmp(magic, binaryMagic, sizeof(magic)) == 0;
+	if(!_isBinary){
+		//text: start over from the first byte
+		_bufferPos = 0;
+	}
+
+	_batch.clear();
+	_queue.clear();
+	_done = false;
+	_stop = false;
+	_numSequences = _numObservations = _numSkipped = 0;
+	_stallSeconds = _producerWaitSeconds = 0;
+	_reader = thread(&DatasetReader::_readLoop, this);
+
+	return true;
+}
+
+/*
+Stops the reader thread, if it is still running, and closes the file.
+*/
+void DatasetReader::Close()
+{
+	//set under the lock, so a producer cannot test _stop and then miss the notification before it waits
+	{
+		lock_guard<mutex> guard(_lock);
+		_stop = true;
+	}
+	_notFull.notify_all();
+	if(_reader.joinable()){
+		_reader.join();
+	}
+	if(_fd >= 0){
+		close(_fd);
+		_fd = -1;
+	}
+	_queue.clear();
+	_done = true;
+}
+
+/*
+Takes the next batch of sequences, blocking until one is ready. Returns false once the whole file has been read.
+*/
+bool DatasetReader::NextBatch(vector<vector<int> >& batch)
+{
+	chrono::steady_clock::time_point start;
+	unique_lock<mutex> guard(_lock);
+
+	if(_queue.empty() && !_done){
+		PROFILE_SCOPE("DatasetReader.Stall");
+		start = chrono::steady_clock::now();
+		while(_queue.empty() && !_done){
+			_notEmpty.wait(guard);
+		}
+		_stallSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	if(_queue.empty()){
+		batch.clear();
+		return false;
+	}
+	batch.swap(_queue.front());
+	_queue.pop_front();
+	guard.unlock();
+	_notFull.notify_one();
+
+	return true;
+}
+
+const vector<string>& DatasetReader::Symbols()
+{
+	return _symbols;
+}
+
+unsigned long long DatasetReader::NumSequences()
+{
+	return _numSequences;
+}
+
+unsigned long long DatasetReader::NumObservations()
+{
+	return _numObservations;
+}
+
+unsigned long long DatasetReader::NumSkipped()
+{
+	return _numSkipped;
+}
+
+double DatasetReader::StallSeconds()
+{
+	lock_guard<mutex> guard(_lock);
+	return _stallSeconds;
+}
+
+double DatasetReader::ProducerWaitSeconds()
+{
+	lock_guard<mutex> guard(_lock);
+	return _producerWaitSeconds;
+}
+
+string DatasetReader::StatsString()
+{
+	ostringstream out;
+
+	out << "sequences=" << _numSequences << " observations=" << _numObservations << " skipped=" << _numSkipped;
+	out << " stall_s=" << StallSeconds() << " producer_wait_s=" << ProducerWaitSeconds();
+
+	return out.str();
+}
+
+void DatasetReader::_readLoop()
+{
+	PROFILE_SCOPE("DatasetReader.Read");
+
+	if(_isBinary){
+		_readBinary();
+	}
+	else{
+		_readText();
+	}
+	_push(true);
+}
+
+/*
+Reads the next chunk of the file into the buffer, keeping any unconsumed bytes, and hints the kernel to
+start reading the chunk after it. Returns false at the end of the file.
+*/
+bool DatasetReader::_fill()
+{
+	ssize_t n;
+
+	if(_bufferPos > 0){
+		memmove(_buffer.data(), _buffer.data() + _bufferPos, _bufferEnd - _bufferPos);
+		_bufferEnd -= _bufferPos;
+		_bufferPos = 0;
+	}
+	if(_bufferEnd == _buffer.size()){
+		_buffer.resize(_buffer.size() * 2);
+	}
+
+	do{
+		n = read(_fd, _buffer.data() + _bufferEnd, _buffer.size() - _bufferEnd);
+	}while(n < 0 && errno == EINTR);
+	if(n <= 0){
+		return false;
+	}
+	_bufferEnd += n;
+	_fileOffset += n;
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(_fd, _fileOffset, _chunkBytes, POSIX_FADV_WILLNEED);
+#endif
+
+	return true;
+}
+
+bool DatasetReader::_readBytes(void* dest, const size_t numBytes)
+{
+	while(_bufferEnd - _bufferPos < numBytes){
+		if(!_fill()){
+			return false;
+		}
+	}
+	memcpy(dest, _buffer.data() + _bufferPos, numBytes);
+	_bufferPos += numBytes;
+
+	return true;
+}
+
+/*
+Returns the id of a symbol; -1 if it is not in a fixed vocabulary.
+*/
+int DatasetReader::_symbolId(const string& symbol)
+{
+	map<string,int>::iterator it = _symbolIds.find(symbol);
+
+	if(it != _symbolIds.end()){
+		return it->second;
+	}
+	if(_fixedVocabulary){
+		return -1;
+	}
+	_symbolIds[symbol] = _symbols.size();
+	_symbols.push_back(symbol);
+
+	return _symbols.size() - 1;
+}
+
+/*
+Adds a completed sequence to the batch being filled (unless @skip), handing the batch over when it is full.
+*/
+void DatasetReader::_finishSequence(vector<int>& sequence, bool& skip)
+{
+	if(skip){
+		_numSkipped++;
+	}
+	else if(sequence.size() > 0){
+		_numSequences++;
+		_numObservations += sequence.size();
+		_batch.push_back(vector<int>());
+		_batch.back().swap(sequence);
+		if(_batch.size() >= _batchSize){
+			_push(false);
+		}
+	}
+	sequence.clear();
+	skip = false;
+}
+
+/*
+Hands the current batch to the consumer, waiting while the queue is full. With @final, also marks the end of
+the data. Returns false if the reader was closed.
+*/
+bool DatasetReader::_push(bool final)
+{
+	chrono::steady_clock::time_point start;
+	unique_lock<mutex> guard(_lock);
+
+	if(_batch.size() > 0){
+		if(_queue.size() >= _queueDepth && !_stop){
+			start = chrono::steady_clock::now();
+			while(_queue.size() >= _queueDepth && !_stop){
+				_notFull.wait(guard);
+			}
+			_producerWaitSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
+		_queue.push_back(vector<vector<int> >());
+		_queue.back().swap(_batch);
+	}
+	if(final){
+		_done = true;
+	}
+	guard.unlock();
+	_notEmpty.notify_one();
+
+	return !_stop;
+}
+
+void DatasetReader::_readText()
+{
+	int id;
+	bool skip = false, more = true;
+	size_t newline, start;
+	string line;
+	vector<int> sequence;
+
+	while(more && !_stop){
+		more = _fill();
+		//decode the whole lines in the buffer; a partial last line waits for the next chunk, or the end of the file
+		start = _bufferPos;
+		while(start < _bufferEnd){
+			newline = start;
+			while(newline < _bufferEnd && _buffer[newline] != '\n'){
+				newline++;
+			}
+			if(newline == _bufferEnd && more){
+				break;
+			}
+			line.assign(_buffer.data() + start, newline - start);
+			if(line.size() > 0 && line[line.size()-1] == '\r'){
+				line.resize(line.size()-1);
+			}
+			start = newline + 1;
+
+			if(line.size() == 0){
+				_finishSequence(sequence, skip);
+				continue;
+			}
+			id = _symbolId(line);
+			if(id < 0){
+				skip = true;
+			}
+			else if(!skip){
+				sequence.push_back(id);
+			}
+		}
+		_bufferPos = min(start, _bufferEnd);
+	}
+	_finishSequence(sequence, skip);
+}
+
+void DatasetReader::_readBinary()
+{
+	uint32_t i, numSymbols, length, idBytes;
+	uint16_t id16;
+	uint32_t id32;
+	int id;
+	bool skip;
+	string symbol;
+	vector<int> sequence, headerMap;
+
+	//the header vocabulary, mapped onto the reader's ids
+	if(!_readBytes(&numSymbols, sizeof(numSymbols))){
+		cout << "ERROR truncated binary dataset header" << endl;
+		return;
+	}
+	for(i = 0; i < numSymbols; i++){
+		if(!_readBytes(&length, sizeof(length))){
+			cout << "ERROR truncated binary dataset header" << endl;
+			return;
+		}
+		symbol.resize(length);
+		if(length > 0 && !_readBytes(&symbol[0], length)){
+			cout << "ERROR truncated binary dataset header" << endl;
+			return;
+		}
+		headerMap.push_back(_symbolId(symbol));
+	}
+	if(!_readBytes(&idBytes, sizeof(idBytes)) || (idBytes != 2 && idBytes != 4)){
+		cout << "ERROR bad id width in binary dataset header" << endl;
+		return;
+	}
+
+	while(!_stop && _readBytes(&length, sizeof(length))){
+		skip = false;
+		sequence.resize(length);
+		for(i = 0; i < length; i++){
+			if(idBytes == 2){
+				if(!_readBytes(&id16, sizeof(id16))){
+					break;
+				}
+				id32 = id16;
+			}
+			else if(!_readBytes(&id32, sizeof(id32))){
+				break;
+			}
+			id = id32 < headerMap.size() ? headerMap[id32] : -1;
+			if(id < 0){
+				skip = true;
+			}
+			sequence[i] = id;
+		}
+		if(i < length){
+			cout << "ERROR truncated sequence in binary dataset" << endl;
+			return;
+		}
+		_finishSequence(sequence, skip);
+	}
+}
+
+/*
+Gets the vocabulary of a dataset, in id order: from the header of a binary file, or by reading a text file.
+*/
+bool DatasetReader::ReadVocabulary(const string& path, vector<string>& symbols)
+{
+	vector<vector<int> > batch;
+	DatasetReader reader;
+
+	if(!reader.Open(path)){
+		return false;
+	}
+	while(reader.NextBatch(batch));
+	symbols = reader.Symbols();
+
+	return true;
+}
+
+/*
+Returns the number of bytes per symbol id in a binary dataset with @numSymbols symbols: 2 or 4.
+*/
+int DatasetReader::BinaryIdBytes(const int numSymbols)
+{
+	return numSymbols <= 65536 ? 2 : 4;
+}
+
+/*
+Returns the header of a binary dataset over @symbols: everything before the first sequence.
+*/
+string DatasetReader::BinaryHeader(const vector<string>& symbols)
+{
+	int i;
+	uint32_t value;
+	string header(binaryMagic, sizeof(binaryMagic));
+
+	value = symbols.size();
+	header.append((const char*)&value, sizeof(value));
+	for(i = 0; i < symbols.size(); i++){
+		value = symbols[i].size();
+		header.append((const char*)&value, sizeof(value));
+		header.append(symbols[i]);
+	}
+	value = BinaryIdBytes(symbols.size());
+	header.append((const char*)&value, sizeof(value));
+
+	return header;
+}
+
+/*
+Writes sequences of symbol ids, with their vocabulary, in the binary format.
+*/
+bool DatasetReader::WriteBinary(const string& path, const vector<string>& symbols, const vector<vector<int> >& sequences)
+{
+	int i;
+	size_t j;
+	uint32_t value, idBytes;
+	uint16_t id16;
+	ofstream out;
+
+	out.open(path.c_str(), ios::out | ios::binary);
+	if(!out.is_open()){
+		cout << "ERROR could not open dataset file: " << path << endl;
+		return false;
+	}
+
+	string header = BinaryHeader(symbols);
+	out.write(header.data(), header.size());
+	idBytes = BinaryIdBytes(symbols.size());
+
+	for(i = 0; i < sequences.size(); i++){
+		value = sequences[i].size();
+		out.write((const char*)&value, sizeof(value));
+		for(j = 0; j < sequences[i].size(); j++){
+			if(idBytes == 2){
+				id16 = sequences[i][j];
+				out.write((const char*)&id16, sizeof(id16));
+			}
+			else{
+				value = sequences[i][j];
+				out.write((const char*)&value, sizeof(value));
+			}
+		}
+	}
+
+	return out.good();
+}
+
+/*
+Converts a text dataset to the binary format, streaming it through a reader.
+*/
+bool DatasetReader::ConvertToBinary(const string& textPath, const string& binaryPath)
+{
+	vector<vector<int> > batch, sequences;
+	DatasetReader reader;
+
+	if(!reader.Open(textPath)){
+		return false;
+	}
+	while(reader.NextBatch(batch)){
+		for(int i = 0; i < batch.size(); i++){
+			sequences.push_back(vector<int>());
+			sequences.back().swap(batch[i]);
+		}
+	}
+
+	return WriteBinary(binaryPath, reader.Symbols(), sequences);
+}
@@ -0,0 +1,101 @@
+#ifndef DATASET_READER_HPP
+#define DATASET_READER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+
+/*
+Reads unlabelled observation sequences on a background thread, so that training and scoring never wait on disk.
+
+The reader thread reads the file in chunks, decodes them into batches of sequences (symbol ids), and hands them
+over through a bounded queue. With the default depth of two, the consumer works on one batch while the next is
+being filled: double buffering. Reads are sequential, and the kernel is told so, with a readahead hint for the
+next chunk as each one is read. Labelled data is streamed by ShardedCounter instead.
+
+Sources:
+	-text, as for DiscreteHmmDataset::BuildUnlabeledDataset(): one symbol per line. A blank line ends a sequence,
+	 so a file without blank lines is one long sequence, exactly as BuildUnlabeledDataset() reads it.
+	-binary, written by WriteBinary(): no parsing, and the vocabulary is in the header. Layout, in host byte order:
+		"HMMSEQ01"
+		uint32 numSymbols, then per symbol: uint32 length, the name's bytes
+		uint32 bytes per id (2 or 4)
+		per sequence: uint32 length, then length ids
+
+Symbol ids: if Open() is given a vocabulary (eg, a model's symbols, in id order) ids follow it, and a sequence
+with a symbol outside it is skipped and counted in NumSkipped(). Otherwise ids are assigned in order of first
+appearance (or by the binary header), and Symbols() returns them once the reader reaches the end.
+
+Stall time is the time the consumer spent blocked in NextBatch() waiting for data; it should be near zero.
+Producer wait time is the time the reader thread spent waiting for the consumer to free a buffer.
+*/
+class DatasetReader{
+	public:
+		DatasetReader(const int batchSize=256, const int queueDepth=2, const int chunkBytes=(1 << 20));
+		~DatasetReader();
+		bool Open(const string& path);
+		bool Open(const string& path, const vector<string>& vocabulary);
+		bool NextBatch(vector<vector<int> >& batch);
+		void Close();
+		const vector<string>& Symbols();
+		unsigned long long NumSequences();
+		unsigned long long NumObservations();
+		unsigned long long NumSkipped();
+		double StallSeconds();
+		double ProducerWaitSeconds();
+		string StatsString();
+		static bool ReadVocabulary(const string& path, vector<string>& symbols);
+		static int BinaryIdBytes(const int numSymbols);
+		static string BinaryHeader(const vector<string>& symbols);
+		static bool WriteBinary(const string& path, const vector<string>& symbols, const vector<vector<int> >& sequences);
+		static bool ConvertToBinary(const string& textPath, const string& binaryPath);
+	private:
+		bool _open(const string& path, const vector<string>* vocabulary);
+		void _readLoop();
+		void _readText();
+		void _readBinary();
+		bool _fill();
+		bool _readBytes(void* dest, const size_t numBytes);
+		int _symbolId(const string& symbol);
+		void _finishSequence(vector<int>& sequence, bool& skip);
+		bool _push(bool final);
+
+		int _batchSize;
+		int _queueDepth;
+		int _chunkBytes;
+		int _fd;
+		bool _isBinary;
+		bool _fixedVocabulary;
+		map<string,int> _symbolIds;
+		vector<string> _symbols;
+
+		//reader thread state: the current chunk, and the batch being filled
+		vector<char> _buffer;
+		size_t _bufferPos;
+		size_t _bufferEnd;
+		long long _fileOffset;
+		vector<vector<int> > _batch;
+
+		thread _reader;
+		mutex _lock;
+		condition_variable _notEmpty;
+		condition_variable _notFull;
+		deque<vector<vector<int> > > _queue;
+		bool _done;
+		atomic<bool> _stop;
+
+		unsigned long long _numSequences;
+		unsigned long long _numObservations;
+		unsigned long long _numSkipped;
+		double _stallSeconds;
+		double _producerWaitSeconds;
+};
+
+#endif
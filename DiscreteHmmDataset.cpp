@@ -1,10 +1,14 @@
 #include "DiscreteHmmDataset.hpp"
+#include "Profiler.hpp"
 
 DiscreteHmmDataset::DiscreteHmmDataset()
-{}
+{
+	_isCompact = false;
+}
 
 DiscreteHmmDataset::DiscreteHmmDataset(const string& path, bool isLabeledData)
 {
+	_isCompact = false;
 	if(isLabeledData){
 		BuildLabeledDataset(path);
 	}
@@ -21,16 +25,82 @@ DiscreteHmmDataset::~DiscreteHmmDataset()
 void DiscreteHmmDataset::Clear()
 {
 	LabeledDataSequence.clear();
+	LabeledSequenceStarts.clear();
 	UnlabeledDataSequence.clear();
+	CompactStateSequence.Clear();
+	CompactSymbolSequence.Clear();
+	CompactUnlabeledSequence.Clear();
 	_stateFlyweight.Clear();
 	_symbolFlyweight.Clear();
 }
 
 int DiscreteHmmDataset::NumInstances()
 {
+	if(_isCompact){
+		return CompactStateSequence.size();
+	}
 	return LabeledDataSequence.size();
 }
 
+/*
+Selects whether subsequent Build calls store sequences bit-packed. Does not convert data
+already loaded; see Compact() for that.
+*/
+void DiscreteHmmDataset::SetCompactStorage(bool compact)
+{
+	_isCompact = compact;
+}
+
+bool DiscreteHmmDataset::IsCompact()
+{
+	return _isCompact;
+}
+
+/*
+Converts any sequences already loaded into the int vectors to packed storage, and releases the vectors.
+*/
+void DiscreteHmmDataset::Compact()
+{
+	int i;
+	vector<int> column;
+
+	if(LabeledDataSequence.size() > 0){
+		column.resize(LabeledDataSequence.size());
+		for(i = 0; i < LabeledDataSequence.size(); i++){
+			column[i] = LabeledDataSequence[i].first;
+		}
+		CompactStateSequence.Pack(column, PackedSequence::WidthFor(NumStates()));
+		for(i = 0; i < LabeledDataSequence.size(); i++){
+			column[i] = LabeledDataSequence[i].second;
+		}
+		CompactSymbolSequence.Pack(column, PackedSequence::WidthFor(NumSymbols()));
+		vector<pair<int,int> >().swap(LabeledDataSequence);
+	}
+	if(UnlabeledDataSequence.size() > 0){
+		CompactUnlabeledSequence.Pack(UnlabeledDataSequence, PackedSequence::WidthFor(NumSymbols()));
+		vector<int>().swap(UnlabeledDataSequence);
+	}
+
+	_isCompact = true;
+}
+
+/*
+Returns the number of bytes held by the sequence storage (not counting the symbol tables).
+*/
+unsigned long long DiscreteHmmDataset::NumBytes()
+{
+	unsigned long long bytes = 0;
+
+	bytes += LabeledDataSequence.capacity() * sizeof(pair<int,int>);
+	bytes += LabeledSequenceStarts.capacity() * sizeof(int);
+	bytes += UnlabeledDataSequence.capacity() * sizeof(int);
+	bytes += CompactStateSequence.NumBytes();
+	bytes += CompactSymbolSequence.NumBytes();
+	bytes += CompactUnlabeledSequence.NumBytes();
+
+	return bytes;
+}
+
 int DiscreteHmmDataset::AddState(const string& state)
 {
 	return _stateFlyweight.AddItem(state);
@@ -58,12 +128,13 @@ Builds dataset in memory from a file of training sequences formatted as
 */
 void DiscreteHmmDataset::BuildUnlabeledDataset(const string& path)
 {
+	PROFILE_SCOPE("BuildUnlabeledDataset");
 	int symbolId;
 	fstream testFile;
 	string line;
 	int lineNum;
 
-	//clear any existing data
+	//clear any existing data; the storage mode is retained
 	Clear();
 
 	testFile.open(path.c_str(),ios::in);
@@ -78,22 +149,28 @@ void DiscreteHmmDataset::BuildUnlabeledDataset(const string& path)
 			//put symbol in the flyweight
 			symbolId = _symbolFlyweight.AddItem(line);
 			//add symbol to the training sequence
-			UnlabeledDataSequence.push_back(symbolId);
+			if(_isCompact){
+				CompactUnlabeledSequence.Append(symbolId);
+			}
+			else{
+				UnlabeledDataSequence.push_back(symbolId);
+			}
 		}
 		else{
 			cout << "ERROR tab found in unsupervised data example, for file: " << path << endl;
 		}
 		lineNum++;
 	}
-	cout << "Dataset build completed. Dataset has num symbols/states: " << this->NumSymbols() << "/" << this->NumStates() << endl;
+	cout << "Dataset build completed. Dataset has num symbols/states: " << this->NumSymbols() << "/" << this->NumStates() << ", " << NumBytes() << " bytes" << endl;
 }
 
 /*
 Builds dataset in memory from a file of training sequences formatted as
-<emission symbol>\t<hidden state symbol>.
+<emission symbol>\t<hidden state symbol>, with a blank line after each sequence if there are several.
 */
 void DiscreteHmmDataset::BuildLabeledDataset(const string& path)
 {
+	PROFILE_SCOPE("BuildLabeledDataset");
 	int stateId, symbolId;
 	fstream testFile;
 	string line;
@@ -101,7 +178,7 @@ void DiscreteHmmDataset::BuildLabeledDataset(const string& path)
 	string state;
 	int tabIndex, lineNum;
 
-	//clear any existing data
+	//clear any existing data; the storage mode is retained
 	Clear();
 
 	testFile.open(path.c_str(),ios::in);
@@ -123,14 +200,26 @@ void DiscreteHmmDataset::BuildLabeledDataset(const string& path)
 			stateId = _stateFlyweight.AddItem(state);
 			symbolId = _symbolFlyweight.AddItem(symbol);
 			//add state:symbol pair to the training sequence
-			LabeledDataSequence.push_back(pair<int,int>(stateId,symbolId));
+			if(_isCompact){
+				CompactStateSequence.Append(stateId);
+				CompactSymbolSequence.Append(symbolId);
+			}
+			else{
+				LabeledDataSequence.push_back(pair<int,int>(stateId,symbolId));
+			}
+		}
+		else if(line.size() == 0){
+			//the end of a sequence: the next example starts a new one
+			if(NumInstances() > 0 && (LabeledSequenceStarts.empty() || LabeledSequenceStarts.back() != NumInstances())){
+				LabeledSequenceStarts.push_back(NumInstances());
+			}
 		}
 		else{
 			cout << "ERROR tabIndex not found in file: " << path << "  for line #" << lineNum << ": " << line << endl;
 		}
 		lineNum++;
 	}
-	cout << "Dataset build completed. Dataset has num symbols/states: " << this->NumSymbols() << "/" << this->NumStates() << endl;
+	cout << "Dataset build completed. Dataset has num symbols/states: " << this->NumSymbols() << "/" << this->NumStates() << ", " << NumBytes() << " bytes" << endl;
 }
 
 const string& DiscreteHmmDataset::GetSymbol(const int key)
@@ -143,6 +232,12 @@ const string& DiscreteHmmDataset::GetState(const int key)
 	return _stateFlyweight.KeyToItem(key);
 }
 
+//Returns the id of a symbol, or -1 if the symbol has not been added
+int DiscreteHmmDataset::GetSymbolKey(const string& symbol)
+{
+	return _symbolFlyweight.GetItemKey(symbol);
+}
+
 
 
 
@@ -3,6 +3,7 @@
 
 #include "Flyweight.hpp"
 #include "Flyweight.cpp"
+#include "PackedSequence.hpp"
 
 #include <string>
 #include <fstream>
@@ -28,6 +29,8 @@ This gives two primary input file formats, (1) supervised/labelled data and (2)
 	...
 
 Both files represent continuous sequences, such that successive lines represent sequential observations.
+In labelled files a blank line ends a sequence, as in the files written by SequenceSampler: the next line starts
+a new one, with no transition from the last (see LabeledSequenceStarts).
 
 So a hmm with part-of-speech latent variables and word emission values
 would look as follows:
@@ -40,6 +43,11 @@ TODO: Template the Dataset class (for string, char, etc) for the class labels.
 TODO: Encapsulate the supervised/unsupervised dataset states of this object; right now the HMM just uses it accordingly.
 
 Note that for unlabeled data, only observation/emissions are known to this class.
+
+Compact storage: by default sequences are held in the int vectors below (4 bytes per symbol, 8 per labeled pair).
+With SetCompactStorage(true), the Build methods instead fill the bit-packed sequences, whose width is the narrowest
+of 2/4/8/16 bits that fits NumSymbols() (or NumStates() for the state labels). Labeled data is then stored as two
+parallel packed sequences, one of states and one of symbols. Only one of the two representations is populated at a time.
 */
 class DiscreteHmmDataset{
 	public:
@@ -48,6 +56,10 @@ class DiscreteHmmDataset{
 		~DiscreteHmmDataset();
 		void BuildLabeledDataset(const string& path);
 		void BuildUnlabeledDataset(const string& path);
+		void SetCompactStorage(bool compact);
+		bool IsCompact();
+		void Compact();
+		unsigned long long NumBytes();
 		void Clear();
 		int NumStates();
 		int NumSymbols();
@@ -55,10 +67,18 @@ class DiscreteHmmDataset{
 		int AddSymbol(const string& symbol);
 		const string& GetSymbol(const int key);
 		const string& GetState(const int key);
+		int GetSymbolKey(const string& symbol);
 		int NumInstances();
 		vector<pair<int,int> > LabeledDataSequence;
+		//the positions in the labelled sequence (either storage) at which a sequence after the first one begins
+		vector<int> LabeledSequenceStarts;
 		vector<int> UnlabeledDataSequence;
+		//compact-storage counterparts of the above
+		PackedSequence CompactStateSequence;
+		PackedSequence CompactSymbolSequence;
+		PackedSequence CompactUnlabeledSequence;
 	private:
+		bool _isCompact;
 		Flyweight<string> _stateFlyweight;
 		Flyweight<string> _symbolFlyweight;
 };
@@ -0,0 +1,340 @@
+#include "DistributedBaumWelch.hpp"
+#include "SocketUtil.hpp"
+
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+
+DistributedBaumWelch::DistributedBaumWelch()
+{
+	_maxIterations = 100;
+	_convergence = 1.0;
+	_memoryBudget = 0;
+}
+
+DistributedBaumWelch::~DistributedBaumWelch()
+{}
+
+void DistributedBaumWelch::SetMaxIterations(const int maxIterations)
+{
+	_maxIterations = maxIterations;
+}
+
+/*
+Training stops once an iteration improves the total log-likelihood of the data by less than @convergence.
+*/
+void DistributedBaumWelch::SetConvergence(const double convergence)
+{
+	_convergence = convergence;
+}
+
+/*
+Starts training from the model in a .hmm file, eg to resume training, instead of a random model. The model must
+have the number of states given to RunCoordinator(), and every symbol of the shards.
+*/
+void DistributedBaumWelch::SetInitialModel(const string& modelPath)
+{
+	_initialModelPath = modelPath;
+}
+
+/*
+Limits the memory of a worker's E-step (see DiscreteHmm::SetMemoryBudget()). A shard which does not fit fails
+the whole training, rather than being left out of the counts.
+*/
+void DistributedBaumWelch::SetMemoryBudget(const unsigned long long bytes)
+{
+	_memoryBudget = bytes;
+}
+
+/*
+Sends a header line with the number of lines in @payload appended, followed by the payload.
+*/
+bool DistributedBaumWelch::_sendBlock(Peer& peer, const string& header, const string& payload)
+{
+	int numLines = 0;
+
+	for(int i = 0; i < payload.size(); i++){
+		if(payload[i] == '\n'){
+			numLines++;
+		}
+	}
+
+	return WriteAll(peer.fd, header + " " + to_string(numLines) + "\n" + payload);
+}
+
+/*
+Reads a block sent by _sendBlock(), whose header must be @expected. Returns false if the peer hung up, reported
+a failure, or sent something else.
+*/
+bool DistributedBaumWelch::_readBlock(Peer& peer, const string& expected, string& payload)
+{
+	int i, numLines;
+	string line, header;
+
+	if(!ReadLine(peer.fd, peer.pending, line)){
+		cout << "ERROR peer closed the connection while " << expected << " was expected" << endl;
+		return false;
+	}
+	istringstream in(line);
+	if(line.compare(0, 6, "FAILED") == 0){
+		cout << "ERROR peer failed while " << expected << " was expected: " << line.substr(min(line.size(), (size_t)7)) << endl;
+		return false;
+	}
+	if(!(in >> header >> numLines) || header != expected){
+		cout << "ERROR expected " << expected << ", received: " << line << endl;
+		return false;
+	}
+
+	payload.clear();
+	for(i = 0; i < numLines; i++){
+		if(!ReadLine(peer.fd, peer.pending, line)){
+			cout << "ERROR peer closed the connection during " << expected << endl;
+			return false;
+		}
+		payload += line + "\n";
+	}
+
+	return true;
+}
+
+void DistributedBaumWelch::_closeAll(vector<Peer>& peers)
+{
+	for(int i = 0; i < peers.size(); i++){
+		close(peers[i].fd);
+	}
+	peers.clear();
+}
+
+/*
+Waits for @numWorkers workers to connect on @address, then trains a model of @numStates hidden states
+over their shards, and writes it to @modelPath.
+*/
+bool DistributedBaumWelch::RunCoordinator(const string& address, const int numWorkers, const int numStates, const string& modelPath)
+{
+	int i, iteration, listenFd;
+	double delta, lastLikelihood;
+	bool converged;
+	string payload, symbol;
+	vector<string> symbols;
+	map<string,int> symbolIds;
+	vector<Peer> peers;
+	HmmCounts total, counts;
+	DiscreteHmm hmm;
+
+	hmm.SetVerbose(false);
+	if(_initialModelPath.size() > 0){
+		if(!hmm.ReadModel(_initialModelPath)){
+			cout << "ERROR could not read initial model " << _initialModelPath << endl;
+			return false;
+		}
+		if(hmm.NumStates() != numStates){
+			cout << "ERROR initial model has " << hmm.NumStates() << " states, not " << numStates << endl;
+			return false;
+		}
+		//the model's symbols keep their ids
+		for(i = 0; i < hmm.NumSymbols(); i++){
+			symbolIds[hmm.GetSymbolName(i)] = i;
+			symbols.push_back(hmm.GetSymbolName(i));
+		}
+	}
+
+	listenFd = ListenSocket(address);
+	if(listenFd < 0){
+		return false;
+	}
+
+	//collect every worker's symbols; ids are assigned in order of first appearance
+	cout << "Waiting for " << numWorkers << " workers on " << address << "..." << endl;
+	while(peers.size() < numWorkers){
+		Peer peer;
+		peer.fd = accept(listenFd, NULL, NULL);
+		if(peer.fd < 0){
+			continue;
+		}
+		peers.push_back(peer);
+		if(!_readBlock(peers.back(), "HELLO", payload)){
+			_closeAll(peers);
+			close(listenFd);
+			return false;
+		}
+		istringstream in(payload);
+		while(getline(in, symbol)){
+			if(symbolIds.count(symbol) == 0){
+				symbolIds[symbol] = symbols.size();
+				symbols.push_back(symbol);
+			}
+		}
+		cout << "Worker " << peers.size() << "/" << numWorkers << " connected" << endl;
+	}
+	close(listenFd);
+	if(!IsTcpAddress(address)){
+		unlink(address.c_str());
+	}
+	if(_initialModelPath.size() > 0 && symbols.size() != hmm.NumSymbols()){
+		cout << "ERROR the shards have " << symbols.size() - hmm.NumSymbols() << " symbols which are not in the initial model" << endl;
+		_closeAll(peers);
+		return false;
+	}
+
+	payload.clear();
+	for(i = 0; i < symbols.size(); i++){
+		payload += symbols[i] + "\n";
+	}
+	for(i = 0; i < peers.size(); i++){
+		if(!_sendBlock(peers[i], "SYMBOLS", payload)){
+			cout << "ERROR could not send symbols to worker " << i << endl;
+			_closeAll(peers);
+			return false;
+		}
+	}
+
+	if(_initialModelPath.size() == 0){
+		hmm.InitRandomModel(symbols, numStates);
+	}
+	cout << "Training " << numStates << " states over " << symbols.size() << " symbols on " << peers.size() << " workers" << endl;
+
+	converged = false;
+	lastLikelihood = -numeric_limits<double>::infinity();
+	for(iteration = 1; iteration <= _maxIterations && !converged; iteration++){
+		//broadcast the model, then gather and sum the expected counts
+		ostringstream model;
+		hmm.WriteParameters(model);
+		for(i = 0; i < peers.size(); i++){
+			if(!_sendBlock(peers[i], "MODEL", model.str())){
+				cout << "ERROR could not send model to worker " << i << endl;
+				_closeAll(peers);
+				return false;
+			}
+		}
+
+		total.Clear();
+		total.Resize(numStates, symbols.size());
+		for(i = 0; i < peers.size(); i++){
+			if(!_readBlock(peers[i], "COUNTS", payload)){
+				_closeAll(peers);
+				return false;
+			}
+			istringstream in(payload);
+			if(!counts.Read(in)){
+				_closeAll(peers);
+				return false;
+			}
+			total.Add(counts);
+		}
+
+		//the likelihood is that of the model just broadcast, so the M-step below is always one step past it
+		delta = total.LogLikelihood - lastLikelihood;
+		converged = iteration > 1 && delta < _convergence;
+		lastLikelihood = total.LogLikelihood;
+		hmm.MaximizeExpectedCounts(total);
+		cout << iteration << "\tln P(obs): " << total.LogLikelihood << "\tdelta: " << delta << endl;
+	}
+
+	for(i = 0; i < peers.size(); i++){
+		WriteAll(peers[i].fd, "DONE\n");
+	}
+	_closeAll(peers);
+
+	cout << "Distributed BaumWelch completed" << (converged ? "" : " (iteration limit reached)") << ", writing model to " << modelPath << endl;
+	hmm.WriteModel(modelPath, false);
+	hmm.PrintModel();
+
+	return true;
+}
+
+/*
+Connects to the coordinator at @address and runs the E-step over the unlabelled data in @dataPath
+for every model it sends, until it is done.
+*/
+bool DistributedBaumWelch::RunWorker(const string& address, const string& dataPath)
+{
+	int i, numIterations;
+	string payload, symbol, line;
+	vector<int> observations;
+	map<string,int> symbolIds;
+	HmmCounts counts;
+	DiscreteHmm hmm;
+	DiscreteHmmDataset dataset(dataPath, false);
+	Peer coordinator;
+
+	if(dataset.UnlabeledDataSequence.size() == 0){
+		cout << "ERROR no observations in shard " << dataPath << endl;
+		return false;
+	}
+
+	//the coordinator may not be listening yet
+	for(i = 0; (coordinator.fd = ConnectSocket(address)) < 0 && i < 50; i++){
+		usleep(100000);
+	}
+	if(coordinator.fd < 0){
+		cout << "ERROR could not connect to coordinator at " << address << endl;
+		return false;
+	}
+
+	payload.clear();
+	for(i = 0; i < dataset.NumSymbols(); i++){
+		payload += dataset.GetSymbol(i) + "\n";
+	}
+	if(!_sendBlock(coordinator, "HELLO", payload) || !_readBlock(coordinator, "SYMBOLS", payload)){
+		close(coordinator.fd);
+		return false;
+	}
+
+	//translate the shard into the coordinator's symbol ids
+	istringstream in(payload);
+	for(i = 0; getline(in, symbol); i++){
+		symbolIds[symbol] = i;
+	}
+	observations.resize(dataset.UnlabeledDataSequence.size());
+	for(i = 0; i < observations.size(); i++){
+		observations[i] = symbolIds[ dataset.GetSymbol(dataset.UnlabeledDataSequence[i]) ];
+	}
+	dataset.Clear();
+
+	hmm.SetVerbose(false);
+	hmm.SetMemoryBudget(_memoryBudget);
+	for(numIterations = 0; ; numIterations++){
+		if(!ReadLine(coordinator.fd, coordinator.pending, line)){
+			cout << "ERROR coordinator closed the connection" << endl;
+			close(coordinator.fd);
+			return false;
+		}
+		if(line == "DONE"){
+			break;
+		}
+		//push the header back and read the whole block
+		coordinator.pending = line + "\n" + coordinator.pending;
+		if(!_readBlock(coordinator, "MODEL", payload)){
+			close(coordinator.fd);
+			return false;
+		}
+
+		istringstream model(payload);
+		if(!hmm.ReadParameters(model)){
+			close(coordinator.fd);
+			return false;
+		}
+		counts.Clear();
+		counts.Resize(hmm.NumStates(), hmm.NumSymbols());
+		if(hmm.AccumulateExpectedCounts(observations, counts) > 0){
+			//partial counts would skew the model, so the coordinator must not use any
+			cout << "ERROR E-step failed over the " << observations.size() << " observations of shard " << dataPath << endl;
+			WriteAll(coordinator.fd, "FAILED E-step failed over shard " + dataPath + "\n");
+			close(coordinator.fd);
+			return false;
+		}
+
+		ostringstream out;
+		counts.Write(out);
+		if(!_sendBlock(coordinator, "COUNTS", out.str())){
+			cout << "ERROR could not send counts to coordinator" << endl;
+			close(coordinator.fd);
+			return false;
+		}
+	}
+	close(coordinator.fd);
+
+	cout << "Worker completed " << numIterations << " iterations over " << observations.size() << " observations" << endl;
+
+	return true;
+}
@@ -0,0 +1,63 @@
+#ifndef DISTRIBUTED_BAUM_WELCH_HPP
+#define DISTRIBUTED_BAUM_WELCH_HPP
+
+#include "Hmm.hpp"
+
+#include <map>
+
+using namespace std;
+
+/*
+Baum-Welch spread over several processes, each of which may run on a different machine. A single BaumWelch()
+process must hold the lattices of the entire training sequence; here each worker holds only its own shard.
+
+Every worker owns one shard of unlabelled data (a file in the DiscreteHmmDataset format), and runs the E-step
+over it: it sends the coordinator its expected counts (see HmmCounts and DiscreteHmm::AccumulateExpectedCounts()).
+The coordinator sums the counts of all shards, runs the M-step, and broadcasts the new model, until the total
+log-likelihood converges. Each shard is treated as an independent sequence, as in multiple-sequence Baum-Welch,
+so the transition spanning two shards is not counted.
+
+Protocol: newline-terminated text over a stream socket (a Unix socket path, or host:port; see SocketUtil).
+Multi-line payloads are preceded by a header giving their number of lines:
+
+	worker:       HELLO <numSymbols>, then one symbol name per line
+	coordinator:  SYMBOLS <numSymbols>, then one symbol name per line: the union of all the shards' symbols,
+	              in which ids all further messages are given
+	coordinator:  MODEL <numLines>, then the model parameters (see DiscreteHmm::WriteParameters())
+	worker:       COUNTS <numLines>, then the expected counts of its shard (see HmmCounts::Write())
+	...
+	coordinator:  DONE
+
+A worker whose E-step fails (eg, its shard is over the memory budget) sends FAILED <reason> instead of COUNTS
+and exits; the coordinator then stops training without updating the model from the other shards' counts.
+
+Workers may be started before the coordinator: they retry the connection for a few seconds.
+*/
+class DistributedBaumWelch{
+	public:
+		DistributedBaumWelch();
+		~DistributedBaumWelch();
+		bool RunCoordinator(const string& address, const int numWorkers, const int numStates, const string& modelPath);
+		bool RunWorker(const string& address, const string& dataPath);
+		void SetMaxIterations(const int maxIterations);
+		void SetConvergence(const double convergence);
+		void SetInitialModel(const string& modelPath);
+		void SetMemoryBudget(const unsigned long long bytes);
+	private:
+		struct Peer{
+			int fd;
+			string pending;
+		};
+		bool _sendBlock(Peer& peer, const string& header, const string& payload);
+		bool _readBlock(Peer& peer, const string& expected, string& payload);
+		void _closeAll(vector<Peer>& peers);
+
+		int _maxIterations;
+		double _convergence;
+		//the model training starts from, if not random; see SetInitialModel()
+		string _initialModelPath;
+		//the worker's memory budget; see SetMemoryBudget()
+		unsigned long long _memoryBudget;
+};
+
+#endif
@@ -68,7 +68,7 @@ int Flyweight<T>::GetItemKey(const T& item)
 	typename map< T,int>::iterator key = _forwardTable.find(item);
 
 	if(key != _forwardTable.end()){
-		return *key;
+		return key->second;
 	}
 	
 	return -1;
@@ -1,7 +1,20 @@
 #include "Hmm.hpp"
 
 DiscreteHmm::DiscreteHmm()
-{}
+{
+	_memoryBudget = 0;
+	_peakMemory = 0;
+	_modelVersion = 0;
+	_verbose = true;
+	SetSimd(true);
+	_fusedEStep = true;
+	_pruneEmissions = true;
+	_accelerateEM = false;
+	_maxIterations = 100;
+	_convergence = 1.0;
+	_randomSeed = 0;
+	ResetForward();
+}
 
 /*
 Consumes a pre-made model contained in a .hmm file, formatted as:
@@ -15,6 +28,18 @@ Consumes a pre-made model contained in a .hmm file, formatted as:
 */
 DiscreteHmm::DiscreteHmm(const string& modelPath)
 {
+	_memoryBudget = 0;
+	_peakMemory = 0;
+	_modelVersion = 0;
+	_verbose = true;
+	SetSimd(true);
+	_fusedEStep = true;
+	_pruneEmissions = true;
+	_accelerateEM = false;
+	_maxIterations = 100;
+	_convergence = 1.0;
+	_randomSeed = 0;
+	ResetForward();
 	ReadModel(modelPath);
 }
 
@@ -32,6 +57,7 @@ is very likely to be updated.
 */
 bool DiscreteHmm::ReadModel(const string& modelPath)
 {
+	PROFILE_SCOPE("ReadModel");
 	int i, j;
 	bool result = true;
 	string line;
@@ -52,7 +78,9 @@ bool DiscreteHmm::ReadModel(const string& modelPath)
 		if(line.length() > 0 && line[0]!= '#'){
 			param = line.substr(0,line.find('='));
 			argstr = line.substr(line.find('=')+1, line.length() - line.find('=') - 1);
-			cout << "param+args:" << param << ":" << argstr << endl;
+			if(_verbose){
+				cout << "param+args:" << param << ":" << argstr << endl;
+			}
 			if(param == "X"){
 				//get the emission labels
 				_split(argstr,',',args);
@@ -91,7 +119,9 @@ bool DiscreteHmm::ReadModel(const string& modelPath)
 				for(i = 0; i < args.size(); i++){
 					_split(args[i],',',row);
 					if(_transitionMatrix.NumRows() < args.size()){
-						cout << "Resizing trans dim from " << _transitionMatrix.NumRows() << " to " << row.size() << endl;
+						if(_verbose){
+							cout << "Resizing trans dim from " << _transitionMatrix.NumRows() << " to " << row.size() << endl;
+						}
 						_transitionMatrix.Resize(args.size(),row.size());
 						_transitionMatrix.Reset();
 					}
@@ -122,8 +152,11 @@ bool DiscreteHmm::ReadModel(const string& modelPath)
 	if(!result){
 		cout << "ERROR model may not have imported correctly" << endl;
 	}
+	_onModelUpdated();
 
-	PrintModel();
+	if(_verbose){
+		PrintModel();
+	}
 
 	return result;
 }
@@ -171,7 +204,9 @@ void DiscreteHmm::_split(const string& str, const char delim, vector<string>& to
 			indices.push_back(i);
 		}
 	}
-	cout << "got " << indices.size() << " indices from " << str << endl;
+	if(_verbose){
+		cout << "got " << indices.size() << " indices from " << str << endl;
+	}
 
 	for(prev = 0, i = 0; i < indices.size(); i++){
 		temp = str.substr(prev,indices[i]-prev);
@@ -184,11 +219,301 @@ void DiscreteHmm::_split(const string& str, const char delim, vector<string>& to
 		tokens.push_back(temp);
 	}
 
-	cout << "split got " << tokens.size() << " tokens: ";
-	for(i = 0; i < tokens.size(); i++){
-		cout << tokens[i] << " ";
+	if(_verbose){
+		cout << "split got " << tokens.size() << " tokens: ";
+		for(i = 0; i < tokens.size(); i++){
+			cout << tokens[i] << " ";
+		}
+		cout << endl;
 	}
-	cout << endl;
+}
+
+/*
+Sets the maximum number of bytes any single lattice-based algorithm may allocate. When the full lattice of
+an algorithm would exceed this budget, a lower-memory variant is used instead:
+	-Viterbi(): checkpointed Viterbi, O(N*sqrt(T))
+	-ForwardAlgorithm() and BackwardAlgorithm(): two rolling columns; the lattice is not retained
+	-BaumWelch(): the fused E-step, if SetFusedEStep(false) selected the one materializing the xi matrices
+If no variant fits, the call fails fast, before allocating anything, with an error naming the bytes it needed;
+this includes the algorithms which need a full lattice (PosteriorDecode(), AccumulateExpectedCounts(),
+KBestViterbi()). See EstimateMemory() for the bytes each operation needs.
+Passing 0 removes the limit.
+*/
+void DiscreteHmm::SetMemoryBudget(unsigned long long bytes)
+{
+	_memoryBudget = bytes;
+}
+
+/*
+Returns the bytes of lattice and workspace an operation would allocate for a model of @numStates states and
+@numSymbols symbols, on a sequence of @length observations, under the current memory budget and settings
+(ie, for the variant that would run; see SetMemoryBudget()). For MEMORY_BAUM_WELCH this is one iteration on
+the whole sequence. MEMORY_DATASET_LOAD is the unlabelled sequence a DiscreteHmmDataset holds for @length
+observations; a labelled dataset holds twice as much. Model parameters and labels are not included.
+
+If the result exceeds the budget, the operation will fail.
+*/
+unsigned long long DiscreteHmm::EstimateMemory(const MemoryOperation op, const int numStates, const int numSymbols, const unsigned long long length)
+{
+	unsigned long long n = numStates, m = numSymbols, column, full, segLen;
+
+	column = n * sizeof(double);
+	switch(op){
+		case MEMORY_FORWARD:
+		case MEMORY_BACKWARD:
+			//the lattice and a scratch column, or three rolling columns
+			full = _latticeBytes(n, length, sizeof(double));
+			if(_memoryBudget > 0 && full > _memoryBudget){
+				return 3 * column;
+			}
+			return full + column;
+		case MEMORY_VITERBI:
+			full = _latticeBytes(n, length, sizeof(double)) + _latticeBytes(n, length, sizeof(int));
+			if(_memoryBudget > 0 && full > _memoryBudget){
+				//checkpoints every segLen columns, one segment of backpointers, and the rolling columns
+				segLen = (unsigned long long)ceil(sqrt((double)length));
+				return _latticeBytes(n, (length + segLen - 1) / segLen, sizeof(double)) + _latticeBytes(n, segLen + 1, sizeof(int)) + 2 * column + n * sizeof(int);
+			}
+			return full;
+		case MEMORY_BAUM_WELCH:
+			full = _baumWelchBytes(n, m, length, false);
+			if(!_fusedEStep && (_memoryBudget == 0 || full <= _memoryBudget)){
+				return full;
+			}
+			return _baumWelchBytes(n, m, length, true);
+		case MEMORY_DATASET_LOAD:
+			return length * sizeof(int);
+	}
+
+	return 0;
+}
+
+/*
+The bytes of one BaumWelch() iteration over @length observations, with the fused E-step (the alpha lattice, the
+expected counts, and four columns) or without it (alpha, beta and gamma lattices, and a xi matrix per time step).
+*/
+unsigned long long DiscreteHmm::_baumWelchBytes(const unsigned long long numStates, const unsigned long long numSymbols, const unsigned long long length, const bool fused)
+{
+	if(fused){
+		return _latticeBytes(numStates, length, sizeof(double)) + (numStates + numStates * numStates + numStates * numSymbols) * sizeof(double) + 4 * numStates * sizeof(double);
+	}
+
+	return 3 * _latticeBytes(numStates, length, sizeof(double)) + length * (sizeof(Matrix<double>) + _latticeBytes(numStates, numStates, sizeof(double))) + numStates * numStates * sizeof(double);
+}
+
+/*
+The bytes of a ColumnMatrix (or Matrix) of @cols vectors of @rows elements.
+*/
+unsigned long long DiscreteHmm::_latticeBytes(const unsigned long long rows, const unsigned long long cols, const unsigned long long elementBytes)
+{
+	return cols * (rows * elementBytes + sizeof(vector<double>));
+}
+
+/*
+Returns the bytes currently held by the model's lattices, xi matrices, incremental forward state and prefix cache.
+The lattices are kept between calls and only ever grow, so this is the largest of them seen since Clear().
+*/
+unsigned long long DiscreteHmm::CurrentMemory()
+{
+	unsigned long long bytes;
+
+	bytes = _alphaLattice.Bytes() + _betaLattice.Bytes() + _viterbiLattice.Bytes() + _ptrLattice.Bytes() + _gammaLattice.Bytes();
+	bytes += _xiMatrices.capacity() * sizeof(Matrix<double>);
+	for(int i = 0; i < _xiMatrices.size(); i++){
+		bytes += _xiMatrices[i].Bytes();
+	}
+	bytes += _incrementalAlpha.capacity() * sizeof(double) + _prefixCache.Bytes();
+
+	return bytes;
+}
+
+/*
+Returns the most memory held at once by the lattice algorithms since ResetPeakMemory(): CurrentMemory() plus the
+workspace of the algorithm running at the time.
+*/
+unsigned long long DiscreteHmm::PeakMemory()
+{
+	return _peakMemory;
+}
+
+void DiscreteHmm::ResetPeakMemory()
+{
+	_peakMemory = CurrentMemory();
+}
+
+/*
+Returns true if @bytes fit within the memory budget; otherwise reports an error for @caller.
+*/
+bool DiscreteHmm::_withinBudget(const unsigned long long bytes, const string& caller)
+{
+	if(_memoryBudget > 0 && bytes > _memoryBudget){
+		cout << "ERROR " << caller << " needs " << bytes << " bytes, over the memory budget of " << _memoryBudget << " bytes" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+Records the memory in use by an algorithm, after its allocations: the model's lattices plus @workspaceBytes of
+local storage.
+*/
+void DiscreteHmm::_trackMemory(const unsigned long long workspaceBytes)
+{
+	unsigned long long bytes = CurrentMemory() + workspaceBytes;
+
+	if(bytes > _peakMemory){
+		_peakMemory = bytes;
+	}
+}
+
+/*
+Enables caching of the forward and Viterbi lattice columns of observation prefixes, for workloads where many
+queries share a prefix. A query reuses the columns of the longest cached prefix of its observations, copying
+them into the lattice instead of recomputing them (O(N) per column instead of O(N^2)), and computes only the rest.
+Results are bit-identical to the uncached algorithms, since the cached columns are the ones they would compute.
+
+@budgetBytes: bound on the cache's memory; least recently used prefixes are evicted beyond it. 0 disables the cache.
+@maxDepth: prefixes longer than this are not cached.
+
+The cache is dropped whenever the model changes. The checkpointed Viterbi variant (see SetMemoryBudget()) bypasses it.
+*/
+void DiscreteHmm::SetPrefixCache(unsigned long long budgetBytes, const int maxDepth)
+{
+	_prefixCache.Configure(budgetBytes, maxDepth);
+}
+
+/*
+Returns the prefix cache's counters: hit rate, columns saved and computed, memory use and evictions.
+*/
+string DiscreteHmm::PrefixCacheStats()
+{
+	return _prefixCache.StatsString();
+}
+
+/*
+Enables or disables the informational output of model loading and the lattice algorithms.
+Errors are always reported. Long-running services should disable this.
+*/
+void DiscreteHmm::SetVerbose(bool verbose)
+{
+	_verbose = verbose;
+}
+
+/*
+Enables or disables the vectorized (AVX2) inner loops. They are only used if the CPU supports them; otherwise,
+or if disabled, the scalar loops are used. Results are bit-identical either way.
+*/
+void DiscreteHmm::SetSimd(bool enable)
+{
+#ifdef HMM_X86_SIMD
+	_useSimd = enable && __builtin_cpu_supports("avx2");
+#else
+	_useSimd = false;
+#endif
+}
+
+/*
+Selects the log-space arithmetic of the model's algorithms: exact (the default), or the table-driven
+approximations of LogMath with an absolute log-space error of at most @maxError per operation.
+Applies to the log-sum-exp of the lattice recurrences and the exponentials of the fused E-step.
+Lattice columns computed in the previous mode (the prefix cache, incremental forward state) are invalidated.
+*/
+void DiscreteHmm::SetLogMath(const LogMathMode mode, const double maxError)
+{
+	_logMath.SetMode(mode, maxError);
+	_modelVersion++;
+}
+
+/*
+Selects the E-step used by BaumWelch(): the fused E-step (the default), or the original one which materializes
+the beta lattice and xi matrices. Both give the same model, up to rounding.
+*/
+void DiscreteHmm::SetFusedEStep(bool fused)
+{
+	_fusedEStep = fused;
+}
+
+/*
+Enables or disables emission pruning (enabled by default). A state that cannot emit o_t has alpha_t = delta_t = 0,
+so a step of the recurrences only needs the source states that can emit the previous observation, and the
+destination states that can emit the current one. Supervised models of large tagsets are mostly zero emissions
+(each word is seen with a few tags), so this is a fraction of the N^2 work of a full step.
+
+Steps are pruned only when the two state lists make at most half the work of a full step; denser steps use the
+full loops, including the vectorized Viterbi kernel. Probabilities and Viterbi paths are identical either way: the
+pruned terms are exactly zero. The exception is the backpointers of states which cannot emit their observation,
+which only matter when the sequence is impossible (P = 0). beta_t(j) does not depend on o_t, so the backward
+recursion prunes only the destination states (see BackwardAlgorithm()), and its lattice is exact.
+*/
+void DiscreteHmm::SetEmissionPruning(bool enable)
+{
+	_pruneEmissions = enable;
+}
+
+/*
+Enables or disables SQUAREM acceleration of BaumWelch() and StreamingBaumWelch() (disabled by default).
+Each cycle takes two plain EM updates and extrapolates along them, which converges in far fewer passes over
+the data when plain EM crawls; extrapolations that lower the likelihood are rejected for the plain update.
+The accelerated loop always uses the fused E-step. See _acceleratedBaumWelch().
+*/
+void DiscreteHmm::SetAcceleratedEM(bool accelerate)
+{
+	_accelerateEM = accelerate;
+}
+
+/*
+Sets the stopping criteria of BaumWelch(), StreamingBaumWelch() and ViterbiTrain(): at most @maxIterations
+iterations (passes over the data, if accelerated), stopping early once an iteration improves the log-likelihood
+by less than @convergence. The defaults are 100 and 1.0; a @convergence of -infinity runs every iteration.
+*/
+void DiscreteHmm::SetTrainingLimits(const int maxIterations, const double convergence)
+{
+	_maxIterations = maxIterations;
+	_convergence = convergence;
+}
+
+/*
+Seeds the random initial models of BaumWelch(), ViterbiTrain(), StreamingBaumWelch() and InitRandomModel(), so
+training can be reproduced. A seed of 0 (the default) seeds from the clock.
+*/
+void DiscreteHmm::SetRandomSeed(const unsigned int seed)
+{
+	_randomSeed = seed;
+}
+
+int DiscreteHmm::NumStates()
+{
+	return _stateMatrix.NumRows();
+}
+
+int DiscreteHmm::NumSymbols()
+{
+	return _transitionMatrix.NumCols();
+}
+
+/*
+Returns the id of a named emission symbol, or -1 if the symbol is not part of the model.
+*/
+int DiscreteHmm::GetSymbolId(const string& symbol)
+{
+	return _dataset.GetSymbolKey(symbol);
+}
+
+/*
+Returns the name of a hidden state, given its id.
+*/
+const string& DiscreteHmm::GetStateName(const int state)
+{
+	return _dataset.GetState(state);
+}
+
+/*
+Returns the name of an emission symbol, given its id.
+*/
+const string& DiscreteHmm::GetSymbolName(const int symbol)
+{
+	return _dataset.GetSymbol(symbol);
 }
 
 /*
@@ -203,9 +528,13 @@ void DiscreteHmm::Clear()
 	_ptrLattice.Clear();
 	_stateMatrix.Clear();
 	_transitionMatrix.Clear();
+	_emissionsBySymbol.Clear();
 	_pi.clear();
 	_gammaLattice.Clear();
 	_xiMatrices.clear();
+	_incrementalAlpha.clear();
+	_incrementalLength = 0;
+	_counts.Clear();
 }
 
 /*
@@ -219,6 +548,65 @@ void DiscreteHmm::_resizeModel(int numStates, int numSymbols)
 	_transitionMatrix.Resize(numStates, numSymbols);
 }
 
+/*
+Must be called whenever the model parameters (pi, A, B) change, ie after training, loading, or initialization.
+Rebuilds the structures derived from the model.
+*/
+void DiscreteHmm::_onModelUpdated()
+{
+	_syncEmissionLayout();
+	_buildEmissionSupport();
+	//invalidates any state computed with the previous parameters, eg incremental forward columns
+	_modelVersion++;
+}
+
+/*
+Builds the symbol-major copy of the emission matrix: row k holds the N ln-emission probabilities of symbol k,
+one per state. The recurrences read all states' emission probabilities for a single symbol at every time step,
+which is a strided walk down a column of the state-major _transitionMatrix, but is one contiguous row here.
+*/
+void DiscreteHmm::_syncEmissionLayout()
+{
+	int i, j;
+
+	_emissionsBySymbol.Resize(_transitionMatrix.NumCols(), _transitionMatrix.NumRows());
+	for(i = 0; i < _transitionMatrix.NumRows(); i++){
+		for(j = 0; j < _transitionMatrix.NumCols(); j++){
+			_emissionsBySymbol[j][i] = _transitionMatrix[i][j];
+		}
+	}
+}
+
+/*
+Builds the per-symbol lists of states with non-zero emission probability (ln-probability > -inf), used to
+prune the recurrences; see SetEmissionPruning().
+*/
+void DiscreteHmm::_buildEmissionSupport()
+{
+	int i, j;
+
+	_statesBySymbol.resize(_emissionsBySymbol.NumRows());
+	for(i = 0; i < _emissionsBySymbol.NumRows(); i++){
+		_statesBySymbol[i].clear();
+		for(j = 0; j < _emissionsBySymbol.NumCols(); j++){
+			if(_emissionsBySymbol[i][j] != -numeric_limits<double>::infinity()){
+				_statesBySymbol[i].push_back(j);
+			}
+		}
+	}
+}
+
+/*
+Returns true if the step from observation @previous to @observation should visit only the states that can emit
+them: pruning is enabled, and the pruned step is at most half the work of a full N x N step.
+*/
+bool DiscreteHmm::_pruneStep(const int previous, const int observation)
+{
+	unsigned long long numStates = _stateMatrix.NumRows();
+
+	return _pruneEmissions && previous >= 0 && (unsigned long long)_statesBySymbol[previous].size() * (unsigned long long)_statesBySymbol[observation].size() * 2 <= numStates * numStates;
+}
+
 /*
 Outputs an HMM model (lambda) to a file. The order of the pi, X, and Y variables
 corresponds with the rows/columns of A and B matrices.
@@ -349,11 +737,38 @@ Implements backward algorithm from Rabiner.
 @observations: The observation sequence
 @t: The column at which to stop; typically one should pass zero, to initialize the entire backward matrix. I left the
 parameter here for the sum-product algorithm.
+
+With emission pruning (see SetEmissionPruning()), the sum for beta_i(j) runs only over the states that can emit
+observation i+1, since b_k(o_i+1) is zero for the others. Every beta_i(j) is still computed, including for states
+which cannot emit o_i: beta_i(j) = P(o_i+1..T | q_i = j) does not depend on o_i, and the lattice is public (see
+CopyBackwardLattice()). A pruned step is N * |states emitting o_i+1|; it is taken when that is at most half of N^2.
+
+If the lattice would exceed the memory budget (see SetMemoryBudget()), only two columns are kept while computing
+it, and the result is the sum over column @t.
 */
 double DiscreteHmm::BackwardAlgorithm(const vector<int>& observations, const int t)
 {
-	int i, j, k;
+	return _backwardAlgorithm(observations, t);
+}
+
+double DiscreteHmm::BackwardAlgorithm(const PackedSequence& observations, const int t)
+{
+	return _backwardAlgorithm(observations, t);
+}
+
+double DiscreteHmm::BackwardAlgorithm(const SequenceView& observations, const int t)
+{
+	return _backwardAlgorithm(observations, t);
+}
+
+template<typename SequenceT>
+double DiscreteHmm::_backwardAlgorithm(const SequenceT& observations, const int t)
+{
+	PROFILE_SCOPE("BackwardAlgorithm");
+	int i, j, k, d;
+	bool rolling;
 	vector<double> temp;
+	vector<double> rollingCols[2];
 	double b, pObs;
 
 	if(t < 0 || t >= observations.size()){
@@ -361,26 +776,56 @@ double DiscreteHmm::BackwardAlgorithm(const vector<int>& observations, const int
 		return 1;
 	}
 
-	//Resize and reset matrix to all zeroes
-	_betaLattice.Resize(_stateMatrix.NumRows(), observations.size());
+	//Resize and reset matrix to all zeroes, unless it does not fit in the budget; then columns alternate in rollingCols
+	rolling = _memoryBudget > 0 && _latticeBytes(_stateMatrix.NumRows(), observations.size(), sizeof(double)) > _memoryBudget;
+	if(rolling){
+		if(!_withinBudget(EstimateMemory(MEMORY_BACKWARD, _stateMatrix.NumRows(), _transitionMatrix.NumCols(), observations.size()), "BackwardAlgorithm()")){
+			return 1;
+		}
+		rollingCols[0].resize(_stateMatrix.NumRows());
+		rollingCols[1].resize(_stateMatrix.NumRows());
+	}
+	else{
+		_betaLattice.Resize(_stateMatrix.NumRows(), observations.size());
+	}
 	temp.resize(_stateMatrix.NumRows());
+	_trackMemory((rolling ? 3 : 1) * _stateMatrix.NumRows() * sizeof(double));
 
 	//init last column of beta matrix to 1.0 (which is 0.0, in logarithm land)
-	vector<double>& lastCol = _betaLattice.GetColumn(_betaLattice.NumCols()-1);
+	vector<double>& lastCol = rolling ? rollingCols[(observations.size()-1) % 2] : _betaLattice.GetColumn(observations.size()-1);
 	for(i = 0; i < lastCol.size(); i++){
 		lastCol[i] = 0; //set all to 0 in log-prob space; in linear space, this is probability 1.0
 	}
 
 	//Induction
 	for(i = observations.size() - 2; i >= t; i--){
-		vector<double>& leftCol = _betaLattice[i];
-		vector<double>& rightCol = _betaLattice[i+1];
+		vector<double>& leftCol = rolling ? rollingCols[i % 2] : _betaLattice[i];
+		vector<double>& rightCol = rolling ? rollingCols[(i+1) % 2] : _betaLattice[i+1];
+		const vector<double>& emissions = _emissionsBySymbol[ observations[i+1] ];
+		if(_pruneEmissions && _statesBySymbol[ observations[i+1] ].size() * 2 <= leftCol.size()){
+			//every state needs its beta value, but only states that can emit o_i+1 contribute to them
+			const vector<int>& destinations = _statesBySymbol[ observations[i+1] ];
+			temp.resize(destinations.size());
+			for(j = 0; j < leftCol.size(); j++){
+				b = MIN_DOUBLE;
+				for(d = 0; d < destinations.size(); d++){
+					k = destinations[d];
+					temp[d] = (_stateMatrix[j][k] + rightCol[k] + emissions[k]);
+					if(temp[d] > b){
+						b = temp[d];
+					}
+				}
+				leftCol[j] = _logSumExp(temp,b);
+			}
+			temp.resize(_stateMatrix.NumRows());
+			continue;
+		}
 		//iterate states in the left column
 		for(j = 0; j < leftCol.size(); j++){
 			b = MIN_DOUBLE; //some very large negative number
 			//sum over right states given left-state j; given the current left state
 			for(k = 0; k < rightCol.size(); k++){
-				temp[k] = (_stateMatrix[j][k] + rightCol[k] + _transitionMatrix[k][ observations[i+1] ]);
+				temp[k] = (_stateMatrix[j][k] + rightCol[k] + emissions[k]);
 				if(temp[k] > b){
 					b = temp[k];
 				}
@@ -392,7 +837,7 @@ double DiscreteHmm::BackwardAlgorithm(const vector<int>& observations, const int
 	}
 
 	//Termination: probability of the observaton is given by the sum over the states in the leftmost column (t=0)
-	vector<double>& firstCol = _betaLattice.GetColumn(0);
+	vector<double>& firstCol = rolling ? rollingCols[t % 2] : _betaLattice.GetColumn(0);
 	b = MIN_DOUBLE;
 	for(i = 0; i < firstCol.size(); i++){
 		if(firstCol[i] > b){
@@ -401,7 +846,9 @@ double DiscreteHmm::BackwardAlgorithm(const vector<int>& observations, const int
 	}
 
 	pObs = _logSumExp(firstCol,b);
-	cout << "Backward algorithm completed. P(observation): " << pObs << endl;
+	if(_verbose){
+		cout << "Backward algorithm completed. P(observation): " << pObs << endl;
+	}
 
 	return pObs;
 }
@@ -421,6 +868,10 @@ double DiscreteHmm::_logSumExp(const vector<double>& vec, double b)
 {
 	double sum = 0;
 
+	if(_logMath.Mode() == LOGMATH_FAST){
+		return _logMath.LogSumExp(vec, b);
+	}
+
 	//handle the zero prob exceptions
 	if(b == -numeric_limits<double>::infinity()){
 		//largest probability is zero (-inf in ln space), so return zero and avert exceptions from exp() function
@@ -453,8 +904,11 @@ I just generated values from scipy's logsumexp function for verification.
 	>>> X = [math.log(float(x)) for x in range(1,101)]
 	>>> misc.logsumexp(X)
 	8.5271435222694052
+
+Uses the model's log math (see SetLogMath()), so the allowed error is the log math's bound for LogSumExp().
+Returns true if the result is within it.
 */
-void DiscreteHmm::_testLogSumExp()
+bool DiscreteHmm::TestLogSumExp()
 {
 	double result, expected, maxX;
 	vector<double> X;
@@ -470,6 +924,8 @@ void DiscreteHmm::_testLogSumExp()
 	cout << "LogSumExp result: " << result << endl;
 	cout << "LogSumExp expected result: " << expected << endl;
 	cout << "Delta: " << fabs(expected - result) << endl;
+
+	return fabs(expected - result) <= 2 * _logMath.MaxError() + 1E-12;
 }
 
 /*
@@ -479,501 +935,2721 @@ Implements forward algorithm from Rabiner.
 on exit, the t-th column (columns counted from 0) will contain inductively defined values of forward alg.
 
 Returns the sum of calculated values in the t-th column. On exit, _alphaLattice will retain all forward probability
-values for this observation as well.
+values for this observation as well, unless the lattice would exceed the memory budget (see SetMemoryBudget()),
+in which case only two columns are kept while computing it.
 */
 double DiscreteHmm::ForwardAlgorithm(const vector<int>& observations, const int t)
 {
-	int i, j, k;
+	return _forwardAlgorithm(observations, t);
+}
+
+double DiscreteHmm::ForwardAlgorithm(const PackedSequence& observations, const int t)
+{
+	return _forwardAlgorithm(observations, t);
+}
+
+double DiscreteHmm::ForwardAlgorithm(const SequenceView& observations, const int t)
+{
+	return _forwardAlgorithm(observations, t);
+}
+
+template<typename SequenceT>
+double DiscreteHmm::_forwardAlgorithm(const SequenceT& observations, const int t)
+{
+	PROFILE_SCOPE("ForwardAlgorithm");
+	int i, cached, numStates;
+	vector<int> path;
 	vector<double> temp;
-	double b, pObs;
+	double pObs;
 
-	if(t < 1 || t >= observations.size()){
+	if(t < 0 || t >= observations.size()){
 		cout << "ERROR insufficient t value in ForwardAlgorithm() t=" << t << endl;
 		return 1;
 	}
 
+	numStates = _stateMatrix.NumRows();
+	temp.resize(numStates);
+	if(_memoryBudget > 0 && _latticeBytes(numStates, observations.size(), sizeof(double)) > _memoryBudget){
+		//the lattice does not fit: roll two columns, without the lattice (or the prefix cache, which copies from it)
+		if(!_withinBudget(EstimateMemory(MEMORY_FORWARD, numStates, _transitionMatrix.NumCols(), observations.size()), "ForwardAlgorithm()")){
+			return 1;
+		}
+		vector<double> leftCol(numStates), rightCol(numStates);
+		const vector<double>& firstEmissions = _emissionsBySymbol[ observations[0] ];
+		for(i = 0; i < numStates; i++){
+			leftCol[i] = _pi[i] + firstEmissions[i];
+		}
+		for(i = 1; i <= t; i++){
+			_forwardColumn(leftCol, rightCol, observations[i-1], observations[i], temp);
+			leftCol.swap(rightCol);
+		}
+		_trackMemory(3 * numStates * sizeof(double));
+		pObs = _columnLogSum(leftCol);
+		if(_verbose){
+			cout << "Forward algorithm completed. P(observation): " << pObs << endl;
+		}
+		return pObs;
+	}
+
 	//Resize matrix to all zeroes
-	_alphaLattice.Resize(_stateMatrix.NumRows(), observations.size());
-	temp.resize(_alphaLattice.NumRows());
+	_alphaLattice.Resize(numStates, observations.size());
+	_trackMemory(numStates * sizeof(double));
+
+	//resume from the longest cached prefix, if any
+	cached = 0;
+	if(_prefixCache.Enabled()){
+		cached = _lookupPrefix(observations, t + 1, false, path);
+		for(i = 0; i < cached; i++){
+			_alphaLattice[i] = _prefixCache.Alpha(path[i]);
+		}
+	}
 
 	//init left-most column of alpha matrix to initial probs, given first observation
-	for(i = 0 ; i < _stateMatrix.NumRows(); i++){
-		_alphaLattice[0][i] = _pi[i] + _transitionMatrix[i][ observations[0] ];
+	if(cached == 0){
+		const vector<double>& firstEmissions = _emissionsBySymbol[ observations[0] ];
+		for(i = 0 ; i < _stateMatrix.NumRows(); i++){
+			_alphaLattice[0][i] = _pi[i] + firstEmissions[i];
+		}
 	}
 
 	//Induction, from 1 to t
-	for(i = 1; i <= t; i++){
-		vector<double>& leftCol = _alphaLattice[i-1];
-		vector<double>& rightCol = _alphaLattice[i];
-		//foreach state in right column
-		for(j = 0; j < rightCol.size(); j++){
-			b = MIN_DOUBLE; //some very large negative number
-			//iterate the previous k states, given the current state j
-			for(k = 0; k < leftCol.size(); k++){
-				temp[k] = (_stateMatrix[k][j] + leftCol[k]); // p(S_k -> S_j) * alpha_k
-				if(temp[k] > b){
-					b = temp[k];
-				}
-			} //end-for: temp now contains all a_i's for log-sum-exp, and we have b, the max of them
-			//now run the log-sum-exp trick
-			rightCol[j] = _logSumExp(temp,b);
-			//lastly, multiply the observation probability back in, which was factored out of forward calculations
-			rightCol[j] += _transitionMatrix[j][ observations[i] ];
-		}
+	for(i = cached > 0 ? cached : 1; i <= t; i++){
+		_forwardColumn(_alphaLattice[i-1], _alphaLattice[i], observations[i-1], observations[i], temp);
 	}
 
-	//Termination
-	vector<double>& lastCol = _alphaLattice.GetColumn( _alphaLattice.NumCols()-1 );
-	b = MIN_DOUBLE;
-	for(i = 0; i < lastCol.size(); i++){
-		if(lastCol[i] > b){
-			b = lastCol[i];
-		}
+	if(_prefixCache.Enabled()){
+		_prefixCache.Record(cached, t + 1 - cached);
+		_storePrefix(observations, t + 1, false, path);
 	}
 
-	pObs = _logSumExp(lastCol,b);
-	cout << "Forward algorithm completed. P(observation): " << pObs << endl;
+	//Termination
+	pObs = _columnLogSum(_alphaLattice.GetColumn(t));
+	if(_verbose){
+		cout << "Forward algorithm completed. P(observation): " << pObs << endl;
+	}
 
 	return pObs;
 }
 
 /*
-The Viterbi algorithm is nearly identical to the forward algorithm except for using a max() operation
-instead of a sum() operation in the inductive step.
-
-@t: The number of states to evaluate. In almost every case, the user would want to evalaute t = |observations|
-to get the complete sequence of most likely hidden states corresponding to the observation sequence.
-
-Returns: Probability of the most likely sequence of hidden states corresponding with the observation
-sequence. On exit, @output will contain the id's of these hidden states, and the viterbiLattice will contain
-all of the calculated viterbi values (Rabiner uses 'delta' for these).
+A single inductive step of the forward algorithm: given the alpha values of the previous column, computes
+the alpha values of the next column, for the observation emitted at the next column.
+@previous: the observation of the previous column, for emission pruning; -1 if unknown
+@temp: scratch space of size |states|
 */
-double DiscreteHmm::Viterbi(const vector<int>& observations, const int t, vector<int>& output)
+void DiscreteHmm::_forwardColumn(const vector<double>& leftCol, vector<double>& rightCol, const int previous, const int observation, vector<double>& temp)
 {
-	int i, j, k;
-	double temp;
-	pair<int,double> max;
+	int j, k, s, d;
+	double b;
+	const vector<double>& emissions = _emissionsBySymbol[observation];
+
+	if(_pruneStep(previous, observation)){
+		//the other sources have alpha = 0, and the other destinations cannot emit the observation
+		const vector<int>& sources = _statesBySymbol[previous];
+		const vector<int>& destinations = _statesBySymbol[observation];
+		temp.resize(sources.size());
+		for(j = 0; j < _stateMatrix.NumRows(); j++){
+			rightCol[j] = -numeric_limits<double>::infinity();
+		}
+		for(d = 0; d < destinations.size(); d++){
+			j = destinations[d];
+			b = MIN_DOUBLE;
+			for(s = 0; s < sources.size(); s++){
+				k = sources[s];
+				temp[s] = (_stateMatrix[k][j] + leftCol[k]);
+				if(temp[s] > b){
+					b = temp[s];
+				}
+			}
+			rightCol[j] = _logSumExp(temp,b);
+			rightCol[j] += emissions[j];
+		}
+		temp.resize(_stateMatrix.NumRows());
+		return;
+	}
 
-	if(t < 0 || t > observations.size()){
-		cout << "ERROR t parameter invalid in Viterbi(): " << t << endl;
-		return 1.0;
+	//foreach state in right column
+	for(j = 0; j < _stateMatrix.NumRows(); j++){
+		b = MIN_DOUBLE; //some very large negative number
+		//iterate the previous k states, given the current state j
+		for(k = 0; k < _stateMatrix.NumRows(); k++){
+			temp[k] = (_stateMatrix[k][j] + leftCol[k]); // p(S_k -> S_j) * alpha_k
+			if(temp[k] > b){
+				b = temp[k];
+			}
+		} //end-for: temp now contains all a_i's for log-sum-exp, and we have b, the max of them
+		//now run the log-sum-exp trick
+		rightCol[j] = _logSumExp(temp,b);
+		//lastly, multiply the observation probability back in, which was factored out of forward calculations
+		rightCol[j] += emissions[j];
 	}
+}
 
-	//Resize and reset matrix to all zeroes
-	_viterbiLattice.Resize(_stateMatrix.NumRows(), observations.size());
-	_viterbiLattice.Reset();
-	//init the backpointer matrix
-	_ptrLattice.Resize(_stateMatrix.NumRows(), observations.size());
-	_ptrLattice.Reset();
+/*
+Returns the log of the sum of the probabilities of a lattice column, eg, P(observations) given the last alpha column.
+*/
+double DiscreteHmm::_columnLogSum(const vector<double>& column)
+{
+	double b = MIN_DOUBLE;
 
-	//init left-most column of alpha matrix to initial probs, given first observation
-	for(i = 0 ; i < _stateMatrix.NumRows(); i++){
-		_viterbiLattice[0][i] = _pi[i] + _transitionMatrix[i][observations[0]];
-		_ptrLattice[0][i] = -1; //point all initial pointers at <start> null state
+	for(int i = 0; i < _stateMatrix.NumRows(); i++){
+		if(column[i] > b){
+			b = column[i];
+		}
 	}
 
-	//Induction, from 1 to t
-	for(i = 1; i <= t; i++){
-		vector<double>& leftCol = _viterbiLattice[i-1];
-		vector<double>& rightCol = _viterbiLattice[i];
-		vector<int>& ptrCol = _ptrLattice[i];
-		//foreach state in right column
-		for(j = 0; j < rightCol.size(); j++){
-			max.second = MIN_DOUBLE; //some large negative number
-			//iterate the previous states, given the current state
-			for(k = 0; k < leftCol.size(); k++){
-				temp = (_stateMatrix[k][j] + leftCol[k]);
-				if(temp > max.second){
-					max.second = temp;
-					max.first = k;
-				}
-			} //end-for: max contains maximum score and a pointer to its argmax state 
-			ptrCol[j]  = max.first;
-			leftCol[j] = max.second;
-			//lastly, multiply the observation probability back in, which was factored out of forward calculations
-			leftCol[j] += _transitionMatrix[j][ observations[i] ];
+	return _logSumExp(column,b);
+}
+
+/*
+Begins a new incremental forward computation; see ExtendForward().
+*/
+void DiscreteHmm::ResetForward()
+{
+	_incrementalAlpha.clear();
+	_incrementalLength = 0;
+	_incrementalSymbol = -1;
+	_incrementalVersion = _modelVersion;
+}
+
+/*
+Incremental forward algorithm, for scoring a sequence that grows over time. Only the last alpha column is retained
+between calls, so each appended observation costs O(N^2) time and the state is O(N) memory, instead of re-running
+ForwardAlgorithm() over the entire sequence.
+
+Call ResetForward() to begin a new sequence, then ExtendForward() with each batch of newly appended observations.
+The incremental state is tied to the model it was computed with: if the model is retrained or reloaded in between,
+this returns an error and the sequence must be restarted.
+
+Returns: ln P(all observations appended since the last ResetForward()), or 1 on error.
+*/
+double DiscreteHmm::ExtendForward(const vector<int>& appended)
+{
+	int i, start;
+	vector<double> temp, nextCol;
+
+	if(_incrementalVersion != _modelVersion){
+		cout << "ERROR model changed since ResetForward() in ExtendForward(); restart the sequence" << endl;
+		return 1;
+	}
+	if(appended.size() == 0){
+		if(_incrementalLength == 0){
+			cout << "ERROR no observations in ExtendForward()" << endl;
+			return 1;
 		}
+		return _columnLogSum(_incrementalAlpha);
 	}
 
-	//Termination: get max in last column
-	vector<double>& lastCol = _viterbiLattice.GetColumn(_viterbiLattice.NumCols()-1);
-	max.second = MIN_DOUBLE;
-	for(i = 0; i < lastCol.size(); i++){
-		if(lastCol[i] > max.second){
-			max.second = lastCol[i];
-			max.first = i;
+	start = 0;
+	if(_incrementalLength == 0){
+		//initialization: the first observation gives the first alpha column
+		const vector<double>& firstEmissions = _emissionsBySymbol[ appended[0] ];
+		_incrementalAlpha.resize(_stateMatrix.NumRows());
+		for(i = 0; i < _stateMatrix.NumRows(); i++){
+			_incrementalAlpha[i] = _pi[i] + firstEmissions[i];
 		}
+		start = 1;
 	}
 
-	//backtrack to get optimal state id sequence
-	output.resize(observations.size());
-	output.back() = max.first;
-	for(i = output.size()-2; i >= 0; i--){
-		output[i] = _ptrLattice[i][ output[i+1] ];
+	temp.resize(_stateMatrix.NumRows());
+	nextCol.resize(_stateMatrix.NumRows());
+	for(i = start; i < appended.size(); i++){
+		_forwardColumn(_incrementalAlpha, nextCol, i > 0 ? appended[i-1] : _incrementalSymbol, appended[i], temp);
+		_incrementalAlpha.swap(nextCol);
 	}
+	_incrementalLength += appended.size();
+	_incrementalSymbol = appended.back();
 
-	return max.second;
+	return _columnLogSum(_incrementalAlpha);
 }
 
-/*
-A BaumWelch utility, initializes the pi vector, and the state and emission matrices. How these matrices are initialized
-can determine the optimum obtained by the algorithm.
+double DiscreteHmm::ExtendForward(const int observation)
+{
+	return ExtendForward(vector<int>(1, observation));
+}
 
-This utility initializes the matrices to random, non-zero probabilities.
+/*
+Returns the number of observations consumed by ExtendForward() since the last ResetForward().
 */
-void DiscreteHmm::_initRandomDistribution()
+int DiscreteHmm::ForwardLength()
 {
-	int i, j;
-	double sum;
+	return _incrementalLength;
+}
 
-	srand(time(NULL));
+/*
+Scores many observation sequences at once: on exit, output[b] = ln P(sequences[b]), as ForwardAlgorithm() would
+return for each sequence on its own (an empty sequence scores 0).
 
-	//set the pi vector to a random distribution
-	for(i = 0, sum = 0.0; i < _pi.size(); i++){
-		_pi[i] = rand() % 100 + 5;
-		sum += _pi[i];
-	}
-	//set the pi vector to a random distribution
-	for(i = 0; i < _pi.size(); i++){
-		_pi[i] /= sum;
-		_pi[i] = log(_pi[i]);
+Rather than advancing each sequence by its own N x N matrix-vector step, the alpha columns of up to @batchWidth
+sequences are stacked into an N x batchWidth block, and the whole block is advanced by one matrix-matrix product
+per time step (see _batchTransition()). Each transition probability is then loaded once per time step for the
+whole block instead of once per sequence, which makes the recurrence compute-bound rather than memory-bound.
+
+The product is computed in linear space, since there is no max-plus-exp form of it, so each sequence's alpha
+column is rescaled to sum to one after every step, and ln P(sequence) is the sum of the logs of the scale factors
+(Rabiner's scaled forward algorithm).
+
+Sequences may have different lengths. They are scored in order of decreasing length, so within a block the
+sequences still running are always a prefix of the block, and those that have ended are masked off simply by
+narrowing the active width of the product.
+*/
+void DiscreteHmm::BatchForward(const vector<vector<int> >& sequences, vector<double>& output, const int batchWidth)
+{
+	PROFILE_SCOPE("BatchForward");
+	int i, j, b, t, first, width, active, numStates, numSymbols;
+	double scale;
+	vector<int> order;
+	vector<double> transitions, emissions, initial, alpha, next, logScale;
+
+	numStates = _stateMatrix.NumRows();
+	numSymbols = _transitionMatrix.NumCols();
+	output.assign(sequences.size(), 0);
+	if(numStates == 0 || batchWidth <= 0){
+		cout << "ERROR no model or invalid batch width in BatchForward()" << endl;
+		return;
 	}
 
-	//set the transition matrix to a random distribution
-	for(i = 0; i < _transitionMatrix.NumRows(); i++){
-		for(j = 0, sum = 0.0; j < _transitionMatrix.NumCols(); j++){
-			_transitionMatrix[i][j] = rand() % 100 + 5;
-			sum += _transitionMatrix[i][j];
+	//linear-space copies of the model: A row-major, emissions symbol-major
+	transitions.resize(numStates * numStates);
+	for(i = 0; i < numStates; i++){
+		for(j = 0; j < numStates; j++){
+			transitions[i * numStates + j] = exp(_stateMatrix[i][j]);
 		}
-		//normalize
-		for(j = 0; j < _transitionMatrix.NumCols(); j++){
-			_transitionMatrix[i][j] /= sum;
-			_transitionMatrix[i][j] = log(_transitionMatrix[i][j]);
+	}
+	emissions.resize(numSymbols * numStates);
+	for(i = 0; i < numSymbols; i++){
+		for(j = 0; j < numStates; j++){
+			emissions[i * numStates + j] = exp(_emissionsBySymbol[i][j]);
 		}
 	}
+	initial.resize(numStates);
+	for(i = 0; i < numStates; i++){
+		initial[i] = exp(_pi[i]);
+	}
 
-	//set the state matrix to a random distribution
-	for(i = 0; i < _stateMatrix.NumRows(); i++){
-		for(j = 0, sum = 0.0; j < _stateMatrix.NumCols(); j++){
-			_stateMatrix[i][j] = rand() % 100 + 5;
-			sum += _stateMatrix[i][j];
+	//longest sequences first, so the running sequences of a block are always a prefix of it
+	for(b = 0; b < sequences.size(); b++){
+		order.push_back(b);
+	}
+	stable_sort(order.begin(), order.end(), [&](int x, int y){ return sequences[x].size() > sequences[y].size(); });
+
+	for(first = 0; first < order.size(); first += batchWidth){
+		width = min(batchWidth, (int)order.size() - first);
+		//the block is state-major: alpha[i * width + b] is alpha_t(i) of the b-th sequence of the block
+		alpha.assign(numStates * width, 0);
+		next.resize(numStates * width);
+		logScale.assign(width, 0);
+
+		for(t = 0, active = width; active > 0; t++){
+			//mask off the sequences which have ended
+			while(active > 0 && sequences[ order[first + active - 1] ].size() <= t){
+				active--;
+			}
+			if(active == 0){
+				break;
+			}
+
+			if(t == 0){
+				for(i = 0; i < numStates; i++){
+					for(b = 0; b < active; b++){
+						next[i * width + b] = initial[i];
+					}
+				}
+			}
+			else{
+				_batchTransition(transitions.data(), alpha.data(), next.data(), numStates, width, active);
+			}
+
+			//emission multiply and rescale, per sequence
+			for(b = 0; b < active; b++){
+				const double* symbolEmissions = &emissions[ sequences[ order[first + b] ][t] * numStates ];
+				scale = 0;
+				for(i = 0; i < numStates; i++){
+					next[i * width + b] *= symbolEmissions[i];
+					scale += next[i * width + b];
+				}
+				if(scale > 0){
+					for(i = 0; i < numStates; i++){
+						next[i * width + b] /= scale;
+					}
+				}
+				//an impossible observation zeroes the column, and every later one
+				logScale[b] += log(scale);
+			}
+			alpha.swap(next);
 		}
-		//normalize
-		for(j = 0; j < _stateMatrix.NumCols(); j++){
-			_stateMatrix[i][j] /= sum;
-			_stateMatrix[i][j] = log(_stateMatrix[i][j]);
+
+		for(b = 0; b < width; b++){
+			output[ order[first + b] ] = logScale[b];
 		}
 	}
 }
 
+/*
+One step of the batched forward recurrence: next = A^T * alpha, for the first @active columns of a
+numStates x @width block. Blocked over the source and destination states so that the tiles of A and of the
+alpha block in use stay in cache; the innermost loop runs along the contiguous sequence lanes, and vectorizes.
+*/
+void DiscreteHmm::_batchTransition(const double* transitions, const double* alpha, double* next, const int numStates, const int width, const int active)
+{
+	int i, j, b, i0, j0, iEnd, jEnd;
+	double a;
+	const int tile = 64;
 
+	for(j = 0; j < numStates; j++){
+		for(b = 0; b < active; b++){
+			next[j * width + b] = 0;
+		}
+	}
 
+	for(i0 = 0; i0 < numStates; i0 += tile){
+		iEnd = min(i0 + tile, numStates);
+		for(j0 = 0; j0 < numStates; j0 += tile){
+			jEnd = min(j0 + tile, numStates);
+			for(i = i0; i < iEnd; i++){
+				const double* source = alpha + i * width;
+				for(j = j0; j < jEnd; j++){
+					a = transitions[i * numStates + j];
+					if(a == 0){
+						continue;
+					}
+					double* dest = next + j * width;
+					for(b = 0; b < active; b++){
+						dest[b] += a * source[b];
+					}
+				}
+			}
+		}
+	}
+}
 
 /*
-For now, just sets both matrices to uniform distributions of 1/N.
-
-Don't use this for BaumWelch initialization. Th effect of a uniform distribution over
-the hidden states is that BaumWelch can make no progress toward improved likelihood,
-due to zero variance in the state probabilities.
+Sliding-window scoring: @output[s] = ln P(observations[s..s+w-1]) for every window of @windowLength w, s = 0..T-w,
+each window scored from the initial distribution as if it were a sequence of its own (eg, for CpG island tracks).
+ForwardAlgorithm() per window costs O(T*w*N^2) in total.
+
+In matrix form P(o_s..o_e) = v_s M_s+1 ... M_e 1, where v_s = pi .* b(o_s) and M_t = A diag(b(o_t)). The sequence is
+cut into blocks of w positions. Every window starting in the block ending at m spans m, so it splits into a left
+product v_s M_s+1..M_m and a right product M_m+1..M_e 1. Within a block, the left products are built right to left
+as suffix products F_s+1 = M_s+1 F_s+2, and the right ones left to right as prefix products P_e = P_e-1 M_e, one
+N x N product per window each, with the tiled kernel of BatchForward(). A window's score is then a dot product of
+the two halves. The total is O(T*N^3) rather than O(T*w*N^2), and independent of w; for w < 2N the per-window
+forward recursion is cheaper, and is used instead. All products are in scaled linear space, as in BatchForward().
 */
-void DiscreteHmm::_initUniformDistribution()
+void DiscreteHmm::SlidingWindowForward(const vector<int>& observations, const int windowLength, vector<double>& output)
 {
-	//set the pi vector to a uniform distribution
-	for(int i = 0; i < _pi.size(); i++){
-		_pi[i] = log(1.0 / (double)_pi.size());
+	PROFILE_SCOPE("SlidingWindowForward");
+	int i, j, s, e, m, t, numStates, numWindows, first, last;
+	double scale, dot;
+	vector<double> transitions, transposed, emissions, initial, alpha, next;
+	vector<double> suffix, prefix, product, leftLogScale, rightLogScale, left, right;
+
+	numStates = _stateMatrix.NumRows();
+	output.clear();
+	if(numStates == 0 || windowLength < 1){
+		cout << "ERROR no model or invalid window length in SlidingWindowForward()" << endl;
+		return;
+	}
+	for(t = 0; t < observations.size(); t++){
+		if(observations[t] < 0 || observations[t] >= _transitionMatrix.NumCols()){
+			cout << "ERROR observation out of range in SlidingWindowForward(): " << observations[t] << endl;
+			return;
+		}
+	}
+	numWindows = (int)observations.size() - windowLength + 1;
+	if(numWindows <= 0){
+		return;
+	}
+	output.resize(numWindows);
+
+	//linear-space copies of the model: A row-major and transposed, and the emissions of each position
+	transitions.resize(numStates * numStates);
+	transposed.resize(numStates * numStates);
+	for(i = 0; i < numStates; i++){
+		for(j = 0; j < numStates; j++){
+			transitions[i * numStates + j] = exp(_stateMatrix[i][j]);
+			transposed[j * numStates + i] = transitions[i * numStates + j];
+		}
+	}
+	initial.resize(numStates);
+	for(i = 0; i < numStates; i++){
+		initial[i] = exp(_pi[i]);
+	}
+	emissions.resize(observations.size() * numStates);
+	for(t = 0; t < observations.size(); t++){
+		for(i = 0; i < numStates; i++){
+			emissions[t * numStates + i] = exp(_emissionsBySymbol[ observations[t] ][i]);
+		}
 	}
 
-	//set the transition matrix to a uniform distribution
-	for(int i = 0; i < _transitionMatrix.NumRows(); i++){
-		for(int j = 0; j < _transitionMatrix.NumCols(); j++){
-			_transitionMatrix[i][j] = log(1.0 / (double)_transitionMatrix[i].size());
+	if(windowLength < 2 * numStates){
+		//short windows: the scaled forward recursion over each window
+		alpha.resize(numStates);
+		next.resize(numStates);
+		for(s = 0; s < numWindows; s++){
+			output[s] = 0;
+			for(t = s; t < s + windowLength; t++){
+				if(t == s){
+					next = initial;
+				}
+				else{
+					_batchTransition(transitions.data(), alpha.data(), next.data(), numStates, 1, 1);
+				}
+				for(i = 0, scale = 0; i < numStates; i++){
+					next[i] *= emissions[t * numStates + i];
+					scale += next[i];
+				}
+				if(scale > 0){
+					for(i = 0; i < numStates; i++){
+						next[i] /= scale;
+					}
+				}
+				output[s] += log(scale);
+				alpha.swap(next);
+			}
 		}
+		return;
 	}
 
-	//set the state matrix to a uniform distribution
-	for(int i = 0; i < _stateMatrix.NumRows(); i++){
-		for(int j = 0; j < _stateMatrix.NumCols(); j++){
-			_stateMatrix[i][j] = log(1.0 / (double)_stateMatrix[i].size());
+	suffix.resize(numStates * numStates);
+	prefix.resize(numStates * numStates);
+	product.resize(numStates * numStates);
+	left.resize(windowLength * numStates);
+	right.resize(windowLength * numStates);
+	leftLogScale.resize(windowLength);
+	rightLogScale.resize(windowLength);
+
+	//blocks end at m = w-1, 2w-1, ...; the windows starting in (m-w, m] all span m
+	for(m = windowLength - 1; m - windowLength + 1 < numWindows; m += windowLength){
+		first = m - windowLength + 1;
+		last = min(m, numWindows - 1);
+
+		//left halves, right to left: suffix = F_s+1 = M_s+1 ... M_m (the identity for s = m), left_s = v_s F_s+1
+		fill(suffix.begin(), suffix.end(), 0.0);
+		for(i = 0; i < numStates; i++){
+			suffix[i * numStates + i] = 1;
+		}
+		scale = 0;
+		for(s = m; s >= first; s--){
+			if(s < m){
+				//F_s+1 = A (diag(b(o_s+1)) F_s+2): the kernel computes X^T Y, so it is given A^T
+				for(i = 0; i < numStates; i++){
+					for(j = 0; j < numStates; j++){
+						suffix[i * numStates + j] *= emissions[(s + 1) * numStates + i];
+					}
+				}
+				_batchTransition(transposed.data(), suffix.data(), product.data(), numStates, numStates, numStates);
+				suffix.swap(product);
+				scale += _scaleLinear(suffix);
+			}
+			if(s > last){
+				continue;
+			}
+			double* leftHalf = &left[(s - first) * numStates];
+			for(j = 0; j < numStates; j++){
+				leftHalf[j] = 0;
+			}
+			for(i = 0; i < numStates; i++){
+				for(j = 0; j < numStates; j++){
+					leftHalf[j] += initial[i] * emissions[s * numStates + i] * suffix[i * numStates + j];
+				}
+			}
+			leftLogScale[s - first] = scale;
+		}
+
+		//right halves, left to right: prefix holds P_e^T = (M_m+1 ... M_e)^T (the identity for e = m), right_e = P_e 1
+		fill(prefix.begin(), prefix.end(), 0.0);
+		for(i = 0; i < numStates; i++){
+			prefix[i * numStates + i] = 1;
+		}
+		scale = 0;
+		for(e = m; e <= last + windowLength - 1; e++){
+			if(e > m){
+				//P_e^T = diag(b(o_e)) A^T P_e-1^T
+				_batchTransition(transitions.data(), prefix.data(), product.data(), numStates, numStates, numStates);
+				for(i = 0; i < numStates; i++){
+					for(j = 0; j < numStates; j++){
+						product[i * numStates + j] *= emissions[e * numStates + i];
+					}
+				}
+				prefix.swap(product);
+				scale += _scaleLinear(prefix);
+			}
+			double* rightHalf = &right[(e - m) * numStates];
+			for(j = 0; j < numStates; j++){
+				rightHalf[j] = 0;
+			}
+			for(i = 0; i < numStates; i++){
+				for(j = 0; j < numStates; j++){
+					rightHalf[j] += prefix[i * numStates + j];
+				}
+			}
+			rightLogScale[e - m] = scale;
+		}
+
+		for(s = first; s <= last; s++){
+			e = s + windowLength - 1;
+			for(j = 0, dot = 0; j < numStates; j++){
+				dot += left[(s - first) * numStates + j] * right[(e - m) * numStates + j];
+			}
+			output[s] = log(dot) + leftLogScale[s - first] + rightLogScale[e - m];
 		}
 	}
 }
 
+/*
+Divides a linear-space matrix by its largest entry, returning the log of the divisor (-inf for a zero matrix).
+*/
+double DiscreteHmm::_scaleLinear(vector<double>& values)
+{
+	int i;
+	double max = 0;
+
+	for(i = 0; i < values.size(); i++){
+		if(values[i] > max){
+			max = values[i];
+		}
+	}
+	if(max > 0){
+		for(i = 0; i < values.size(); i++){
+			values[i] /= max;
+		}
+	}
+
+	return log(max);
+}
 
 /*
-Given an observation sequence, Baum-Welch will maximize the likelihood of the observations
-given by the model. The maximization is local, not global, converging to a critical point. But See Rabiner.
-Greek letters correspond with Rabiner's notation as well.
+The Viterbi algorithm is nearly identical to the forward algorithm except for using a max() operation
+instead of a sum() operation in the inductive step.
 
-As far as implementation, the iterations are basically:
-	Let lambda = (A,B,Pi) distributions.
+@t: The number of states to evaluate. In almost every case, the user would want to evalaute t = |observations|
+to get the complete sequence of most likely hidden states corresponding to the observation sequence.
 
-	Init: lambda can be uniform, trained, whatever. The BW algorithm will maximize lambda according
-	to the training observations it is passed, thereby modifying it from whatever its initial state.
+Returns: Probability of the most likely sequence of hidden states corresponding with the observation
+sequence. On exit, @output will contain the id's of these hidden states. If the full lattice fits within the
+memory budget (see SetMemoryBudget()), the viterbiLattice will also contain all of the calculated viterbi
+values (Rabiner uses 'delta' for these); otherwise the checkpointed variant is used, which recovers the same
+path in O(N*sqrt(T)) memory but does not retain the lattice.
+*/
+double DiscreteHmm::Viterbi(const vector<int>& observations, const int t, vector<int>& output)
+{
+	return _viterbi(observations, t, output);
+}
 
-	BW then uses these steps, in terms of implementation:
-		1) determine Xi, gamma from observation sequence, lambda
-		2) Set forward variables (alpha and beta models)
-		3) use Xi, gamma to determine lambda'
-		4) repeat from (1) until convergence
+double DiscreteHmm::Viterbi(const PackedSequence& observations, const int t, vector<int>& output)
+{
+	return _viterbi(observations, t, output);
+}
 
-See wikipedia for a decent example. There are many others elsewhere.
+double DiscreteHmm::Viterbi(const SequenceView& observations, const int t, vector<int>& output)
+{
+	return _viterbi(observations, t, output);
+}
 
-@dataset: The unlabelled dataset from which to learn
-@numHiddenStates: The number of hidden states to initialize the hmm with
+template<typename SequenceT>
+double DiscreteHmm::_viterbi(const SequenceT& observations, const int t, vector<int>& output)
+{
+	PROFILE_SCOPE("Viterbi");
+	unsigned long long latticeBytes;
+
+	if(t < 1 || t > observations.size()){
+		cout << "ERROR t parameter invalid in Viterbi(): " << t << endl;
+		return 1.0;
+	}
+
+	//the full algorithm stores a double and a backpointer for every state at every time step
+	latticeBytes = _latticeBytes(_stateMatrix.NumRows(), t, sizeof(double)) + _latticeBytes(_stateMatrix.NumRows(), t, sizeof(int));
+	if(_memoryBudget > 0 && latticeBytes > _memoryBudget){
+		if(!_withinBudget(EstimateMemory(MEMORY_VITERBI, _stateMatrix.NumRows(), _transitionMatrix.NumCols(), t), "Viterbi()")){
+			return 1.0;
+		}
+		return _viterbiCheckpointed(observations, t, output);
+	}
 
+	return _viterbiFull(observations, t, output);
+}
+
+/*
+Posterior (max marginal) decoding: for each time step, outputs the individually most likely state,
+argmax_i P(state_t = i | observations), which is proportional to alpha_t(i) * beta_t(i). Unlike Viterbi,
+the output sequence is not guaranteed to be a valid path through the model.
+
+Returns: ln P(observations), or 1 on error. On exit, @output contains the id's of the decoded states.
 */
-double DiscreteHmm::BaumWelch(DiscreteHmmDataset& dataset, const int numHiddenStates)
+double DiscreteHmm::PosteriorDecode(const vector<int>& observations, vector<int>& output)
 {
-	int i, maxIterations;
-	double pObs_forward, pObs_backward, delta, lastProb;
-	const double convergence = 1.0;
-	vector<int>& observations = dataset.UnlabeledDataSequence;
-	string dummy;
-
-	cout << "TODO: need to handle cases when observations vector includes observations not previously seen" << endl;
-	cout << "in which case the model won't have the correct number of states, etc. This needs to be errr-checked" << endl;
-	cout << "elsewhere, I just don't want to pollute the code with error checks until the methods are stable" << endl;
-	cout << "TODO: define the temporary vars (xi/gamma matrices) recursively to cut down space consumption." << endl;
+	PROFILE_SCOPE("PosteriorDecode");
+	int i, t, best;
+	double pObs, score, bestScore;
 
-	//init
-	Clear();
-	//resize all the required models
-	_resizeModel(numHiddenStates, dataset.NumSymbols()); //resize the pi, state, and transition matrices to fit this data
-	_xiMatrices.resize(dataset.UnlabeledDataSequence.size());
-	for(int i = 0; i < _xiMatrices.size(); i++){
-		//resize every matrix in the xi matrices to be a square matrix by the number of hidden states
-		_xiMatrices[i].Resize(_stateMatrix.NumRows(), _stateMatrix.NumCols()); 
+	if(observations.size() == 0){
+		cout << "ERROR empty observation sequence in PosteriorDecode()" << endl;
+		return 1;
 	}
-	//gamma matrix is sized NumStates x NumObservations
-	_gammaLattice.Resize(_stateMatrix.NumRows(), observations.size()); 
-	//set the hmm-model to random initial values
-	_initRandomDistribution();
 
-	cout << "Initial model: " << endl;
-	PrintModel();
+	if(!_withinBudget(2 * _latticeBytes(_stateMatrix.NumRows(), observations.size(), sizeof(double)), "PosteriorDecode()")){
+		return 1;
+	}
 
-	//until convergence, keep retraining the Xi Model, then using its values to maximize the likelihood of the data
-	i = 0; maxIterations = 100; pObs_forward = pObs_backward = 0;
-	//initialize the forward and backward values
-	pObs_forward = ForwardAlgorithm(observations, observations.size()-1);
-	cout << "initial p(obs): " << exp(-pObs_forward) << endl;
+	pObs = ForwardAlgorithm(observations, observations.size()-1);
 	BackwardAlgorithm(observations, 0);
-	while(true){
-		//expectation step: get the Xi and gamma values (see Rabiner)
-		_retrainXiModel(observations);
-		//maximization step: based on the Xi and gamma values, reset the state and emission probabilities
-		_updateModels(observations);
-		//re-run Forward and Backward algorithms to reset alpha/beta matrices; this is necessary RIGHT???!?!
-		lastProb = pObs_forward;
-		pObs_forward  = ForwardAlgorithm(observations,observations.size()-1);
-		pObs_backward = BackwardAlgorithm(observations,0);
-		delta = pObs_forward - lastProb;
-		i++;
 
-		PrintModel();
-		printf("%lf\n",pObs_forward);
-		cout << i << "\tforward p(obs): " << pObs_forward << "/" << exp(-1 * pObs_forward) << "\tbackward p(obs): " << pObs_backward << "/" << exp(-1 * pObs_backward) << "\tdelta: " << delta << endl;
+	output.resize(observations.size());
+	for(t = 0; t < observations.size(); t++){
+		best = 0;
+		bestScore = MIN_DOUBLE;
+		for(i = 0; i < _stateMatrix.NumRows(); i++){
+			score = _alphaLattice[t][i] + _betaLattice[t][i];
+			if(score > bestScore){
+				bestScore = score;
+				best = i;
+			}
+		}
+		output[t] = best;
+	}
+
+	return pObs;
+}
+
+/*
+A single inductive step of Viterbi: given the delta values of the previous column, computes the delta values
+and backpointers of the next column, for the observation emitted at the next column.
+@previous: the observation of the previous column, for emission pruning; -1 if unknown
+*/
+void DiscreteHmm::_viterbiColumn(const vector<double>& leftCol, vector<double>& rightCol, vector<int>& ptrCol, const int previous, const int observation)
+{
+	int j, k, s, d;
+	double temp;
+	pair<int,double> max;
+	const vector<double>& emissions = _emissionsBySymbol[observation];
+
+	if(_pruneStep(previous, observation)){
+		//sources are visited in increasing order, and the skipped ones are -inf, so the argmax is the same
+		const vector<int>& sources = _statesBySymbol[previous];
+		const vector<int>& destinations = _statesBySymbol[observation];
+		for(j = 0; j < _stateMatrix.NumRows(); j++){
+			rightCol[j] = -numeric_limits<double>::infinity();
+			ptrCol[j] = 0;
+		}
+		for(d = 0; d < destinations.size(); d++){
+			j = destinations[d];
+			max.first = 0;
+			max.second = MIN_DOUBLE;
+			for(s = 0; s < sources.size(); s++){
+				k = sources[s];
+				temp = (_stateMatrix[k][j] + leftCol[k]);
+				if(temp > max.second){
+					max.second = temp;
+					max.first = k;
+				}
+			}
+			ptrCol[j] = max.first;
+			rightCol[j] = max.second + emissions[j];
+		}
+		return;
+	}
+
+#ifdef HMM_X86_SIMD
+	if(_useSimd){
+		_viterbiColumnAvx2(leftCol, rightCol, ptrCol, observation);
+		return;
+	}
+#endif
+
+	//foreach state in right column
+	for(j = 0; j < _stateMatrix.NumRows(); j++){
+		max.first = 0;
+		max.second = MIN_DOUBLE; //some large negative number
+		//iterate the previous states, given the current state
+		for(k = 0; k < _stateMatrix.NumRows(); k++){
+			temp = (_stateMatrix[k][j] + leftCol[k]);
+			if(temp > max.second){
+				max.second = temp;
+				max.first = k;
+			}
+		} //end-for: max contains maximum score and a pointer to its argmax state 
+		ptrCol[j]  = max.first;
+		rightCol[j] = max.second;
+		//lastly, multiply the observation probability back in, which was factored out of forward calculations
+		rightCol[j] += emissions[j];
+	}
+}
+
+#ifdef HMM_X86_SIMD
+/*
+The vectorized equivalent of the scalar loop of _viterbiColumn(). Rather than walking down a column of
+_stateMatrix for each destination state j, it computes a block of destination states j..j+3 (or j..j+7) at
+once: for each source state k it reads the contiguous a_k,j..a_k,j+3 from row k, adds delta_k to every lane,
+and keeps a running max and argmax per lane. Sources are visited in increasing k and replace the max only when strictly
+greater, as in the scalar loop, so ties resolve to the same (lowest) k and the results are bit-identical.
+The argmax lanes hold k as a double, which is exact for any realistic number of states.
+*/
+__attribute__((target("avx2")))
+void DiscreteHmm::_viterbiColumnAvx2(const vector<double>& leftCol, vector<double>& rightCol, vector<int>& ptrCol, const int observation)
+{
+	int j, k, lane, numStates;
+	double temp, bestScores[4], bestStates[4];
+	pair<int,double> max;
+	__m256d best, argmax, score, source, greater;
+	const vector<double>& emissions = _emissionsBySymbol[observation];
+
+	numStates = _stateMatrix.NumRows();
+	//eight states per step, as two independent max chains, to hide the latency of the compare/blend dependency
+	for(j = 0; j + 8 <= numStates; j += 8){
+		__m256d best2, argmax2, score2, greater2;
+		best = best2 = _mm256_set1_pd(MIN_DOUBLE);
+		argmax = argmax2 = _mm256_setzero_pd();
+		for(k = 0; k < numStates; k++){
+			const double* row = &_stateMatrix[k][j];
+			source = _mm256_set1_pd((double)k);
+			score = _mm256_add_pd(_mm256_loadu_pd(row), _mm256_set1_pd(leftCol[k]));
+			score2 = _mm256_add_pd(_mm256_loadu_pd(row + 4), _mm256_set1_pd(leftCol[k]));
+			greater = _mm256_cmp_pd(score, best, _CMP_GT_OQ);
+			greater2 = _mm256_cmp_pd(score2, best2, _CMP_GT_OQ);
+			best = _mm256_blendv_pd(best, score, greater);
+			best2 = _mm256_blendv_pd(best2, score2, greater2);
+			argmax = _mm256_blendv_pd(argmax, source, greater);
+			argmax2 = _mm256_blendv_pd(argmax2, source, greater2);
+		}
+		_mm256_storeu_pd(bestScores, best);
+		_mm256_storeu_pd(bestStates, argmax);
+		for(lane = 0; lane < 4; lane++){
+			ptrCol[j + lane] = (int)bestStates[lane];
+			rightCol[j + lane] = bestScores[lane] + emissions[j + lane];
+		}
+		_mm256_storeu_pd(bestScores, best2);
+		_mm256_storeu_pd(bestStates, argmax2);
+		for(lane = 0; lane < 4; lane++){
+			ptrCol[j + 4 + lane] = (int)bestStates[lane];
+			rightCol[j + 4 + lane] = bestScores[lane] + emissions[j + 4 + lane];
+		}
+	}
+	for(; j + 4 <= numStates; j += 4){
+		best = _mm256_set1_pd(MIN_DOUBLE);
+		argmax = _mm256_setzero_pd();
+		for(k = 0; k < numStates; k++){
+			score = _mm256_add_pd(_mm256_loadu_pd(&_stateMatrix[k][j]), _mm256_set1_pd(leftCol[k]));
+			source = _mm256_set1_pd((double)k);
+			//ordered, non-signalling >: false for NaN, like the scalar comparison
+			greater = _mm256_cmp_pd(score, best, _CMP_GT_OQ);
+			best = _mm256_blendv_pd(best, score, greater);
+			argmax = _mm256_blendv_pd(argmax, source, greater);
+		}
+		_mm256_storeu_pd(bestScores, best);
+		_mm256_storeu_pd(bestStates, argmax);
+		for(lane = 0; lane < 4; lane++){
+			ptrCol[j + lane] = (int)bestStates[lane];
+			rightCol[j + lane] = bestScores[lane] + emissions[j + lane];
+		}
+	}
+
+	//remaining states, as in the scalar loop
+	for(; j < numStates; j++){
+		max.first = 0;
+		max.second = MIN_DOUBLE;
+		for(k = 0; k < numStates; k++){
+			temp = (_stateMatrix[k][j] + leftCol[k]);
+			if(temp > max.second){
+				max.second = temp;
+				max.first = k;
+			}
+		}
+		ptrCol[j] = max.first;
+		rightCol[j] = max.second + emissions[j];
+	}
+}
+#endif
+
+/*
+Standard Viterbi, retaining the entire delta and backpointer lattices: O(N*T) memory.
+*/
+template<typename SequenceT>
+double DiscreteHmm::_viterbiFull(const SequenceT& observations, const int t, vector<int>& output)
+{
+	int i, cached;
+	vector<int> path;
+	pair<int,double> max;
+
+	//Resize and reset matrix to all zeroes
+	_viterbiLattice.Resize(_stateMatrix.NumRows(), t);
+	_viterbiLattice.Reset();
+	//init the backpointer matrix
+	_ptrLattice.Resize(_stateMatrix.NumRows(), t);
+	_ptrLattice.Reset();
+	_trackMemory(0);
+
+	//resume from the longest cached prefix, if any
+	cached = 0;
+	if(_prefixCache.Enabled()){
+		cached = _lookupPrefix(observations, t, true, path);
+		for(i = 0; i < cached; i++){
+			_viterbiLattice[i] = _prefixCache.Delta(path[i]);
+			_ptrLattice[i] = _prefixCache.Pointers(path[i]);
+		}
+	}
+
+	//init left-most column of alpha matrix to initial probs, given first observation
+	if(cached == 0){
+		const vector<double>& firstEmissions = _emissionsBySymbol[observations[0]];
+		for(i = 0 ; i < _stateMatrix.NumRows(); i++){
+			_viterbiLattice[0][i] = _pi[i] + firstEmissions[i];
+			_ptrLattice[0][i] = -1; //point all initial pointers at <start> null state
+		}
+	}
+
+	//Induction, over the remaining t-1 columns
+	for(i = cached > 0 ? cached : 1; i < t; i++){
+		_viterbiColumn(_viterbiLattice[i-1], _viterbiLattice[i], _ptrLattice[i], observations[i-1], observations[i]);
+	}
+
+	if(_prefixCache.Enabled()){
+		_prefixCache.Record(cached, t - cached);
+		_storePrefix(observations, t, true, path);
+	}
+
+	//Termination: get max in last column
+	vector<double>& lastCol = _viterbiLattice.GetColumn(t-1);
+	max.first = 0;
+	max.second = MIN_DOUBLE;
+	for(i = 0; i < _stateMatrix.NumRows(); i++){
+		if(lastCol[i] > max.second){
+			max.second = lastCol[i];
+			max.first = i;
+		}
+	}
+
+	//backtrack to get optimal state id sequence
+	output.resize(t);
+	output.back() = max.first;
+	for(i = output.size()-2; i >= 0; i--){
+		output[i] = _ptrLattice[i+1][ output[i+1] ];
+	}
+
+	return max.second;
+}
+
+/*
+Walks the prefix cache along the first @length observations, stopping at the first prefix whose columns are not
+cached (alpha columns, or delta and backpointer columns if @viterbi).
+@path: on exit, the cache nodes of the cached prefixes; path[i] holds the columns of observation i.
+
+Returns the number of cached columns, path.size().
+*/
+template<typename SequenceT>
+int DiscreteHmm::_lookupPrefix(const SequenceT& observations, const int length, const bool viterbi, vector<int>& path)
+{
+	int i, node;
+
+	_prefixCache.Validate(_modelVersion);
+	path.clear();
+	for(i = 0, node = 0; i < length; i++){
+		node = _prefixCache.Child(node, observations[i]);
+		if(node < 0 || (viterbi ? _prefixCache.Delta(node).empty() : _prefixCache.Alpha(node).empty())){
+			break;
+		}
+		path.push_back(node);
+	}
+
+	return path.size();
+}
+
+/*
+Caches the lattice columns of the first @length observations (up to the cache's maximum depth) after a query,
+continuing from the @path returned by _lookupPrefix(). Then marks the path as recently used, and evicts down
+to the budget.
+*/
+template<typename SequenceT>
+void DiscreteHmm::_storePrefix(const SequenceT& observations, const int length, const bool viterbi, vector<int>& path)
+{
+	int i, node, child;
+	const int depth = min(length, _prefixCache.MaxDepth());
+
+	node = path.size() > 0 ? path.back() : 0;
+	for(i = path.size(); i < depth; i++){
+		child = _prefixCache.Child(node, observations[i]);
+		if(child < 0){
+			child = _prefixCache.AddChild(node, observations[i]);
+		}
+		if(viterbi){
+			_prefixCache.Delta(child) = _viterbiLattice[i];
+			_prefixCache.Pointers(child) = _ptrLattice[i];
+		}
+		else{
+			_prefixCache.Alpha(child) = _alphaLattice[i];
+		}
+		_prefixCache.Account(child);
+		path.push_back(child);
+		node = child;
+	}
+
+	_prefixCache.Touch(path);
+	_prefixCache.Trim();
+}
+
+/*
+Checkpointed Viterbi for sequences whose full lattice would not fit in memory.
+
+The forward pass keeps only a rolling delta column, saving a copy of it every L = ceil(sqrt(t)) columns. The path
+is then recovered segment by segment, right to left: each segment's delta values are recomputed from its checkpoint,
+keeping backpointers for that segment only, and backtracked from the state already decoded at the segment's right edge.
+Memory is O(N*sqrt(T)) for the checkpoints plus one segment of backpointers, at the cost of a second pass over the data.
+Since the recomputation performs exactly the same floating point operations, the path is identical to _viterbiFull().
+*/
+template<typename SequenceT>
+double DiscreteHmm::_viterbiCheckpointed(const SequenceT& observations, const int t, vector<int>& output)
+{
+	int i, c, segStart, segEnd, segLen, numStates;
+	pair<int,double> max;
+	vector<double> leftCol, rightCol;
+	vector<int> ptrCol;
+	vector<vector<double> > checkpoints;
+	ColumnMatrix<int> segPtrs;
+
+	numStates = _stateMatrix.NumRows();
+	segLen = (int)ceil(sqrt((double)t));
+	leftCol.resize(numStates);
+	rightCol.resize(numStates);
+	ptrCol.resize(numStates);
+	checkpoints.resize((t + segLen - 1) / segLen);
+	_trackMemory(_latticeBytes(numStates, checkpoints.size(), sizeof(double)) + _latticeBytes(numStates, segLen + 1, sizeof(int)) + 2 * numStates * sizeof(double) + numStates * sizeof(int));
+
+	//init left-most column, which is also the first checkpoint
+	const vector<double>& firstEmissions = _emissionsBySymbol[observations[0]];
+	for(i = 0 ; i < numStates; i++){
+		leftCol[i] = _pi[i] + firstEmissions[i];
+	}
+	checkpoints[0] = leftCol;
+
+	//Induction, saving every segLen-th column
+	for(i = 1; i < t; i++){
+		_viterbiColumn(leftCol, rightCol, ptrCol, observations[i-1], observations[i]);
+		leftCol.swap(rightCol);
+		if(i % segLen == 0){
+			checkpoints[i / segLen] = leftCol;
+		}
+	}
+
+	//Termination: get max in last column
+	max.first = 0;
+	max.second = MIN_DOUBLE;
+	for(i = 0; i < numStates; i++){
+		if(leftCol[i] > max.second){
+			max.second = leftCol[i];
+			max.first = i;
+		}
+	}
+
+	output.resize(t);
+	output.back() = max.first;
+
+	//recompute each segment's backpointers from its checkpoint and backtrack through it, right to left
+	segPtrs.Resize(numStates, segLen + 1);
+	for(c = checkpoints.size() - 1; c >= 0; c--){
+		segStart = c * segLen;
+		segEnd = segStart + segLen;
+		if(segEnd > t - 1){
+			segEnd = t - 1;
+		}
+		leftCol = checkpoints[c];
+		for(i = segStart + 1; i <= segEnd; i++){
+			_viterbiColumn(leftCol, rightCol, segPtrs[i - segStart], observations[i-1], observations[i]);
+			leftCol.swap(rightCol);
+		}
+		for(i = segEnd; i > segStart; i--){
+			output[i-1] = segPtrs[i - segStart][ output[i] ];
+		}
+		//this segment's checkpoint is no longer needed
+		vector<double>().swap(checkpoints[c]);
+	}
+
+	return max.second;
+}
+
+/*
+A candidate derivation of a lattice node (t, j) for KBestViterbi(): the @rank'th best path to (t-1, @source),
+extended by the transition to j. Candidates are ordered by score, then source, then rank.
+*/
+struct KBestCandidate{
+	double score;
+	int source;
+	int rank;
+	bool operator<(const KBestCandidate& other) const
+	{
+		if(score != other.score){
+			return score < other.score;
+		}
+		return source != other.source ? source > other.source : rank > other.rank;
+	}
+};
+
+/*
+The lazily expanded k-best list of a lattice node: its best derivations found so far, and a heap of candidates.
+*/
+struct KBestNode{
+	vector<KBestCandidate> best;
+	vector<KBestCandidate> candidates;
+	bool successorQueued;
+	bool exhausted;
+};
+
+/*
+k-best Viterbi: the @k most likely state sequences for the whole of @observations, best first.
+
+This is lazy best-first enumeration over the Viterbi lattice (Huang and Chiang's "lazy k-best" algorithm). A normal
+Viterbi pass first computes the best score of every node (t, j). The paths are then drawn from a virtual end node
+whose incoming edges are the final column. A node's list of best derivations is only extended when some later
+node needs its next one: the r'th best path through (t, j) arrives along an edge from some (t-1, i), and its
+successor candidate is the next best path to (t-1, i) along the same edge, which is expanded in turn. A node's
+candidate heap is built once from the Viterbi scores of the previous column, at O(N), when it is first expanded.
+
+So the cost is one Viterbi pass, O(N^2 T), plus O(k T (N + log k)) for at most k T expanded nodes, rather than
+k Viterbi passes or the O(k N^2 T) of keeping k entries for every node. Memory is the Viterbi lattice and its
+backpointers, which recover the parts of paths through nodes that were never expanded, plus the expanded nodes.
+Equal scores are ordered by source state and then rank, so the first path is Viterbi()'s.
+
+Impossible (zero probability) paths are never returned, so fewer than @k paths are returned if fewer exist.
+Returns the score of the best path, with the score of every path in @scores; returns 1 on error.
+*/
+double DiscreteHmm::KBestViterbi(const vector<int>& observations, const int k, vector<vector<int> >& paths, vector<double>& scores)
+{
+	PROFILE_SCOPE("KBestViterbi");
+	int t, i, j, r, numStates, length, node, source;
+	vector<int> nodeIds;
+	vector<KBestNode> nodes;
+	vector<pair<int,int> > stack;
+	ColumnMatrix<double> delta;
+	ColumnMatrix<int> backpointers;
+	KBestCandidate candidate;
+
+	paths.clear();
+	scores.clear();
+	numStates = _stateMatrix.NumRows();
+	length = observations.size();
+	if(k < 1 || length == 0 || numStates == 0){
+		cout << "ERROR KBestViterbi() requires k > 0, a model, and observations" << endl;
+		return 1;
+	}
+	for(t = 0; t < length; t++){
+		if(observations[t] < 0 || observations[t] >= _transitionMatrix.NumCols()){
+			cout << "ERROR observation out of range in KBestViterbi(): " << observations[t] << endl;
+			return 1;
+		}
+	}
+
+	//the best score of every node, and its backpointer, exactly as Viterbi() computes them
+	if(!_withinBudget(_latticeBytes(numStates, length, sizeof(double)) + _latticeBytes(numStates, length, sizeof(int)), "KBestViterbi()")){
+		return 1;
+	}
+	delta.Resize(numStates, length);
+	backpointers.Resize(numStates, length);
+	_trackMemory(delta.Bytes() + backpointers.Bytes());
+	const vector<double>& firstEmissions = _emissionsBySymbol[observations[0]];
+	for(j = 0; j < numStates; j++){
+		delta[0][j] = _pi[j] + firstEmissions[j];
+	}
+	for(t = 1; t < length; t++){
+		_viterbiColumn(delta[t-1], delta[t], backpointers[t], observations[t-1], observations[t]);
+	}
+
+	//node (t, j) is t * numStates + j; the virtual end node is length * numStates. Expanded nodes get an entry in nodes.
+	nodeIds.assign(length * numStates + 1, -1);
+	stack.push_back(pair<int,int>(length * numStates, k - 1));
+	while(!stack.empty()){
+		node = stack.back().first;
+		r = stack.back().second;
+		t = node / numStates;
+		j = node % numStates;
+
+		if(nodeIds[node] < 0){
+			//first expansion: a candidate for the best path along each incoming edge
+			nodeIds[node] = nodes.size();
+			nodes.push_back(KBestNode());
+			KBestNode& expanded = nodes.back();
+			expanded.successorQueued = true;
+			expanded.exhausted = false;
+			if(t == 0){
+				candidate.score = delta[0][j];
+				candidate.source = -1;
+				candidate.rank = 0;
+				if(candidate.score > -numeric_limits<double>::infinity()){
+					expanded.candidates.push_back(candidate);
+				}
+			}
+			for(i = 0; t > 0 && i < numStates; i++){
+				//the same additions, in the same order, as _viterbiColumn()
+				candidate.score = t == length ? delta[t-1][i] : (_stateMatrix[i][j] + delta[t-1][i]) + _emissionsBySymbol[observations[t]][j];
+				candidate.source = i;
+				candidate.rank = 0;
+				if(candidate.score > -numeric_limits<double>::infinity()){
+					expanded.candidates.push_back(candidate);
+				}
+			}
+			make_heap(expanded.candidates.begin(), expanded.candidates.end());
+		}
+		KBestNode& current = nodes[ nodeIds[node] ];
+
+		if(current.best.size() > r || current.exhausted){
+			stack.pop_back();
+			continue;
+		}
+		//the successor of the last derivation taken: the next best path to its source, along the same edge
+		if(!current.successorQueued){
+			const KBestCandidate& last = current.best.back();
+			source = (t - 1) * numStates + last.source;
+			if(t > 0 && last.source >= 0){
+				if(nodeIds[source] < 0 || (nodes[ nodeIds[source] ].best.size() <= last.rank + 1 && !nodes[ nodeIds[source] ].exhausted)){
+					stack.push_back(pair<int,int>(source, last.rank + 1));
+					continue;
+				}
+				KBestNode& previous = nodes[ nodeIds[source] ];
+				if(previous.best.size() > last.rank + 1){
+					if(t < length){
+						candidate.score = (_stateMatrix[last.source][j] + previous.best[last.rank + 1].score) + _emissionsBySymbol[observations[t]][j];
+					}
+					else{
+						candidate.score = previous.best[last.rank + 1].score;
+					}
+					candidate.source = last.source;
+					candidate.rank = last.rank + 1;
+					current.candidates.push_back(candidate);
+					push_heap(current.candidates.begin(), current.candidates.end());
+				}
+			}
+			current.successorQueued = true;
+		}
+		if(current.candidates.empty()){
+			current.exhausted = true;
+			continue;
+		}
+		pop_heap(current.candidates.begin(), current.candidates.end());
+		current.best.push_back(current.candidates.back());
+		current.candidates.pop_back();
+		current.successorQueued = false;
+	}
+
+	//backtrack each derivation of the end node through the ranks recorded at each node
+	KBestNode& end = nodes[ nodeIds[length * numStates] ];
+	paths.resize(end.best.size());
+	for(r = 0; r < end.best.size(); r++){
+		scores.push_back(end.best[r].score);
+		paths[r].resize(length);
+		j = end.best[r].source;
+		i = end.best[r].rank;
+		for(t = length - 1; t >= 0; t--){
+			paths[r][t] = j;
+			if(nodeIds[t * numStates + j] < 0){
+				//never expanded, so only its best path was used: the Viterbi backpointers give the rest
+				for(; t > 0; t--){
+					j = backpointers[t][j];
+					paths[r][t-1] = j;
+				}
+				break;
+			}
+			const KBestCandidate& step = nodes[ nodeIds[t * numStates + j] ].best[i];
+			j = step.source;
+			i = step.rank;
+		}
+	}
+
+	return scores.size() > 0 ? scores[0] : -numeric_limits<double>::infinity();
+}
+
+/*
+A BaumWelch utility, initializes the pi vector, and the state and emission matrices. How these matrices are initialized
+can determine the optimum obtained by the algorithm.
+
+This utility initializes the matrices to random, non-zero probabilities.
+*/
+void DiscreteHmm::_initRandomDistribution()
+{
+	int i, j;
+	double sum;
+
+	srand(_randomSeed != 0 ? _randomSeed : time(NULL));
+
+	//set the pi vector to a random distribution
+	for(i = 0, sum = 0.0; i < _pi.size(); i++){
+		_pi[i] = rand() % 100 + 5;
+		sum += _pi[i];
+	}
+	//set the pi vector to a random distribution
+	for(i = 0; i < _pi.size(); i++){
+		_pi[i] /= sum;
+		_pi[i] = log(_pi[i]);
+	}
+
+	//set the transition matrix to a random distribution
+	for(i = 0; i < _transitionMatrix.NumRows(); i++){
+		for(j = 0, sum = 0.0; j < _transitionMatrix.NumCols(); j++){
+			_transitionMatrix[i][j] = rand() % 100 + 5;
+			sum += _transitionMatrix[i][j];
+		}
+		//normalize
+		for(j = 0; j < _transitionMatrix.NumCols(); j++){
+			_transitionMatrix[i][j] /= sum;
+			_transitionMatrix[i][j] = log(_transitionMatrix[i][j]);
+		}
+	}
+
+	//set the state matrix to a random distribution
+	for(i = 0; i < _stateMatrix.NumRows(); i++){
+		for(j = 0, sum = 0.0; j < _stateMatrix.NumCols(); j++){
+			_stateMatrix[i][j] = rand() % 100 + 5;
+			sum += _stateMatrix[i][j];
+		}
+		//normalize
+		for(j = 0; j < _stateMatrix.NumCols(); j++){
+			_stateMatrix[i][j] /= sum;
+			_stateMatrix[i][j] = log(_stateMatrix[i][j]);
+		}
+	}
+
+	_onModelUpdated();
+}
+
+
+
+
+/*
+For now, just sets both matrices to uniform distributions of 1/N.
+
+Don't use this for BaumWelch initialization. Th effect of a uniform distribution over
+the hidden states is that BaumWelch can make no progress toward improved likelihood,
+due to zero variance in the state probabilities.
+*/
+void DiscreteHmm::_initUniformDistribution()
+{
+	//set the pi vector to a uniform distribution
+	for(int i = 0; i < _pi.size(); i++){
+		_pi[i] = log(1.0 / (double)_pi.size());
+	}
+
+	//set the transition matrix to a uniform distribution
+	for(int i = 0; i < _transitionMatrix.NumRows(); i++){
+		for(int j = 0; j < _transitionMatrix.NumCols(); j++){
+			_transitionMatrix[i][j] = log(1.0 / (double)_transitionMatrix[i].size());
+		}
+	}
+
+	//set the state matrix to a uniform distribution
+	for(int i = 0; i < _stateMatrix.NumRows(); i++){
+		for(int j = 0; j < _stateMatrix.NumCols(); j++){
+			_stateMatrix[i][j] = log(1.0 / (double)_stateMatrix[i].size());
+		}
+	}
+
+	_onModelUpdated();
+}
+
+
+/*
+Given an observation sequence, Baum-Welch will maximize the likelihood of the observations
+given by the model. The maximization is local, not global, converging to a critical point. But See Rabiner.
+Greek letters correspond with Rabiner's notation as well.
+
+As far as implementation, the iterations are basically:
+	Let lambda = (A,B,Pi) distributions.
+
+	Init: lambda can be uniform, trained, whatever. The BW algorithm will maximize lambda according
+	to the training observations it is passed, thereby modifying it from whatever its initial state.
+
+	BW then uses these steps, in terms of implementation:
+		1) determine Xi, gamma from observation sequence, lambda
+		2) Set forward variables (alpha and beta models)
+		3) use Xi, gamma to determine lambda'
+		4) repeat from (1) until convergence
+
+See wikipedia for a decent example. There are many others elsewhere.
+
+By default steps 1-2 are the fused E-step of AccumulateExpectedCounts(), which needs only the alpha lattice;
+SetFusedEStep(false) selects the original implementation, which stores the beta lattice and the xi matrices.
+Iterations stop once the log-likelihood improves by less than the convergence threshold, or after the iteration
+limit (see SetTrainingLimits()).
+SetAcceleratedEM(true) extrapolates the updates (see _acceleratedBaumWelch()), with the same stopping criteria
+counted in passes over the data.
+
+@dataset: The unlabelled dataset from which to learn
+@numHiddenStates: The number of hidden states to initialize the hmm with
+
+*/
+double DiscreteHmm::BaumWelch(DiscreteHmmDataset& dataset, const int numHiddenStates)
+{
+	PROFILE_SCOPE("BaumWelch");
+	int i;
+	bool fused;
+	double pObs_forward, pObs_backward, delta, lastProb;
+	vector<int> unpacked;
+	string dummy;
+	HmmCounts counts;
+
+	//the E-step visits every observation many times per iteration, so compact datasets are decoded once up front
+	if(dataset.IsCompact()){
+		dataset.CompactUnlabeledSequence.Unpack(unpacked);
+	}
+	const vector<int>& observations = dataset.IsCompact() ? unpacked : dataset.UnlabeledDataSequence;
+
+	cout << "TODO: need to handle cases when observations vector includes observations not previously seen" << endl;
+	cout << "in which case the model won't have the correct number of states, etc. This needs to be errr-checked" << endl;
+	cout << "elsewhere, I just don't want to pollute the code with error checks until the methods are stable" << endl;
+
+	//pick the E-step that fits the memory budget before allocating anything
+	fused = _fusedEStep || (_memoryBudget > 0 && _baumWelchBytes(numHiddenStates, dataset.NumSymbols(), observations.size(), false) > _memoryBudget);
+	if(!_withinBudget(_baumWelchBytes(numHiddenStates, dataset.NumSymbols(), observations.size(), fused), "BaumWelch()")){
+		return 1;
+	}
+	if(fused != _fusedEStep){
+		cout << "The xi matrices do not fit in the memory budget; using the fused E-step" << endl;
+	}
+
+	//init
+	Clear();
+	//resize all the required models
+	_resizeModel(numHiddenStates, dataset.NumSymbols()); //resize the pi, state, and transition matrices to fit this data
+	//the fused E-step needs no xi/gamma storage
+	if(!fused){
+		_xiMatrices.resize(observations.size());
+		for(int i = 0; i < _xiMatrices.size(); i++){
+			//resize every matrix in the xi matrices to be a square matrix by the number of hidden states
+			_xiMatrices[i].Resize(_stateMatrix.NumRows(), _stateMatrix.NumCols()); 
+		}
+		//gamma matrix is sized NumStates x NumObservations
+		_gammaLattice.Resize(_stateMatrix.NumRows(), observations.size()); 
+	}
+	//set the hmm-model to random initial values
+	_initRandomDistribution();
+
+	cout << "Initial model: " << endl;
+	PrintModel();
+
+	//until convergence, keep retraining the Xi Model, then using its values to maximize the likelihood of the data
+	i = 0; pObs_forward = pObs_backward = 0;
+	if(_accelerateEM){
+		pObs_forward = _acceleratedBaumWelch([&](HmmCounts& counts){ return AccumulateExpectedCounts(observations, counts); }, _maxIterations, _convergence);
+		PrintModel();
+
+		return pObs_forward;
+	}
+	if(fused){
+		lastProb = -numeric_limits<double>::infinity();
+		while(i < _maxIterations){
+			PROFILE_SCOPE("BaumWelch.Iteration");
+			//expectation step: expected counts under the current model (see AccumulateExpectedCounts())
+			counts.Clear();
+			counts.Resize(_stateMatrix.NumRows(), _transitionMatrix.NumCols());
+			pObs_forward = AccumulateExpectedCounts(observations, counts);
+			//maximization step
+			MaximizeExpectedCounts(counts);
+			//the likelihood is that of the model before this update, so the delta lags by one iteration
+			delta = pObs_forward - lastProb;
+			lastProb = pObs_forward;
+			i++;
+
+			if(_verbose){
+				PrintModel();
+			}
+			cout << i << "\tforward p(obs): " << pObs_forward << "\tdelta: " << delta << endl;
+			if(delta < _convergence){
+				break;
+			}
+		}
+		cout << "BaumWelch completed after " << i << " iterations" << endl;
+		PrintModel();
+
+		return pObs_forward;
+	}
+
+	//initialize the forward and backward values
+	pObs_forward = ForwardAlgorithm(observations, observations.size()-1);
+	cout << "initial p(obs): " << exp(-pObs_forward) << endl;
+	BackwardAlgorithm(observations, 0);
+	while(i < _maxIterations){
+		PROFILE_SCOPE("BaumWelch.Iteration");
+		//expectation step: get the Xi and gamma values (see Rabiner)
+		_retrainXiModel(observations);
+		//maximization step: based on the Xi and gamma values, reset the state and emission probabilities
+		_updateModels(observations);
+		//re-run Forward and Backward algorithms to reset alpha/beta matrices; this is necessary RIGHT???!?!
+		lastProb = pObs_forward;
+		pObs_forward  = ForwardAlgorithm(observations,observations.size()-1);
+		pObs_backward = BackwardAlgorithm(observations,0);
+		delta = pObs_forward - lastProb;
+		i++;
+
+		PrintModel();
+		printf("%lf\n",pObs_forward);
+		cout << i << "\tforward p(obs): " << pObs_forward << "/" << exp(-1 * pObs_forward) << "\tbackward p(obs): " << pObs_backward << "/" << exp(-1 * pObs_backward) << "\tdelta: " << delta << endl;
 		//cout << "Enter anything to continue: " << flush;
 		//cin >> dummy;
 
-		/*****THIS CODE IS EXPERIMENTAL********
-		The BW procedure quickly finds local optima, as tested on +/- state for atcg symbol streams (cpg data).
-		One solution is like the Perceptron pocket algorithm:
-			-Run BW several times until "convergence", giving locally-optimal parameters lambda* for each run.
-			This gives some heuristics:
-			-Keep all such lambda*'s around, average them, re-run
-			-Weight the input of the lambda*'s by their observation probability
-			-Randomizaton and annealing: take the best performing lambda*, and randomly flip some of its parameters according to some
-						decreasing radius.
+		/*****THIS CODE IS EXPERIMENTAL********
+		The BW procedure quickly finds local optima, as tested on +/- state for atcg symbol streams (cpg data).
+		One solution is like the Perceptron pocket algorithm:
+			-Run BW several times until "convergence", giving locally-optimal parameters lambda* for each run.
+			This gives some heuristics:
+			-Keep all such lambda*'s around, average them, re-run
+			-Weight the input of the lambda*'s by their observation probability
+			-Randomizaton and annealing: take the best performing lambda*, and randomly flip some of its parameters according to some
+						decreasing radius.
+
+		Beware overfitting the training data. But for very large training sets relative to the state model complexity,
+		this shouldn't be too much of a problem.
+		****************************************/
+		if(delta < _convergence){
+			break;
+		}
+	}
+	cout << "BaumWelch completed" << endl;
+	PrintModel();
+
+	return pObs_forward;
+}
+
+/*
+Viterbi training (hard EM, or segmental k-means): an unsupervised alternative to BaumWelch() which is much
+cheaper per iteration. Each iteration decodes the dataset with Viterbi() under the current model, then
+re-estimates the model from the decoded state sequence by counting, as DirectTrain() does from labelled data.
+An iteration is a max-plus pass with no log-sum-exp, exponentials, or xi/gamma accumulation, and the decoding
+honours the memory budget (see SetMemoryBudget()), so it scales to long sequences.
+
+Hard EM maximizes the probability of the best path rather than of the data, so its optimum is generally not that
+of Baum-Welch. It is best used to warm start Baum-Welch: @refinementIterations plain (or accelerated, see
+SetAcceleratedEM()) Baum-Welch iterations are run on the result, which usually need far fewer iterations
+than from a random model.
+
+Iterations stop once the decoded path is unchanged, or its ln-probability improves by less than the convergence
+threshold, or after the iteration limit (see SetTrainingLimits()). Returns ln P(observations) under the final model,
+or 1 on error. The decoding can fall back to a checkpointed lattice under a tight memory budget, but the refinement
+needs a full alpha lattice, so with @refinementIterations > 0 the budget is checked for it before training.
+*/
+double DiscreteHmm::ViterbiTrain(DiscreteHmmDataset& dataset, const int numHiddenStates, const int refinementIterations)
+{
+	PROFILE_SCOPE("ViterbiTrain");
+	double pObs;
+	vector<int> unpacked;
+
+	if(dataset.IsCompact()){
+		dataset.CompactUnlabeledSequence.Unpack(unpacked);
+	}
+	const vector<int>& observations = dataset.IsCompact() ? unpacked : dataset.UnlabeledDataSequence;
+	if(observations.size() == 0){
+		cout << "ERROR empty dataset in ViterbiTrain()" << endl;
+		return 1;
+	}
+	if(refinementIterations > 0 && !_withinBudget(_baumWelchBytes(numHiddenStates, dataset.NumSymbols(), observations.size(), true), "ViterbiTrain() refinement")){
+		return 1;
+	}
+
+	Clear();
+	_resizeModel(numHiddenStates, dataset.NumSymbols());
+	_initRandomDistribution();
+
+	if(_viterbiTrain(observations, _maxIterations, _convergence) > 0){
+		return 1;
+	}
+	if(refinementIterations > 0){
+		pObs = _refineBaumWelch(observations, refinementIterations);
+		if(pObs > 0){
+			return 1;
+		}
+	}
+	else{
+		pObs = _forwardAlgorithm(observations, observations.size()-1);
+	}
+	cout << "ViterbiTrain completed. p(obs): " << pObs << endl;
+	if(_verbose){
+		PrintModel();
+	}
+
+	return pObs;
+}
+
+/*
+The hard EM loop of ViterbiTrain(), from the current model. Counts are smoothed by a small pseudo-count, since a
+state or transition which the decoded path happens to miss would otherwise get probability zero, and could never
+be used again. Returns the ln-probability of the last decoded path, or 1 if decoding failed (eg, over the memory
+budget), in which case the model is left as of the last completed iteration.
+*/
+double DiscreteHmm::_viterbiTrain(const vector<int>& observations, const int maxIterations, const double convergence)
+{
+	int i, t, j, k;
+	const double smoothing = 0.01;
+	double score, lastScore;
+	vector<int> path, lastPath;
+	HmmCounts counts;
+
+	score = lastScore = -numeric_limits<double>::infinity();
+	for(i = 0; i < maxIterations; i++){
+		PROFILE_SCOPE("ViterbiTrain.Iteration");
+		//path holds the previous iteration's path, which a failed decoding would leave in place
+		path.clear();
+		score = _viterbi(observations, observations.size(), path);
+		if(score > 0 || path.size() != observations.size()){
+			cout << "ERROR decoding failed in iteration " << (i+1) << " of ViterbiTrain()" << endl;
+			return 1;
+		}
+
+		counts.Clear();
+		counts.Resize(_stateMatrix.NumRows(), _transitionMatrix.NumCols());
+		for(j = 0; j < counts.NumStates(); j++){
+			counts.Initial[j] = smoothing;
+			for(k = 0; k < counts.NumStates(); k++){
+				counts.Transitions[j][k] = smoothing;
+			}
+			for(k = 0; k < counts.NumSymbols(); k++){
+				counts.Emissions[j][k] = smoothing;
+			}
+		}
+		counts.Initial[ path[0] ]++;
+		counts.Emissions[ path[0] ][ observations[0] ]++;
+		for(t = 1; t < observations.size(); t++){
+			counts.Transitions[ path[t-1] ][ path[t] ]++;
+			counts.Emissions[ path[t] ][ observations[t] ]++;
+		}
+		MaximizeExpectedCounts(counts);
+
+		cout << (i+1) << "\tviterbi p(path, obs): " << score << "\tdelta: " << (score - lastScore) << endl;
+		if(path == lastPath || score - lastScore < convergence){
+			i++;
+			break;
+		}
+		lastScore = score;
+		path.swap(lastPath);
+	}
+	cout << "Viterbi training completed after " << i << " iterations" << endl;
+
+	return score;
+}
+
+/*
+Runs @iterations Baum-Welch iterations on the current model (fused E-step, or accelerated; see SetAcceleratedEM()),
+stopping early on convergence as BaumWelch() does. Returns ln P(observations) under the model before the last update,
+or 1 if an E-step failed, in which case the model is left as of the last completed iteration.
+*/
+double DiscreteHmm::_refineBaumWelch(const vector<int>& observations, const int iterations)
+{
+	int i;
+	double pObs, lastProb;
+	HmmCounts counts;
+
+	if(_accelerateEM){
+		return _acceleratedBaumWelch([&](HmmCounts& counts){ return AccumulateExpectedCounts(observations, counts); }, iterations, _convergence);
+	}
+
+	lastProb = -numeric_limits<double>::infinity();
+	pObs = 0;
+	for(i = 0; i < iterations; i++){
+		counts.Clear();
+		counts.Resize(_stateMatrix.NumRows(), _transitionMatrix.NumCols());
+		pObs = AccumulateExpectedCounts(observations, counts);
+		if(pObs > 0){
+			cout << "ERROR E-step failed in iteration " << (i+1) << " of the Baum-Welch refinement" << endl;
+			return 1;
+		}
+		MaximizeExpectedCounts(counts);
+		cout << (i+1) << "\tforward p(obs): " << pObs << "\tdelta: " << (pObs - lastProb) << endl;
+		if(pObs - lastProb < _convergence){
+			break;
+		}
+		lastProb = pObs;
+	}
+
+	return pObs;
+}
+
+/*
+This updates the state and emission probabilities based on the expectation given by the updated
+Xi/gamma models. This assumes the Xi/gamma models were just updated in the expectation step;
+this step is the corresponding maximization step.
+
+NOTE: All values should already be normalized, per work in _retrainXiModels().
+*/
+void DiscreteHmm::_updateModels(const vector<int>& observations)
+{
+	PROFILE_SCOPE("BaumWelch.MStep");
+	int t, i, j, k;
+	double maxXi, maxGamma, maxObsGamma, gammaNorm;
+	vector<double> xiVals, gammaVals, gammaObsVals;
+	vector<vector<int> > symbolTimes;
+
+	//init the temp storage vectors for summing log probabilities; there are T-1 transitions, but T emissions
+	xiVals.resize(observations.size() - 1);
+	gammaVals.resize(observations.size() - 1);
+
+	//cout << "_updateModels()" << endl;
+ 
+	//update the Pi values: these are just the first column of the gamma values
+	for(i = 0; i < _gammaLattice.NumRows(); i++){
+		_pi[i] = _gammaLattice[0][i];
+	}
+
+	//update the A (state transition prob) values
+	for(i = 0; i < _stateMatrix.NumRows(); i++){
+		//first get the normal/denominator for current state i
+		maxGamma = MIN_DOUBLE;
+		for(t = 0; t < observations.size() - 1; t++){
+			gammaVals[t] = _gammaLattice[t][i];
+			if(gammaVals[t] > maxGamma){
+				maxGamma = gammaVals[t];
+			}
+		}
+		gammaNorm = _logSumExp(gammaVals,maxGamma);
+		//now sum through xiMatrices for all transitions from state i to j
+		for(j = 0; j < _stateMatrix.NumCols(); j++){
+			maxXi = MIN_DOUBLE;
+			for(t = 0; t < observations.size() - 1; t++){
+				xiVals[t] = _xiMatrices[t][i][j];
+				if(xiVals[t] > maxXi){
+					maxXi = xiVals[t];
+				}
+			}
+			//use the log-sum-exp trick to get the sum of these probs, then divide them
+			_stateMatrix[i][j] = _logSumExp(xiVals,maxXi) - gammaNorm;
+		}
+	}
+
+	//update the emission probabilities: bucket the time steps by their observed symbol once, so each state needs
+	//one pass over its gamma values for the normalizer and one over the buckets, rather than a pass over the
+	//sequence per symbol. The per-symbol sums visit their gamma values in time order, as a per-symbol scan would.
+	symbolTimes.resize(_transitionMatrix.NumCols());
+	for(t = 0; t < observations.size(); t++){
+		symbolTimes[ observations[t] ].push_back(t);
+	}
+	gammaVals.resize(observations.size());
+	for(i = 0; i < _transitionMatrix.NumRows(); i++){ // iterate the states
+		//the denominator: total expected occupancy of state i
+		maxGamma = MIN_DOUBLE;
+		for(t = 0; t < observations.size(); t++){
+			gammaVals[t] = _gammaLattice[t][i];
+			if(gammaVals[t] > maxGamma){
+				maxGamma = gammaVals[t];
+			}
+		}
+		gammaNorm = _logSumExp(gammaVals, maxGamma);
+
+		for(j = 0; j < _transitionMatrix.NumCols(); j++){ // iterate the symbols
+			const vector<int>& times = symbolTimes[j];
+			if(times.size() == 0){
+				_transitionMatrix[i][j] = MIN_DOUBLE; //no symbol matches, so set log probability to negative infinity
+				continue;
+			}
+			gammaObsVals.resize(times.size());
+			maxObsGamma = MIN_DOUBLE;
+			for(k = 0; k < times.size(); k++){
+				gammaObsVals[k] = _gammaLattice[ times[k] ][i];
+				if(gammaObsVals[k] > maxObsGamma){
+					maxObsGamma = gammaObsVals[k];
+				}
+			}
+			_transitionMatrix[i][j] = _logSumExp(gammaObsVals, maxObsGamma) - gammaNorm;
+		}
+	}
+
+	_onModelUpdated();
+}
+
+/*
+Updates the Xi and gamma models given an observation sequence.
+*/
+void DiscreteHmm::_retrainXiModel(const vector<int>& observations)
+{
+	PROFILE_SCOPE("BaumWelch.EStep");
+	int t, i, j;
+	double pObs, b;
+	vector<double> normVec, gammaVec;
+
+	//normalization vectors
+	normVec.resize(_stateMatrix.NumRows() * _stateMatrix.NumCols());
+	gammaVec.resize(_stateMatrix.NumRows());
+
+	for(t = 0; t < observations.size() - 1; t++){
+		Matrix<double>& xiMatrix = _xiMatrices[t];
+		const vector<double>& emissions = _emissionsBySymbol[ observations[t+1] ];
+		//cout << "top1... " << t << "/" << _xiMatrices.size() << "/" << observations.size() << endl;
+		//set the Xi matrix values
+		b = MIN_DOUBLE;
+		for(i = 0; i < _stateMatrix.NumRows(); i++){
+			for(j = 0; j < _stateMatrix.NumCols(); j++){
+				xiMatrix[i][j] = _alphaLattice[t][i] + _stateMatrix[i][j] + emissions[j] + _betaLattice[t+1][j];
+				//sum log-probs
+				normVec[i * _stateMatrix.NumRows() + j] = xiMatrix[i][j];
+				if(xiMatrix[i][j] > b){
+					b = xiMatrix[i][j];
+				}
+			}
+		}
+		//get the total probability of the observation per the log-sum-exp trick
+		pObs = _logSumExp(normVec, b);
+		//and normalize all the probs for this state after initializing them
+		for(i = 0; i < xiMatrix.NumRows(); i++){
+			for(j = 0; j < xiMatrix.NumCols(); j++){
+				xiMatrix[i][j] -= pObs; // log division
+			}
+		}
+
+		//set the gamma values for each state (See Rabiner; for a given state i, its gamma value is the sum over all states j)
+		for(i = 0; i < xiMatrix.NumRows(); i++){
+			//cout << "summing.." << endl;
+			b = MIN_DOUBLE;
+			for(j = 0, _gammaLattice[t][i] = 0; j < xiMatrix.NumCols(); j++){
+				gammaVec[j] = xiMatrix[i][j]; //sum the log-probs in linear space by exp'ing them
+				if(gammaVec[j] > b){
+					b = gammaVec[j];
+				}
+			}
+			_gammaLattice[t][i] = _logSumExp(gammaVec, b); //convert back to log space
+		}
+	}
+
+	//the last column has no outgoing transitions; its gamma values are alpha_T-1(i) / P(observations), since beta_T-1 = 1
+	t = observations.size() - 1;
+	pObs = _columnLogSum(_alphaLattice[t]);
+	for(i = 0; i < _stateMatrix.NumRows(); i++){
+		_gammaLattice[t][i] = _alphaLattice[t][i] - pObs;
+	}
+}
+
+/*
+Normal initialization training: read a bunch of data containing both labelled emissions
+and labelled hidden/latent states, and build the A and B matrices (as they're called in Rabiner's tutorial)
+
+The raw transition, emission and initial state counts are retained with the model, so that more labelled
+data can be added later with UpdateDirectTrain() without recounting, and they can be saved with WriteCounts().
+Any previous model is discarded. Each sequence of the dataset (sequences are separated by blank lines in the
+file) gives one initial state count.
+
+TODO: State and Transition matrices could be very large and sparse for some datasets; this could be resolved
+by implementing a Matrix class capable of handling such sparseness.
+
+TODO: Smoothing for unobserved transitions. Rather than setting them to zero, use some smoothing method (there
+are many).
+*/
+void DiscreteHmm::DirectTrain(DiscreteHmmDataset& dataset)
+{
+	PROFILE_SCOPE("DirectTrain");
+	//TODO: numerical storage could be wrapped in compiler/maXine specific ifdefs, but I don't want to for now
+	//For every maXine/compiler that's worth more than two cents, this should evaluate to true.
+	if(!numeric_limits<double>::has_infinity || !std::numeric_limits<double>::is_iec559){ //IEEE 754
+		cout << "ERROR double does not have infinity, recompile with some other signal value for zero probabilities in log space" << endl;
+		cout << "Consider updating your computer to electric power." << endl;
+	}
+
+	cout << "Training directly on " << dataset.NumInstances() << " labelled examples..." << endl;
+
+	Clear();
+	_addDatasetCounts(dataset);
+
+	cout << "HMM training completed." << endl;
+	this->PrintModel();
+}
+
+/*
+Adds the counts of another labelled dataset to those retained from previous training, and renormalizes
+only the rows of the model whose counts changed (or all of them, if the dataset introduces new states
+or symbols). The dataset is treated as a separate sequence: no transition is counted between the end of
+the previous data and the start of this one.
+*/
+void DiscreteHmm::UpdateDirectTrain(DiscreteHmmDataset& dataset)
+{
+	PROFILE_SCOPE("UpdateDirectTrain");
+	if(_counts.NumStates() == 0 && _stateMatrix.NumRows() > 0){
+		cout << "ERROR model has no raw counts to update; train it with DirectTrain() or load its counts with ReadCounts()" << endl;
+		return;
+	}
+
+	cout << "Updating model with " << dataset.NumInstances() << " labelled examples..." << endl;
+	_addDatasetCounts(dataset);
+}
+
+/*
+Counts a labelled dataset in its own id space and adds the counts to the model. Each of the dataset's sequences
+(see DiscreteHmmDataset::LabeledSequenceStarts) gives an initial state count, and no transition is counted
+between consecutive sequences.
+*/
+void DiscreteHmm::_addDatasetCounts(DiscreteHmmDataset& dataset)
+{
+	int i, k, numStates, numSymbols;
+	vector<string> states, symbols;
+	HmmCounts counts;
+
+	numStates = dataset.NumStates();
+	numSymbols = dataset.NumSymbols();
+	counts.Resize(numStates, numSymbols);
+	vector<double>& initial = counts.Initial;
+	vector<vector<double> >& transitions = counts.Transitions;
+	vector<vector<double> >& emissions = counts.Emissions;
+	for(i = 0; i < numStates; i++){
+		states.push_back(dataset.GetState(i));
+	}
+	for(i = 0; i < numSymbols; i++){
+		symbols.push_back(dataset.GetSymbol(i));
+	}
+
+	//count all the frequencies; k indexes the next sequence start
+	const vector<int>& starts = dataset.LabeledSequenceStarts;
+	if(dataset.IsCompact()){
+		const PackedSequence& stateSeq = dataset.CompactStateSequence;
+		const PackedSequence& symbolSeq = dataset.CompactSymbolSequence;
+		if(stateSeq.size() > 0){
+			initial[ stateSeq[0] ]++;
+			emissions[ stateSeq[0] ][ symbolSeq[0] ]++;
+		}
+		for(i = 1, k = 0; i < stateSeq.size(); i++){
+			if(k < starts.size() && starts[k] == i){
+				initial[ stateSeq[i] ]++;
+				k++;
+			}
+			else{
+				transitions[ stateSeq[i-1] ][ stateSeq[i] ]++;
+			}
+			emissions[ stateSeq[i] ][ symbolSeq[i] ]++;
+		}
+	}
+	else{
+		vector<pair<int,int> >& sequence = dataset.LabeledDataSequence;
+		if(sequence.size() > 0){
+			initial[ sequence[0].first ]++;
+			emissions[ sequence[0].first ][ sequence[0].second ]++;
+		}
+		for(i = 1, k = 0; i < sequence.size(); i++){
+			if(k < starts.size() && starts[k] == i){
+				initial[ sequence[i].first ]++;
+				k++;
+			}
+			else{
+				transitions[ sequence[i-1].first ][ sequence[i].first ]++;
+			}
+			emissions[ sequence[i].first ][ sequence[i].second ]++;
+		}
+	}
+
+	_addCounts(states, symbols, counts);
+}
+
+/*
+Adds raw counts to those retained by the model, then renormalizes the affected parts of the model.
+The counts are indexed by @states and @symbols, which are mapped to the model's own ids by name;
+labels the model has not seen before are added to it.
+*/
+void DiscreteHmm::_addCounts(const vector<string>& states, const vector<string>& symbols, const HmmCounts& counts)
+{
+	int i, j, oldStates, oldSymbols, numStates, numSymbols;
+	bool grown, initialChanged;
+	vector<int> stateMap, symbolMap;
+	vector<bool> dirtyTransitions, dirtyEmissions;
+
+	oldStates = _dataset.NumStates();
+	oldSymbols = _dataset.NumSymbols();
+	for(i = 0; i < states.size(); i++){
+		stateMap.push_back(_dataset.AddState(states[i]));
+	}
+	for(i = 0; i < symbols.size(); i++){
+		symbolMap.push_back(_dataset.AddSymbol(symbols[i]));
+	}
+	numStates = _dataset.NumStates();
+	numSymbols = _dataset.NumSymbols();
+	grown = numStates != oldStates || numSymbols != oldSymbols;
+
+	//grow the count tables, preserving existing counts
+	_counts.Resize(numStates, numSymbols);
+
+	//add the counts, tracking which rows changed
+	initialChanged = false;
+	dirtyTransitions.assign(numStates, false);
+	dirtyEmissions.assign(numStates, false);
+	for(i = 0; i < states.size(); i++){
+		if(counts.Initial[i] != 0){
+			_counts.Initial[ stateMap[i] ] += counts.Initial[i];
+			initialChanged = true;
+		}
+		for(j = 0; j < states.size(); j++){
+			if(counts.Transitions[i][j] != 0){
+				_counts.Transitions[ stateMap[i] ][ stateMap[j] ] += counts.Transitions[i][j];
+				dirtyTransitions[ stateMap[i] ] = true;
+			}
+		}
+		for(j = 0; j < symbols.size(); j++){
+			if(counts.Emissions[i][j] != 0){
+				_counts.Emissions[ stateMap[i] ][ symbolMap[j] ] += counts.Emissions[i][j];
+				dirtyEmissions[ stateMap[i] ] = true;
+			}
+		}
+	}
+
+	//renormalize the affected rows; if the label set grew, every row gains new entries
+	_pi.resize(numStates);
+	_stateMatrix.Resize(numStates, numStates);
+	_transitionMatrix.Resize(numStates, numSymbols);
+	if(grown || initialChanged){
+		_lnNormalize(_counts.Initial, _pi);
+	}
+	for(i = 0; i < numStates; i++){
+		if(grown || dirtyTransitions[i]){
+			_lnNormalize(_counts.Transitions[i], _stateMatrix[i]);
+		}
+		if(grown || dirtyEmissions[i]){
+			_lnNormalize(_counts.Emissions[i], _transitionMatrix[i]);
+		}
+	}
+
+	_onModelUpdated();
+}
+
+/*
+Writes the ln-normalized values of a vector of counts into @output, as in Matrix::LnNormalizeRows(),
+but leaving the counts intact. Zero counts become -inf (zero probability); a row with no counts at all
+becomes all -inf.
+*/
+void DiscreteHmm::_lnNormalize(const vector<double>& counts, vector<double>& output)
+{
+	int i;
+	double norm = 0;
+
+	for(i = 0; i < counts.size(); i++){
+		norm += counts[i];
+	}
+	for(i = 0; i < counts.size(); i++){
+		if(counts[i] > 0){
+			output[i] = log(counts[i]) - log(norm);
+		}
+		else{
+			output[i] = -numeric_limits<double>::infinity();
+		}
+	}
+}
+
+/*
+Writes the raw counts retained from supervised training to a file, in the same layout as a .hmm file
+but with counts in place of probabilities:
+	X=<symbols>
+	Z=<states>
+	A=<transition counts, rows separated by ';'>
+	B=<emission counts, rows separated by ';'>
+	Pi=<initial state counts>
+*/
+void DiscreteHmm::WriteCounts(const string& path)
+{
+	int i, j;
+	fstream outputFile;
+
+	outputFile.open(path.c_str(),ios::out);
+	if(!outputFile.is_open()){
+		cout << "ERROR could not open counts file: " << path << endl;
+		return;
+	}
+	outputFile.precision(17);
+
+	outputFile << "X=";
+	for(i = 0; i < _dataset.NumSymbols(); i++){
+		outputFile << _dataset.GetSymbol(i) << (i < _dataset.NumSymbols()-1 ? "," : "");
+	}
+	outputFile << "\nZ=";
+	for(i = 0; i < _dataset.NumStates(); i++){
+		outputFile << _dataset.GetState(i) << (i < _dataset.NumStates()-1 ? "," : "");
+	}
+	outputFile << "\nA=";
+	for(i = 0; i < _counts.Transitions.size(); i++){
+		for(j = 0; j < _counts.Transitions[i].size(); j++){
+			outputFile << _counts.Transitions[i][j] << (j < _counts.Transitions[i].size()-1 ? "," : "");
+		}
+		outputFile << (i < _counts.Transitions.size()-1 ? ";" : "");
+	}
+	outputFile << "\nB=";
+	for(i = 0; i < _counts.Emissions.size(); i++){
+		for(j = 0; j < _counts.Emissions[i].size(); j++){
+			outputFile << _counts.Emissions[i][j] << (j < _counts.Emissions[i].size()-1 ? "," : "");
+		}
+		outputFile << (i < _counts.Emissions.size()-1 ? ";" : "");
+	}
+	outputFile << "\nPi=";
+	for(i = 0; i < _counts.Initial.size(); i++){
+		outputFile << _counts.Initial[i] << (i < _counts.Initial.size()-1 ? "," : "");
+	}
+	outputFile << endl;
+
+	outputFile.close();
+}
+
+/*
+Replaces the model with the one given by a counts file (see WriteCounts()).
+*/
+bool DiscreteHmm::ReadCounts(const string& path)
+{
+	Clear();
+	return MergeCounts(path);
+}
+
+/*
+Adds the counts in a counts file (see WriteCounts()) to the model's counts, eg to combine the counts
+of several jobs which each trained on part of the data. States and symbols are matched by name.
+*/
+bool DiscreteHmm::MergeCounts(const string& path)
+{
+	int i, j;
+	string line, param, argstr;
+	fstream countsFile;
+	vector<string> states, symbols, args, row;
+	HmmCounts counts;
+	vector<double>& initial = counts.Initial;
+	vector<vector<double> >& transitions = counts.Transitions;
+	vector<vector<double> >& emissions = counts.Emissions;
+
+	countsFile.open(path.c_str(), ios::in);
+	if(!countsFile.is_open()){
+		cout << "ERROR could not open counts file: " << path << endl;
+		return false;
+	}
+
+	while(getline(countsFile,line)){
+		if(line.length() > 0 && line[0] != '#' && line.find('=') != string::npos){
+			param = line.substr(0,line.find('='));
+			argstr = line.substr(line.find('=')+1);
+			if(param == "X"){
+				_split(argstr,',',symbols);
+			}
+			else if(param == "Z"){
+				_split(argstr,',',states);
+			}
+			else if(param == "A" || param == "B"){
+				vector<vector<double> >& table = (param == "A") ? transitions : emissions;
+				_split(argstr,';',args);
+				table.resize(args.size());
+				for(i = 0; i < args.size(); i++){
+					_split(args[i],',',row);
+					for(j = 0; j < row.size(); j++){
+						table[i].push_back(stod(row[j]));
+					}
+				}
+			}
+			else if(param == "Pi"){
+				_split(argstr,',',args);
+				for(i = 0; i < args.size(); i++){
+					initial.push_back(stod(args[i]));
+				}
+			}
+		}
+	}
+
+	//validate the dimensions before touching the model
+	bool valid = initial.size() == states.size() && transitions.size() == states.size() && emissions.size() == states.size();
+	for(i = 0; valid && i < states.size(); i++){
+		valid = transitions[i].size() == states.size() && emissions[i].size() == symbols.size();
+	}
+	if(!valid){
+		cout << "ERROR counts file has inconsistent dimensions: " << path << endl;
+		return false;
+	}
+
+	_addCounts(states, symbols, counts);
+
+	return true;
+}
+
+/*
+The same supervised training as DirectTrain(), but streamed from a labeled dataset file (see DiscreteHmmDataset
+for the format) instead of a dataset in memory, with the counting spread over @numThreads threads. See ShardedCounter.
+Memory use depends on @chunkBytes, the number of threads and the size of the model, but not the size of the file,
+so this is the option for corpora which do not fit in memory. The resulting model and counts are identical to those
+of BuildLabeledDataset() followed by DirectTrain().
+*/
+void DiscreteHmm::StreamingDirectTrain(const string& dataPath, const int numThreads, const int chunkBytes)
+{
+	PROFILE_SCOPE("StreamingDirectTrain");
+	int i;
+	vector<string> states, symbols;
+	HmmCounts counts;
+	DiscreteHmmDataset labels;
+	ShardedCounter counter(numThreads, chunkBytes);
+
+	Clear();
+	if(!counter.CountFile(dataPath, labels, counts)){
+		cout << "ERROR streaming training failed for " << dataPath << endl;
+		return;
+	}
+
+	for(i = 0; i < labels.NumStates(); i++){
+		states.push_back(labels.GetState(i));
+	}
+	for(i = 0; i < labels.NumSymbols(); i++){
+		symbols.push_back(labels.GetSymbol(i));
+	}
+	_addCounts(states, symbols, counts);
 
-		Beware overfitting the training data. But for very large training sets relative to the state model complexity,
-		this shouldn't be too much of a problem.
-		****************************************/
+	cout << "HMM training completed." << endl;
+	if(_verbose){
+		this->PrintModel();
 	}
-	cout << "BaumWelch completed" << endl;
-	PrintModel();
+}
 
-	return pObs_forward;
+/*
+Baum-Welch over an unlabelled dataset file (text or binary, see DatasetReader) too large to hold in memory,
+which may contain many sequences. Each iteration streams the file through a DatasetReader, whose background
+thread decodes the next batch of sequences while the E-step runs on the current one, so the E-step should not
+wait on the disk; the time it did wait is reported per iteration. Stopping criteria, and acceleration (see
+SetAcceleratedEM()), are those of BaumWelch().
+
+Every sequence must fit the memory budget (see SetMemoryBudget()), since the E-step holds its whole alpha lattice.
+Training stops at the first sequence whose E-step fails, before any update from the partial counts, so the model
+is left as of the last completed iteration.
+
+Returns the total ln P of the dataset under the model before the last update, as BaumWelch() does, or 1 on error.
+*/
+double DiscreteHmm::StreamingBaumWelch(const string& dataPath, const int numHiddenStates, const int batchSize)
+{
+	PROFILE_SCOPE("StreamingBaumWelch");
+	int i, j;
+	unsigned long long n;
+	double delta, lastProb, stall;
+	vector<string> symbols;
+	vector<vector<int> > batch;
+	HmmCounts counts;
+	DatasetReader reader(batchSize);
+
+	//the vocabulary fixes the model's dimensions: from the binary header, or a first pass over a text file
+	if(!DatasetReader::ReadVocabulary(dataPath, symbols) || symbols.size() == 0){
+		cout << "ERROR no symbols read from " << dataPath << " in StreamingBaumWelch()" << endl;
+		return 1;
+	}
+
+	Clear();
+	InitRandomModel(symbols, numHiddenStates);
+
+	//one E-step over the whole file; returns 1 if the file cannot be read or a sequence fails
+	auto eStep = [&](HmmCounts& counts) -> double {
+		if(!reader.Open(dataPath, symbols)){
+			return 1;
+		}
+		for(n = 0; reader.NextBatch(batch); ){
+			for(j = 0; j < batch.size(); j++, n++){
+				if(AccumulateExpectedCounts(batch[j], counts) > 0){
+					cout << "ERROR E-step failed on sequence " << n << " (" << batch[j].size() << " observations) of " << dataPath << endl;
+					reader.Close();
+					return 1;
+				}
+			}
+		}
+		stall += reader.StallSeconds();
+		return counts.LogLikelihood;
+	};
+
+	stall = 0;
+	if(_accelerateEM){
+		lastProb = _acceleratedBaumWelch(eStep, _maxIterations, _convergence);
+		if(lastProb > 0){
+			return 1;
+		}
+		cout << "StreamingBaumWelch completed; reader stall time " << stall << "s" << endl;
+		if(_verbose){
+			PrintModel();
+		}
+
+		return lastProb;
+	}
+
+	lastProb = -numeric_limits<double>::infinity();
+	for(i = 0; i < _maxIterations; i++){
+		PROFILE_SCOPE("StreamingBaumWelch.Iteration");
+		counts.Clear();
+		counts.Resize(_stateMatrix.NumRows(), _transitionMatrix.NumCols());
+		if(eStep(counts) > 0){
+			cout << "ERROR StreamingBaumWelch stopped in iteration " << (i+1) << endl;
+			return 1;
+		}
+		MaximizeExpectedCounts(counts);
+
+		delta = counts.LogLikelihood - lastProb;
+		lastProb = counts.LogLikelihood;
+		cout << (i+1) << "\tforward p(obs): " << counts.LogLikelihood << "\tdelta: " << delta << "\t" << reader.StatsString() << endl;
+		if(delta < _convergence){
+			i++;
+			break;
+		}
+	}
+	cout << "StreamingBaumWelch completed after " << i << " iterations; reader stall time " << stall << "s" << endl;
+	if(_verbose){
+		PrintModel();
+	}
+
+	return counts.LogLikelihood;
 }
 
 /*
-This updates the state and emission probabilities based on the expectation given by the updated
-Xi/gamma models. This assumes the Xi/gamma models were just updated in the expectation step;
-this step is the corresponding maximization step.
+Initializes a random model over the given emission symbols, for distributed Baum-Welch (see DistributedBaumWelch).
+The hidden states are unlabelled, so they are named by their ids.
+*/
+void DiscreteHmm::InitRandomModel(const vector<string>& symbols, const int numStates)
+{
+	int i;
 
-NOTE: All values should already be normalized, per work in _retrainXiModels().
+	_resizeModel(numStates, symbols.size());
+	for(i = 0; i < symbols.size(); i++){
+		_dataset.AddSymbol(symbols[i]);
+	}
+	for(i = 0; i < numStates; i++){
+		_dataset.AddState(to_string(i));
+	}
+	_initRandomDistribution();
+}
+
+/*
+The expectation step of Baum-Welch, for one observation sequence. Adds the expected initial state, transition
+and emission counts under the current model to @counts, which must already be sized to the model, and adds
+ln P(observations) to counts.LogLikelihood. Returns ln P(observations).
+
+This is a fused E-step: only the alpha lattice is stored. The backward recursion then runs from the end of the
+sequence keeping just two beta columns, and at each step the gamma and xi values of that step are added into
+the count tables as soon as they are computed. The terms a_ij + b_j(o_t+1) + beta_t+1(j) are shared by the
+beta recurrence and by xi_t(i,j), so each row of the model is read once per time step. Compared with
+BackwardAlgorithm() followed by _retrainXiModel(), no beta lattice or xi matrices are materialized, and the
+per-iteration pass over them is gone.
+
+With emission pruning (see SetEmissionPruning()), gamma_t is counted only for the states that can emit o_t, and
+xi_t-1 only between the states that can emit o_t-1 and o_t; every other term is exactly zero.
+
+The counts of several sequences (or shards of a corpus) can be summed and passed to MaximizeExpectedCounts(),
+without any one process holding all of the data.
 */
-void DiscreteHmm::_updateModels(const vector<int>& observations)
+double DiscreteHmm::AccumulateExpectedCounts(const vector<int>& observations, HmmCounts& counts)
 {
-	int t, i, j;
-	double maxXi, maxGamma, maxObsGamma, gammaNorm;
-	vector<double> xiVals, gammaVals, gammaObsVals;
+	return _accumulateExpectedCounts(observations, counts);
+}
 
-	//init the temp storage vectors for summing log probabilities
-	xiVals.resize(observations.size());
-	gammaVals.resize(observations.size());
+double DiscreteHmm::AccumulateExpectedCounts(const SequenceView& observations, HmmCounts& counts)
+{
+	return _accumulateExpectedCounts(observations, counts);
+}
 
-	//cout << "_updateModels()" << endl;
- 
-	//update the Pi values: these are just the first column of the gamma values
-	for(i = 0; i < _gammaLattice.NumRows(); i++){
-		_pi[i] = _gammaLattice[0][i];
+template<typename SequenceT>
+double DiscreteHmm::_accumulateExpectedCounts(const SequenceT& observations, HmmCounts& counts)
+{
+	PROFILE_SCOPE("AccumulateExpectedCounts");
+	int t, i, j, s, d, numStates;
+	bool pruned;
+	double pObs, gamma, b;
+	vector<double> beta, prevBeta, right, temp;
+
+	numStates = _stateMatrix.NumRows();
+	if(observations.size() == 0){
+		return 0;
+	}
+	if(counts.NumStates() != numStates || counts.NumSymbols() != _transitionMatrix.NumCols()){
+		cout << "ERROR counts dimensions do not match the model in AccumulateExpectedCounts()" << endl;
+		return 1;
+	}
+	//the backward pass reads the whole alpha lattice, so there is no rolling variant
+	if(!_withinBudget(_latticeBytes(numStates, observations.size(), sizeof(double)) + 4 * numStates * sizeof(double), "AccumulateExpectedCounts()")){
+		return 1;
 	}
 
-	//update the A (state transition prob) values
-	for(i = 0; i < _stateMatrix.NumRows(); i++){
-		//first get the normal/denominator for current state i
-		maxGamma = MIN_DOUBLE;
-		for(t = 0; t < observations.size(); t++){
-			gammaVals[t] = _gammaLattice[t][i];
-			if(gammaVals[t] > maxGamma){
-				maxGamma = gammaVals[t];
+	pObs = _forwardAlgorithm(observations, observations.size()-1);
+	if(isinf(pObs)){
+		//the sequence is impossible under the model, and has no posterior to count
+		counts.LogLikelihood += pObs;
+		return pObs;
+	}
+
+	//beta_T-1 is all ones (zero in log space)
+	beta.assign(numStates, 0);
+	prevBeta.resize(numStates);
+	right.resize(numStates);
+	temp.resize(numStates);
+	for(t = observations.size() - 1; t >= 0; t--){
+		const vector<double>& alpha = _alphaLattice[t];
+		const vector<int>& emitting = _statesBySymbol[ observations[t] ];
+		pruned = _pruneEmissions && emitting.size() * 2 <= numStates;
+		for(s = 0; s < (pruned ? emitting.size() : numStates); s++){
+			i = pruned ? emitting[s] : s;
+			//gamma_t(i) = alpha_t(i) * beta_t(i) / P(observations)
+			gamma = _logMath.Exp(alpha[i] + beta[i] - pObs);
+			counts.Emissions[i][ observations[t] ] += gamma;
+			if(t == 0){
+				counts.Initial[i] += gamma;
 			}
 		}
-		gammaNorm = _logSumExp(gammaVals,maxGamma);
-		//now sum through xiMatrices for all transitions from state i to j
-		for(j = 0; j < _stateMatrix.NumCols(); j++){
-			maxXi = MIN_DOUBLE;
-			for(t = 0; t < observations.size(); t++){
-				xiVals[t] = _xiMatrices[t][i][j];
-				if(xiVals[t] > maxXi){
-					maxXi = xiVals[t];
-				}
-			}
-			//use the log-sum-exp trick to get the sum of these probs, then divide them
-			_stateMatrix[i][j] = _logSumExp(xiVals,maxXi) - gammaNorm;
+		if(t == 0){
+			break;
 		}
-	}
 
-	//update the emission probabilities
-	for(i = 0; i < _transitionMatrix.NumRows(); i++){ // iterate the states
-		for(j = 0; j < _transitionMatrix.NumCols(); j++){ // iterate the symbols
-			//reset the temp vals and vecs
-			gammaObsVals.clear();
-			maxObsGamma = MIN_DOUBLE;
-			maxGamma = MIN_DOUBLE;
-			//iterate the entire observation sequence
-			for(t = 0; t < observations.size(); t++){
-				//only add the gamma value of this time step if the observation matches the emission symbol
-				if(observations[t] == j){
-					gammaObsVals.push_back(_gammaLattice[t][i]);
-					if(_gammaLattice[t][i] > maxObsGamma){
-						maxObsGamma = _gammaLattice[t][i];
+		//step back to t-1: beta_t-1(i) = sum_j a_ij * b_j(o_t) * beta_t(j), and xi_t-1(i,j) from the same terms
+		const vector<double>& prevAlpha = _alphaLattice[t-1];
+		const vector<double>& emissions = _emissionsBySymbol[ observations[t] ];
+		for(j = 0; j < numStates; j++){
+			right[j] = emissions[j] + beta[j];
+		}
+		if(_pruneStep(observations[t-1], observations[t])){
+			//only the states emitting o_t-1 need beta_t-1, since alpha_t-1 is zero for the others
+			const vector<int>& sources = _statesBySymbol[ observations[t-1] ];
+			temp.resize(emitting.size());
+			for(i = 0; i < numStates; i++){
+				prevBeta[i] = -numeric_limits<double>::infinity();
+			}
+			for(s = 0; s < sources.size(); s++){
+				i = sources[s];
+				const vector<double>& row = _stateMatrix[i];
+				vector<double>& transitionCounts = counts.Transitions[i];
+				b = MIN_DOUBLE;
+				for(d = 0; d < emitting.size(); d++){
+					j = emitting[d];
+					temp[d] = row[j] + right[j];
+					if(temp[d] > b){
+						b = temp[d];
 					}
+					transitionCounts[j] += _logMath.Exp(prevAlpha[i] + temp[d] - pObs);
 				}
-				//running total (denominator)
-				gammaVals[t] = _gammaLattice[t][i];
-				if(gammaVals[t] > maxGamma){
-					maxGamma = gammaVals[t];
+				prevBeta[i] = _logSumExp(temp, b);
+			}
+			temp.resize(numStates);
+			beta.swap(prevBeta);
+			continue;
+		}
+		for(i = 0; i < numStates; i++){
+			const vector<double>& row = _stateMatrix[i];
+			vector<double>& transitionCounts = counts.Transitions[i];
+			b = MIN_DOUBLE;
+			for(j = 0; j < numStates; j++){
+				temp[j] = row[j] + right[j];
+				if(temp[j] > b){
+					b = temp[j];
 				}
+				//xi_t-1(i,j) = alpha_t-1(i) * a_ij * b_j(o_t) * beta_t(j) / P(observations)
+				transitionCounts[j] += _logMath.Exp(prevAlpha[i] + temp[j] - pObs);
 			}
+			prevBeta[i] = _logSumExp(temp, b);
+		}
+		beta.swap(prevBeta);
+	}
+	counts.LogLikelihood += pObs;
 
-			//divide the values calculated from above
-			if(gammaObsVals.size() > 0){
-				_transitionMatrix[i][j] = _logSumExp(gammaObsVals,maxObsGamma) - _logSumExp(gammaVals, maxGamma);
-			}
-			else{
-				_transitionMatrix[i][j] = MIN_DOUBLE; //no symbol matches, so set log probability to negative infinity
+	return pObs;
+}
+
+/*
+The maximization step of Baum-Welch: replaces the model parameters with the normalized expected counts.
+*/
+void DiscreteHmm::MaximizeExpectedCounts(const HmmCounts& counts)
+{
+	PROFILE_SCOPE("MaximizeExpectedCounts");
+	int i;
+
+	if(counts.NumStates() != _stateMatrix.NumRows() || counts.NumSymbols() != _transitionMatrix.NumCols()){
+		cout << "ERROR counts dimensions do not match the model in MaximizeExpectedCounts()" << endl;
+		return;
+	}
+
+	_lnNormalize(counts.Initial, _pi);
+	for(i = 0; i < counts.NumStates(); i++){
+		_lnNormalize(counts.Transitions[i], _stateMatrix[i]);
+		_lnNormalize(counts.Emissions[i], _transitionMatrix[i]);
+	}
+
+	_onModelUpdated();
+}
+
+/*
+SQUAREM-accelerated EM (Varadhan and Roland, 2008), over the parameter vector theta = (pi, A, B) in ln-space.
+@eStep: adds the expected counts of the whole dataset under the current model to its argument, as
+AccumulateExpectedCounts() does for a sequence; each call is one pass over the data.
+
+Each cycle starts from theta0 with its E-step already done, and takes two plain EM updates:
+theta1 = EM(theta0), theta2 = EM(theta1). With r = theta1 - theta0 and v = theta2 - 2*theta1 + theta0, it jumps to
+	theta' = theta0 - 2*alpha*r + alpha^2*v,	alpha = -|r| / |v|
+which is theta2 for alpha = -1, and extrapolates further along the EM path for larger steps. Each distribution in
+theta' is renormalized, and zero probabilities stay zero, so theta' is always a valid model.
+
+Safeguards: alpha is clamped to [-maxStep, -1], where maxStep starts at 1, grows fourfold each time a step at the
+bound is accepted, and shrinks fourfold on each rejection. theta' is accepted only if its likelihood is at least
+that of theta1 (plain EM guarantees theta2 is); otherwise the cycle falls back to theta2. The E-step of the accepted model starts the next cycle, so a
+cycle costs two passes, or three on fallback.
+
+Stops once a cycle improves the likelihood by less than @convergence, or after @maxPasses passes. As in BaumWelch(),
+the model is left one EM update past the last evaluated one, and the likelihood returned is that of the evaluated one.
+
+@eStep returns 1 if it failed (as AccumulateExpectedCounts() does), and then no update is made from its counts:
+training stops with the model restored to the last one evaluated, and 1 is returned.
+*/
+double DiscreteHmm::_acceleratedBaumWelch(const function<double(HmmCounts&)>& eStep, const int maxPasses, const double convergence)
+{
+	PROFILE_SCOPE("AcceleratedBaumWelch");
+	int passes, cycles, fallbacks;
+	double alpha, maxStep, delta, lastProb, prob1, prob;
+	bool accepted, failed;
+	vector<double> theta0, theta1, theta2, extrapolated;
+	HmmCounts counts;
+
+	//runs an E-step under the current model into fresh counts
+	auto evaluate = [&]() -> bool {
+		counts.Clear();
+		counts.Resize(_stateMatrix.NumRows(), _transitionMatrix.NumCols());
+		passes++;
+		return eStep(counts) <= 0;
+	};
+
+	passes = 0;
+	if(!evaluate()){
+		cout << "ERROR E-step failed in accelerated BaumWelch" << endl;
+		return 1;
+	}
+	cycles = fallbacks = 0;
+	failed = false;
+	lastProb = counts.LogLikelihood;
+	maxStep = 1;
+	_getParameters(theta0);
+	while(passes < maxPasses){
+		PROFILE_SCOPE("AcceleratedBaumWelch.Cycle");
+		//two plain EM updates
+		MaximizeExpectedCounts(counts);
+		_getParameters(theta1);
+		failed = !evaluate();
+		if(failed){
+			break;
+		}
+		prob1 = counts.LogLikelihood;
+		MaximizeExpectedCounts(counts);
+		_getParameters(theta2);
+
+		//extrapolate, and evaluate the result
+		alpha = _extrapolate(theta0, theta1, theta2, maxStep, extrapolated);
+		_setParameters(extrapolated);
+		failed = !evaluate();
+		if(failed){
+			break;
+		}
+		prob = counts.LogLikelihood;
+		//written so that a NaN likelihood is rejected
+		accepted = prob >= prob1;
+		if(!accepted){
+			_setParameters(theta2);
+			failed = !evaluate();
+			if(failed){
+				break;
 			}
+			prob = counts.LogLikelihood;
+			fallbacks++;
+			maxStep = max(1.0, maxStep / 4);
+		}
+		else if(alpha <= -maxStep){
+			maxStep *= 4;
+		}
+		cycles++;
+
+		delta = prob - lastProb;
+		lastProb = prob;
+		cout << passes << "\tforward p(obs): " << prob << "\tdelta: " << delta << "\tstep: " << -alpha << (accepted ? "" : " (rejected)") << endl;
+		if(delta < convergence){
+			break;
 		}
+		_getParameters(theta0);
 	}
+	if(failed){
+		cout << "ERROR E-step failed after " << passes << " passes of accelerated BaumWelch" << endl;
+		_setParameters(theta0);
+		return 1;
+	}
+	MaximizeExpectedCounts(counts);
+	cout << "Accelerated BaumWelch completed after " << passes << " passes (" << cycles << " cycles, " << fallbacks << " rejected extrapolations)" << endl;
+
+	return lastProb;
 }
 
 /*
-Updates the Xi and gamma models given an observation sequence.
+Flattens the model parameters into @params: pi, then the rows of A, then the rows of B, as ln-probabilities.
 */
-void DiscreteHmm::_retrainXiModel(const vector<int>& observations)
+void DiscreteHmm::_getParameters(vector<double>& params)
 {
-	int t, i, j;
-	double pObs, b;
-	vector<double> normVec, gammaVec;
+	int i;
 
-	//normalization vectors
-	normVec.resize(_stateMatrix.NumRows() * _stateMatrix.NumCols());
-	gammaVec.resize(_stateMatrix.NumRows());
+	params.assign(_pi.begin(), _pi.end());
+	for(i = 0; i < _stateMatrix.NumRows(); i++){
+		params.insert(params.end(), _stateMatrix[i].begin(), _stateMatrix[i].end());
+	}
+	for(i = 0; i < _transitionMatrix.NumRows(); i++){
+		params.insert(params.end(), _transitionMatrix[i].begin(), _transitionMatrix[i].end());
+	}
+}
 
-	for(t = 0; t < observations.size() - 1; t++){
-		Matrix<double>& xiMatrix = _xiMatrices[t];
-		//cout << "top1... " << t << "/" << _xiMatrices.size() << "/" << observations.size() << endl;
-		//set the Xi matrix values
+/*
+The inverse of _getParameters(). Each distribution (pi, and every row of A and B) is renormalized, since
+@params need not be normalized, eg after an extrapolation.
+*/
+void DiscreteHmm::_setParameters(const vector<double>& params)
+{
+	int i, j, offset;
+	double b;
+	vector<vector<double>*> rows;
+
+	rows.push_back(&_pi);
+	for(i = 0; i < _stateMatrix.NumRows(); i++){
+		rows.push_back(&_stateMatrix[i]);
+	}
+	for(i = 0; i < _transitionMatrix.NumRows(); i++){
+		rows.push_back(&_transitionMatrix[i]);
+	}
+
+	offset = 0;
+	for(i = 0; i < rows.size(); i++){
+		vector<double>& row = *rows[i];
 		b = MIN_DOUBLE;
-		for(i = 0; i < _stateMatrix.NumRows(); i++){
-			for(j = 0; j < _stateMatrix.NumCols(); j++){
-				xiMatrix[i][j] = _alphaLattice[t][i] + _stateMatrix[i][j] + _transitionMatrix[j][ observations[t+1] ] + _betaLattice[t+1][j];
-				//sum log-probs
-				normVec[i * _stateMatrix.NumRows() + j] = xiMatrix[i][j];
-				if(xiMatrix[i][j] > b){
-					b = xiMatrix[i][j];
-				}
+		for(j = 0; j < row.size(); j++){
+			row[j] = params[offset + j];
+			if(row[j] > b){
+				b = row[j];
 			}
 		}
-		//get the total probability of the observation per the log-sum-exp trick
-		pObs = _logSumExp(normVec, b);
-		//and normalize all the probs for this state after initializing them
-		for(i = 0; i < xiMatrix.NumRows(); i++){
-			for(j = 0; j < xiMatrix.NumCols(); j++){
-				xiMatrix[i][j] -= pObs; // log division
-			}
+		b = _logSumExp(row, b);
+		for(j = 0; j < row.size(); j++){
+			row[j] -= b;
 		}
+		offset += row.size();
+	}
 
-		//set the gamma values for each state (See Rabiner; for a given state i, its gamma value is the sum over all states j)
-		for(i = 0; i < xiMatrix.NumRows(); i++){
-			//cout << "summing.." << endl;
-			b = MIN_DOUBLE;
-			for(j = 0, _gammaLattice[t][i] = 0; j < xiMatrix.NumCols(); j++){
-				gammaVec[j] = xiMatrix[i][j]; //sum the log-probs in linear space by exp'ing them
-				if(gammaVec[j] > b){
-					b = gammaVec[j];
-				}
-			}
-			_gammaLattice[t][i] = _logSumExp(gammaVec, b); //convert back to log space
+	_onModelUpdated();
+}
+
+/*
+The SQUAREM step (see _acceleratedBaumWelch()): sets @output to theta0 - 2*alpha*r + alpha^2*v and returns alpha,
+clamped to [-maxStep, -1]. Components which are zero probabilities (-inf) in any of the three are left as in theta2.
+*/
+double DiscreteHmm::_extrapolate(const vector<double>& theta0, const vector<double>& theta1, const vector<double>& theta2, const double maxStep, vector<double>& output)
+{
+	int i;
+	double r, v, rr = 0, vv = 0, alpha;
+	vector<bool> finite(theta0.size());
+
+	for(i = 0; i < theta0.size(); i++){
+		finite[i] = !isinf(theta0[i]) && !isinf(theta1[i]) && !isinf(theta2[i]);
+		if(finite[i]){
+			r = theta1[i] - theta0[i];
+			v = theta2[i] - 2 * theta1[i] + theta0[i];
+			rr += r * r;
+			vv += v * v;
+		}
+	}
+	alpha = vv > 0 ? -sqrt(rr / vv) : -1;
+	alpha = min(-1.0, max(-maxStep, alpha));
+
+	output.resize(theta0.size());
+	for(i = 0; i < theta0.size(); i++){
+		if(finite[i]){
+			r = theta1[i] - theta0[i];
+			v = theta2[i] - 2 * theta1[i] + theta0[i];
+			output[i] = theta0[i] - 2 * alpha * r + alpha * alpha * v;
+		}
+		else{
+			output[i] = theta2[i];
 		}
 	}
+
+	return alpha;
 }
 
 /*
-Normal initialization training: read a bunch of data containing both labelled emissions
-and labelled hidden/latent states, and build the A and B matrices (as they're called in Rabiner's tutorial)
+Writes the model parameters (ln-probabilities) as text at full precision, for exchanging a model between
+processes. Unlike WriteModel(), this round-trips exactly, including zero probabilities (-inf). Labels are
+not included. The layout is:
+	<numStates> <numSymbols>
+	<pi>
+	<one line per row of A>
+	<one line per row of B>
+*/
+void DiscreteHmm::WriteParameters(ostream& out)
+{
+	int i, j;
+	streamsize precision = out.precision(17);
 
-TODO: State and Transition matrices could be very large and sparse for some datasets; this could be resolved
-by implementing a Matrix class capable of handling such sparseness.
+	out << _stateMatrix.NumRows() << " " << _transitionMatrix.NumCols() << "\n";
+	for(i = 0; i < _pi.size(); i++){
+		out << _pi[i] << (i < _pi.size()-1 ? " " : "\n");
+	}
+	for(i = 0; i < _stateMatrix.NumRows(); i++){
+		for(j = 0; j < _stateMatrix.NumCols(); j++){
+			out << _stateMatrix[i][j] << (j < _stateMatrix.NumCols()-1 ? " " : "\n");
+		}
+	}
+	for(i = 0; i < _transitionMatrix.NumRows(); i++){
+		for(j = 0; j < _transitionMatrix.NumCols(); j++){
+			out << _transitionMatrix[i][j] << (j < _transitionMatrix.NumCols()-1 ? " " : "\n");
+		}
+	}
+	out.precision(precision);
+}
 
-TODO: Smoothing for unobserved transitions. Rather than setting them to zero, use some smoothing method (there
-are many).
+/*
+Reads parameters written by WriteParameters(), resizing the model to fit. Any labels are kept.
+Returns false on malformed input.
 */
-void DiscreteHmm::DirectTrain(DiscreteHmmDataset& dataset)
+bool DiscreteHmm::ReadParameters(istream& in)
 {
-	//TODO: numerical storage could be wrapped in compiler/maXine specific ifdefs, but I don't want to for now
-	//For every maXine/compiler that's worth more than two cents, this should evaluate to true.
-	if(!numeric_limits<double>::has_infinity || !std::numeric_limits<double>::is_iec559){ //IEEE 754
-		cout << "ERROR double does not have infinity, recompile with some other signal value for zero probabilities in log space" << endl;
-		cout << "Consider updating your computer to electric power." << endl;
+	int i, j, numStates, numSymbols;
+	string token;
+
+	if(!(in >> numStates >> numSymbols) || numStates <= 0 || numSymbols <= 0){
+		cout << "ERROR malformed model parameters" << endl;
+		return false;
 	}
 
-	cout << "Training directly on " << dataset.LabeledDataSequence.size() << " labelled examples..." << endl;
+	_pi.resize(numStates);
+	_stateMatrix.Resize(numStates, numStates);
+	_transitionMatrix.Resize(numStates, numSymbols);
+	for(i = 0; i < numStates && (in >> token); i++){
+		_pi[i] = strtod(token.c_str(), NULL);
+	}
+	for(i = 0; i < numStates; i++){
+		for(j = 0; j < numStates && (in >> token); j++){
+			_stateMatrix[i][j] = strtod(token.c_str(), NULL);
+		}
+	}
+	for(i = 0; i < numStates; i++){
+		for(j = 0; j < numSymbols && (in >> token); j++){
+			_transitionMatrix[i][j] = strtod(token.c_str(), NULL);
+		}
+	}
+	if(!in){
+		cout << "ERROR truncated model parameters" << endl;
+		return false;
+	}
+	_onModelUpdated();
 
-	//init the A matrix
-	_stateMatrix.Resize(dataset.NumStates(), dataset.NumStates());
-	_stateMatrix.Reset();
-	//init the B matrix (|rows| == |states|, |cols| == |symbols|)
-	_transitionMatrix.Resize(dataset.NumStates(), dataset.NumSymbols());
-	_transitionMatrix.Reset();
+	return true;
+}
 
-	//count all the frequencies
-	for(int i = 1; i < dataset.LabeledDataSequence.size(); i++){
-		_stateMatrix[ dataset.LabeledDataSequence[i-1].first ][dataset.LabeledDataSequence[i].first]++;
-		_transitionMatrix[ dataset.LabeledDataSequence[i].first ][ dataset.LabeledDataSequence[i].second ]++;
-		//if(i % 100 == 99)
-		//	cout << i << endl;
+/*
+Copies the model parameters (ln-probabilities) into caller-owned, row-major arrays: @initial holds NumStates()
+values of pi, @transitions NumStates() x NumStates() values of A, and @emissions NumStates() x NumSymbols()
+values of B. The model stores its matrices as a vector per row, so this is for callers that need them flat, such
+as the Python buffers of pyhmm.cpp.
+*/
+void DiscreteHmm::CopyParameters(double* initial, double* transitions, double* emissions)
+{
+	int i, numStates, numSymbols;
+
+	numStates = _stateMatrix.NumRows();
+	numSymbols = _transitionMatrix.NumCols();
+	copy(_pi.begin(), _pi.begin() + numStates, initial);
+	for(i = 0; i < numStates; i++){
+		copy(_stateMatrix[i].begin(), _stateMatrix[i].begin() + numStates, transitions + i * numStates);
+		copy(_transitionMatrix[i].begin(), _transitionMatrix[i].begin() + numSymbols, emissions + i * numSymbols);
 	}
+}
 
-	//normalize all state frequencies (making them probabilities in ln space)
-	_stateMatrix.LnNormalizeRows();
-
-	//normalize all emission frequencies (making them probabilities in ln space)
-	_transitionMatrix.LnNormalizeRows();
+/*
+Copies the first @length columns of the alpha lattice left by ForwardAlgorithm() (CopyForwardLattice()) or the
+beta lattice left by BackwardAlgorithm() (CopyBackwardLattice()) into a caller-owned, row-major @length x
+NumStates() array, one time step per row. The lattice must have been retained, ie fit within the memory budget.
+*/
+void DiscreteHmm::CopyForwardLattice(double* output, const int length)
+{
+	int t;
 
-	cout << "HMM training completed." << endl;
-	this->PrintModel();
+	for(t = 0; t < length; t++){
+		copy(_alphaLattice[t].begin(), _alphaLattice[t].begin() + _stateMatrix.NumRows(), output + t * _stateMatrix.NumRows());
+	}
 }
 
+void DiscreteHmm::CopyBackwardLattice(double* output, const int length)
+{
+	int t;
+
+	for(t = 0; t < length; t++){
+		copy(_betaLattice[t].begin(), _betaLattice[t].begin() + _stateMatrix.NumRows(), output + t * _stateMatrix.NumRows());
+	}
+}
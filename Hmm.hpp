@@ -6,6 +6,13 @@
 #include "Matrix.cpp"
 #include "ColumnMatrix.cpp"
 #include "DiscreteHmmDataset.hpp"
+#include "ShardedCounter.hpp"
+#include "HmmCounts.hpp"
+#include "Profiler.hpp"
+#include "LogMath.hpp"
+#include "DatasetReader.hpp"
+#include "PrefixCache.hpp"
+#include "SequenceView.hpp"
 
 #include <string>
 #include <iostream>
@@ -14,10 +21,23 @@
 #include <limits>
 #include <cstdlib>
 #include <ctime>
+#include <algorithm>
+#include <functional>
+
+//the vectorized kernels are compiled for x86 targets, and selected at runtime if the CPU supports them
+#if defined(__x86_64__) || defined(__i386__)
+#define HMM_X86_SIMD
+#include <immintrin.h>
+#endif
 
 //some very large negative number, such that any log-probability (negative numbers) would be larger
 #define MIN_DOUBLE -numeric_limits<double>::max()
 
+template<typename T> class QuantizedHmm;
+
+//operations whose memory use can be estimated before running them; see DiscreteHmm::EstimateMemory()
+enum MemoryOperation { MEMORY_FORWARD, MEMORY_BACKWARD, MEMORY_VITERBI, MEMORY_BAUM_WELCH, MEMORY_DATASET_LOAD };
+
 using namespace std;
 
 /*
@@ -46,21 +66,107 @@ class DiscreteHmm{
 		DiscreteHmm(const string& modelPath);
 		~DiscreteHmm();
 		void DirectTrain(DiscreteHmmDataset& dataset);
+		void UpdateDirectTrain(DiscreteHmmDataset& dataset);
+		void WriteCounts(const string& path);
+		bool ReadCounts(const string& path);
+		bool MergeCounts(const string& path);
+		void StreamingDirectTrain(const string& dataPath, const int numThreads=4, const int chunkBytes=(1 << 22));
 		double BaumWelch(DiscreteHmmDataset& dataset, const int numHiddenStates);
+		double StreamingBaumWelch(const string& dataPath, const int numHiddenStates, const int batchSize=256);
+		double ViterbiTrain(DiscreteHmmDataset& dataset, const int numHiddenStates, const int refinementIterations=0);
+		void InitRandomModel(const vector<string>& symbols, const int numStates);
+		double AccumulateExpectedCounts(const vector<int>& observations, HmmCounts& counts);
+		double AccumulateExpectedCounts(const SequenceView& observations, HmmCounts& counts);
+		void MaximizeExpectedCounts(const HmmCounts& counts);
+		void WriteParameters(ostream& out);
+		bool ReadParameters(istream& in);
+		void CopyParameters(double* initial, double* transitions, double* emissions);
+		void CopyForwardLattice(double* output, const int length);
+		void CopyBackwardLattice(double* output, const int length);
 		double Viterbi(const vector<int>& observations, const int t, vector<int>& output);
+		double Viterbi(const PackedSequence& observations, const int t, vector<int>& output);
+		double Viterbi(const SequenceView& observations, const int t, vector<int>& output);
+		double KBestViterbi(const vector<int>& observations, const int k, vector<vector<int> >& paths, vector<double>& scores);
 		double ForwardAlgorithm(const vector<int>& observations, const int t);
+		double ForwardAlgorithm(const PackedSequence& observations, const int t);
+		double ForwardAlgorithm(const SequenceView& observations, const int t);
+		void ResetForward();
+		double ExtendForward(const vector<int>& appended);
+		double ExtendForward(const int observation);
+		int ForwardLength();
+		void BatchForward(const vector<vector<int> >& sequences, vector<double>& output, const int batchWidth=64);
+		void SlidingWindowForward(const vector<int>& observations, const int windowLength, vector<double>& output);
 		double BackwardAlgorithm(const vector<int>& observations, const int t);
+		double BackwardAlgorithm(const PackedSequence& observations, const int t);
+		double BackwardAlgorithm(const SequenceView& observations, const int t);
+		double PosteriorDecode(const vector<int>& observations, vector<int>& output);
 		bool ReadModel(const string& modelPath);
+		void SetMemoryBudget(unsigned long long bytes);
+		unsigned long long EstimateMemory(const MemoryOperation op, const int numStates, const int numSymbols, const unsigned long long length);
+		unsigned long long CurrentMemory();
+		unsigned long long PeakMemory();
+		void ResetPeakMemory();
+		void SetPrefixCache(unsigned long long budgetBytes, const int maxDepth=256);
+		string PrefixCacheStats();
+		void SetVerbose(bool verbose);
+		void SetSimd(bool enable);
+		void SetFusedEStep(bool fused);
+		void SetEmissionPruning(bool enable);
+		void SetAcceleratedEM(bool accelerate);
+		void SetTrainingLimits(const int maxIterations, const double convergence);
+		void SetRandomSeed(const unsigned int seed);
+		void SetLogMath(const LogMathMode mode, const double maxError=1E-6);
+		bool TestLogSumExp();
+		int NumStates();
+		int NumSymbols();
+		int GetSymbolId(const string& symbol);
+		const string& GetStateName(const int state);
+		const string& GetSymbolName(const int symbol);
 		void Clear();
 		void PrintModel(bool asLogProbs=false);
 		void WriteModel(const string& path, bool asLogProbs=true);
 	private:
+		//QuantizedHmm::Build() reads the parameters directly
+		template<typename T> friend class QuantizedHmm;
 		void _initUniformDistribution();
 		void _initRandomDistribution();
 		void _updateModels(const vector<int>& observations);
 		void _retrainXiModel(const vector<int>& observations);
 		void _resizeModel(int numStates, int numSymbols);
-		void _testLogSumExp();
+		void _onModelUpdated();
+		void _addDatasetCounts(DiscreteHmmDataset& dataset);
+		void _addCounts(const vector<string>& states, const vector<string>& symbols, const HmmCounts& counts);
+		void _lnNormalize(const vector<double>& counts, vector<double>& output);
+		double _viterbiTrain(const vector<int>& observations, const int maxIterations, const double convergence);
+		double _refineBaumWelch(const vector<int>& observations, const int iterations);
+		double _acceleratedBaumWelch(const function<double(HmmCounts&)>& eStep, const int maxPasses, const double convergence);
+		void _getParameters(vector<double>& params);
+		void _setParameters(const vector<double>& params);
+		double _extrapolate(const vector<double>& theta0, const vector<double>& theta1, const vector<double>& theta2, const double maxStep, vector<double>& output);
+		void _syncEmissionLayout();
+		void _buildEmissionSupport();
+		bool _pruneStep(const int previous, const int observation);
+		//the lattice algorithms are templated over the observation storage: vector<int>, PackedSequence or SequenceView
+		template<typename SequenceT> double _forwardAlgorithm(const SequenceT& observations, const int t);
+		template<typename SequenceT> double _backwardAlgorithm(const SequenceT& observations, const int t);
+		template<typename SequenceT> double _viterbi(const SequenceT& observations, const int t, vector<int>& output);
+		template<typename SequenceT> double _viterbiFull(const SequenceT& observations, const int t, vector<int>& output);
+		template<typename SequenceT> double _viterbiCheckpointed(const SequenceT& observations, const int t, vector<int>& output);
+		template<typename SequenceT> double _accumulateExpectedCounts(const SequenceT& observations, HmmCounts& counts);
+		bool _withinBudget(const unsigned long long bytes, const string& caller);
+		unsigned long long _baumWelchBytes(const unsigned long long numStates, const unsigned long long numSymbols, const unsigned long long length, const bool fused);
+		unsigned long long _latticeBytes(const unsigned long long rows, const unsigned long long cols, const unsigned long long elementBytes);
+		void _trackMemory(const unsigned long long workspaceBytes);
+		template<typename SequenceT> int _lookupPrefix(const SequenceT& observations, const int length, const bool viterbi, vector<int>& path);
+		template<typename SequenceT> void _storePrefix(const SequenceT& observations, const int length, const bool viterbi, vector<int>& path);
+		void _forwardColumn(const vector<double>& leftCol, vector<double>& rightCol, const int previous, const int observation, vector<double>& temp);
+		double _columnLogSum(const vector<double>& column);
+		void _batchTransition(const double* transitions, const double* alpha, double* next, const int numStates, const int width, const int active);
+		double _scaleLinear(vector<double>& values);
+		void _viterbiColumn(const vector<double>& leftCol, vector<double>& rightCol, vector<int>& ptrCol, const int previous, const int observation);
+#ifdef HMM_X86_SIMD
+		void _viterbiColumnAvx2(const vector<double>& leftCol, vector<double>& rightCol, vector<int>& ptrCol, const int observation);
+#endif
 
 		DiscreteHmmDataset _dataset;
 		ColumnMatrix<double> _alphaLattice;
@@ -71,9 +177,44 @@ class DiscreteHmm{
 		Matrix<double> _stateMatrix;
 		//transition matrix semantics: rows = states, cols = emissions
 		Matrix<double> _transitionMatrix;
+		//raw counts retained from supervised training, indexed like _pi, _stateMatrix and _transitionMatrix
+		HmmCounts _counts;
+		//the transpose of _transitionMatrix (rows = emissions, cols = states), kept in sync by _onModelUpdated()
+		Matrix<double> _emissionsBySymbol;
+		//for each symbol, the states with a non-zero probability of emitting it, in increasing order; see SetEmissionPruning()
+		vector<vector<int> > _statesBySymbol;
 
 		ColumnMatrix<double> _gammaLattice;
 		vector<Matrix<double> >	_xiMatrices;
+		//upper bound on lattice bytes an algorithm may allocate before switching to a lower-memory variant; 0 is unlimited
+		unsigned long long _memoryBudget;
+		//the most memory held by the lattices, caches and workspaces of the algorithms since ResetPeakMemory()
+		unsigned long long _peakMemory;
+		bool _verbose;
+		//use the vectorized inner loops; see SetSimd()
+		bool _useSimd;
+		//BaumWelch() E-step selection; see SetFusedEStep()
+		bool _fusedEStep;
+		//restrict the recurrences to the states that can emit the observations; see SetEmissionPruning()
+		bool _pruneEmissions;
+		//BaumWelch() and StreamingBaumWelch() extrapolate the EM updates; see SetAcceleratedEM()
+		bool _accelerateEM;
+		//stopping criteria of the training loops; see SetTrainingLimits()
+		int _maxIterations;
+		double _convergence;
+		//seed of the random initial models, or 0 for the clock; see SetRandomSeed()
+		unsigned int _randomSeed;
+		//exact or approximate log-space arithmetic; see SetLogMath()
+		LogMath _logMath;
+		//incremented whenever the model parameters, or the arithmetic of the lattices (see SetLogMath()), change
+		unsigned long _modelVersion;
+		//incremental forward state: the last alpha column, the number of observations consumed, the last observation, and the model version used
+		vector<double> _incrementalAlpha;
+		int _incrementalLength;
+		int _incrementalSymbol;
+		unsigned long _incrementalVersion;
+		//forward and Viterbi columns of recently seen observation prefixes; see SetPrefixCache()
+		PrefixCache _prefixCache;
 		void _split(const string& str, const char delim, vector<string>& tokens);
 		double _logSumExp(const vector<double>& vec, double b);
 		bool _validate();
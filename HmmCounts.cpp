@@ -0,0 +1,151 @@
+#include "HmmCounts.hpp"
+
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
+HmmCounts::HmmCounts()
+{
+	LogLikelihood = 0;
+}
+
+HmmCounts::~HmmCounts()
+{
+	Clear();
+}
+
+int HmmCounts::NumStates() const
+{
+	return Initial.size();
+}
+
+int HmmCounts::NumSymbols() const
+{
+	if(Emissions.size() == 0)
+		return 0;
+	return Emissions[0].size();
+}
+
+/*
+Resizes the tables. Unlike Matrix::Resize(), this preserves existing counts, and new entries are zero.
+*/
+void HmmCounts::Resize(const int numStates, const int numSymbols)
+{
+	Initial.resize(numStates, 0);
+	Transitions.resize(numStates);
+	Emissions.resize(numStates);
+	for(int i = 0; i < numStates; i++){
+		Transitions[i].resize(numStates, 0);
+		Emissions[i].resize(numSymbols, 0);
+	}
+}
+
+//Sets all counts to zero; does not resize.
+void HmmCounts::Reset()
+{
+	LogLikelihood = 0;
+	for(int i = 0; i < Initial.size(); i++){
+		Initial[i] = 0;
+		Transitions[i].assign(Transitions[i].size(), 0);
+		Emissions[i].assign(Emissions[i].size(), 0);
+	}
+}
+
+void HmmCounts::Clear()
+{
+	Initial.clear();
+	Transitions.clear();
+	Emissions.clear();
+	LogLikelihood = 0;
+}
+
+/*
+Adds another set of counts with the same dimensions and id space, eg from another shard of the data.
+*/
+void HmmCounts::Add(const HmmCounts& other)
+{
+	int i, j;
+
+	if(other.NumStates() != NumStates() || other.NumSymbols() != NumSymbols()){
+		cout << "ERROR HmmCounts::Add() dimension mismatch " << other.NumStates() << "x" << other.NumSymbols() << " != " << NumStates() << "x" << NumSymbols() << endl;
+		return;
+	}
+
+	for(i = 0; i < Initial.size(); i++){
+		Initial[i] += other.Initial[i];
+		for(j = 0; j < Transitions[i].size(); j++){
+			Transitions[i][j] += other.Transitions[i][j];
+		}
+		for(j = 0; j < Emissions[i].size(); j++){
+			Emissions[i][j] += other.Emissions[i][j];
+		}
+	}
+	LogLikelihood += other.LogLikelihood;
+}
+
+/*
+Writes the counts as text, at full precision:
+	<numStates> <numSymbols> <logLikelihood>
+	<initial counts>
+	<one line per transition row>
+	<one line per emission row>
+*/
+void HmmCounts::Write(ostream& out) const
+{
+	int i, j;
+	streamsize precision = out.precision(17);
+
+	out << NumStates() << " " << NumSymbols() << " " << LogLikelihood << "\n";
+	for(i = 0; i < Initial.size(); i++){
+		out << Initial[i] << (i < Initial.size()-1 ? " " : "\n");
+	}
+	for(i = 0; i < Transitions.size(); i++){
+		for(j = 0; j < Transitions[i].size(); j++){
+			out << Transitions[i][j] << (j < Transitions[i].size()-1 ? " " : "\n");
+		}
+	}
+	for(i = 0; i < Emissions.size(); i++){
+		for(j = 0; j < Emissions[i].size(); j++){
+			out << Emissions[i][j] << (j < Emissions[i].size()-1 ? " " : "\n");
+		}
+	}
+	out.precision(precision);
+}
+
+/*
+Reads counts written by Write(). Values are parsed with strtod, so infinities round trip.
+Returns false on malformed input.
+*/
+bool HmmCounts::Read(istream& in)
+{
+	int i, j, numStates, numSymbols;
+	string token;
+
+	if(!(in >> numStates >> numSymbols >> token) || numStates < 0 || numSymbols < 0){
+		cout << "ERROR malformed HmmCounts header" << endl;
+		return false;
+	}
+	Clear();
+	Resize(numStates, numSymbols);
+	LogLikelihood = strtod(token.c_str(), NULL);
+
+	for(i = 0; i < numStates && (in >> token); i++){
+		Initial[i] = strtod(token.c_str(), NULL);
+	}
+	for(i = 0; i < numStates; i++){
+		for(j = 0; j < numStates && (in >> token); j++){
+			Transitions[i][j] = strtod(token.c_str(), NULL);
+		}
+	}
+	for(i = 0; i < numStates; i++){
+		for(j = 0; j < numSymbols && (in >> token); j++){
+			Emissions[i][j] = strtod(token.c_str(), NULL);
+		}
+	}
+	if(!in){
+		cout << "ERROR truncated HmmCounts" << endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,35 @@
+#ifndef HMM_COUNTS_HPP
+#define HMM_COUNTS_HPP
+
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/*
+Counts of initial states, state transitions and emissions: the sufficient statistics of an HMM.
+For supervised training these are observed counts; for Baum-Welch they are expected counts, summed
+over the posterior distribution of the hidden states, and LogLikelihood holds ln P(observations)
+of the data they were collected from. Either way, normalizing the rows gives the model estimate.
+
+Tables are indexed like the model: Transitions is |states| x |states|, Emissions is |states| x |symbols|.
+*/
+class HmmCounts{
+	public:
+		HmmCounts();
+		~HmmCounts();
+		void Resize(const int numStates, const int numSymbols);
+		void Reset();
+		void Clear();
+		void Add(const HmmCounts& other);
+		int NumStates() const;
+		int NumSymbols() const;
+		void Write(ostream& out) const;
+		bool Read(istream& in);
+		vector<double> Initial;
+		vector<vector<double> > Transitions;
+		vector<vector<double> > Emissions;
+		double LogLikelihood;
+};
+
+#endif
@@ -0,0 +1,466 @@
+#include "HmmServer.hpp"
+#include "SocketUtil.hpp"
+
+#include <sstream>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+HmmServer::Connection::Connection(int socketFd)
+{
+	fd = socketFd;
+}
+
+HmmServer::Connection::~Connection()
+{
+	close(fd);
+}
+
+/*
+Writes an entire reply, serialized with any other worker replying on the same connection.
+Write failures (eg, the client hung up) are ignored; the reader thread will see the hangup.
+*/
+void HmmServer::Connection::Write(const string& reply)
+{
+	lock_guard<mutex> guard(writeLock);
+	WriteAll(fd, reply);
+}
+
+HmmServer::HmmServer()
+{
+	_maxBatch = 1;
+	_prefixCacheBytes = 0;
+	_stop = false;
+	_numRequests = 0;
+	_numErrors = 0;
+	_numBatches = 0;
+	_totalLatency = 0;
+	_maxLatency = 0;
+	_latencyBuckets.resize(40, 0);
+	_startTime = chrono::steady_clock::now();
+}
+
+HmmServer::~HmmServer()
+{
+	Stop();
+}
+
+/*
+Reads a model from a .hmm file and registers it under @name. Must be called before Run().
+*/
+bool HmmServer::LoadModel(const string& name, const string& modelPath)
+{
+	DiscreteHmm& hmm = _models[name];
+
+	hmm.SetVerbose(false);
+	if(!hmm.ReadModel(modelPath)){
+		cout << "ERROR could not load model " << name << " from " << modelPath << endl;
+		_models.erase(name);
+		return false;
+	}
+	cout << "Loaded model " << name << " (" << hmm.NumStates() << " states, " << hmm.NumSymbols() << " symbols) from " << modelPath << endl;
+
+	return true;
+}
+
+/*
+Enables the prefix lattice cache of every loaded model (see DiscreteHmm::SetPrefixCache()), for workloads whose
+queries share prefixes. Each worker's copy of a model gets its own cache of @budgetBytes. Must be called after
+the models are loaded, and before Run().
+*/
+void HmmServer::SetPrefixCache(unsigned long long budgetBytes, const int maxDepth)
+{
+	map<string,DiscreteHmm>::iterator it;
+
+	_prefixCacheBytes = budgetBytes;
+	for(it = _models.begin(); it != _models.end(); it++){
+		it->second.SetPrefixCache(budgetBytes, maxDepth);
+	}
+}
+
+/*
+Signals the server to stop. Run() returns once the acceptor, readers and workers have exited.
+*/
+void HmmServer::Stop()
+{
+	_stop = true;
+	_queueNotEmpty.notify_all();
+	_queueNotFull.notify_all();
+}
+
+/*
+Serves requests on @socketPath until Stop() is called. Blocks the calling thread.
+The path may also be a host:port TCP address; see SocketUtil.
+@numWorkers: number of scoring threads
+@maxBatch: maximum number of queued requests a worker takes per wakeup
+*/
+bool HmmServer::Run(const string& socketPath, const int numWorkers, const int maxBatch)
+{
+	int i, listenFd;
+	vector<thread> workers;
+
+	if(_models.size() == 0){
+		cout << "ERROR no models loaded in HmmServer::Run()" << endl;
+		return false;
+	}
+
+	listenFd = ListenSocket(socketPath);
+	if(listenFd < 0){
+		return false;
+	}
+
+	_stop = false;
+	_maxBatch = maxBatch > 0 ? maxBatch : 1;
+	_startTime = chrono::steady_clock::now();
+
+	//every worker gets its own copies of the models, already parsed
+	_workerModels.assign(numWorkers > 0 ? numWorkers : 1, _models);
+	for(i = 0; i < _workerModels.size(); i++){
+		workers.push_back(thread(&HmmServer::_workerLoop, this, i));
+	}
+
+	cout << "Serving " << _models.size() << " model(s) on " << socketPath << " with " << workers.size() << " workers, batch size " << _maxBatch << endl;
+	_acceptLoop(listenFd);
+
+	//shutdown: readers exit on _stop, then workers drain
+	close(listenFd);
+	if(!IsTcpAddress(socketPath)){
+		unlink(socketPath.c_str());
+	}
+	_reapReaders(true);
+	_queueNotEmpty.notify_all();
+	for(i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+
+	cout << "Server stopped. " << StatsString() << endl;
+	for(i = 0; i < _workerModels.size() && _prefixCacheBytes > 0; i++){
+		for(map<string,DiscreteHmm>::iterator it = _workerModels[i].begin(); it != _workerModels[i].end(); it++){
+			cout << "Worker " << i << " model " << it->first << " prefix cache: " << it->second.PrefixCacheStats() << endl;
+		}
+	}
+
+	return true;
+}
+
+void HmmServer::_acceptLoop(int listenFd)
+{
+	int fd;
+	struct pollfd pfd;
+	Reader reader;
+
+	pfd.fd = listenFd;
+	pfd.events = POLLIN;
+	while(!_stop){
+		_reapReaders(false);
+		//poll with a timeout, so Stop() is noticed without another connection arriving
+		if(poll(&pfd, 1, 200) <= 0){
+			continue;
+		}
+		fd = accept(listenFd, NULL, NULL);
+		if(fd < 0){
+			continue;
+		}
+		reader.done = make_shared<atomic<bool> >(false);
+		reader.worker = thread(&HmmServer::_readLoop, this, shared_ptr<Connection>(new Connection(fd)), reader.done);
+		lock_guard<mutex> guard(_readersLock);
+		_readers.push_back(move(reader));
+	}
+}
+
+/*
+Joins the reader threads whose connections have closed, or every reader if @all (on shutdown, once _stop is set).
+A long-running server sees many short-lived clients, whose threads would otherwise hold their stacks until exit.
+*/
+void HmmServer::_reapReaders(bool all)
+{
+	int i, kept;
+	lock_guard<mutex> guard(_readersLock);
+
+	for(i = 0, kept = 0; i < _readers.size(); i++){
+		if(all || *_readers[i].done){
+			_readers[i].worker.join();
+		}
+		else if(kept++ != i){
+			_readers[kept-1] = move(_readers[i]);
+		}
+	}
+	_readers.resize(kept);
+}
+
+/*
+Splits the byte stream of a connection into request lines and queues them.
+*/
+void HmmServer::_readLoop(shared_ptr<Connection> conn, shared_ptr<atomic<bool> > done)
+{
+	int n;
+	size_t newline;
+	char buf[65536];
+	string pending;
+	struct pollfd pfd;
+	Request request;
+
+	pfd.fd = conn->fd;
+	pfd.events = POLLIN;
+	request.conn = conn;
+	while(!_stop){
+		if(poll(&pfd, 1, 200) <= 0){
+			continue;
+		}
+		n = read(conn->fd, buf, sizeof(buf));
+		if(n < 0 && errno == EINTR){
+			continue;
+		}
+		if(n <= 0){
+			break;
+		}
+		pending.append(buf, n);
+
+		while((newline = pending.find('\n')) != string::npos){
+			request.line = pending.substr(0, newline);
+			request.arrival = chrono::steady_clock::now();
+			pending.erase(0, newline + 1);
+			if(request.line.size() == 0){
+				continue;
+			}
+			unique_lock<mutex> guard(_queueLock);
+			while(_queue.size() >= _maxQueueDepth && !_stop){
+				_queueNotFull.wait(guard);
+			}
+			_queue.push_back(request);
+			guard.unlock();
+			_queueNotEmpty.notify_one();
+		}
+	}
+	*done = true;
+}
+
+void HmmServer::_workerLoop(int workerId)
+{
+	int i, j;
+	double micros;
+	DiscreteHmm* hmm;
+	vector<Request> batch;
+	vector<string> replies, ops, tags;
+	vector<int> observations;
+	vector<double> scores;
+	//the FORWARD requests of a batch by model: their indices in the batch, and their observations
+	map<DiscreteHmm*,vector<int> > forwardIndices;
+	map<DiscreteHmm*,vector<vector<int> > > forwardSequences;
+	map<DiscreteHmm*,vector<int> >::iterator it;
+	map<string,DiscreteHmm>& models = _workerModels[workerId];
+
+	while(true){
+		batch.clear();
+		{
+			unique_lock<mutex> guard(_queueLock);
+			while(_queue.empty() && !_stop){
+				_queueNotEmpty.wait(guard);
+			}
+			if(_queue.empty() && _stop){
+				return;
+			}
+			while(!_queue.empty() && batch.size() < _maxBatch){
+				batch.push_back(_queue.front());
+				_queue.pop_front();
+			}
+		}
+		_queueNotFull.notify_all();
+
+		replies.assign(batch.size(), "");
+		ops.assign(batch.size(), "");
+		forwardIndices.clear();
+		forwardSequences.clear();
+		tags.assign(batch.size(), "");
+		for(i = 0; i < batch.size(); i++){
+			if(!_parse(models, batch[i].line, tags[i], ops[i], hmm, observations, replies[i])){
+				continue;
+			}
+			if(ops[i] == "FORWARD" && _prefixCacheBytes == 0){
+				forwardIndices[hmm].push_back(i);
+				forwardSequences[hmm].push_back(observations);
+			}
+			else{
+				replies[i] = _execute(*hmm, tags[i], ops[i], observations);
+			}
+		}
+		//one matrix-matrix recurrence per model for its FORWARD requests; a lone request takes the plain algorithm
+		for(it = forwardIndices.begin(); it != forwardIndices.end(); it++){
+			vector<vector<int> >& sequences = forwardSequences[it->first];
+			if(sequences.size() > 1){
+				it->first->BatchForward(sequences, scores);
+			}
+			else{
+				scores.assign(1, it->first->ForwardAlgorithm(sequences[0], sequences[0].size()-1));
+			}
+			for(j = 0; j < it->second.size(); j++){
+				i = it->second[j];
+				replies[i] = _formatReply(*it->first, tags[i], scores[j], vector<int>());
+			}
+		}
+
+		for(i = 0; i < batch.size(); i++){
+			batch[i].conn->Write(replies[i]);
+			micros = chrono::duration<double,micro>(chrono::steady_clock::now() - batch[i].arrival).count();
+			_recordLatency(ops[i], micros);
+		}
+
+		lock_guard<mutex> guard(_statsLock);
+		_numBatches++;
+	}
+}
+
+/*
+Parses a request line. Returns true with @model and @observations set if it is a scoring request; otherwise
+@reply holds the reply (to STATS, or an error), and @op is STATS or ERROR.
+*/
+bool HmmServer::_parse(map<string,DiscreteHmm>& models, const string& line, string& tag, string& op, DiscreteHmm*& model, vector<int>& observations, string& reply)
+{
+	int symbol;
+	string modelName, token;
+	istringstream in(line);
+	ostringstream out;
+	map<string,DiscreteHmm>::iterator it;
+
+	out.precision(17);
+	tag.clear();
+	op.clear();
+	observations.clear();
+	in >> tag >> op;
+	if(op == "STATS"){
+		out << tag << " OK " << StatsString() << "\n";
+		reply = out.str();
+		return false;
+	}
+	if(op != "FORWARD" && op != "VITERBI" && op != "POSTERIOR"){
+		op = "ERROR";
+		out << tag << " ERROR unknown operation\n";
+		reply = out.str();
+		return false;
+	}
+
+	in >> modelName;
+	it = models.find(modelName);
+	if(it == models.end()){
+		out << tag << " ERROR unknown model " << modelName << "\n";
+		op = "ERROR";
+		reply = out.str();
+		return false;
+	}
+	model = &it->second;
+
+	while(in >> token){
+		symbol = model->GetSymbolId(token);
+		if(symbol < 0){
+			out << tag << " ERROR unknown symbol " << token << "\n";
+			op = "ERROR";
+			reply = out.str();
+			return false;
+		}
+		observations.push_back(symbol);
+	}
+	if(observations.size() == 0){
+		out << tag << " ERROR empty observation sequence\n";
+		op = "ERROR";
+		reply = out.str();
+		return false;
+	}
+
+	return true;
+}
+
+/*
+Executes a parsed scoring request (see _parse()), returning the reply line.
+*/
+string HmmServer::_execute(DiscreteHmm& hmm, const string& tag, const string& op, const vector<int>& observations)
+{
+	double score;
+	vector<int> path;
+
+	if(op == "FORWARD"){
+		score = hmm.ForwardAlgorithm(observations, observations.size()-1);
+	}
+	else if(op == "VITERBI"){
+		score = hmm.Viterbi(observations, observations.size(), path);
+	}
+	else{
+		score = hmm.PosteriorDecode(observations, path);
+	}
+
+	return _formatReply(hmm, tag, score, path);
+}
+
+/*
+Formats the reply to a scoring request: the score, then the state names of @path, if any.
+*/
+string HmmServer::_formatReply(DiscreteHmm& hmm, const string& tag, const double score, const vector<int>& path)
+{
+	int i;
+	ostringstream out;
+
+	out.precision(17);
+	out << tag << " OK " << score;
+	for(i = 0; i < path.size(); i++){
+		out << " " << hmm.GetStateName(path[i]);
+	}
+	out << "\n";
+
+	return out.str();
+}
+
+void HmmServer::_recordLatency(const string& op, double micros)
+{
+	int bucket;
+	lock_guard<mutex> guard(_statsLock);
+
+	_numRequests++;
+	if(op == "ERROR"){
+		_numErrors++;
+	}
+	_requestCounts[op]++;
+	_totalLatency += micros;
+	if(micros > _maxLatency){
+		_maxLatency = micros;
+	}
+	for(bucket = 0; bucket < _latencyBuckets.size() - 1 && (double)(1ULL << bucket) < micros; bucket++);
+	_latencyBuckets[bucket]++;
+}
+
+/*
+Returns the server counters as space separated key=value pairs. Latencies are in microseconds,
+measured from the request being parsed to its reply being written; percentiles are the upper bound
+of the power-of-two bucket containing them.
+*/
+string HmmServer::StatsString()
+{
+	int i;
+	double seconds, percentiles[] = {0.5, 0.9, 0.99};
+	unsigned long long cumulative;
+	ostringstream out;
+	map<string,unsigned long long>::iterator it;
+	lock_guard<mutex> guard(_statsLock);
+
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - _startTime).count();
+	out << "uptime_s=" << seconds << " requests=" << _numRequests << " errors=" << _numErrors;
+	for(it = _requestCounts.begin(); it != _requestCounts.end(); it++){
+		out << " " << it->first << "=" << it->second;
+	}
+	out << " batches=" << _numBatches;
+	out << " mean_batch=" << (_numBatches > 0 ? (double)_numRequests / (double)_numBatches : 0.0);
+	out << " throughput_rps=" << (seconds > 0 ? (double)_numRequests / seconds : 0.0);
+	out << " mean_latency_us=" << (_numRequests > 0 ? _totalLatency / (double)_numRequests : 0.0);
+	for(int p = 0; p < 3; p++){
+		cumulative = 0;
+		for(i = 0; i < _latencyBuckets.size(); i++){
+			cumulative += _latencyBuckets[i];
+			if(cumulative >= percentiles[p] * _numRequests){
+				break;
+			}
+		}
+		out << " p" << (int)(percentiles[p] * 100) << "_latency_us=" << (_numRequests > 0 ? (1ULL << i) : 0);
+	}
+	out << " max_latency_us=" << _maxLatency;
+
+	return out.str();
+}
@@ -0,0 +1,106 @@
+#ifndef HMM_SERVER_HPP
+#define HMM_SERVER_HPP
+
+#include "Hmm.hpp"
+
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <chrono>
+
+using namespace std;
+
+/*
+A long-running local scoring server. Models are read once at startup and then served over a
+Unix domain socket, so scoring jobs no longer pay the model parse/setup cost per process.
+
+Protocol: newline-terminated text requests over a stream socket. Every request begins with a client
+chosen tag, which is echoed in the reply, so a client may pipeline many requests on one connection
+and match the (possibly reordered) replies:
+
+	<tag> FORWARD <model> <symbol> <symbol> ...    ->  <tag> OK <ln P(observations)>
+	<tag> VITERBI <model> <symbol> <symbol> ...    ->  <tag> OK <ln P(best path)> <state> <state> ...
+	<tag> POSTERIOR <model> <symbol> <symbol> ...  ->  <tag> OK <ln P(observations)> <state> <state> ...
+	<tag> STATS                                    ->  <tag> OK <counter>=<value> ...
+
+Symbols and states are referred to by the names in the .hmm file. Failures reply <tag> ERROR <message>.
+
+Each connection has a reader thread which parses requests into a shared queue; the thread is joined by the
+acceptor once the client hangs up. Worker threads take up to maxBatch queued requests at a time, so bursts of
+small requests cost one queue lock and wakeup per batch rather than per request. The FORWARD requests of a
+batch are scored together per model by DiscreteHmm::BatchForward(), whose scores agree with ForwardAlgorithm()
+to rounding; with a prefix cache they are scored one at a time instead, through the cache. Each worker owns
+private copies of the models, since DiscreteHmm keeps its lattices as members and is not safe to share between
+threads. For the same reason each worker has its own prefix cache (see SetPrefixCache()); their counters are
+printed on shutdown.
+*/
+class HmmServer{
+	public:
+		HmmServer();
+		~HmmServer();
+		bool LoadModel(const string& name, const string& modelPath);
+		void SetPrefixCache(unsigned long long budgetBytes, const int maxDepth=256);
+		bool Run(const string& socketPath, const int numWorkers, const int maxBatch);
+		void Stop();
+		string StatsString();
+	private:
+		struct Connection{
+			int fd;
+			mutex writeLock;
+			Connection(int socketFd);
+			~Connection();
+			void Write(const string& reply);
+		};
+		struct Request{
+			shared_ptr<Connection> conn;
+			string line;
+			chrono::steady_clock::time_point arrival;
+		};
+		struct Reader{
+			thread worker;
+			//set by the reader thread as it exits, so the acceptor can join it
+			shared_ptr<atomic<bool> > done;
+		};
+		void _acceptLoop(int listenFd);
+		void _reapReaders(bool all);
+		void _readLoop(shared_ptr<Connection> conn, shared_ptr<atomic<bool> > done);
+		void _workerLoop(int workerId);
+		bool _parse(map<string,DiscreteHmm>& models, const string& line, string& tag, string& op, DiscreteHmm*& model, vector<int>& observations, string& reply);
+		string _execute(DiscreteHmm& hmm, const string& tag, const string& op, const vector<int>& observations);
+		string _formatReply(DiscreteHmm& hmm, const string& tag, const double score, const vector<int>& path);
+		void _recordLatency(const string& op, double micros);
+
+		map<string,DiscreteHmm> _models;
+		vector<map<string,DiscreteHmm> > _workerModels;
+		int _maxBatch;
+		unsigned long long _prefixCacheBytes;
+		atomic<bool> _stop;
+
+		//request queue, bounded to apply backpressure to the readers
+		deque<Request> _queue;
+		mutex _queueLock;
+		condition_variable _queueNotEmpty;
+		condition_variable _queueNotFull;
+		static const int _maxQueueDepth = 4096;
+
+		//connection reader threads, joined once they exit, or on shutdown
+		vector<Reader> _readers;
+		mutex _readersLock;
+
+		//counters; latencies are bucketed by powers of two of microseconds for percentile estimates
+		mutex _statsLock;
+		chrono::steady_clock::time_point _startTime;
+		map<string,unsigned long long> _requestCounts;
+		unsigned long long _numRequests;
+		unsigned long long _numErrors;
+		unsigned long long _numBatches;
+		double _totalLatency;
+		double _maxLatency;
+		vector<unsigned long long> _latencyBuckets;
+};
+
+#endif
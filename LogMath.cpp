@@ -0,0 +1,117 @@
+#include "LogMath.hpp"
+
+#include <iostream>
+
+LogMath::LogMath()
+{
+	_mode = LOGMATH_EXACT;
+	_maxError = 0;
+	_exp2Scale = _logScale = _logAddScale = _logAddMax = 0;
+}
+
+LogMath::~LogMath()
+{}
+
+LogMathMode LogMath::Mode() const
+{
+	return _mode;
+}
+
+/*
+Returns the error bound of the current mode; 0 in exact mode.
+*/
+double LogMath::MaxError() const
+{
+	return _maxError;
+}
+
+double LogMath::MinError()
+{
+	return 1E-10;
+}
+
+/*
+Selects exact or fast mode. For fast mode, builds the tables for an absolute log-space error of at most @maxError.
+
+Linear interpolation of f over a spacing h errs by at most h^2/8 * max|f''|:
+	-2^f: relative error h^2/8 * ln(2)^2
+	-ln(m), m >= 1: h^2/8
+	-log1p(exp(-d)): h^2/8 * 1/4
+Each spacing is chosen for half of @maxError, leaving the other half for rounding and, in LogSumExp(), to the
+final Log().
+*/
+void LogMath::SetMode(const LogMathMode mode, const double maxError)
+{
+	int i, size;
+	double h, target;
+
+	_exp2Table.clear();
+	_logTable.clear();
+	_logAddTable.clear();
+	if(mode == LOGMATH_EXACT || maxError < MinError()){
+		if(mode == LOGMATH_FAST){
+			cout << "WARNING error bound " << maxError << " is below " << MinError() << "; using exact log math" << endl;
+		}
+		_mode = LOGMATH_EXACT;
+		_maxError = 0;
+		return;
+	}
+	_mode = LOGMATH_FAST;
+	_maxError = maxError;
+	target = maxError / 2;
+
+	h = sqrt(8 * target) / log(2.0);
+	size = (int)ceil(1.0 / h);
+	_exp2Scale = size;
+	_exp2Table.resize(size + 2);
+	for(i = 0; i < _exp2Table.size(); i++){
+		_exp2Table[i] = pow(2.0, (double)i / (double)size);
+	}
+
+	h = sqrt(8 * target);
+	size = (int)ceil(1.0 / h);
+	_logScale = size;
+	_logTable.resize(size + 2);
+	for(i = 0; i < _logTable.size(); i++){
+		_logTable[i] = log(1.0 + (double)i / (double)size);
+	}
+
+	//beyond dMax, log1p(exp(-d)) < exp(-d) < target
+	h = sqrt(32 * target);
+	_logAddMax = -log(target);
+	size = (int)ceil(_logAddMax / h);
+	_logAddScale = size / _logAddMax;
+	_logAddTable.resize(size + 2);
+	for(i = 0; i < _logAddTable.size(); i++){
+		_logAddTable[i] = log1p(exp(-(double)i / _logAddScale));
+	}
+}
+
+/*
+log(sum(exp(vec))), given @b = max(vec), skipping -inf (zero probability) entries. A vector of all -inf sums to -inf.
+*/
+double LogMath::LogSumExp(const vector<double>& vec, const double b) const
+{
+	int i;
+	double sum = 0;
+
+	if(b == -numeric_limits<double>::infinity()){
+		return b;
+	}
+	if(_mode == LOGMATH_EXACT){
+		for(i = 0; i < vec.size(); i++){
+			if(vec[i] != -numeric_limits<double>::infinity()){
+				sum += exp(vec[i] - b);
+			}
+		}
+		return b + log(sum);
+	}
+
+	for(i = 0; i < vec.size(); i++){
+		if(vec[i] != -numeric_limits<double>::infinity()){
+			sum += _fastExp(vec[i] - b);
+		}
+	}
+
+	return b + _fastLog(sum);
+}
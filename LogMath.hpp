@@ -0,0 +1,151 @@
+#ifndef LOG_MATH_HPP
+#define LOG_MATH_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+/*
+The log-space arithmetic of the lattice algorithms: exp, log, the pairwise log-add log(exp(a) + exp(b)), and
+log-sum-exp over a vector. In exact mode these are the libm functions. In fast mode they are table-driven
+approximations, accurate to a configurable bound:
+
+	-Exp(x): x is split into 2^n * 2^f, with 2^f from a table over f in [0,1), linearly interpolated
+	-Log(x): x is split into 2^e * m, with log(m) from a table over m in [1,2), linearly interpolated
+	-LogAdd(a,b): max(a,b) + log1p(exp(-|a-b|)), with log1p(exp(-d)) from a table over d in [0,dMax);
+	 beyond dMax the correction is below the error bound and is dropped
+	-LogSumExp(): b + Log(sum of Exp(x - b))
+
+The table spacings are derived from @maxError, the bound on the absolute error of the result in log space
+(equivalently, the relative error of Exp()). LogSumExp() combines two approximations and is bounded by twice it.
+Bounds below MinError() would need very large tables, so they select exact mode.
+*/
+enum LogMathMode { LOGMATH_EXACT, LOGMATH_FAST };
+
+class LogMath{
+	public:
+		LogMath();
+		~LogMath();
+		void SetMode(const LogMathMode mode, const double maxError=1E-6);
+		LogMathMode Mode() const;
+		double MaxError() const;
+		static double MinError();
+		inline double Exp(const double x) const;
+		inline double Log(const double x) const;
+		inline double LogAdd(const double a, const double b) const;
+		double LogSumExp(const vector<double>& vec, const double b) const;
+	private:
+		inline double _fastExp(const double x) const;
+		inline double _fastLog(const double x) const;
+		inline double _fastLogAdd(const double a, const double b) const;
+
+		LogMathMode _mode;
+		double _maxError;
+		//2^f for f in [0,1]
+		vector<double> _exp2Table;
+		double _exp2Scale;
+		//ln(m) for m in [1,2]
+		vector<double> _logTable;
+		double _logScale;
+		//log1p(exp(-d)) for d in [0,dMax]
+		vector<double> _logAddTable;
+		double _logAddScale;
+		double _logAddMax;
+};
+
+double LogMath::Exp(const double x) const
+{
+	return _mode == LOGMATH_EXACT ? exp(x) : _fastExp(x);
+}
+
+double LogMath::Log(const double x) const
+{
+	return _mode == LOGMATH_EXACT ? log(x) : _fastLog(x);
+}
+
+double LogMath::LogAdd(const double a, const double b) const
+{
+	if(_mode == LOGMATH_FAST){
+		return _fastLogAdd(a, b);
+	}
+	if(a == -numeric_limits<double>::infinity()){
+		return b;
+	}
+	if(b == -numeric_limits<double>::infinity()){
+		return a;
+	}
+	return a > b ? a + log1p(exp(b - a)) : b + log1p(exp(a - b));
+}
+
+double LogMath::_fastExp(const double x) const
+{
+	int i, n;
+	double f, frac, scale;
+	uint64_t bits;
+
+	//outside the normal range of doubles; also handles -inf and nan
+	if(!(x > -708.0 && x < 709.0)){
+		return exp(x);
+	}
+
+	//exp(x) = 2^(x*log2(e)) = 2^n * 2^f, f in [0,1); the bias makes the truncation a floor
+	f = x * 1.4426950408889634;
+	n = (int)(f + 1024.0) - 1024;
+	f = (f - n) * _exp2Scale;
+	i = (int)f;
+	frac = f - i;
+	//2^n, built directly in the exponent bits
+	bits = (uint64_t)(n + 1023) << 52;
+	memcpy(&scale, &bits, sizeof(scale));
+
+	return scale * (_exp2Table[i] + frac * (_exp2Table[i+1] - _exp2Table[i]));
+}
+
+double LogMath::_fastLog(const double x) const
+{
+	int i, exponent;
+	double m, frac;
+	uint64_t bits;
+
+	memcpy(&bits, &x, sizeof(bits));
+	exponent = (int)((bits >> 52) & 0x7ff);
+	//zero, negative, subnormal, inf and nan
+	if(!(x > 0) || exponent == 0 || exponent == 0x7ff){
+		return log(x);
+	}
+
+	//x = 2^e * m, m in [1,2)
+	bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+	memcpy(&m, &bits, sizeof(m));
+	m = (m - 1.0) * _logScale;
+	i = (int)m;
+	frac = m - i;
+
+	return (exponent - 1023) * 0.69314718055994531 + _logTable[i] + frac * (_logTable[i+1] - _logTable[i]);
+}
+
+double LogMath::_fastLogAdd(const double a, const double b) const
+{
+	int i;
+	double hi, d, frac;
+
+	hi = a > b ? a : b;
+	if(hi == -numeric_limits<double>::infinity()){
+		return hi;
+	}
+	d = (a > b ? a - b : b - a);
+	if(!(d < _logAddMax)){
+		return hi;
+	}
+	d *= _logAddScale;
+	i = (int)d;
+	frac = d - i;
+
+	return hi + _logAddTable[i] + frac * (_logAddTable[i+1] - _logAddTable[i]);
+}
+
+#endif
@@ -23,6 +23,22 @@ const vector<T>& Matrix<T>::operator[](const int i) const
 	return _matrix[i];
 }
 
+/*
+Returns the bytes allocated by the matrix' storage. Since Resize() never shrinks it, this can exceed the
+size of the current representation.
+*/
+template<typename T>
+unsigned long long Matrix<T>::Bytes()
+{
+	unsigned long long bytes = _matrix.capacity() * sizeof(vector<T>);
+
+	for(int i = 0; i < _matrix.size(); i++){
+		bytes += _matrix[i].capacity() * sizeof(T);
+	}
+
+	return bytes;
+}
+
 template<typename T>
 void Matrix<T>::GetSize(int& rows, int& cols)
 {
@@ -53,7 +69,7 @@ template<typename T>
 void Matrix<T>::Clear()
 {
 	if(_matrix.size() > 0){
-		for(int i = 0; i < _matrix[0].size(); i++){
+		for(int i = 0; i < _matrix.size(); i++){
 			_matrix[i].clear();
 		}
 		_matrix.clear();
@@ -141,8 +157,9 @@ void Matrix<T>::Resize(const int rows, const int cols)
 		_matrix.resize(rows);
 		_matrix.shrink_to_fit();
 	}
-	if(_matrix[0].size() < cols){
-		for(int i = 0; i < _matrix.size(); i++){
+	//rows added above are empty, so each row is checked
+	for(int i = 0; i < _matrix.size(); i++){
+		if(_matrix[i].size() < cols){
 			_matrix[i].resize(cols);
 			_matrix[i].shrink_to_fit();
 		}
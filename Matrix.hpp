@@ -25,6 +25,7 @@ class Matrix{
 		void GetSize(int& rows, int& cols);
 		int NumRows();
 		int NumCols();
+		unsigned long long Bytes();
 		void Print(bool convertLogProbs=false);
 		void LnNormalizeRows();
 		//[] gets a row from the matrix (a std::vector)
@@ -57,6 +58,7 @@ class ColumnMatrix{
 		void Reset();
 		int NumRows();
 		int NumCols();
+		unsigned long long Bytes();
 		void Print();
 		void GetSize(int& rows, int& cols);
 		inline vector<T>& GetColumn(const int i);
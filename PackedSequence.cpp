@@ -0,0 +1,187 @@
+#include "PackedSequence.hpp"
+
+PackedSequence::PackedSequence()
+{
+	_size = 0;
+	_setWidth(2);
+}
+
+PackedSequence::PackedSequence(const int bitWidth)
+{
+	_size = 0;
+	_setWidth(bitWidth);
+}
+
+PackedSequence::~PackedSequence()
+{
+	Clear();
+}
+
+/*
+Clears the sequence and resets it to the narrowest width.
+*/
+void PackedSequence::Clear()
+{
+	_words.clear();
+	_words.shrink_to_fit();
+	_size = 0;
+	_setWidth(2);
+}
+
+/*
+Returns the narrowest supported bit width able to represent the ids 0 to numValues-1.
+*/
+int PackedSequence::WidthFor(const int numValues)
+{
+	if(numValues <= 4)
+		return 2;
+	if(numValues <= 16)
+		return 4;
+	if(numValues <= 256)
+		return 8;
+	if(numValues <= 65536)
+		return 16;
+	return 32;
+}
+
+void PackedSequence::_setWidth(const int bitWidth)
+{
+	int perWord;
+
+	if(bitWidth != 2 && bitWidth != 4 && bitWidth != 8 && bitWidth != 16 && bitWidth != 32){
+		cout << "ERROR unsupported bit width in PackedSequence: " << bitWidth << ", using 32" << endl;
+		_setWidth(32);
+		return;
+	}
+
+	_width = bitWidth;
+	perWord = 64 / _width;
+	_indexMask = perWord - 1;
+	for(_wordShift = 0; (1 << _wordShift) < perWord; _wordShift++);
+	_valueMask = ((uint64_t)1 << _width) - 1;
+}
+
+int PackedSequence::BitWidth() const
+{
+	return _width;
+}
+
+unsigned long long PackedSequence::NumBytes() const
+{
+	return (unsigned long long)_words.size() * sizeof(uint64_t);
+}
+
+void PackedSequence::Reserve(const int n)
+{
+	_words.reserve((n + _indexMask) >> _wordShift);
+}
+
+/*
+Repacks the sequence at a new width. Narrowing a sequence containing values that do not fit
+in the new width is an error, and the width is left unchanged.
+*/
+void PackedSequence::SetBitWidth(const int bitWidth)
+{
+	vector<int> values;
+
+	if(bitWidth == _width){
+		return;
+	}
+	if(bitWidth < _width && _size > 0){
+		uint64_t newMask = ((uint64_t)1 << bitWidth) - 1;
+		for(int i = 0; i < _size; i++){
+			if((uint64_t)(*this)[i] > newMask){
+				cout << "ERROR cannot narrow PackedSequence to " << bitWidth << " bits, value " << (*this)[i] << " at index " << i << endl;
+				return;
+			}
+		}
+	}
+
+	Unpack(values);
+	Pack(values, bitWidth);
+}
+
+/*
+Appends a value, widening the whole sequence first if the value does not fit in the current width.
+*/
+void PackedSequence::Append(const int value)
+{
+	int word, offset;
+
+	if(value < 0){
+		cout << "ERROR negative value appended to PackedSequence: " << value << endl;
+		return;
+	}
+	if((uint64_t)value > _valueMask){
+		SetBitWidth(WidthFor(value + 1));
+	}
+
+	word = _size >> _wordShift;
+	offset = (_size & _indexMask) * _width;
+	if(word >= _words.size()){
+		_words.push_back(0);
+	}
+	_words[word] |= ((uint64_t)value << offset);
+	_size++;
+}
+
+/*
+Replaces the contents of this sequence with @values, packed at @bitWidth.
+*/
+void PackedSequence::Pack(const vector<int>& values, const int bitWidth)
+{
+	_words.clear();
+	_size = 0;
+	_setWidth(bitWidth);
+	_words.resize((values.size() + _indexMask) >> _wordShift, 0);
+	_words.shrink_to_fit();
+
+	for(int i = 0; i < values.size(); i++){
+		if(values[i] < 0 || (uint64_t)values[i] > _valueMask){
+			cout << "ERROR value " << values[i] << " does not fit in " << _width << " bits in PackedSequence::Pack()" << endl;
+		}
+		_words[i >> _wordShift] |= (((uint64_t)values[i] & _valueMask) << ((i & _indexMask) * _width));
+	}
+	_size = values.size();
+}
+
+void PackedSequence::Unpack(vector<int>& output) const
+{
+	output.resize(_size);
+	if(_size > 0){
+		Decode(0, _size, output.data());
+	}
+}
+
+/*
+Block-decodes @count values beginning at index @start into @output, a word at a time.
+This is the fast path for loops that consume long runs of the sequence, such as building
+an observation buffer for a block of lattice columns.
+*/
+void PackedSequence::Decode(const int start, const int count, int* output) const
+{
+	int i, end, perWord;
+	uint64_t word;
+
+	perWord = _indexMask + 1;
+	end = start + count;
+	i = start;
+
+	//leading partial word
+	while(i < end && (i & _indexMask) != 0){
+		*output++ = (*this)[i++];
+	}
+	//whole words
+	while(i + perWord <= end){
+		word = _words[i >> _wordShift];
+		for(int j = 0; j < perWord; j++){
+			*output++ = (int)(word & _valueMask);
+			word >>= _width;
+		}
+		i += perWord;
+	}
+	//trailing partial word
+	while(i < end){
+		*output++ = (*this)[i++];
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef PACKED_SEQUENCE_HPP
+#define PACKED_SEQUENCE_HPP
+
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+using namespace std;
+
+/*
+A compact, bit-packed sequence of small non-negative integers (symbol or state ids).
+
+Values are stored in 64-bit words at a fixed width of 2, 4, 8 or 16 bits, so that no value ever straddles
+a word boundary. For a 4-letter nucleotide alphabet this is 2 bits per position, versus 32 bits for a
+vector<int>. If a value is appended that does not fit in the current width, the sequence is repacked
+at the next wider width, so sequences can be built incrementally as a flyweight assigns new ids. Values
+that do not fit in 16 bits fall back to 32 bit storage.
+
+The class deliberately mimics the read interface of vector<int> (operator[] and size()), so the
+HMM algorithms can be instantiated over either storage type.
+*/
+class PackedSequence{
+	public:
+		PackedSequence();
+		PackedSequence(const int bitWidth);
+		~PackedSequence();
+		void Clear();
+		void Reserve(const int n);
+		void Append(const int value);
+		void Pack(const vector<int>& values, const int bitWidth);
+		void Unpack(vector<int>& output) const;
+		void Decode(const int start, const int count, int* output) const;
+		void SetBitWidth(const int bitWidth);
+		int BitWidth() const;
+		unsigned long long NumBytes() const;
+		static int WidthFor(const int numValues);
+		//defined here so the per-element shift/mask inlines into the algorithm loops
+		inline int operator[](const int i) const
+		{
+			return (int)((_words[i >> _wordShift] >> ((i & _indexMask) * _width)) & _valueMask);
+		}
+		inline int size() const
+		{
+			return _size;
+		}
+	private:
+		void _setWidth(const int bitWidth);
+		vector<uint64_t> _words;
+		int _size;
+		int _width;
+		//log2 of the number of values per word, for word indexing by shift
+		int _wordShift;
+		//(values per word - 1), for the index within a word
+		int _indexMask;
+		uint64_t _valueMask;
+};
+
+#endif
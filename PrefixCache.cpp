@@ -0,0 +1,249 @@
+#include "PrefixCache.hpp"
+
+#include <sstream>
+
+PrefixCache::PrefixCache()
+{
+	_budget = 0;
+	_maxDepth = 0;
+	_modelVersion = 0;
+	_numQueries = _numHits = _cachedColumns = _computedColumns = _numEvictions = _numInvalidations = 0;
+	Clear();
+}
+
+PrefixCache::~PrefixCache()
+{}
+
+/*
+@budgetBytes: upper bound on the memory held by cached nodes; 0 disables the cache
+@maxDepth: the longest prefix cached. Queries longer than this still reuse its columns, but their tails are not
+cached, so that long unique sequences do not flush the shared prefixes out.
+*/
+void PrefixCache::Configure(const unsigned long long budgetBytes, const int maxDepth)
+{
+	_budget = budgetBytes;
+	_maxDepth = maxDepth > 0 ? maxDepth : 0;
+	Clear();
+}
+
+bool PrefixCache::Enabled()
+{
+	return _budget > 0 && _maxDepth > 0;
+}
+
+int PrefixCache::MaxDepth()
+{
+	return _maxDepth;
+}
+
+/*
+Drops every cached node; the counters are kept.
+*/
+void PrefixCache::Clear()
+{
+	_nodes.resize(1);
+	_nodes[0].parent = -1;
+	_nodes[0].symbol = -1;
+	_nodes[0].numChildren = 0;
+	_nodes[0].prev = _nodes[0].next = -1;
+	_nodes[0].bytes = 0;
+	_freeNodes.clear();
+	_edges.clear();
+	_head = _tail = -1;
+	_bytes = 0;
+}
+
+/*
+Clears the cache if its columns were computed under a different model version.
+*/
+void PrefixCache::Validate(const unsigned long modelVersion)
+{
+	if(modelVersion != _modelVersion){
+		if(_nodes.size() - _freeNodes.size() > 1){
+			_numInvalidations++;
+		}
+		Clear();
+		_modelVersion = modelVersion;
+	}
+}
+
+unsigned long long PrefixCache::_edgeKey(const int node, const int symbol)
+{
+	return ((unsigned long long)(unsigned int)node << 32) | (unsigned int)symbol;
+}
+
+/*
+Returns the node of @node's prefix extended by @symbol, or -1 if it is not cached.
+*/
+int PrefixCache::Child(const int node, const int symbol)
+{
+	unordered_map<unsigned long long,int>::iterator it = _edges.find(_edgeKey(node, symbol));
+
+	return it == _edges.end() ? -1 : it->second;
+}
+
+/*
+Adds an empty child node; its columns are filled in by the caller, followed by Account().
+*/
+int PrefixCache::AddChild(const int node, const int symbol)
+{
+	int child;
+
+	if(_freeNodes.size() > 0){
+		child = _freeNodes.back();
+		_freeNodes.pop_back();
+	}
+	else{
+		child = _nodes.size();
+		_nodes.push_back(Node());
+	}
+	Node& added = _nodes[child];
+	added.parent = node;
+	added.symbol = symbol;
+	added.numChildren = 0;
+	added.bytes = 0;
+	added.alpha.clear();
+	added.delta.clear();
+	added.pointers.clear();
+	_nodes[node].numChildren++;
+	_edges[_edgeKey(node, symbol)] = child;
+	_pushFront(child);
+	Account(child);
+
+	return child;
+}
+
+vector<double>& PrefixCache::Alpha(const int node)
+{
+	return _nodes[node].alpha;
+}
+
+vector<double>& PrefixCache::Delta(const int node)
+{
+	return _nodes[node].delta;
+}
+
+vector<int>& PrefixCache::Pointers(const int node)
+{
+	return _nodes[node].pointers;
+}
+
+/*
+Updates the byte count of a node after its columns have changed: the node, its columns, and its trie edge.
+*/
+void PrefixCache::Account(const int node)
+{
+	Node& n = _nodes[node];
+
+	_bytes -= n.bytes;
+	n.bytes = sizeof(Node) + 48 + n.alpha.capacity() * sizeof(double) + n.delta.capacity() * sizeof(double) + n.pointers.capacity() * sizeof(int);
+	_bytes += n.bytes;
+}
+
+/*
+Marks the nodes of a query's path as most recently used. @path lists them root side first; they are touched
+deepest first, so every node ends up more recent than its descendants.
+*/
+void PrefixCache::Touch(const vector<int>& path)
+{
+	for(int i = path.size() - 1; i >= 0; i--){
+		_unlink(path[i]);
+		_pushFront(path[i]);
+	}
+}
+
+/*
+Evicts least recently used nodes until the cache is within its budget.
+*/
+void PrefixCache::Trim()
+{
+	while(_bytes > _budget && _tail >= 0){
+		_evict(_tail);
+	}
+}
+
+void PrefixCache::_unlink(const int node)
+{
+	Node& n = _nodes[node];
+
+	if(n.prev >= 0){
+		_nodes[n.prev].next = n.next;
+	}
+	else{
+		_head = n.next;
+	}
+	if(n.next >= 0){
+		_nodes[n.next].prev = n.prev;
+	}
+	else{
+		_tail = n.prev;
+	}
+	n.prev = n.next = -1;
+}
+
+void PrefixCache::_pushFront(const int node)
+{
+	Node& n = _nodes[node];
+
+	n.prev = -1;
+	n.next = _head;
+	if(_head >= 0){
+		_nodes[_head].prev = node;
+	}
+	_head = node;
+	if(_tail < 0){
+		_tail = node;
+	}
+}
+
+void PrefixCache::_evict(const int node)
+{
+	Node& n = _nodes[node];
+
+	_unlink(node);
+	_edges.erase(_edgeKey(n.parent, n.symbol));
+	_nodes[n.parent].numChildren--;
+	_bytes -= n.bytes;
+	n.bytes = 0;
+	vector<double>().swap(n.alpha);
+	vector<double>().swap(n.delta);
+	vector<int>().swap(n.pointers);
+	_freeNodes.push_back(node);
+	_numEvictions++;
+}
+
+/*
+Returns the bytes held by cached nodes.
+*/
+unsigned long long PrefixCache::Bytes()
+{
+	return _bytes;
+}
+
+/*
+Counts a query which reused @cachedColumns columns and computed @computedColumns.
+*/
+void PrefixCache::Record(const int cachedColumns, const int computedColumns)
+{
+	_numQueries++;
+	_numHits += cachedColumns > 0 ? 1 : 0;
+	_cachedColumns += cachedColumns;
+	_computedColumns += computedColumns;
+}
+
+/*
+Returns the cache counters as space separated key=value pairs. hit_rate is the fraction of queries which reused
+at least one column; saved_columns is the number of columns reused rather than computed.
+*/
+string PrefixCache::StatsString()
+{
+	ostringstream out;
+
+	out << "queries=" << _numQueries << " hits=" << _numHits;
+	out << " hit_rate=" << (_numQueries > 0 ? (double)_numHits / (double)_numQueries : 0.0);
+	out << " saved_columns=" << _cachedColumns << " computed_columns=" << _computedColumns;
+	out << " nodes=" << (_nodes.size() - _freeNodes.size() - 1) << " bytes=" << _bytes << " budget=" << _budget;
+	out << " evictions=" << _numEvictions << " invalidations=" << _numInvalidations;
+
+	return out.str();
+}
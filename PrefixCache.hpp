@@ -0,0 +1,78 @@
+#ifndef PREFIX_CACHE_HPP
+#define PREFIX_CACHE_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+/*
+A trie of lattice columns keyed by observation prefix, so that queries sharing a prefix (eg, a common header) reuse
+its forward and Viterbi columns rather than recomputing them. See DiscreteHmm::SetPrefixCache().
+
+Node 0 is the root, the empty prefix. Every other node is the prefix of its parent extended by one symbol, and may
+hold the alpha column, and the delta and backpointer columns, of the last position of its prefix. Those depend only
+on the prefix and the model, so the whole cache is dropped whenever the model version changes.
+
+Memory is bounded by a byte budget, by evicting least recently used nodes. A query touches the nodes of its path
+deepest first, so a node is always more recent than its descendants, and the least recent node is always a leaf:
+eviction never disconnects a cached prefix from the root.
+*/
+class PrefixCache{
+	public:
+		PrefixCache();
+		~PrefixCache();
+		void Configure(const unsigned long long budgetBytes, const int maxDepth);
+		bool Enabled();
+		int MaxDepth();
+		void Clear();
+		void Validate(const unsigned long modelVersion);
+		int Child(const int node, const int symbol);
+		int AddChild(const int node, const int symbol);
+		vector<double>& Alpha(const int node);
+		vector<double>& Delta(const int node);
+		vector<int>& Pointers(const int node);
+		void Account(const int node);
+		void Touch(const vector<int>& path);
+		void Trim();
+		void Record(const int cachedColumns, const int computedColumns);
+		string StatsString();
+		unsigned long long Bytes();
+	private:
+		struct Node{
+			int parent;
+			int symbol;
+			int numChildren;
+			//LRU list links; the head is the most recent
+			int prev;
+			int next;
+			unsigned long long bytes;
+			vector<double> alpha;
+			vector<double> delta;
+			vector<int> pointers;
+		};
+		unsigned long long _edgeKey(const int node, const int symbol);
+		void _unlink(const int node);
+		void _pushFront(const int node);
+		void _evict(const int node);
+
+		unsigned long long _budget;
+		int _maxDepth;
+		unsigned long _modelVersion;
+		vector<Node> _nodes;
+		vector<int> _freeNodes;
+		unordered_map<unsigned long long,int> _edges;
+		int _head;
+		int _tail;
+		unsigned long long _bytes;
+
+		unsigned long long _numQueries;
+		unsigned long long _numHits;
+		unsigned long long _cachedColumns;
+		unsigned long long _computedColumns;
+		unsigned long long _numEvictions;
+		unsigned long long _numInvalidations;
+};
+
+#endif
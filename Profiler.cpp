@@ -0,0 +1,308 @@
+#include "Profiler.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+atomic<bool> Profiler::_enabled(false);
+atomic<bool> Profiler::_counters(false);
+mutex Profiler::_lock;
+vector<Profiler::Event> Profiler::_events;
+map<string,Profiler::Summary> Profiler::_summary;
+unsigned long Profiler::_traceLimit = 1 << 20;
+unsigned long long Profiler::_droppedEvents = 0;
+chrono::steady_clock::time_point Profiler::_epoch = chrono::steady_clock::now();
+
+static const char* counterNames[PROFILE_NUM_COUNTERS] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+#ifdef __linux__
+/*
+The hardware counters of one thread: a perf event group led by the cycle counter, so all four are read
+with a single read(). Opened the first time a thread reads its counters.
+*/
+struct ThreadCounters{
+	int fds[PROFILE_NUM_COUNTERS];
+	bool opened;
+	bool failed;
+	ThreadCounters()
+	{
+		opened = failed = false;
+		for(int i = 0; i < PROFILE_NUM_COUNTERS; i++){
+			fds[i] = -1;
+		}
+	}
+	~ThreadCounters()
+	{
+		for(int i = 0; i < PROFILE_NUM_COUNTERS; i++){
+			if(fds[i] >= 0){
+				close(fds[i]);
+			}
+		}
+	}
+	bool Open()
+	{
+		int i;
+		struct perf_event_attr attr;
+		unsigned long long configs[PROFILE_NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+		opened = true;
+		for(i = 0; i < PROFILE_NUM_COUNTERS; i++){
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = configs[i];
+			attr.read_format = PERF_FORMAT_GROUP;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.disabled = (i == 0);
+			//this thread, any cpu
+			fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0);
+			if(fds[i] < 0){
+				failed = true;
+				return false;
+			}
+		}
+		ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+		return true;
+	}
+};
+static thread_local ThreadCounters threadCounters;
+#endif
+
+/*
+Turns profiling on or off. With @hardwareCounters, scopes also record the hardware counters of their thread;
+if the counters are unavailable (eg, not Linux, or perf_event_paranoid forbids them) they are switched off
+and only wall time is recorded.
+*/
+void Profiler::Enable(bool enable, bool hardwareCounters)
+{
+	_counters = enable && hardwareCounters;
+	_enabled = enable;
+}
+
+bool Profiler::CountersEnabled()
+{
+	return _counters;
+}
+
+/*
+Discards all recorded events and summaries.
+*/
+void Profiler::Reset()
+{
+	lock_guard<mutex> guard(_lock);
+	_events.clear();
+	_summary.clear();
+	_droppedEvents = 0;
+	_epoch = chrono::steady_clock::now();
+}
+
+/*
+Sets the maximum number of events kept for the trace; later events still count toward the summary.
+*/
+void Profiler::SetTraceLimit(const unsigned long maxEvents)
+{
+	_traceLimit = maxEvents;
+}
+
+/*
+Reads the calling thread's hardware counters into @counters, or zeroes if they are unavailable.
+*/
+void Profiler::ReadCounters(unsigned long long counters[PROFILE_NUM_COUNTERS])
+{
+	int i;
+
+	for(i = 0; i < PROFILE_NUM_COUNTERS; i++){
+		counters[i] = 0;
+	}
+#ifndef __linux__
+	_counters = false;
+#else
+	//group read layout: number of events, then one value per event
+	unsigned long long values[1 + PROFILE_NUM_COUNTERS];
+
+	if(!threadCounters.opened && !threadCounters.Open()){
+		cout << "WARNING hardware counters unavailable (check /proc/sys/kernel/perf_event_paranoid); recording wall time only" << endl;
+		_counters = false;
+	}
+	if(threadCounters.failed){
+		return;
+	}
+	if(read(threadCounters.fds[0], values, sizeof(values)) == sizeof(values)){
+		for(i = 0; i < PROFILE_NUM_COUNTERS; i++){
+			counters[i] = values[i+1];
+		}
+	}
+#endif
+}
+
+int Profiler::_threadId()
+{
+	static atomic<int> nextId(0);
+	static thread_local int id = nextId++;
+
+	return id;
+}
+
+void Profiler::Record(const char* name, const chrono::steady_clock::time_point& start, const chrono::steady_clock::time_point& end, const unsigned long long counters[PROFILE_NUM_COUNTERS])
+{
+	int i;
+	Event event;
+
+	event.name = name;
+	event.threadId = _threadId();
+	event.startMicros = chrono::duration<double,micro>(start - _epoch).count();
+	event.durationMicros = chrono::duration<double,micro>(end - start).count();
+	for(i = 0; i < PROFILE_NUM_COUNTERS; i++){
+		event.counters[i] = counters[i];
+	}
+
+	lock_guard<mutex> guard(_lock);
+	//new summaries are value-initialized to zero
+	Summary& summary = _summary[name];
+	summary.calls++;
+	summary.totalMicros += event.durationMicros;
+	if(event.durationMicros > summary.maxMicros){
+		summary.maxMicros = event.durationMicros;
+	}
+	for(i = 0; i < PROFILE_NUM_COUNTERS; i++){
+		summary.counters[i] += counters[i];
+	}
+	if(_events.size() < _traceLimit){
+		_events.push_back(event);
+	}
+	else{
+		_droppedEvents++;
+	}
+}
+
+void ProfileScope::_end()
+{
+	int i;
+	unsigned long long counters[PROFILE_NUM_COUNTERS];
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	if(Profiler::CountersEnabled()){
+		Profiler::ReadCounters(counters);
+		for(i = 0; i < PROFILE_NUM_COUNTERS; i++){
+			counters[i] -= _counters[i];
+		}
+	}
+	else{
+		memset(counters, 0, sizeof(counters));
+	}
+	Profiler::Record(_name, _start, end, counters);
+}
+
+/*
+Writes the recorded events as Chrome trace-event JSON: one complete ("X") event per scope, with the
+hardware counters, if recorded, as its args.
+*/
+bool Profiler::WriteChromeTrace(const string& path)
+{
+	int i;
+	fstream outputFile;
+
+	outputFile.open(path.c_str(), ios::out);
+	if(!outputFile.is_open()){
+		cout << "ERROR could not open trace file: " << path << endl;
+		return false;
+	}
+
+	lock_guard<mutex> guard(_lock);
+	outputFile.precision(3);
+	outputFile << fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for(unsigned long e = 0; e < _events.size(); e++){
+		const Event& event = _events[e];
+		outputFile << (e > 0 ? ",\n" : "\n");
+		outputFile << "{\"name\":\"" << event.name << "\",\"cat\":\"hmm\",\"ph\":\"X\",\"pid\":" << getpid() << ",\"tid\":" << event.threadId;
+		outputFile << ",\"ts\":" << event.startMicros << ",\"dur\":" << event.durationMicros;
+		if(_counters){
+			outputFile << ",\"args\":{";
+			for(i = 0; i < PROFILE_NUM_COUNTERS; i++){
+				outputFile << (i > 0 ? "," : "") << "\"" << counterNames[i] << "\":" << event.counters[i];
+			}
+			outputFile << "}";
+		}
+		outputFile << "}";
+	}
+	outputFile << "\n]}" << endl;
+	outputFile.close();
+
+	if(_droppedEvents > 0){
+		cout << "WARNING trace limit reached, " << _droppedEvents << " events not written to " << path << endl;
+	}
+
+	return true;
+}
+
+/*
+Prints one row per scope name: calls, total/mean/max wall time, and, if recorded, the hardware counter
+totals with instructions per cycle.
+*/
+void Profiler::PrintSummary(ostream& out)
+{
+	char row[512];
+	map<string,Summary>::iterator it;
+	lock_guard<mutex> guard(_lock);
+
+	snprintf(row, sizeof(row), "%-28s %10s %12s %12s %12s", "scope", "calls", "total_ms", "mean_us", "max_us");
+	out << row;
+	if(_counters){
+		snprintf(row, sizeof(row), " %14s %14s %6s %12s %12s", "cycles", "instructions", "ipc", "cache_miss", "branch_miss");
+		out << row;
+	}
+	out << "\n";
+
+	for(it = _summary.begin(); it != _summary.end(); it++){
+		const Summary& s = it->second;
+		snprintf(row, sizeof(row), "%-28s %10llu %12.3f %12.3f %12.3f", it->first.c_str(), s.calls, s.totalMicros / 1000.0, s.totalMicros / (double)s.calls, s.maxMicros);
+		out << row;
+		if(_counters){
+			snprintf(row, sizeof(row), " %14llu %14llu %6.2f %12llu %12llu", s.counters[PROFILE_CYCLES], s.counters[PROFILE_INSTRUCTIONS],
+				s.counters[PROFILE_CYCLES] > 0 ? (double)s.counters[PROFILE_INSTRUCTIONS] / (double)s.counters[PROFILE_CYCLES] : 0.0,
+				s.counters[PROFILE_CACHE_MISSES], s.counters[PROFILE_BRANCH_MISSES]);
+			out << row;
+		}
+		out << "\n";
+	}
+	out << flush;
+}
+
+/*
+Environment-driven profiling: HMM_PROFILE names the trace file to write at exit.
+*/
+static string tracePath;
+
+static void writeProfileAtExit()
+{
+	Profiler::PrintSummary(cout);
+	Profiler::WriteChromeTrace(tracePath);
+}
+
+static bool initFromEnvironment()
+{
+	const char* path = getenv("HMM_PROFILE");
+	const char* counters = getenv("HMM_PROFILE_COUNTERS");
+
+	if(path != NULL && path[0] != '\0'){
+		tracePath = path;
+		Profiler::Enable(true, counters != NULL && atoi(counters) != 0);
+		atexit(writeProfileAtExit);
+	}
+
+	return true;
+}
+
+static bool initialized = initFromEnvironment();
@@ -0,0 +1,107 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+/*
+Scoped instrumentation of the expensive phases of the library (the lattice algorithms, the Baum-Welch steps,
+training and dataset loading). Each instrumented scope records its wall time and, optionally, the hardware
+counters of its thread: cycles, instructions, cache misses and branch misses, read with perf_event_open on Linux.
+
+Recorded scopes are aggregated into a per-name summary table, and kept as events for a Chrome trace-event
+JSON file (load it in chrome://tracing or https://ui.perfetto.dev).
+
+Profiling is off by default, and a disabled scope costs a single branch on a global flag. It can be enabled
+in code with Profiler::Enable(), or for any program by setting environment variables:
+
+	HMM_PROFILE=<trace.json>     enable, and write the trace and print the summary at exit
+	HMM_PROFILE_COUNTERS=1       also read the hardware counters
+
+Compiling with -DHMM_DISABLE_PROFILING removes the scopes entirely.
+*/
+
+enum ProfileCounter { PROFILE_CYCLES = 0, PROFILE_INSTRUCTIONS, PROFILE_CACHE_MISSES, PROFILE_BRANCH_MISSES, PROFILE_NUM_COUNTERS };
+
+class Profiler{
+	public:
+		static void Enable(bool enable, bool hardwareCounters=false);
+		static inline bool IsEnabled() { return _enabled.load(memory_order_relaxed); }
+		static bool CountersEnabled();
+		static void Reset();
+		static void SetTraceLimit(const unsigned long maxEvents);
+		static bool WriteChromeTrace(const string& path);
+		static void PrintSummary(ostream& out=cout);
+		//used by ProfileScope
+		static void ReadCounters(unsigned long long counters[PROFILE_NUM_COUNTERS]);
+		static void Record(const char* name, const chrono::steady_clock::time_point& start, const chrono::steady_clock::time_point& end, const unsigned long long counters[PROFILE_NUM_COUNTERS]);
+	private:
+		struct Event{
+			const char* name;
+			int threadId;
+			double startMicros;
+			double durationMicros;
+			unsigned long long counters[PROFILE_NUM_COUNTERS];
+		};
+		struct Summary{
+			unsigned long long calls;
+			double totalMicros;
+			double maxMicros;
+			unsigned long long counters[PROFILE_NUM_COUNTERS];
+		};
+		static int _threadId();
+
+		static atomic<bool> _enabled;
+		static atomic<bool> _counters;
+		static mutex _lock;
+		static vector<Event> _events;
+		static map<string,Summary> _summary;
+		static unsigned long _traceLimit;
+		static unsigned long long _droppedEvents;
+		static chrono::steady_clock::time_point _epoch;
+};
+
+/*
+Records the enclosing scope under @name, which must be a string literal (or otherwise outlive the profiler).
+*/
+class ProfileScope{
+	public:
+		inline ProfileScope(const char* name)
+		{
+			_name = Profiler::IsEnabled() ? name : NULL;
+			if(_name != NULL){
+				if(Profiler::CountersEnabled()){
+					Profiler::ReadCounters(_counters);
+				}
+				_start = chrono::steady_clock::now();
+			}
+		}
+		inline ~ProfileScope()
+		{
+			if(_name != NULL){
+				_end();
+			}
+		}
+	private:
+		void _end();
+		const char* _name;
+		chrono::steady_clock::time_point _start;
+		unsigned long long _counters[PROFILE_NUM_COUNTERS];
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifdef HMM_DISABLE_PROFILING
+	#define PROFILE_SCOPE(name)
+#else
+	#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(name)
+#endif
+
+#endif
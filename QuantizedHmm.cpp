@@ -0,0 +1,666 @@
+#include "QuantizedHmm.hpp"
+
+#include <sstream>
+#include <chrono>
+
+template<typename T>
+QuantizedHmm<T>::QuantizedHmm()
+{
+	_numStates = 0;
+	_numSymbols = 0;
+	_scale = 1;
+	_tableShift = 0;
+	_tableRound = 0;
+	//int16_t relies on saturation at the type's minimum; int32_t leaves headroom so a sum of two values cannot overflow
+	_floor = sizeof(T) == 2 ? numeric_limits<T>::min() : numeric_limits<T>::min() / 4;
+	SetSimd(true);
+}
+
+template<typename T>
+QuantizedHmm<T>::~QuantizedHmm()
+{}
+
+/*
+Enables or disables the AVX2 Viterbi kernel, if the CPU supports it. Results are identical either way.
+*/
+template<typename T>
+void QuantizedHmm<T>::SetSimd(bool enable)
+{
+#ifdef HMM_X86_SIMD
+	_useSimd = enable && __builtin_cpu_supports("avx2");
+#else
+	_useSimd = false;
+#endif
+}
+
+template<typename T>
+int QuantizedHmm<T>::NumStates()
+{
+	return _numStates;
+}
+
+template<typename T>
+int QuantizedHmm<T>::NumSymbols()
+{
+	return _numSymbols;
+}
+
+/*
+Returns the number of integer units per nat: a stored value v is the log-probability v / Scale().
+*/
+template<typename T>
+double QuantizedHmm<T>::Scale()
+{
+	return _scale;
+}
+
+/*
+Returns the id of a symbol, or -1 if it is not in the model.
+*/
+template<typename T>
+int QuantizedHmm<T>::GetSymbolId(const string& symbol)
+{
+	typename map<string,int>::iterator it = _symbolIds.find(symbol);
+
+	return it == _symbolIds.end() ? -1 : it->second;
+}
+
+template<typename T>
+const string& QuantizedHmm<T>::GetStateName(const int state)
+{
+	return _states[state];
+}
+
+/*
+Quantizes the parameters of @hmm.
+
+@scale: integer units per nat. 0 picks the largest scale at which the smallest nonzero parameter still uses no more
+than a quarter of the range above the floor, which leaves room for the sums of the recurrences before they saturate.
+It is capped (1024 for int16_t, 65536 for int32_t), since beyond that the parameters of a trained model carry no
+more precision worth keeping.
+*/
+template<typename T>
+bool QuantizedHmm<T>::Build(DiscreteHmm& hmm, const double scale)
+{
+	int i, j;
+	double minLogProb, range;
+
+	if(hmm.NumStates() <= 0 || hmm.NumSymbols() <= 0){
+		cout << "ERROR cannot quantize an empty model" << endl;
+		return false;
+	}
+	if(sizeof(T) == 2 && hmm.NumStates() > numeric_limits<int16_t>::max()){
+		cout << "ERROR too many states for a 16-bit quantized model: " << hmm.NumStates() << endl;
+		return false;
+	}
+
+	_numStates = hmm.NumStates();
+	_numSymbols = hmm.NumSymbols();
+
+	//the smallest nonzero probability sets the scale
+	minLogProb = 0;
+	for(i = 0; i < _numStates; i++){
+		if(hmm._pi[i] > -numeric_limits<double>::infinity()){
+			minLogProb = min(minLogProb, hmm._pi[i]);
+		}
+		for(j = 0; j < _numStates; j++){
+			if(hmm._stateMatrix[i][j] > -numeric_limits<double>::infinity()){
+				minLogProb = min(minLogProb, hmm._stateMatrix[i][j]);
+			}
+		}
+		for(j = 0; j < _numSymbols; j++){
+			if(hmm._transitionMatrix[i][j] > -numeric_limits<double>::infinity()){
+				minLogProb = min(minLogProb, hmm._transitionMatrix[i][j]);
+			}
+		}
+	}
+	if(scale > 0){
+		_scale = scale;
+	}
+	else{
+		range = -(double)_floor / 4.0;
+		_scale = min(range / max(-minLogProb, 1.0), sizeof(T) == 2 ? 1024.0 : 65536.0);
+	}
+	if(minLogProb * _scale <= (double)_floor){
+		cout << "WARNING quantization scale " << _scale << " saturates parameters as small as " << minLogProb << endl;
+	}
+
+	_pi.resize(_numStates);
+	_transitions.resize(_numStates * _numStates);
+	_emissions.resize(_numSymbols * _numStates);
+	for(i = 0; i < _numStates; i++){
+		_pi[i] = _quantize(hmm._pi[i]);
+		for(j = 0; j < _numStates; j++){
+			_transitions[i * _numStates + j] = _quantize(hmm._stateMatrix[i][j]);
+		}
+	}
+	for(i = 0; i < _numSymbols; i++){
+		for(j = 0; j < _numStates; j++){
+			_emissions[i * _numStates + j] = _quantize(hmm._emissionsBySymbol[i][j]);
+		}
+	}
+
+	_states.clear();
+	_symbols.clear();
+	_symbolIds.clear();
+	for(i = 0; i < _numStates; i++){
+		_states.push_back(hmm.GetStateName(i));
+	}
+	for(i = 0; i < _numSymbols; i++){
+		_symbols.push_back(hmm.GetSymbolName(i));
+		_symbolIds[_symbols.back()] = i;
+	}
+	_buildLogAddTable();
+
+	return true;
+}
+
+/*
+Maps a log-probability to the integer domain: -inf (or NaN) to the floor, and finite values to the nearest integer
+above it, so a rare event never becomes impossible.
+*/
+template<typename T>
+T QuantizedHmm<T>::_quantize(const double logProb)
+{
+	double q;
+
+	if(!(logProb > -numeric_limits<double>::infinity())){
+		return _floor;
+	}
+	q = round(logProb * _scale);
+	if(q <= (double)_floor){
+		return _floor + 1;
+	}
+	if(q > (double)numeric_limits<T>::max()){
+		return numeric_limits<T>::max();
+	}
+
+	return (T)q;
+}
+
+/*
+Fills the log-sum-exp correction table: entry i holds round(Scale() * ln(1 + exp(-d / Scale()))) for a difference
+d of i << _tableShift, and _logAdd() interpolates between entries. Past the end of the table the correction rounds
+to zero. The shift keeps large scales from needing a table too large to stay in cache.
+*/
+template<typename T>
+void QuantizedHmm<T>::_buildLogAddTable()
+{
+	int i, size;
+	long long span;
+	double d;
+
+	//differences beyond scale * ln(2 * scale) have a correction under half a unit
+	span = (long long)ceil(_scale * log(2.0 * _scale + 2.0)) + 2;
+	for(_tableShift = 0; (span >> _tableShift) > 8192; _tableShift++);
+	_tableRound = _tableShift > 0 ? 1LL << (_tableShift - 1) : 0;
+	//the last entry is zero, so interpolation never reads past the end
+	size = (int)(span >> _tableShift) + 2;
+
+	_logAddTable.resize(size);
+	for(i = 0; i < size; i++){
+		d = (double)((long long)i << _tableShift);
+		_logAddTable[i] = i < size - 1 ? (T)round(_scale * log1p(exp(-d / _scale))) : 0;
+	}
+}
+
+/*
+Saturating addition: the result is clamped to [floor, max], so the floor absorbs any finite value.
+*/
+template<typename T>
+inline T QuantizedHmm<T>::_add(const T a, const T b)
+{
+	long long sum = (long long)a + (long long)b;
+
+	if(sum < _floor){
+		return _floor;
+	}
+	if(sum > numeric_limits<T>::max()){
+		return numeric_limits<T>::max();
+	}
+
+	return (T)sum;
+}
+
+/*
+ln(e^a + e^b) in the integer domain: the larger value plus a tabulated correction, linearly interpolated.
+*/
+template<typename T>
+inline T QuantizedHmm<T>::_logAdd(const T a, const T b)
+{
+	long long hi, lo, index, fraction;
+
+	hi = a >= b ? a : b;
+	lo = a >= b ? b : a;
+	if(lo <= _floor){
+		return (T)hi;
+	}
+	index = (hi - lo) >> _tableShift;
+	if(index < (long long)_logAddTable.size() - 1){
+		fraction = (hi - lo) - (index << _tableShift);
+		//rounded to nearest: the recurrences add many corrections, so a truncation bias would accumulate
+		hi += _logAddTable[index] + ((((long long)_logAddTable[index + 1] - _logAddTable[index]) * fraction + _tableRound) >> _tableShift);
+	}
+
+	return hi > numeric_limits<T>::max() ? numeric_limits<T>::max() : (T)hi;
+}
+
+/*
+Subtracts the maximum of a lattice column from its values, adding it to @offset. Values at the floor stay there.
+Returns false if every value is at the floor, ie the observations are impossible under the model.
+*/
+template<typename T>
+bool QuantizedHmm<T>::_renormalize(vector<T>& column, long long& offset)
+{
+	int i;
+	T max = _floor;
+
+	for(i = 0; i < column.size(); i++){
+		if(column[i] > max){
+			max = column[i];
+		}
+	}
+	if(max <= _floor){
+		return false;
+	}
+	for(i = 0; i < column.size(); i++){
+		column[i] = column[i] <= _floor ? _floor : _add(column[i], (T)-max);
+	}
+	offset += max;
+
+	return true;
+}
+
+/*
+A max-plus Viterbi step over the quantized tables. As in DiscreteHmm::_viterbiColumn(), sources are visited in
+increasing order and replace the max only when strictly greater.
+*/
+template<typename T>
+void QuantizedHmm<T>::_viterbiColumn(const vector<T>& leftCol, vector<T>& rightCol, int* ptrCol, const int observation)
+{
+	int j = 0, k, argmax;
+	T score, best;
+	const T* emissions = &_emissions[observation * _numStates];
+
+#ifdef HMM_X86_SIMD
+	if(_useSimd){
+		j = _viterbiColumnSimd(leftCol, rightCol, ptrCol, observation);
+	}
+#endif
+
+	for(; j < _numStates; j++){
+		best = _floor;
+		argmax = 0;
+		for(k = 0; k < _numStates; k++){
+			score = _add(leftCol[k], _transitions[k * _numStates + j]);
+			if(score > best){
+				best = score;
+				argmax = k;
+			}
+		}
+		ptrCol[j] = argmax;
+		rightCol[j] = _add(best, emissions[j]);
+	}
+}
+
+#ifdef HMM_X86_SIMD
+/*
+16 destination states per instruction. The saturating 16-bit add is exactly _add(), since the floor is the type's minimum
+and no value exceeds zero. Returns the number of states computed; the caller finishes the rest.
+*/
+template<>
+__attribute__((target("avx2")))
+int QuantizedHmm<int16_t>::_viterbiColumnSimd(const vector<int16_t>& leftCol, vector<int16_t>& rightCol, int* ptrCol, const int observation)
+{
+	int j, k, lane;
+	int16_t bestStates[16];
+	__m256i best, argmax, score, greater;
+	const int16_t* emissions = &_emissions[observation * _numStates];
+
+	for(j = 0; j + 16 <= _numStates; j += 16){
+		best = _mm256_set1_epi16(_floor);
+		argmax = _mm256_setzero_si256();
+		for(k = 0; k < _numStates; k++){
+			score = _mm256_adds_epi16(_mm256_loadu_si256((const __m256i*)&_transitions[k * _numStates + j]), _mm256_set1_epi16(leftCol[k]));
+			greater = _mm256_cmpgt_epi16(score, best);
+			best = _mm256_blendv_epi8(best, score, greater);
+			argmax = _mm256_blendv_epi8(argmax, _mm256_set1_epi16((int16_t)k), greater);
+		}
+		best = _mm256_adds_epi16(best, _mm256_loadu_si256((const __m256i*)(emissions + j)));
+		_mm256_storeu_si256((__m256i*)&rightCol[j], best);
+		_mm256_storeu_si256((__m256i*)bestStates, argmax);
+		for(lane = 0; lane < 16; lane++){
+			ptrCol[j + lane] = bestStates[lane];
+		}
+	}
+
+	return j;
+}
+
+/*
+8 destination states per instruction. The floor is INT32_MIN/4, so the plain 32-bit add cannot overflow, and clamping
+it at the floor with a max is exactly _add().
+*/
+template<>
+__attribute__((target("avx2")))
+int QuantizedHmm<int32_t>::_viterbiColumnSimd(const vector<int32_t>& leftCol, vector<int32_t>& rightCol, int* ptrCol, const int observation)
+{
+	int j, k;
+	__m256i best, argmax, score, greater, floor;
+	const int32_t* emissions = &_emissions[observation * _numStates];
+
+	floor = _mm256_set1_epi32(_floor);
+	for(j = 0; j + 8 <= _numStates; j += 8){
+		best = floor;
+		argmax = _mm256_setzero_si256();
+		for(k = 0; k < _numStates; k++){
+			score = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)&_transitions[k * _numStates + j]), _mm256_set1_epi32(leftCol[k]));
+			score = _mm256_max_epi32(score, floor);
+			greater = _mm256_cmpgt_epi32(score, best);
+			best = _mm256_blendv_epi8(best, score, greater);
+			argmax = _mm256_blendv_epi8(argmax, _mm256_set1_epi32(k), greater);
+		}
+		best = _mm256_max_epi32(_mm256_add_epi32(best, _mm256_loadu_si256((const __m256i*)(emissions + j))), floor);
+		_mm256_storeu_si256((__m256i*)&rightCol[j], best);
+		_mm256_storeu_si256((__m256i*)(ptrCol + j), argmax);
+	}
+
+	return j;
+}
+#endif
+
+/*
+Viterbi decoding of the whole of @observations. Returns the approximate ln-probability of the best path, -inf if
+the observations are impossible, or 1 on error; the path is written to @output.
+*/
+template<typename T>
+double QuantizedHmm<T>::Viterbi(const vector<int>& observations, vector<int>& output)
+{
+	PROFILE_SCOPE("QuantizedHmm.Viterbi");
+	int i, j, best;
+	long long offset = 0;
+	vector<T> leftCol(_numStates), rightCol(_numStates);
+
+	output.clear();
+	if(observations.size() == 0 || _numStates == 0){
+		cout << "ERROR empty observations or model in QuantizedHmm::Viterbi()" << endl;
+		return 1;
+	}
+	for(i = 0; i < observations.size(); i++){
+		if(observations[i] < 0 || observations[i] >= _numSymbols){
+			cout << "ERROR observation out of range in QuantizedHmm::Viterbi(): " << observations[i] << endl;
+			return 1;
+		}
+	}
+
+	_ptrLattice.resize(observations.size() * _numStates);
+	for(j = 0; j < _numStates; j++){
+		leftCol[j] = _add(_pi[j], _emissions[observations[0] * _numStates + j]);
+	}
+	if(!_renormalize(leftCol, offset)){
+		return -numeric_limits<double>::infinity();
+	}
+	for(i = 1; i < observations.size(); i++){
+		_viterbiColumn(leftCol, rightCol, &_ptrLattice[i * _numStates], observations[i]);
+		if(!_renormalize(rightCol, offset)){
+			return -numeric_limits<double>::infinity();
+		}
+		leftCol.swap(rightCol);
+	}
+
+	//the best final state is the first one at the column maximum, which renormalization made zero
+	best = 0;
+	for(j = 0; j < _numStates; j++){
+		if(leftCol[j] > leftCol[best]){
+			best = j;
+		}
+	}
+	output.resize(observations.size());
+	output.back() = best;
+	for(i = output.size() - 2; i >= 0; i--){
+		output[i] = _ptrLattice[(i + 1) * _numStates + output[i + 1]];
+	}
+
+	return (double)(offset + leftCol[best]) / _scale;
+}
+
+/*
+Approximate forward algorithm over the whole of @observations. Returns ln P(observations), -inf if they are
+impossible, or 1 on error.
+*/
+template<typename T>
+double QuantizedHmm<T>::Forward(const vector<int>& observations)
+{
+	PROFILE_SCOPE("QuantizedHmm.Forward");
+	int i, j, k;
+	long long offset = 0;
+	T total;
+	vector<T> leftCol(_numStates), rightCol(_numStates);
+
+	if(observations.size() == 0 || _numStates == 0){
+		cout << "ERROR empty observations or model in QuantizedHmm::Forward()" << endl;
+		return 1;
+	}
+	for(i = 0; i < observations.size(); i++){
+		if(observations[i] < 0 || observations[i] >= _numSymbols){
+			cout << "ERROR observation out of range in QuantizedHmm::Forward(): " << observations[i] << endl;
+			return 1;
+		}
+	}
+
+	for(j = 0; j < _numStates; j++){
+		leftCol[j] = _add(_pi[j], _emissions[observations[0] * _numStates + j]);
+	}
+	if(!_renormalize(leftCol, offset)){
+		return -numeric_limits<double>::infinity();
+	}
+	for(i = 1; i < observations.size(); i++){
+		const T* emissions = &_emissions[observations[i] * _numStates];
+		//sources in the outer loop, so each row of the transition table is read contiguously
+		rightCol.assign(_numStates, _floor);
+		for(k = 0; k < _numStates; k++){
+			if(leftCol[k] <= _floor){
+				continue;
+			}
+			const T* row = &_transitions[k * _numStates];
+			for(j = 0; j < _numStates; j++){
+				rightCol[j] = _logAdd(rightCol[j], _add(leftCol[k], row[j]));
+			}
+		}
+		for(j = 0; j < _numStates; j++){
+			rightCol[j] = _add(rightCol[j], emissions[j]);
+		}
+		if(!_renormalize(rightCol, offset)){
+			return -numeric_limits<double>::infinity();
+		}
+		leftCol.swap(rightCol);
+	}
+
+	total = _floor;
+	for(j = 0; j < _numStates; j++){
+		total = _logAdd(total, leftCol[j]);
+	}
+
+	return (double)(offset + total) / _scale;
+}
+
+/*
+Writes the quantized model: a header line (QHMM <bytes per value> <states> <symbols> <scale> <floor>), the state
+and symbol names one per line, then pi, the transition rows and the emission rows (by symbol) as integers.
+*/
+template<typename T>
+bool QuantizedHmm<T>::Write(const string& path)
+{
+	int i, j;
+	ofstream out;
+
+	out.open(path.c_str(), ios::out);
+	if(!out.is_open()){
+		cout << "ERROR could not open quantized model file: " << path << endl;
+		return false;
+	}
+
+	out.precision(17);
+	out << "QHMM " << sizeof(T) << " " << _numStates << " " << _numSymbols << " " << _scale << " " << (long long)_floor << "\n";
+	for(i = 0; i < _numStates; i++){
+		out << _states[i] << "\n";
+	}
+	for(i = 0; i < _numSymbols; i++){
+		out << _symbols[i] << "\n";
+	}
+	for(j = 0; j < _numStates; j++){
+		out << (j > 0 ? " " : "") << (long long)_pi[j];
+	}
+	out << "\n";
+	for(i = 0; i < _numStates + _numSymbols; i++){
+		const T* row = i < _numStates ? &_transitions[i * _numStates] : &_emissions[(i - _numStates) * _numStates];
+		for(j = 0; j < _numStates; j++){
+			out << (j > 0 ? " " : "") << (long long)row[j];
+		}
+		out << "\n";
+	}
+
+	return out.good();
+}
+
+/*
+Reads a model written by Write() with the same value width.
+*/
+template<typename T>
+bool QuantizedHmm<T>::Read(const string& path)
+{
+	int i, bytes;
+	long long value, floor;
+	string magic;
+	ifstream in;
+
+	in.open(path.c_str(), ios::in);
+	if(!in.is_open()){
+		cout << "ERROR could not open quantized model file: " << path << endl;
+		return false;
+	}
+
+	in >> magic >> bytes >> _numStates >> _numSymbols >> _scale >> floor;
+	if(!in || magic != "QHMM" || bytes != sizeof(T) || floor != _floor || _numStates <= 0 || _numSymbols <= 0){
+		cout << "ERROR bad header in quantized model file: " << path << endl;
+		_numStates = _numSymbols = 0;
+		return false;
+	}
+	getline(in, magic);
+
+	_states.resize(_numStates);
+	_symbols.resize(_numSymbols);
+	_symbolIds.clear();
+	for(i = 0; i < _numStates; i++){
+		getline(in, _states[i]);
+	}
+	for(i = 0; i < _numSymbols; i++){
+		getline(in, _symbols[i]);
+		_symbolIds[_symbols[i]] = i;
+	}
+
+	_pi.resize(_numStates);
+	_transitions.resize(_numStates * _numStates);
+	_emissions.resize(_numSymbols * _numStates);
+	for(i = 0; i < _pi.size(); i++){
+		in >> value;
+		_pi[i] = (T)value;
+	}
+	for(i = 0; i < _transitions.size(); i++){
+		in >> value;
+		_transitions[i] = (T)value;
+	}
+	for(i = 0; i < _emissions.size(); i++){
+		in >> value;
+		_emissions[i] = (T)value;
+	}
+	if(!in){
+		cout << "ERROR truncated quantized model file: " << path << endl;
+		_numStates = _numSymbols = 0;
+		return false;
+	}
+	_buildLogAddTable();
+
+	return true;
+}
+
+/*
+Decodes and scores @sequences with both @hmm and this quantized copy of it, and returns the comparison as space
+separated key=value pairs:
+	path_agreement: fraction of sequences whose Viterbi paths are identical
+	state_agreement: fraction of observations assigned the same state
+	viterbi_err_mean/max, forward_err_mean/max: absolute ln-probability errors, over sequences possible under both
+	impossible_mismatch: sequences impossible (-inf) under one engine only
+	*_s: the time spent by each engine
+*/
+template<typename T>
+string QuantizedHmm<T>::Report(DiscreteHmm& hmm, const vector<vector<int> >& sequences)
+{
+	int i, j, numCompared[2] = {0, 0}, numAgree = 0, numMismatch = 0;
+	unsigned long long numObservations = 0, numStatesAgree = 0;
+	double exact, approx, error, viterbiMean = 0, viterbiMax = 0, forwardMean = 0, forwardMax = 0;
+	double seconds[4] = {0, 0, 0, 0};
+	vector<int> exactPath, approxPath;
+	vector<double> exactScores[2], approxScores[2];
+	chrono::steady_clock::time_point start;
+	ostringstream out;
+
+	for(i = 0; i < sequences.size(); i++){
+		if(sequences[i].size() == 0){
+			continue;
+		}
+		start = chrono::steady_clock::now();
+		exactScores[0].push_back(hmm.Viterbi(sequences[i], sequences[i].size(), exactPath));
+		seconds[0] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		start = chrono::steady_clock::now();
+		approxScores[0].push_back(Viterbi(sequences[i], approxPath));
+		seconds[1] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		start = chrono::steady_clock::now();
+		exactScores[1].push_back(hmm.ForwardAlgorithm(sequences[i], sequences[i].size() - 1));
+		seconds[2] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		start = chrono::steady_clock::now();
+		approxScores[1].push_back(Forward(sequences[i]));
+		seconds[3] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		numAgree += exactPath == approxPath ? 1 : 0;
+		for(j = 0; j < exactPath.size() && j < approxPath.size(); j++){
+			numStatesAgree += exactPath[j] == approxPath[j] ? 1 : 0;
+		}
+		numObservations += sequences[i].size();
+	}
+
+	for(i = 0; i < exactScores[0].size(); i++){
+		for(j = 0; j < 2; j++){
+			exact = exactScores[j][i];
+			approx = approxScores[j][i];
+			if(isinf(exact) || isinf(approx)){
+				numMismatch += isinf(exact) != isinf(approx) ? 1 : 0;
+				continue;
+			}
+			error = fabs(exact - approx);
+			numCompared[j]++;
+			if(j == 0){
+				viterbiMean += error;
+				viterbiMax = max(viterbiMax, error);
+			}
+			else{
+				forwardMean += error;
+				forwardMax = max(forwardMax, error);
+			}
+		}
+	}
+
+	out << "bits=" << 8 * sizeof(T) << " scale=" << _scale << " sequences=" << exactScores[0].size() << " observations=" << numObservations;
+	out << " path_agreement=" << (exactScores[0].size() > 0 ? (double)numAgree / (double)exactScores[0].size() : 0.0);
+	out << " state_agreement=" << (numObservations > 0 ? (double)numStatesAgree / (double)numObservations : 0.0);
+	out << " viterbi_err_mean=" << (numCompared[0] > 0 ? viterbiMean / numCompared[0] : 0.0) << " viterbi_err_max=" << viterbiMax;
+	out << " forward_err_mean=" << (numCompared[1] > 0 ? forwardMean / numCompared[1] : 0.0) << " forward_err_max=" << forwardMax;
+	out << " impossible_mismatch=" << numMismatch;
+	out << " double_viterbi_s=" << seconds[0] << " quantized_viterbi_s=" << seconds[1];
+	out << " double_forward_s=" << seconds[2] << " quantized_forward_s=" << seconds[3];
+
+	return out.str();
+}
+
+template class QuantizedHmm<int16_t>;
+template class QuantizedHmm<int32_t>;
@@ -0,0 +1,79 @@
+#ifndef QUANTIZED_HMM_HPP
+#define QUANTIZED_HMM_HPP
+
+#include "Hmm.hpp"
+
+#include <cstdint>
+#include <map>
+
+using namespace std;
+
+/*
+A fixed-point copy of a DiscreteHmm for decoding and scoring, where double precision is not needed.
+
+Every log-probability p is stored as the integer round(p * Scale()) in T (int16_t or int32_t). Zero probabilities
+(-inf) are stored as a floor value, and all additions saturate at the floor, so -inf + x stays -inf. For int16_t the
+floor is the type's minimum; for int32_t it is INT32_MIN/4, so the sum of two values cannot overflow before it is
+clamped. The tables are a quarter (int16_t) or half (int32_t) the size of the double ones, and are contiguous
+row-major arrays: transitions by source state, emissions by symbol, as in _emissionsBySymbol.
+
+Lattice columns are renormalized at every step by subtracting their maximum, which is accumulated in a 64-bit
+offset, so long sequences do not run out of range. Values which fall to the floor relative to the best state of
+their column are treated as impossible; this is the main approximation besides the rounding of the parameters.
+
+Viterbi is max-plus, so it is exact integer arithmetic over the rounded parameters. On AVX2 the column kernel runs
+16 (int16_t) or 8 (int32_t) destination states per instruction; it is bit-identical to the scalar loop, including
+argmax ties. Forward() approximates log-sum-exp with a table of round(Scale() * ln(1 + exp(-d / Scale()))).
+
+Report() runs both engines over the same sequences and summarizes path agreement, score error and timing.
+*/
+template<typename T>
+class QuantizedHmm{
+	public:
+		QuantizedHmm();
+		~QuantizedHmm();
+		bool Build(DiscreteHmm& hmm, const double scale=0);
+		bool Write(const string& path);
+		bool Read(const string& path);
+		double Viterbi(const vector<int>& observations, vector<int>& output);
+		double Forward(const vector<int>& observations);
+		string Report(DiscreteHmm& hmm, const vector<vector<int> >& sequences);
+		void SetSimd(bool enable);
+		int NumStates();
+		int NumSymbols();
+		double Scale();
+		int GetSymbolId(const string& symbol);
+		const string& GetStateName(const int state);
+	private:
+		T _quantize(const double logProb);
+		inline T _add(const T a, const T b);
+		inline T _logAdd(const T a, const T b);
+		void _buildLogAddTable();
+		bool _renormalize(vector<T>& column, long long& offset);
+		void _viterbiColumn(const vector<T>& leftCol, vector<T>& rightCol, int* ptrCol, const int observation);
+#ifdef HMM_X86_SIMD
+		int _viterbiColumnSimd(const vector<T>& leftCol, vector<T>& rightCol, int* ptrCol, const int observation);
+#endif
+
+		int _numStates;
+		int _numSymbols;
+		double _scale;
+		T _floor;
+		vector<T> _pi;
+		//_transitions[k * _numStates + j] = a_kj
+		vector<T> _transitions;
+		//_emissions[o * _numStates + j] = b_j(o)
+		vector<T> _emissions;
+		//log-sum-exp correction terms, indexed by (difference >> _tableShift)
+		vector<T> _logAddTable;
+		int _tableShift;
+		long long _tableRound;
+		vector<string> _symbols;
+		vector<string> _states;
+		map<string,int> _symbolIds;
+		bool _useSimd;
+		//backpointers, reused between calls
+		vector<int> _ptrLattice;
+};
+
+#endif
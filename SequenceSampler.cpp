@@ -0,0 +1,509 @@
+#include "SequenceSampler.hpp"
+#include "Profiler.hpp"
+
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+SequenceSampler::SequenceSampler()
+{
+	_numStates = 0;
+	_numSymbols = 0;
+	_maxLineBytes = 0;
+	_emissionOffset = 0;
+	_slotted = false;
+	_fd = -1;
+	_nextWrite = 0;
+	_abort = false;
+	_bytesWritten = 0;
+	_seconds = 0;
+}
+
+SequenceSampler::~SequenceSampler()
+{}
+
+/*
+Builds the alias tables of a model, and the text of its labels. Returns false if @hmm has no model.
+*/
+bool SequenceSampler::Build(DiscreteHmm& hmm)
+{
+	int i;
+	vector<double> initial, transitions, emissions;
+
+	_numStates = hmm.NumStates();
+	_numSymbols = hmm.NumSymbols();
+	if(_numStates == 0 || _numSymbols == 0){
+		cout << "ERROR SequenceSampler::Build() requires a model" << endl;
+		_numStates = _numSymbols = 0;
+		return false;
+	}
+
+	initial.resize(_numStates);
+	transitions.resize(_numStates * _numStates);
+	emissions.resize(_numStates * _numSymbols);
+	hmm.CopyParameters(initial.data(), transitions.data(), emissions.data());
+
+	_emissionOffset = _numStates + _numStates * _numStates;
+	_thresholds.resize(_emissionOffset + _numStates * _numSymbols);
+	_aliases.resize(_thresholds.size());
+	_buildAliasTable(initial.data(), _numStates, 0);
+	for(i = 0; i < _numStates; i++){
+		_buildAliasTable(&transitions[i * _numStates], _numStates, _numStates * (1 + i));
+		_buildAliasTable(&emissions[i * _numSymbols], _numSymbols, _emissionOffset + _numSymbols * i);
+	}
+
+	_symbols.resize(_numSymbols);
+	_symbolLines.resize(_numSymbols);
+	_states.resize(_numStates);
+	_stateLines.resize(_numStates);
+	_maxLineBytes = 0;
+	for(i = 0; i < _numSymbols; i++){
+		_symbols[i] = hmm.GetSymbolName(i);
+		_symbolLines[i] = _symbols[i] + "\n";
+	}
+	for(i = 0; i < _numStates; i++){
+		_states[i] = hmm.GetStateName(i);
+		_stateLines[i] = "\t" + _states[i] + "\n";
+	}
+	for(i = 0; i < _numSymbols; i++){
+		_maxLineBytes = max(_maxLineBytes, (int)_symbolLines[i].size());
+	}
+	for(i = 0; i < _numStates; i++){
+		_maxLineBytes = max(_maxLineBytes, (int)_stateLines[i].size());
+	}
+	_maxLineBytes *= 2;
+
+	_slotted = _maxLineBytes <= 2 * lineSlot;
+	_symbolSlots.assign(_numSymbols * lineSlot, 0);
+	_stateSlots.assign(_numStates * lineSlot, 0);
+	for(i = 0; _slotted && i < _numSymbols; i++){
+		memcpy(&_symbolSlots[i * lineSlot], _symbolLines[i].data(), _symbolLines[i].size());
+	}
+	for(i = 0; _slotted && i < _numStates; i++){
+		memcpy(&_stateSlots[i * lineSlot], _stateLines[i].data(), _stateLines[i].size());
+	}
+
+	return true;
+}
+
+/*
+Vose's method: builds the alias table at @offset for the distribution of @n ln-probabilities @logProbs.
+Columns are scaled so the mean is one; each column under one is paired with a column over one, which gives it
+the difference as its alias. A distribution which sums to zero is drawn uniformly.
+*/
+void SequenceSampler::_buildAliasTable(const double* logProbs, const int n, const int offset)
+{
+	int i, small, large;
+	double sum;
+	vector<double> scaled(n);
+	vector<int> smallColumns, largeColumns;
+
+	sum = 0;
+	for(i = 0; i < n; i++){
+		scaled[i] = exp(logProbs[i]);
+		sum += scaled[i];
+	}
+	for(i = 0; i < n; i++){
+		scaled[i] = sum > 0 ? scaled[i] * n / sum : 1.0;
+		if(scaled[i] < 1.0){
+			smallColumns.push_back(i);
+		}
+		else{
+			largeColumns.push_back(i);
+		}
+	}
+
+	while(!smallColumns.empty() && !largeColumns.empty()){
+		small = smallColumns.back();
+		smallColumns.pop_back();
+		large = largeColumns.back();
+		largeColumns.pop_back();
+		_thresholds[offset + small] = (uint64_t)(scaled[small] * 4294967296.0);
+		_aliases[offset + small] = large;
+		scaled[large] = (scaled[large] + scaled[small]) - 1.0;
+		if(scaled[large] < 1.0){
+			smallColumns.push_back(large);
+		}
+		else{
+			largeColumns.push_back(large);
+		}
+	}
+	//what is left is one, up to rounding
+	for(i = 0; i < smallColumns.size(); i++){
+		_thresholds[offset + smallColumns[i]] = 1ULL << 32;
+		_aliases[offset + smallColumns[i]] = smallColumns[i];
+	}
+	for(i = 0; i < largeColumns.size(); i++){
+		_thresholds[offset + largeColumns[i]] = 1ULL << 32;
+		_aliases[offset + largeColumns[i]] = largeColumns[i];
+	}
+}
+
+/*
+The splitmix64 output function.
+*/
+inline uint64_t SequenceSampler::_mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return z ^ (z >> 31);
+}
+
+/*
+Draws from the alias table at @offset over @n columns with the random number @r. The high 32 bits pick the
+column, and the low 32 bits decide between it and its alias. The choice is random, so it is made with a mask
+rather than a branch, which would be mispredicted about as often as the alias is taken.
+*/
+inline int SequenceSampler::_draw(const int offset, const int n, const uint64_t r)
+{
+	int column, keep;
+
+	column = (int)(((r >> 32) * (uint64_t)n) >> 32);
+	keep = -(int)((r & 0xffffffffULL) < _thresholds[offset + column]);
+
+	return (column & keep) | (_aliases[offset + column] & ~keep);
+}
+
+/*
+Draws the next @count observations of a sequence into @symbols and @states, from the splitmix64 stream @rng,
+continuing the chain from @state, or from pi if @state is negative. On exit @state is the last state drawn.
+
+Each state depends on the one before it, so the loop is bound by the latency of a draw. The random numbers do not
+depend on the chain, so they are generated ahead in batches, which leaves only the table lookups on its path.
+*/
+void SequenceSampler::_drawBlock(uint64_t& rng, int& state, const int count, int* symbols, int* states)
+{
+	int i, j, n, current;
+	const int numStates = _numStates, numSymbols = _numSymbols, emissionOffset = _emissionOffset;
+	uint64_t randoms[512];
+
+	//the chain is kept in locals: through the references, every step would reload it from memory
+	current = state;
+	for(i = 0; i < count; i += 256){
+		n = min(256, count - i);
+		for(j = 0; j < 2 * n; j++){
+			rng += 0x9e3779b97f4a7c15ULL;
+			randoms[j] = _mix(rng);
+		}
+		for(j = 0; j < n; j++){
+			current = _draw(current < 0 ? 0 : numStates * (1 + current), numStates, randoms[2 * j]);
+			states[i + j] = current;
+			symbols[i + j] = _draw(emissionOffset + numSymbols * current, numSymbols, randoms[2 * j + 1]);
+		}
+	}
+	state = current;
+}
+
+/*
+The initial state of the stream of sequence @index under @seed: a hash of both, so that streams start at
+unrelated points of the 2^64 period.
+*/
+uint64_t SequenceSampler::_streamSeed(const uint64_t seed, const uint64_t index)
+{
+	return _mix(_mix(seed + 0x9e3779b97f4a7c15ULL) + index);
+}
+
+/*
+Draws sequence @index of the seed @seed, of @length observations: the same one Generate() writes.
+*/
+void SequenceSampler::Sample(const uint64_t seed, const uint64_t index, const int length, vector<int>& symbols, vector<int>& states)
+{
+	int state = -1;
+	uint64_t rng = _streamSeed(seed, index);
+
+	symbols.resize(length);
+	states.resize(length);
+	if(_numStates > 0 && length > 0){
+		_drawBlock(rng, state, length, symbols.data(), states.data());
+	}
+}
+
+/*
+Writes @numSequences sequences of @length observations, drawn with @seed, to @path ("-" is stdout) in @format,
+using @numThreads threads to draw and format them. Returns false if the model is missing or the output could not
+be written.
+*/
+bool SequenceSampler::Generate(const string& path, const SampleFormat format, const uint64_t numSequences, const int length, const uint64_t seed, const int numThreads)
+{
+	int i;
+	bool ok;
+	uint64_t numBlocks;
+	Block* block;
+	vector<thread> workers;
+	chrono::steady_clock::time_point start;
+
+	if(_numStates == 0){
+		cout << "ERROR SequenceSampler::Generate() requires a model; see Build()" << endl;
+		return false;
+	}
+	if(length <= 0){
+		cout << "ERROR sequence length must be positive: " << length << endl;
+		return false;
+	}
+
+	if(path == "-"){
+		_fd = STDOUT_FILENO;
+	}
+	else{
+		_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(_fd < 0){
+			cout << "ERROR could not open output file: " << path << endl;
+			return false;
+		}
+	}
+
+	start = chrono::steady_clock::now();
+	_format = format;
+	_numSequences = numSequences;
+	_length = length;
+	_seed = seed;
+	_blockLength = 1 << 16;
+	if(length >= _blockLength){
+		_sequencesPerGroup = 1;
+		_blocksPerGroup = (length + _blockLength - 1) / _blockLength;
+	}
+	else{
+		_sequencesPerGroup = _blockLength / length;
+		_blocksPerGroup = 1;
+	}
+	_window = 4 * (numThreads > 0 ? numThreads : 1);
+	_nextGroup = 0;
+	_nextWrite = 0;
+	_abort = false;
+	_bytesWritten = 0;
+
+	ok = true;
+	if(_format == SAMPLE_BINARY){
+		string header = DatasetReader::BinaryHeader(_symbols);
+		ok = _writeAll(header.data(), header.size());
+	}
+
+	if(ok){
+		for(i = 0; i < (numThreads > 0 ? numThreads : 1); i++){
+			workers.push_back(thread(&SequenceSampler::_workerLoop, this));
+		}
+	}
+
+	//write the blocks in file order as they complete
+	numBlocks = (_numSequences + _sequencesPerGroup - 1) / _sequencesPerGroup * _blocksPerGroup;
+	while(ok && _nextWrite < numBlocks){
+		unique_lock<mutex> guard(_lock);
+		while(_completed.count(_nextWrite) == 0){
+			_blockCompleted.wait(guard);
+		}
+		block = _completed[_nextWrite];
+		_completed.erase(_nextWrite);
+		guard.unlock();
+
+		ok = _writeAll(block->bytes.data(), block->bytes.size());
+		delete block;
+
+		guard.lock();
+		_nextWrite++;
+		guard.unlock();
+		_blockWritten.notify_all();
+	}
+
+	if(!ok){
+		lock_guard<mutex> guard(_lock);
+		_abort = true;
+	}
+	_blockWritten.notify_all();
+	for(i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+	for(map<uint64_t,Block*>::iterator it = _completed.begin(); it != _completed.end(); ++it){
+		delete it->second;
+	}
+	_completed.clear();
+
+	if(_fd != STDOUT_FILENO && close(_fd) != 0){
+		cout << "ERROR could not close output file: " << path << endl;
+		ok = false;
+	}
+	_fd = -1;
+	_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	return ok;
+}
+
+/*
+Takes groups of sequences in order, and draws and formats each of them block by block, waiting whenever a block
+would be more than the window ahead of the writer. A group is either one sequence of one or more blocks, or
+several sequences that together fill one block.
+*/
+void SequenceSampler::_workerLoop()
+{
+	int b, count, state;
+	uint64_t group, sequence, lastSequence, block, rng;
+	vector<int> symbols(_blockLength), states(_blockLength);
+	Block* output;
+
+	while(true){
+		group = _nextGroup++;
+		sequence = group * _sequencesPerGroup;
+		if(sequence >= _numSequences){
+			return;
+		}
+		lastSequence = min(sequence + _sequencesPerGroup, _numSequences);
+
+		for(b = 0; b < _blocksPerGroup; b++){
+			block = group * _blocksPerGroup + b;
+			{
+				unique_lock<mutex> guard(_lock);
+				while(block >= _nextWrite + _window && !_abort){
+					_blockWritten.wait(guard);
+				}
+				if(_abort){
+					return;
+				}
+			}
+
+			output = new Block();
+			if(_blocksPerGroup == 1){
+				for(; sequence < lastSequence; sequence++){
+					rng = _streamSeed(_seed, sequence);
+					state = -1;
+					_drawBlock(rng, state, _length, symbols.data(), states.data());
+					_formatBlock(true, true, symbols.data(), states.data(), _length, *output);
+				}
+			}
+			else{
+				if(b == 0){
+					rng = _streamSeed(_seed, sequence);
+					state = -1;
+				}
+				count = min(_blockLength, _length - b * _blockLength);
+				_drawBlock(rng, state, count, symbols.data(), states.data());
+				_formatBlock(b == 0, b == _blocksPerGroup - 1, symbols.data(), states.data(), count, *output);
+			}
+
+			{
+				lock_guard<mutex> guard(_lock);
+				_completed[block] = output;
+			}
+			_blockCompleted.notify_one();
+		}
+	}
+}
+
+/*
+Appends @count symbols (and @states) of a sequence to @output, in the Generate() format. The @first block of a
+binary sequence starts with its length; the @last block of a text sequence ends with a blank line.
+*/
+void SequenceSampler::_formatBlock(const bool first, const bool last, const int* symbols, const int* states, const int count, Block& output)
+{
+	PROFILE_SCOPE("SequenceSampler.FormatBlock");
+	int i, idBytes;
+	size_t start;
+	uint32_t length;
+	uint16_t id16;
+	char* out;
+
+	start = output.bytes.size();
+	if(_format == SAMPLE_BINARY){
+		idBytes = DatasetReader::BinaryIdBytes(_numSymbols);
+		output.bytes.resize(start + (first ? sizeof(length) : 0) + (size_t)count * idBytes);
+		out = output.bytes.data() + start;
+		if(first){
+			length = _length;
+			memcpy(out, &length, sizeof(length));
+			out += sizeof(length);
+		}
+		if(idBytes == 2){
+			for(i = 0; i < count; i++){
+				id16 = symbols[i];
+				memcpy(out + i * sizeof(id16), &id16, sizeof(id16));
+			}
+		}
+		else{
+			memcpy(out, symbols, (size_t)count * sizeof(int));
+		}
+		return;
+	}
+
+	//room for the longest lines, the blank line, and the overrun of the last fixed-size move
+	output.bytes.resize(start + (size_t)count * _maxLineBytes + 1 + 2 * lineSlot);
+	out = output.bytes.data() + start;
+	if(_slotted){
+		const char* symbolSlots = _symbolSlots.data();
+		const char* stateSlots = _stateSlots.data();
+		for(i = 0; i < count; i++){
+			//the symbol's newline is overwritten by the state label
+			if(_format == SAMPLE_LABELED_TEXT){
+				memcpy(out, symbolSlots + symbols[i] * lineSlot, lineSlot);
+				out += _symbols[ symbols[i] ].size();
+				memcpy(out, stateSlots + states[i] * lineSlot, lineSlot);
+				out += _stateLines[ states[i] ].size();
+			}
+			else{
+				memcpy(out, symbolSlots + symbols[i] * lineSlot, lineSlot);
+				out += _symbolLines[ symbols[i] ].size();
+			}
+		}
+	}
+	else{
+		for(i = 0; i < count; i++){
+			if(_format == SAMPLE_LABELED_TEXT){
+				const string& symbol = _symbols[ symbols[i] ];
+				const string& state = _stateLines[ states[i] ];
+				memcpy(out, symbol.data(), symbol.size());
+				out += symbol.size();
+				memcpy(out, state.data(), state.size());
+				out += state.size();
+			}
+			else{
+				const string& line = _symbolLines[ symbols[i] ];
+				memcpy(out, line.data(), line.size());
+				out += line.size();
+			}
+		}
+	}
+	if(last){
+		*out++ = '\n';
+	}
+	output.bytes.resize(out - output.bytes.data());
+}
+
+/*
+Writes @numBytes to the output, through partial writes and interruptions.
+*/
+bool SequenceSampler::_writeAll(const char* data, size_t numBytes)
+{
+	ssize_t written;
+
+	while(numBytes > 0){
+		written = write(_fd, data, numBytes);
+		if(written < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			cout << "ERROR could not write generated sequences: " << strerror(errno) << endl;
+			return false;
+		}
+		data += written;
+		numBytes -= written;
+		_bytesWritten += written;
+	}
+
+	return true;
+}
+
+/*
+Returns the size and rate of the last Generate().
+*/
+string SequenceSampler::StatsString()
+{
+	ostringstream stats;
+
+	stats << "Generated " << _numSequences << " sequences of " << _length << " observations, " << _bytesWritten << " bytes in " << _seconds << " s";
+	if(_seconds > 0){
+		stats << " (" << (_bytesWritten / _seconds / 1E6) << " MB/s, " << (_numSequences * _length / _seconds / 1E6) << "M observations/s)";
+	}
+
+	return stats.str();
+}
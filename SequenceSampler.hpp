@@ -0,0 +1,98 @@
+#ifndef SEQUENCE_SAMPLER_HPP
+#define SEQUENCE_SAMPLER_HPP
+
+#include "Hmm.hpp"
+
+#include <map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+using namespace std;
+
+//output formats of SequenceSampler::Generate()
+enum SampleFormat { SAMPLE_TEXT, SAMPLE_LABELED_TEXT, SAMPLE_BINARY };
+
+/*
+Draws synthetic observation sequences, and their hidden states, from a DiscreteHmm, for benchmarks and tests.
+
+pi and every row of A and B become a Walker alias table (built with Vose's method): a column picked uniformly at
+random is kept with its threshold probability, and otherwise replaced by its alias, so each draw costs one 64-bit
+random number whatever the number of states or symbols. Sequence i is drawn from its own splitmix64 stream,
+seeded from (seed, i), so a seed gives the same sequences for any number of threads.
+
+Generate() writes many sequences to a file (or stdout) in any of the formats the readers take:
+	-SAMPLE_TEXT: one symbol per line, a blank line after each sequence (see DatasetReader)
+	-SAMPLE_LABELED_TEXT: <symbol>\t<state> lines, as for DiscreteHmmDataset::BuildLabeledDataset(), a blank line
+	 after each sequence, which the labelled readers treat as the end of a sequence
+	-SAMPLE_BINARY: the binary dataset format of DatasetReader::WriteBinary()
+Sequences are drawn in blocks of observations on worker threads and written in order by the calling thread,
+through a bounded reorder window, so memory does not grow with the output. Consecutive blocks of a sequence
+depend on each other, so one long sequence is drawn by a single thread; parallelism is across sequences.
+*/
+class SequenceSampler{
+	public:
+		SequenceSampler();
+		~SequenceSampler();
+		bool Build(DiscreteHmm& hmm);
+		void Sample(const uint64_t seed, const uint64_t index, const int length, vector<int>& symbols, vector<int>& states);
+		bool Generate(const string& path, const SampleFormat format, const uint64_t numSequences, const int length, const uint64_t seed, const int numThreads=4);
+		string StatsString();
+	private:
+		struct Block{
+			vector<char> bytes;
+		};
+		void _buildAliasTable(const double* logProbs, const int n, const int offset);
+		inline int _draw(const int offset, const int n, const uint64_t r);
+		void _drawBlock(uint64_t& rng, int& state, const int count, int* symbols, int* states);
+		static inline uint64_t _mix(uint64_t z);
+		static uint64_t _streamSeed(const uint64_t seed, const uint64_t index);
+		void _workerLoop();
+		void _formatBlock(const bool first, const bool last, const int* symbols, const int* states, const int count, Block& output);
+		bool _writeAll(const char* data, size_t numBytes);
+
+		int _numStates;
+		int _numSymbols;
+		vector<string> _symbols;
+		vector<string> _states;
+		//the text of each symbol ("<symbol>\n") and state label ("\t<state>\n"), and the longest labelled line
+		vector<string> _symbolLines;
+		vector<string> _stateLines;
+		int _maxLineBytes;
+		//if every line fits in a slot of lineSlot bytes, the same text padded to slots, so lines copy in fixed-size moves
+		static const int lineSlot = 16;
+		bool _slotted;
+		vector<char> _symbolSlots;
+		vector<char> _stateSlots;
+		//alias tables: pi at 0, row i of A at _numStates * (1 + i), row i of B at _emissionOffset + _numSymbols * i.
+		//a column is kept if the low 32 bits of the draw are below its threshold (1 << 32 keeps it always)
+		vector<uint64_t> _thresholds;
+		vector<int> _aliases;
+		int _emissionOffset;
+
+		//Generate() state: sequences are taken in groups, several short ones or one long one, and drawn in blocks,
+		//which are numbered in file order
+		SampleFormat _format;
+		uint64_t _numSequences;
+		int _length;
+		uint64_t _seed;
+		int _blockLength;
+		uint64_t _sequencesPerGroup;
+		int _blocksPerGroup;
+		uint64_t _window;
+		int _fd;
+		atomic<uint64_t> _nextGroup;
+		mutex _lock;
+		condition_variable _blockCompleted;
+		condition_variable _blockWritten;
+		map<uint64_t,Block*> _completed;
+		uint64_t _nextWrite;
+		bool _abort;
+
+		uint64_t _bytesWritten;
+		double _seconds;
+};
+
+#endif
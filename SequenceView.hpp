@@ -0,0 +1,38 @@
+#ifndef SEQUENCE_VIEW_HPP
+#define SEQUENCE_VIEW_HPP
+
+using namespace std;
+
+/*
+A read-only view of a contiguous array of int observations owned by someone else, such as a Python buffer (see
+pyhmm.cpp). Like PackedSequence it mimics the read interface of vector<int> (operator[] and size()), so the HMM
+algorithms can be instantiated over it and run on the caller's memory without copying it into a vector.
+
+The array must outlive the view, and must not change while an algorithm is reading it.
+*/
+class SequenceView{
+	public:
+		SequenceView()
+		{
+			_data = 0;
+			_size = 0;
+		}
+		SequenceView(const int* data, const int size)
+		{
+			_data = data;
+			_size = size;
+		}
+		inline int operator[](const int i) const
+		{
+			return _data[i];
+		}
+		inline int size() const
+		{
+			return _size;
+		}
+	private:
+		const int* _data;
+		int _size;
+};
+
+#endif
@@ -0,0 +1,361 @@
+#include "ShardedCounter.hpp"
+#include "Profiler.hpp"
+
+ShardedCounter::ShardedCounter(const int numThreads, const int chunkBytes)
+{
+	_numThreads = numThreads > 0 ? numThreads : 1;
+	_chunkBytes = chunkBytes > 0 ? chunkBytes : (1 << 20);
+	_done = false;
+	_inFlight = 0;
+	_nextMerge = 0;
+	_lastState = -1;
+	_numInstances = 0;
+}
+
+ShardedCounter::~ShardedCounter()
+{}
+
+/*
+Returns the number of labeled examples counted by the last call to CountFile().
+*/
+unsigned long long ShardedCounter::NumInstances()
+{
+	return _numInstances;
+}
+
+/*
+Counts a labeled dataset file.
+
+@labels: receives the state and symbol labels, in the same id order BuildLabeledDataset() would assign.
+Any labels already present are kept, and new ones appended after them.
+@counts: on exit, the initial state, transition and emission counts, indexed by the ids in @labels.
+Blank lines separate sequences, each of which gives an initial state count for its first state.
+
+Returns false if the file could not be read.
+*/
+bool ShardedCounter::CountFile(const string& path, DiscreteHmmDataset& labels, HmmCounts& counts)
+{
+	int i;
+	size_t lastNewline;
+	string carry;
+	vector<char> buffer(_chunkBytes);
+	vector<thread> workers;
+	Chunk* chunk;
+	ifstream file;
+
+	file.open(path.c_str(), ios::in | ios::binary);
+	if(!file.is_open()){
+		cout << "ERROR could not open dataset file: " << path << endl;
+		return false;
+	}
+
+	_initial.clear();
+	_transitions.clear();
+	_emissions.clear();
+	_lastState = -1;
+	_numInstances = 0;
+	_done = false;
+	_inFlight = 0;
+	_nextMerge = 0;
+
+	for(i = 0; i < _numThreads; i++){
+		workers.push_back(thread(&ShardedCounter::_workerLoop, this));
+	}
+
+	cout << "Counting " << path << " in chunks of " << _chunkBytes << " bytes on " << _numThreads << " threads..." << endl;
+	for(i = 0; ; i++){
+		chunk = new Chunk();
+		chunk->index = i;
+		chunk->text.swap(carry);
+		carry.clear();
+
+		//read until the chunk ends with a whole line, or the file ends
+		lastNewline = string::npos;
+		while(file && (chunk->text.size() < _chunkBytes || lastNewline == string::npos)){
+			file.read(buffer.data(), buffer.size());
+			chunk->text.append(buffer.data(), file.gcount());
+			lastNewline = chunk->text.rfind('\n');
+		}
+		if(file && lastNewline != string::npos){
+			carry = chunk->text.substr(lastNewline + 1);
+			chunk->text.resize(lastNewline + 1);
+		}
+		if(chunk->text.size() == 0){
+			delete chunk;
+			break;
+		}
+
+		//hand the chunk to the workers, merging finished chunks while waiting for room
+		unique_lock<mutex> guard(_lock);
+		while(_inFlight >= 2 * _numThreads){
+			if(_completed.count(_nextMerge) > 0){
+				guard.unlock();
+				_mergeReady(labels);
+				guard.lock();
+			}
+			else{
+				_chunkCompleted.wait(guard);
+			}
+		}
+		_pending.push_back(chunk);
+		_inFlight++;
+		guard.unlock();
+		_workAvailable.notify_one();
+
+		_mergeReady(labels);
+	}
+
+	//drain the remaining chunks
+	{
+		unique_lock<mutex> guard(_lock);
+		_done = true;
+		_workAvailable.notify_all();
+		while(_inFlight > 0){
+			if(_completed.count(_nextMerge) > 0){
+				guard.unlock();
+				_mergeReady(labels);
+				guard.lock();
+			}
+			else{
+				_chunkCompleted.wait(guard);
+			}
+		}
+	}
+	for(i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+
+	//pad the tables out to the full label set
+	_initial.resize(labels.NumStates(), 0);
+	_transitions.resize(labels.NumStates());
+	_emissions.resize(labels.NumStates());
+	for(i = 0; i < labels.NumStates(); i++){
+		_transitions[i].resize(labels.NumStates(), 0);
+		_emissions[i].resize(labels.NumSymbols(), 0);
+	}
+	counts.Clear();
+	counts.Initial.swap(_initial);
+	counts.Transitions.swap(_transitions);
+	counts.Emissions.swap(_emissions);
+	_initial.clear();
+	_transitions.clear();
+	_emissions.clear();
+
+	cout << "Counted " << _numInstances << " labelled examples. Dataset has num symbols/states: " << labels.NumSymbols() << "/" << labels.NumStates() << endl;
+
+	return true;
+}
+
+void ShardedCounter::_workerLoop()
+{
+	Chunk* chunk;
+
+	while(true){
+		{
+			unique_lock<mutex> guard(_lock);
+			while(_pending.empty() && !_done){
+				_workAvailable.wait(guard);
+			}
+			if(_pending.empty()){
+				return;
+			}
+			chunk = _pending.front();
+			_pending.pop_front();
+		}
+
+		_countChunk(*chunk);
+
+		{
+			lock_guard<mutex> guard(_lock);
+			_completed[chunk->index] = chunk;
+		}
+		_chunkCompleted.notify_all();
+	}
+}
+
+/*
+Parses a chunk of lines into chunk-local ids and counts them. The first example of the chunk is only
+recorded, since its incoming transition (or initial state count) and its emission are counted when the
+chunk is merged. An example after a blank line starts a new sequence, so counts as an initial state.
+*/
+void ShardedCounter::_countChunk(Chunk& chunk)
+{
+	PROFILE_SCOPE("ShardedCounter.CountChunk");
+	int i, tabIndex, stateId, symbolId;
+	size_t start, end;
+	string line, state, symbol;
+	map<string,int>::iterator it;
+
+	chunk.firstState = chunk.firstSymbol = chunk.lastState = -1;
+	chunk.breakBeforeFirst = false;
+	chunk.numInstances = 0;
+
+	for(start = 0; start < chunk.text.size(); start = end + 1){
+		end = chunk.text.find('\n', start);
+		if(end == string::npos){
+			end = chunk.text.size();
+		}
+		line = chunk.text.substr(start, end - start);
+		if(line.empty()){
+			//the end of a sequence: no transition into the next example
+			if(chunk.numInstances == 0){
+				chunk.breakBeforeFirst = true;
+			}
+			chunk.lastState = -1;
+			continue;
+		}
+
+		tabIndex = line.find("\t");
+		if(tabIndex <= 0){
+			cout << "ERROR tabIndex not found in chunk " << chunk.index << " for line: " << line << endl;
+			continue;
+		}
+		symbol = line.substr(0,tabIndex);
+		state = line.substr(tabIndex+1, line.length()-tabIndex);
+
+		//map the labels to chunk-local ids, growing the local tables for new ones
+		it = chunk.stateIds.find(state);
+		if(it == chunk.stateIds.end()){
+			stateId = chunk.states.size();
+			chunk.stateIds[state] = stateId;
+			chunk.states.push_back(state);
+			chunk.initial.resize(chunk.states.size(), 0);
+			chunk.transitions.resize(chunk.states.size());
+			chunk.emissions.resize(chunk.states.size());
+			for(i = 0; i < chunk.states.size(); i++){
+				chunk.transitions[i].resize(chunk.states.size(), 0);
+				chunk.emissions[i].resize(chunk.symbols.size(), 0);
+			}
+		}
+		else{
+			stateId = it->second;
+		}
+		it = chunk.symbolIds.find(symbol);
+		if(it == chunk.symbolIds.end()){
+			symbolId = chunk.symbols.size();
+			chunk.symbolIds[symbol] = symbolId;
+			chunk.symbols.push_back(symbol);
+			for(i = 0; i < chunk.states.size(); i++){
+				chunk.emissions[i].resize(chunk.symbols.size(), 0);
+			}
+		}
+		else{
+			symbolId = it->second;
+		}
+
+		if(chunk.numInstances == 0){
+			chunk.firstState = stateId;
+			chunk.firstSymbol = symbolId;
+		}
+		else{
+			if(chunk.lastState >= 0){
+				chunk.transitions[chunk.lastState][stateId]++;
+			}
+			else{
+				chunk.initial[stateId]++;
+			}
+			chunk.emissions[stateId][symbolId]++;
+		}
+		chunk.lastState = stateId;
+		chunk.numInstances++;
+	}
+
+	//the text is no longer needed, and is the bulk of the chunk's memory
+	string().swap(chunk.text);
+}
+
+/*
+Merges all completed chunks that are next in file order.
+*/
+void ShardedCounter::_mergeReady(DiscreteHmmDataset& labels)
+{
+	Chunk* chunk;
+	map<int,Chunk*>::iterator it;
+
+	while(true){
+		{
+			lock_guard<mutex> guard(_lock);
+			it = _completed.find(_nextMerge);
+			if(it == _completed.end()){
+				return;
+			}
+			chunk = it->second;
+			_completed.erase(it);
+		}
+
+		_mergeChunk(*chunk, labels);
+		delete chunk;
+
+		{
+			lock_guard<mutex> guard(_lock);
+			_nextMerge++;
+			_inFlight--;
+		}
+		_chunkCompleted.notify_all();
+	}
+}
+
+/*
+Adds a chunk's counts into the global tables, translating chunk-local ids to global ids.
+Labels are added in chunk-local id order, which is first-seen order, so global ids are assigned
+in the order the labels first appear in the file.
+*/
+void ShardedCounter::_mergeChunk(Chunk& chunk, DiscreteHmmDataset& labels)
+{
+	PROFILE_SCOPE("ShardedCounter.MergeChunk");
+	int i, j;
+	vector<int> stateMap, symbolMap;
+
+	if(chunk.numInstances == 0){
+		//a chunk of blank lines still ends the current sequence
+		if(chunk.breakBeforeFirst){
+			_lastState = -1;
+		}
+		return;
+	}
+
+	stateMap.resize(chunk.states.size());
+	for(i = 0; i < chunk.states.size(); i++){
+		stateMap[i] = labels.AddState(chunk.states[i]);
+	}
+	symbolMap.resize(chunk.symbols.size());
+	for(i = 0; i < chunk.symbols.size(); i++){
+		symbolMap[i] = labels.AddSymbol(chunk.symbols[i]);
+	}
+
+	if(_transitions.size() < labels.NumStates()){
+		_initial.resize(labels.NumStates(), 0);
+		_transitions.resize(labels.NumStates());
+		_emissions.resize(labels.NumStates());
+	}
+	for(i = 0; i < _transitions.size(); i++){
+		if(_transitions[i].size() < labels.NumStates()){
+			_transitions[i].resize(labels.NumStates(), 0);
+		}
+		if(_emissions[i].size() < labels.NumSymbols()){
+			_emissions[i].resize(labels.NumSymbols(), 0);
+		}
+	}
+
+	for(i = 0; i < chunk.states.size(); i++){
+		_initial[ stateMap[i] ] += chunk.initial[i];
+		for(j = 0; j < chunk.states.size(); j++){
+			_transitions[ stateMap[i] ][ stateMap[j] ] += chunk.transitions[i][j];
+		}
+		for(j = 0; j < chunk.symbols.size(); j++){
+			_emissions[ stateMap[i] ][ symbolMap[j] ] += chunk.emissions[i][j];
+		}
+	}
+
+	//the first example of the chunk: its emission, and the transition spanning the chunk boundary, or its
+	//initial state count if it starts a sequence
+	_emissions[ stateMap[chunk.firstState] ][ symbolMap[chunk.firstSymbol] ]++;
+	if(_lastState >= 0 && !chunk.breakBeforeFirst){
+		_transitions[_lastState][ stateMap[chunk.firstState] ]++;
+	}
+	else{
+		_initial[ stateMap[chunk.firstState] ]++;
+	}
+	_lastState = chunk.lastState >= 0 ? stateMap[chunk.lastState] : -1;
+	_numInstances += chunk.numInstances;
+}
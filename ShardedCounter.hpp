@@ -0,0 +1,79 @@
+#ifndef SHARDED_COUNTER_HPP
+#define SHARDED_COUNTER_HPP
+
+#include "DiscreteHmmDataset.hpp"
+#include "HmmCounts.hpp"
+
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/*
+Counts the state transitions and emissions of a labeled dataset file (<emissionSymbol>\t<stateSymbol> lines,
+see DiscreteHmmDataset) without ever materializing the sequence in memory.
+
+The file is read in chunks of whole lines. Each chunk is parsed and counted by one of several worker threads,
+into private count tables indexed by chunk-local ids. Completed chunks are merged into the global tables in
+file order, which assigns global ids in first-seen order, exactly as DiscreteHmmDataset::BuildLabeledDataset()
+would. The transition spanning each chunk boundary (last state of one chunk to the first state of the next)
+is counted during the merge, unless a blank line, which ends a sequence, separates them.
+
+Memory is bounded by the number of chunks in flight (2 per thread) and the size of the count tables,
+independent of the size of the file.
+*/
+class ShardedCounter{
+	public:
+		ShardedCounter(const int numThreads, const int chunkBytes);
+		~ShardedCounter();
+		bool CountFile(const string& path, DiscreteHmmDataset& labels, HmmCounts& counts);
+		unsigned long long NumInstances();
+	private:
+		struct Chunk{
+			int index;
+			string text;
+			//chunk-local label tables, in first-seen order
+			map<string,int> stateIds;
+			map<string,int> symbolIds;
+			vector<string> states;
+			vector<string> symbols;
+			//chunk-local counts
+			vector<double> initial;
+			vector<vector<double> > transitions;
+			vector<vector<double> > emissions;
+			int firstState;
+			int firstSymbol;
+			//the state of the last example, or -1 if a blank line follows it
+			int lastState;
+			//whether a blank line precedes the first example
+			bool breakBeforeFirst;
+			unsigned long long numInstances;
+		};
+		void _workerLoop();
+		void _countChunk(Chunk& chunk);
+		void _mergeChunk(Chunk& chunk, DiscreteHmmDataset& labels);
+		void _mergeReady(DiscreteHmmDataset& labels);
+
+		int _numThreads;
+		int _chunkBytes;
+		bool _done;
+		deque<Chunk*> _pending;
+		map<int,Chunk*> _completed;
+		int _inFlight;
+		int _nextMerge;
+		mutex _lock;
+		condition_variable _workAvailable;
+		condition_variable _chunkCompleted;
+
+		//global tables, indexed by the ids in the labels dataset
+		vector<double> _initial;
+		vector<vector<double> > _transitions;
+		vector<vector<double> > _emissions;
+		int _lastState;
+		unsigned long long _numInstances;
+};
+
+#endif
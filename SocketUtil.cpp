@@ -0,0 +1,186 @@
+#include "SocketUtil.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+An address is TCP if it has the form host:port; anything else is a Unix socket path.
+*/
+bool IsTcpAddress(const string& address)
+{
+	size_t colon = address.rfind(':');
+
+	if(colon == string::npos || colon == address.size() - 1 || address.find('/') != string::npos){
+		return false;
+	}
+	for(size_t i = colon + 1; i < address.size(); i++){
+		if(address[i] < '0' || address[i] > '9'){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+Resolves a host:port address. Returns NULL on failure; the result must be freed with freeaddrinfo().
+*/
+static struct addrinfo* resolveTcp(const string& address, bool passive)
+{
+	int result;
+	string host, port;
+	struct addrinfo hints, *info;
+	size_t colon = address.rfind(':');
+
+	host = address.substr(0, colon);
+	port = address.substr(colon + 1);
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if(passive){
+		hints.ai_flags = AI_PASSIVE;
+	}
+
+	result = getaddrinfo(host.size() > 0 ? host.c_str() : NULL, port.c_str(), &hints, &info);
+	if(result != 0){
+		cout << "ERROR could not resolve " << address << ": " << gai_strerror(result) << endl;
+		return NULL;
+	}
+
+	return info;
+}
+
+/*
+Creates a listening socket on @address. For Unix sockets, any stale socket file is removed first.
+Returns the socket descriptor, or -1 on failure.
+*/
+int ListenSocket(const string& address, const int backlog)
+{
+	int fd, on = 1;
+	struct sockaddr_un addr;
+
+	if(IsTcpAddress(address)){
+		struct addrinfo* info = resolveTcp(address, true);
+		if(info == NULL){
+			return -1;
+		}
+		fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+		if(fd >= 0){
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			if(bind(fd, info->ai_addr, info->ai_addrlen) < 0 || listen(fd, backlog) < 0){
+				close(fd);
+				fd = -1;
+			}
+		}
+		freeaddrinfo(info);
+	}
+	else{
+		if(address.size() >= sizeof(addr.sun_path)){
+			cout << "ERROR socket path too long: " << address << endl;
+			return -1;
+		}
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+		unlink(address.c_str());
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(fd >= 0 && (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0)){
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	if(fd < 0){
+		cout << "ERROR could not listen on " << address << ": " << strerror(errno) << endl;
+	}
+
+	return fd;
+}
+
+/*
+Connects to a listening socket at @address. Returns the socket descriptor, or -1 on failure.
+*/
+int ConnectSocket(const string& address)
+{
+	int fd;
+	struct sockaddr_un addr;
+
+	if(IsTcpAddress(address)){
+		struct addrinfo* info = resolveTcp(address, false);
+		if(info == NULL){
+			return -1;
+		}
+		fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+		if(fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) < 0){
+			close(fd);
+			fd = -1;
+		}
+		freeaddrinfo(info);
+	}
+	else{
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	return fd;
+}
+
+/*
+Writes all of @data, retrying partial writes. Never raises SIGPIPE; a closed peer is just a failure.
+*/
+bool WriteAll(const int fd, const string& data)
+{
+	int n;
+	size_t written = 0;
+
+	while(written < data.size()){
+		n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR){
+			continue;
+		}
+		if(n <= 0){
+			return false;
+		}
+		written += n;
+	}
+
+	return true;
+}
+
+/*
+Reads one newline-terminated line (without the newline) into @line. Bytes read past the newline are
+kept in @pending, which must be passed to every call for the same socket.
+Returns false if the connection closed before a full line arrived.
+*/
+bool ReadLine(const int fd, string& pending, string& line)
+{
+	int n;
+	size_t newline;
+	char buf[65536];
+
+	while((newline = pending.find('\n')) == string::npos){
+		n = read(fd, buf, sizeof(buf));
+		if(n < 0 && errno == EINTR){
+			continue;
+		}
+		if(n <= 0){
+			return false;
+		}
+		pending.append(buf, n);
+	}
+	line = pending.substr(0, newline);
+	pending.erase(0, newline + 1);
+
+	return true;
+}
@@ -0,0 +1,20 @@
+#ifndef SOCKET_UTIL_HPP
+#define SOCKET_UTIL_HPP
+
+#include <string>
+
+using namespace std;
+
+/*
+Small helpers for the line-oriented socket protocols of the scoring server and distributed trainer.
+
+Addresses are either a filesystem path, for a Unix domain socket on the local machine, or host:port
+for TCP, so the same programs can run on one box and later across several.
+*/
+int ListenSocket(const string& address, const int backlog=128);
+int ConnectSocket(const string& address);
+bool WriteAll(const int fd, const string& data);
+bool ReadLine(const int fd, string& pending, string& line);
+bool IsTcpAddress(const string& address);
+
+#endif
@@ -0,0 +1,3 @@
+#!/bin/bash
+echo compiling distributed training test...
+g++ testDistributed.cpp DistributedBaumWelch.cpp SocketUtil.cpp Hmm.cpp Matrix.cpp ColumnMatrix.cpp DiscreteHmmDataset.cpp Flyweight.cpp PackedSequence.cpp ShardedCounter.cpp HmmCounts.cpp Profiler.cpp LogMath.cpp DatasetReader.cpp QuantizedHmm.cpp PrefixCache.cpp --std=c++11 -pthread -o distributedTest
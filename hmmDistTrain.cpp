@@ -0,0 +1,40 @@
+#include "DistributedBaumWelch.hpp"
+
+/*
+Distributed Baum-Welch training; see DistributedBaumWelch.
+
+	./hmmDistTrain coordinator <address> <numWorkers> <numStates> <output.hmm> [maxIterations] [convergence] [initial.hmm]
+	./hmmDistTrain worker <address> <shard.txt>
+
+The address is a Unix socket path, or host:port to run the workers on other machines.
+eg, on one box:
+	./hmmDistTrain coordinator /tmp/bw.sock 2 4 trained.hmm &
+	./hmmDistTrain worker /tmp/bw.sock shard0.txt &
+	./hmmDistTrain worker /tmp/bw.sock shard1.txt
+*/
+int main(int argc, char** argv)
+{
+	string mode;
+	DistributedBaumWelch trainer;
+
+	mode = argc > 1 ? argv[1] : "";
+	if(mode == "coordinator" && argc >= 6){
+		if(argc > 6){
+			trainer.SetMaxIterations(atoi(argv[6]));
+		}
+		if(argc > 7){
+			trainer.SetConvergence(atof(argv[7]));
+		}
+		if(argc > 8){
+			trainer.SetInitialModel(argv[8]);
+		}
+		return trainer.RunCoordinator(argv[2], atoi(argv[3]), atoi(argv[4]), argv[5]) ? 0 : 1;
+	}
+	if(mode == "worker" && argc >= 4){
+		return trainer.RunWorker(argv[2], argv[3]) ? 0 : 1;
+	}
+
+	cout << "usage: " << argv[0] << " coordinator <address> <numWorkers> <numStates> <output.hmm> [maxIterations] [convergence] [initial.hmm]" << endl;
+	cout << "       " << argv[0] << " worker <address> <shard.txt>" << endl;
+	return 1;
+}
@@ -0,0 +1,51 @@
+#include "SequenceSampler.hpp"
+
+/*
+Draws synthetic datasets from a model; see SequenceSampler.
+
+	./hmmGenerate <model.hmm> <output|-> <numSequences> <length> [text|labeled|binary] [seed] [numThreads]
+
+Text output is one symbol per line, labelled output <symbol>\t<state> lines, each with a blank line after every
+sequence; binary output is the format of DatasetReader (see hmmScore convert). The same seed gives the same
+sequences for any number of threads. The size and rate of the output are printed to stderr.
+*/
+int main(int argc, char** argv)
+{
+	int numThreads;
+	string format;
+	SampleFormat sampleFormat;
+	DiscreteHmm hmm;
+	SequenceSampler sampler;
+
+	if(argc < 5){
+		cout << "usage: " << argv[0] << " <model.hmm> <output|-> <numSequences> <length> [text|labeled|binary] [seed] [numThreads]" << endl;
+		return 1;
+	}
+
+	format = argc > 5 ? argv[5] : "text";
+	if(format == "text"){
+		sampleFormat = SAMPLE_TEXT;
+	}
+	else if(format == "labeled"){
+		sampleFormat = SAMPLE_LABELED_TEXT;
+	}
+	else if(format == "binary"){
+		sampleFormat = SAMPLE_BINARY;
+	}
+	else{
+		cout << "ERROR unknown output format: " << format << endl;
+		return 1;
+	}
+	numThreads = argc > 7 ? atoi(argv[7]) : thread::hardware_concurrency();
+
+	hmm.SetVerbose(false);
+	if(!hmm.ReadModel(argv[1]) || !sampler.Build(hmm)){
+		return 1;
+	}
+	if(!sampler.Generate(argv[2], sampleFormat, strtoull(argv[3], NULL, 10), atoi(argv[4]), argc > 6 ? strtoull(argv[6], NULL, 10) : 1, numThreads)){
+		return 1;
+	}
+	cerr << sampler.StatsString() << endl;
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+#include "SocketUtil.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+Load generator for hmmServer. Opens a number of connections, each of which keeps a window of
+pipelined requests outstanding, and reports client-side throughput and latency percentiles,
+followed by the server's own counters.
+
+	./hmmLoadGen <socketPath> <model> <FORWARD|VITERBI|POSTERIOR> <symbols> <numConnections> <requestsPerConnection> <sequenceLength> [window]
+
+@symbols: comma separated symbol names to draw random observation sequences from, eg S,M,L
+*/
+
+/*
+Runs one connection's share of the load, appending each request's latency (microseconds) to @latencies.
+@id identifies the connection in its error messages.
+*/
+void runConnection(int id, string socketPath, string request, int numRequests, int window, vector<double>* latencies, int* errors)
+{
+	int sent, received, tag;
+	string pending, line;
+	map<int,chrono::steady_clock::time_point> inFlight;
+	int fd = ConnectSocket(socketPath);
+
+	if(fd < 0){
+		cout << "ERROR connection " << id << " could not connect to " << socketPath << endl;
+		*errors += numRequests;
+		return;
+	}
+
+	sent = received = 0;
+	while(received < numRequests){
+		//top up the window of outstanding requests
+		while(sent < numRequests && sent - received < window){
+			ostringstream out;
+			out << sent << " " << request << "\n";
+			inFlight[sent] = chrono::steady_clock::now();
+			if(!WriteAll(fd, out.str())){
+				cout << "ERROR connection " << id << " could not send request " << sent << endl;
+				*errors += numRequests - received;
+				close(fd);
+				return;
+			}
+			sent++;
+		}
+		if(!ReadLine(fd, pending, line)){
+			cout << "ERROR connection " << id << " closed by the server after " << received << " replies" << endl;
+			*errors += numRequests - received;
+			break;
+		}
+		tag = atoi(line.c_str());
+		latencies->push_back(chrono::duration<double,micro>(chrono::steady_clock::now() - inFlight[tag]).count());
+		inFlight.erase(tag);
+		if(line.find(" OK ") == string::npos){
+			if(*errors == 0){
+				cout << "ERROR reply on connection " << id << ": " << line << endl;
+			}
+			(*errors)++;
+		}
+		received++;
+	}
+
+	close(fd);
+}
+
+int main(int argc, char** argv)
+{
+	int i, numConnections, numRequests, length, window, totalErrors;
+	double seconds;
+	string symbolList, token, request, pending, line;
+	vector<string> symbols;
+	vector<thread> threads;
+	vector<vector<double> > latencies;
+	vector<int> errors;
+	vector<double> all;
+
+	if(argc < 8){
+		cout << "usage: " << argv[0] << " <socketPath> <model> <FORWARD|VITERBI|POSTERIOR> <symbols> <numConnections> <requestsPerConnection> <sequenceLength> [window]" << endl;
+		return 1;
+	}
+
+	symbolList = argv[4];
+	istringstream symbolStream(symbolList);
+	while(getline(symbolStream, token, ',')){
+		symbols.push_back(token);
+	}
+	numConnections = atoi(argv[5]);
+	numRequests = atoi(argv[6]);
+	length = atoi(argv[7]);
+	window = argc > 8 ? atoi(argv[8]) : 8;
+
+	//every request scores the same random sequence, so results are comparable across runs
+	srand(1);
+	request = string(argv[3]) + " " + argv[2];
+	for(i = 0; i < length; i++){
+		request += " " + symbols[rand() % symbols.size()];
+	}
+
+	latencies.resize(numConnections);
+	errors.resize(numConnections, 0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(i = 0; i < numConnections; i++){
+		threads.push_back(thread(runConnection, i, string(argv[1]), request, numRequests, window, &latencies[i], &errors[i]));
+	}
+	for(i = 0; i < numConnections; i++){
+		threads[i].join();
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	totalErrors = 0;
+	for(i = 0; i < numConnections; i++){
+		all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+		totalErrors += errors[i];
+	}
+	sort(all.begin(), all.end());
+
+	cout << "requests: " << all.size() << " errors: " << totalErrors << " seconds: " << seconds << endl;
+	if(all.size() > 0){
+		cout << "throughput: " << all.size() / seconds << " req/s" << endl;
+		cout << "latency us: p50=" << all[all.size() / 2] << " p90=" << all[all.size() * 9 / 10] << " p99=" << all[all.size() * 99 / 100] << " max=" << all.back() << endl;
+	}
+
+	//report the server's view as well
+	int fd = ConnectSocket(argv[1]);
+	if(fd >= 0){
+		WriteAll(fd, "stats STATS\n");
+		if(ReadLine(fd, pending, line)){
+			cout << "server: " << line << endl;
+		}
+		close(fd);
+	}
+
+	return totalErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+#include "QuantizedHmm.hpp"
+
+/*
+Batch scoring of a dataset file with a prefetching DatasetReader; see DatasetReader for the text and binary formats.
+
+	./hmmScore score <model.hmm> <dataset> [batchSize]      prints ln P(sequence) per sequence, in file order
+	./hmmScore train <dataset> <numStates> <output.hmm> [batchSize] [squarem]
+	                                                       streaming Baum-Welch over a multi-sequence dataset,
+	                                                       optionally accelerated; see SetAcceleratedEM()
+	./hmmScore convert <dataset.txt> <dataset.bin>         converts a text dataset to the binary format
+	./hmmScore quantize <model.hmm> <output.qhmm> [16|32]  exports a fixed-point model; see QuantizedHmm
+	./hmmScore compare <model.hmm> <dataset> [16|32]       compares the quantized engine with the double one
+
+Reader counters, including the time spent waiting on the reader, are printed to stderr.
+*/
+int main(int argc, char** argv)
+{
+	int i, batchSize;
+	string mode;
+	vector<double> scores;
+	vector<vector<int> > batch;
+	vector<string> symbols;
+
+	mode = argc > 1 ? argv[1] : "";
+	if(mode == "score" && argc >= 4){
+		DiscreteHmm hmm;
+		hmm.SetVerbose(false);
+		if(!hmm.ReadModel(argv[2])){
+			return 1;
+		}
+		batchSize = argc > 4 ? atoi(argv[4]) : 256;
+		for(i = 0; i < hmm.NumSymbols(); i++){
+			symbols.push_back(hmm.GetSymbolName(i));
+		}
+		DatasetReader reader(batchSize);
+		if(!reader.Open(argv[3], symbols)){
+			return 1;
+		}
+		cout.precision(17);
+		while(reader.NextBatch(batch)){
+			hmm.BatchForward(batch, scores);
+			for(i = 0; i < scores.size(); i++){
+				cout << scores[i] << "\n";
+			}
+		}
+		cerr << reader.StatsString() << endl;
+		return 0;
+	}
+	if(mode == "train" && argc >= 5){
+		DiscreteHmm hmm;
+		hmm.SetVerbose(false);
+		hmm.SetAcceleratedEM(argc > 6 && string(argv[6]) == "squarem");
+		if(hmm.StreamingBaumWelch(argv[2], atoi(argv[3]), argc > 5 ? atoi(argv[5]) : 256) > 0){
+			return 1;
+		}
+		hmm.WriteModel(argv[4]);
+		return 0;
+	}
+	if(mode == "convert" && argc >= 4){
+		return DatasetReader::ConvertToBinary(argv[2], argv[3]) ? 0 : 1;
+	}
+	if((mode == "quantize" || mode == "compare") && argc >= 4){
+		DiscreteHmm hmm;
+		QuantizedHmm<int16_t> quantized16;
+		QuantizedHmm<int32_t> quantized32;
+		bool wide = argc > 4 && atoi(argv[4]) == 32;
+		hmm.SetVerbose(false);
+		if(!hmm.ReadModel(argv[2]) || !(wide ? quantized32.Build(hmm) : quantized16.Build(hmm))){
+			return 1;
+		}
+		if(mode == "quantize"){
+			return (wide ? quantized32.Write(argv[3]) : quantized16.Write(argv[3])) ? 0 : 1;
+		}
+		vector<vector<int> > sequences;
+		for(i = 0; i < hmm.NumSymbols(); i++){
+			symbols.push_back(hmm.GetSymbolName(i));
+		}
+		DatasetReader reader;
+		if(!reader.Open(argv[3], symbols)){
+			return 1;
+		}
+		while(reader.NextBatch(batch)){
+			sequences.insert(sequences.end(), batch.begin(), batch.end());
+		}
+		cout << (wide ? quantized32.Report(hmm, sequences) : quantized16.Report(hmm, sequences)) << endl;
+		return 0;
+	}
+
+	cout << "usage: " << argv[0] << " score <model.hmm> <dataset> [batchSize]" << endl;
+	cout << "       " << argv[0] << " train <dataset> <numStates> <output.hmm> [batchSize] [squarem]" << endl;
+	cout << "       " << argv[0] << " convert <dataset.txt> <dataset.bin>" << endl;
+	cout << "       " << argv[0] << " quantize <model.hmm> <output.qhmm> [16|32]" << endl;
+	cout << "       " << argv[0] << " compare <model.hmm> <dataset> [16|32]" << endl;
+	return 1;
+}
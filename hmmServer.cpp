@@ -0,0 +1,57 @@
+#include "HmmServer.hpp"
+
+#include <csignal>
+#include <pthread.h>
+
+/*
+Runs the scoring server until SIGINT/SIGTERM.
+
+	./hmmServer <socketPath> <numWorkers> <maxBatch> [--prefix-cache=<MB>] <name>=<model.hmm> [<name>=<model.hmm> ...]
+
+eg, ./hmmServer /tmp/hmm.sock 4 16 stamp=test.hmm
+--prefix-cache gives each worker a cache of that many megabytes per model, for queries sharing prefixes.
+*/
+int main(int argc, char** argv)
+{
+	int i, sig;
+	size_t eq;
+	unsigned long long cacheBytes = 0;
+	string arg;
+	sigset_t signals;
+	HmmServer server;
+
+	if(argc < 5){
+		cout << "usage: " << argv[0] << " <socketPath> <numWorkers> <maxBatch> [--prefix-cache=<MB>] <name>=<model.hmm> [<name>=<model.hmm> ...]" << endl;
+		return 1;
+	}
+
+	for(i = 4; i < argc; i++){
+		arg = argv[i];
+		if(arg.find("--prefix-cache=") == 0){
+			cacheBytes = strtoull(arg.substr(15).c_str(), NULL, 10) << 20;
+			continue;
+		}
+		eq = arg.find('=');
+		if(eq == string::npos || !server.LoadModel(arg.substr(0, eq), arg.substr(eq + 1))){
+			cout << "ERROR bad model argument: " << arg << endl;
+			return 1;
+		}
+	}
+
+	if(cacheBytes > 0){
+		server.SetPrefixCache(cacheBytes);
+	}
+
+	//block the shutdown signals in every thread, and wait for them in a dedicated one
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+	thread signalThread([&](){
+		sigwait(&signals, &sig);
+		server.Stop();
+	});
+	signalThread.detach();
+
+	return server.Run(argv[1], atoi(argv[2]), atoi(argv[3])) ? 0 : 1;
+}
@@ -1,4 +1,4 @@
 #!/bin/bash
 echo compiling lse test...
-g++ testLSE.cpp Hmm.cpp Matrix.cpp ColumnMatrix.cpp DiscreteHmmDataset.cpp Flyweight.cpp --std=c++11 -o lseTest
+g++ testLSE.cpp Hmm.cpp Matrix.cpp ColumnMatrix.cpp DiscreteHmmDataset.cpp Flyweight.cpp PackedSequence.cpp ShardedCounter.cpp HmmCounts.cpp Profiler.cpp LogMath.cpp DatasetReader.cpp QuantizedHmm.cpp PrefixCache.cpp --std=c++11 -pthread -o lseTest
 #g++ test.cpp Hmm.cpp DiscreteHmmDataset.cpp --std=c++11 -o testHmm
@@ -0,0 +1,737 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "Hmm.hpp"
+
+#include <mutex>
+#include <memory>
+#include <climits>
+
+/*
+Python bindings for DiscreteHmm, built as the extension module pyhmm by pyhmm.sh.
+
+Observations go in as any C-contiguous, one-dimensional buffer of 32-bit ints: array.array('i'), a numpy int32
+array, or a Buffer returned by this module. The algorithms read the caller's memory in place through a
+SequenceView; nothing is copied into a vector<int>. Results come back as pyhmm.Buffer objects, which own their
+storage and export it through the buffer protocol, so memoryview(buffer) or numpy.asarray(buffer) wraps it without
+a copy. Paths are handed over from Viterbi() as they are; lattices and parameters are copied once, into a
+contiguous row-major array, since the model stores them as a vector per column (or row).
+
+	import pyhmm, array
+	hmm = pyhmm.Hmm("model.hmm")                   or hmm = pyhmm.Hmm(); hmm.init_random(["a", "b"], 4)
+	obs = hmm.encode(["a", "b", "b"])               int32 Buffer of symbol ids
+	score = hmm.forward(obs)                        ln P(obs)
+	score, alpha = hmm.forward(obs, lattice=True)   alpha is a T x N Buffer of doubles
+	score, beta = hmm.backward(obs, lattice=True)   score is the log-sum of beta_0, as BackwardAlgorithm() returns
+	score, path = hmm.viterbi(obs)                  path is an int32 Buffer of state ids
+	logLikelihood = hmm.baum_welch([obs, ...], iterations=100, tolerance=1.0)
+	initial, transitions, emissions = hmm.parameters()      ln-probabilities; N, N x N and N x M
+	hmm.write("trained.hmm")
+
+The GIL is released while forward(), backward(), viterbi(), baum_welch(), read() and write() run, so Python threads
+can score in parallel. A DiscreteHmm keeps its lattices between calls, so calls on the same Hmm object are
+serialized by a per-object lock; threads that should run in parallel need an Hmm each (eg, Hmm(path) per thread).
+*/
+
+//Owns a result array and exports it through the buffer protocol: doubles (format "d") or ints (format "i").
+typedef struct{
+	PyObject_HEAD
+	vector<double>* doubles;
+	vector<int>* ints;
+	int ndim;
+	Py_ssize_t shape[2];
+	Py_ssize_t strides[2];
+} PyHmmBuffer;
+
+typedef struct{
+	PyObject_HEAD
+	DiscreteHmm* hmm;
+	mutex* lock;
+} PyHmm;
+
+static PyTypeObject PyHmmBufferType = { PyVarObject_HEAD_INIT(NULL, 0) };
+static PyTypeObject PyHmmType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+//runs @statement on the model without the GIL, holding the model's lock
+#define WITHOUT_GIL(self, ...) \
+	Py_BEGIN_ALLOW_THREADS \
+	{ \
+		lock_guard<mutex> guard(*(self)->lock); \
+		__VA_ARGS__; \
+	} \
+	Py_END_ALLOW_THREADS
+
+/*
+Wraps @values in a new Buffer of @rows x @cols (or @rows, if @cols is 0), taking its contents without copying.
+*/
+template<typename T>
+static PyObject* _newBuffer(vector<T>& values, const Py_ssize_t rows, const Py_ssize_t cols);
+
+template<>
+PyObject* _newBuffer(vector<double>& values, const Py_ssize_t rows, const Py_ssize_t cols)
+{
+	PyHmmBuffer* buffer = PyObject_New(PyHmmBuffer, &PyHmmBufferType);
+
+	if(buffer == NULL){
+		return NULL;
+	}
+	buffer->doubles = new vector<double>();
+	buffer->doubles->swap(values);
+	buffer->ints = NULL;
+	buffer->ndim = cols > 0 ? 2 : 1;
+	buffer->shape[0] = rows;
+	buffer->shape[1] = cols;
+	buffer->strides[0] = (cols > 0 ? cols : 1) * sizeof(double);
+	buffer->strides[1] = sizeof(double);
+
+	return (PyObject*)buffer;
+}
+
+template<>
+PyObject* _newBuffer(vector<int>& values, const Py_ssize_t rows, const Py_ssize_t cols)
+{
+	PyHmmBuffer* buffer = PyObject_New(PyHmmBuffer, &PyHmmBufferType);
+
+	if(buffer == NULL){
+		return NULL;
+	}
+	buffer->ints = new vector<int>();
+	buffer->ints->swap(values);
+	buffer->doubles = NULL;
+	buffer->ndim = cols > 0 ? 2 : 1;
+	buffer->shape[0] = rows;
+	buffer->shape[1] = cols;
+	buffer->strides[0] = (cols > 0 ? cols : 1) * sizeof(int);
+	buffer->strides[1] = sizeof(int);
+
+	return (PyObject*)buffer;
+}
+
+static void _bufferDealloc(PyHmmBuffer* self)
+{
+	delete self->doubles;
+	delete self->ints;
+	PyObject_Del(self);
+}
+
+static int _bufferGet(PyHmmBuffer* self, Py_buffer* view, int flags)
+{
+	static double empty;
+
+	view->obj = (PyObject*)self;
+	Py_INCREF(self);
+	if(self->doubles != NULL){
+		view->buf = self->doubles->size() > 0 ? (void*)self->doubles->data() : (void*)&empty;
+		view->itemsize = sizeof(double);
+		view->len = self->doubles->size() * sizeof(double);
+		view->format = (flags & PyBUF_FORMAT) ? (char*)"d" : NULL;
+	}
+	else{
+		view->buf = self->ints->size() > 0 ? (void*)self->ints->data() : (void*)&empty;
+		view->itemsize = sizeof(int);
+		view->len = self->ints->size() * sizeof(int);
+		view->format = (flags & PyBUF_FORMAT) ? (char*)"i" : NULL;
+	}
+	view->readonly = 0;
+	view->ndim = self->ndim;
+	view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+
+	return 0;
+}
+
+static Py_ssize_t _bufferLength(PyHmmBuffer* self)
+{
+	return self->shape[0];
+}
+
+static PyObject* _bufferRepr(PyHmmBuffer* self)
+{
+	if(self->ndim == 2){
+		return PyUnicode_FromFormat("<pyhmm.Buffer %s[%zd x %zd]>", self->doubles != NULL ? "double" : "int32", self->shape[0], self->shape[1]);
+	}
+	return PyUnicode_FromFormat("<pyhmm.Buffer %s[%zd]>", self->doubles != NULL ? "double" : "int32", self->shape[0]);
+}
+
+static PyBufferProcs _bufferProcs = { (getbufferproc)_bufferGet, NULL };
+static PySequenceMethods _bufferSequence = { (lenfunc)_bufferLength };
+
+/*
+Holds a caller's buffer of int32 observations for the duration of a call, and views it as a SequenceView.
+Releasing the buffer needs the GIL, which the destructor has when it runs at the end of a binding function.
+*/
+class ObservationBuffer{
+	public:
+		ObservationBuffer()
+		{
+			_held = false;
+		}
+		~ObservationBuffer()
+		{
+			if(_held){
+				PyBuffer_Release(&_buffer);
+			}
+		}
+		/*
+		Acquires @object's buffer. Returns false with a Python exception set if it is not a non-empty, C-contiguous,
+		one-dimensional array of native 32-bit ints.
+		*/
+		bool Acquire(PyObject* object)
+		{
+			const char* format;
+
+			if(PyObject_GetBuffer(object, &_buffer, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0){
+				return false;
+			}
+			_held = true;
+
+			format = _buffer.format != NULL ? _buffer.format : "B";
+			if(*format == '@' || *format == '=' || (*format == '<' && _isLittleEndian())){
+				format++;
+			}
+			if(_buffer.ndim != 1 || _buffer.itemsize != sizeof(int) || (string(format) != "i" && string(format) != "l")){
+				PyErr_Format(PyExc_TypeError, "observations must be a one-dimensional array of int32 (eg, array.array('i') or numpy.int32), not format '%s' with %zd-byte items", _buffer.format != NULL ? _buffer.format : "B", _buffer.itemsize);
+				return false;
+			}
+			if(_buffer.shape[0] == 0 || _buffer.shape[0] > INT_MAX){
+				PyErr_SetString(PyExc_ValueError, "observations must hold between 1 and INT_MAX symbols");
+				return false;
+			}
+			View = SequenceView((const int*)_buffer.buf, (int)_buffer.shape[0]);
+
+			return true;
+		}
+		/*
+		Returns the first observation outside [0, numSymbols), or -1 if all are valid. Does not need the GIL.
+		*/
+		int FindInvalid(const int numSymbols)
+		{
+			int i;
+
+			for(i = 0; i < View.size(); i++){
+				if(View[i] < 0 || View[i] >= numSymbols){
+					return i;
+				}
+			}
+
+			return -1;
+		}
+		SequenceView View;
+	private:
+		static bool _isLittleEndian()
+		{
+			const int one = 1;
+			return *(const char*)&one == 1;
+		}
+		Py_buffer _buffer;
+		bool _held;
+};
+
+/*
+Raises ValueError for an observation outside the model's symbols, found by FindInvalid() at @index.
+*/
+static void _invalidObservation(ObservationBuffer& observations, const int index, const int numSymbols)
+{
+	PyErr_Format(PyExc_ValueError, "observation %d is %d, outside the model's %d symbols", index, observations.View[index], numSymbols);
+}
+
+static PyObject* _hmmNew(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+{
+	PyHmm* self = (PyHmm*)type->tp_alloc(type, 0);
+
+	if(self != NULL){
+		self->hmm = new DiscreteHmm();
+		self->hmm->SetVerbose(false);
+		self->lock = new mutex();
+	}
+
+	return (PyObject*)self;
+}
+
+static void _hmmDealloc(PyHmm* self)
+{
+	delete self->hmm;
+	delete self->lock;
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/*
+Reads a model file written by DiscreteHmm::WriteModel(). Returns false with an exception set on failure.
+*/
+static bool _readModel(PyHmm* self, const string& path)
+{
+	bool ok;
+
+	WITHOUT_GIL(self, ok = self->hmm->ReadModel(path));
+	if(!ok){
+		PyErr_Format(PyExc_IOError, "could not read model file %s", path.c_str());
+	}
+
+	return ok;
+}
+
+/*
+Hmm(path=None): reads a model file, if given.
+*/
+static int _hmmInit(PyHmm* self, PyObject* args, PyObject* kwargs)
+{
+	static const char* keywords[] = {"path", NULL};
+	const char* path = NULL;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|z", (char**)keywords, &path)){
+		return -1;
+	}
+	if(path != NULL && !_readModel(self, path)){
+		return -1;
+	}
+
+	return 0;
+}
+
+static PyObject* _hmmRead(PyHmm* self, PyObject* args)
+{
+	const char* path;
+
+	if(!PyArg_ParseTuple(args, "s", &path) || !_readModel(self, path)){
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+static PyObject* _hmmWrite(PyHmm* self, PyObject* args)
+{
+	const char* path;
+
+	if(!PyArg_ParseTuple(args, "s", &path)){
+		return NULL;
+	}
+	string modelPath(path);
+
+	WITHOUT_GIL(self, self->hmm->WriteModel(modelPath));
+
+	Py_RETURN_NONE;
+}
+
+/*
+init_random(symbols, num_states): a random model over the symbol names in the list @symbols.
+*/
+static PyObject* _hmmInitRandom(PyHmm* self, PyObject* args)
+{
+	int i, numStates;
+	PyObject* list;
+	PyObject* item;
+	vector<string> symbols;
+
+	if(!PyArg_ParseTuple(args, "Oi", &list, &numStates)){
+		return NULL;
+	}
+	if(numStates <= 0){
+		PyErr_SetString(PyExc_ValueError, "num_states must be positive");
+		return NULL;
+	}
+	list = PySequence_Fast(list, "symbols must be a sequence of str");
+	if(list == NULL){
+		return NULL;
+	}
+	for(i = 0; i < PySequence_Fast_GET_SIZE(list); i++){
+		item = PySequence_Fast_GET_ITEM(list, i);
+		if(!PyUnicode_Check(item)){
+			Py_DECREF(list);
+			PyErr_SetString(PyExc_TypeError, "symbols must be a sequence of str");
+			return NULL;
+		}
+		symbols.push_back(PyUnicode_AsUTF8(item));
+	}
+	Py_DECREF(list);
+
+	WITHOUT_GIL(self, self->hmm->InitRandomModel(symbols, numStates));
+
+	Py_RETURN_NONE;
+}
+
+/*
+Gets the model's dimensions. Returns false with an exception set if it has no model yet.
+*/
+static bool _getDimensions(PyHmm* self, int& numStates, int& numSymbols)
+{
+	WITHOUT_GIL(self, numStates = self->hmm->NumStates(); numSymbols = self->hmm->NumSymbols());
+	if(numStates == 0 || numSymbols == 0){
+		PyErr_SetString(PyExc_RuntimeError, "the Hmm has no model; call read() or init_random() first");
+		return false;
+	}
+
+	return true;
+}
+
+static PyObject* _hmmNumStates(PyHmm* self, PyObject* unused)
+{
+	int numStates;
+
+	WITHOUT_GIL(self, numStates = self->hmm->NumStates());
+
+	return PyLong_FromLong(numStates);
+}
+
+static PyObject* _hmmNumSymbols(PyHmm* self, PyObject* unused)
+{
+	int numSymbols;
+
+	WITHOUT_GIL(self, numSymbols = self->hmm->NumSymbols());
+
+	return PyLong_FromLong(numSymbols);
+}
+
+static PyObject* _hmmSymbolName(PyHmm* self, PyObject* args)
+{
+	int id, numStates, numSymbols;
+	string name;
+
+	if(!PyArg_ParseTuple(args, "i", &id) || !_getDimensions(self, numStates, numSymbols)){
+		return NULL;
+	}
+	if(id < 0 || id >= numSymbols){
+		PyErr_Format(PyExc_IndexError, "symbol id %d is outside the model's %d symbols", id, numSymbols);
+		return NULL;
+	}
+	WITHOUT_GIL(self, name = self->hmm->GetSymbolName(id));
+
+	return PyUnicode_FromString(name.c_str());
+}
+
+static PyObject* _hmmStateName(PyHmm* self, PyObject* args)
+{
+	int id, numStates, numSymbols;
+	string name;
+
+	if(!PyArg_ParseTuple(args, "i", &id) || !_getDimensions(self, numStates, numSymbols)){
+		return NULL;
+	}
+	if(id < 0 || id >= numStates){
+		PyErr_Format(PyExc_IndexError, "state id %d is outside the model's %d states", id, numStates);
+		return NULL;
+	}
+	WITHOUT_GIL(self, name = self->hmm->GetStateName(id));
+
+	return PyUnicode_FromString(name.c_str());
+}
+
+/*
+encode(symbols): the int32 Buffer of ids of the symbol names in the list @symbols.
+*/
+static PyObject* _hmmEncode(PyHmm* self, PyObject* args)
+{
+	int i;
+	PyObject* list;
+	PyObject* item;
+	vector<string> names;
+	vector<int> ids;
+
+	if(!PyArg_ParseTuple(args, "O", &list)){
+		return NULL;
+	}
+	list = PySequence_Fast(list, "symbols must be a sequence of str");
+	if(list == NULL){
+		return NULL;
+	}
+	for(i = 0; i < PySequence_Fast_GET_SIZE(list); i++){
+		item = PySequence_Fast_GET_ITEM(list, i);
+		if(!PyUnicode_Check(item)){
+			Py_DECREF(list);
+			PyErr_SetString(PyExc_TypeError, "symbols must be a sequence of str");
+			return NULL;
+		}
+		names.push_back(PyUnicode_AsUTF8(item));
+	}
+	Py_DECREF(list);
+
+	ids.resize(names.size());
+	WITHOUT_GIL(self, for(i = 0; i < names.size(); i++){ ids[i] = self->hmm->GetSymbolId(names[i]); });
+	for(i = 0; i < ids.size(); i++){
+		if(ids[i] < 0){
+			PyErr_Format(PyExc_ValueError, "unknown symbol '%s'", names[i].c_str());
+			return NULL;
+		}
+	}
+
+	return _newBuffer(ids, ids.size(), 0);
+}
+
+/*
+forward(observations, lattice=False) and backward(observations, lattice=False): the score of ForwardAlgorithm()
+(ln P(observations)) or BackwardAlgorithm() (the log-sum of beta_0) over the whole sequence, and if @lattice, the
+T x N alpha (or beta) lattice.
+*/
+static PyObject* _forwardBackward(PyHmm* self, PyObject* args, PyObject* kwargs, const bool forward)
+{
+	static const char* keywords[] = {"observations", "lattice", NULL};
+	int withLattice = 0, invalid, numStates, numSymbols;
+	double pObs = 0;
+	PyObject* object;
+	ObservationBuffer observations;
+	vector<double> lattice;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", (char**)keywords, &object, &withLattice) || !observations.Acquire(object)){
+		return NULL;
+	}
+
+	WITHOUT_GIL(self,
+		numStates = self->hmm->NumStates();
+		numSymbols = self->hmm->NumSymbols();
+		invalid = observations.FindInvalid(numSymbols);
+		if(numStates > 0 && invalid < 0){
+			if(forward){
+				pObs = self->hmm->ForwardAlgorithm(observations.View, observations.View.size() - 1);
+			}
+			else{
+				pObs = self->hmm->BackwardAlgorithm(observations.View, 0);
+			}
+			if(withLattice){
+				lattice.resize((size_t)observations.View.size() * numStates);
+				if(forward){
+					self->hmm->CopyForwardLattice(lattice.data(), observations.View.size());
+				}
+				else{
+					self->hmm->CopyBackwardLattice(lattice.data(), observations.View.size());
+				}
+			}
+		}
+	);
+	if(numStates == 0){
+		PyErr_SetString(PyExc_RuntimeError, "the Hmm has no model; call read() or init_random() first");
+		return NULL;
+	}
+	if(invalid >= 0){
+		_invalidObservation(observations, invalid, numSymbols);
+		return NULL;
+	}
+	//the model returns 1, an impossible ln-probability, on error
+	if(pObs > 0){
+		PyErr_SetString(PyExc_RuntimeError, forward ? "ForwardAlgorithm() failed" : "BackwardAlgorithm() failed");
+		return NULL;
+	}
+
+	if(withLattice){
+		PyObject* buffer = _newBuffer(lattice, observations.View.size(), numStates);
+		if(buffer == NULL){
+			return NULL;
+		}
+		return Py_BuildValue("(dN)", pObs, buffer);
+	}
+	return PyFloat_FromDouble(pObs);
+}
+
+static PyObject* _hmmForward(PyHmm* self, PyObject* args, PyObject* kwargs)
+{
+	return _forwardBackward(self, args, kwargs, true);
+}
+
+static PyObject* _hmmBackward(PyHmm* self, PyObject* args, PyObject* kwargs)
+{
+	return _forwardBackward(self, args, kwargs, false);
+}
+
+/*
+viterbi(observations): the ln-probability of the most likely state sequence, and that sequence as an int32 Buffer.
+*/
+static PyObject* _hmmViterbi(PyHmm* self, PyObject* args)
+{
+	int invalid, numStates, numSymbols;
+	double score = 0;
+	PyObject* object;
+	PyObject* buffer;
+	ObservationBuffer observations;
+	vector<int> path;
+
+	if(!PyArg_ParseTuple(args, "O", &object) || !observations.Acquire(object)){
+		return NULL;
+	}
+
+	WITHOUT_GIL(self,
+		numStates = self->hmm->NumStates();
+		numSymbols = self->hmm->NumSymbols();
+		invalid = observations.FindInvalid(numSymbols);
+		if(numStates > 0 && invalid < 0){
+			score = self->hmm->Viterbi(observations.View, observations.View.size(), path);
+		}
+	);
+	if(numStates == 0){
+		PyErr_SetString(PyExc_RuntimeError, "the Hmm has no model; call read() or init_random() first");
+		return NULL;
+	}
+	if(invalid >= 0){
+		_invalidObservation(observations, invalid, numSymbols);
+		return NULL;
+	}
+	if(score > 0 || path.size() != observations.View.size()){
+		PyErr_SetString(PyExc_RuntimeError, "Viterbi() failed");
+		return NULL;
+	}
+
+	buffer = _newBuffer(path, path.size(), 0);
+	if(buffer == NULL){
+		return NULL;
+	}
+	return Py_BuildValue("(dN)", score, buffer);
+}
+
+/*
+baum_welch(sequences, iterations=100, tolerance=1.0): trains the current model on one observation buffer or a list
+of them, until the log-likelihood improves by less than @tolerance or @iterations passes have run; see
+DiscreteHmm::AccumulateExpectedCounts(). Returns the log-likelihood of the data under the model before the last
+update, as BaumWelch() does.
+*/
+static PyObject* _hmmBaumWelch(PyHmm* self, PyObject* args, PyObject* kwargs)
+{
+	static const char* keywords[] = {"sequences", "iterations", "tolerance", NULL};
+	int i, s, iterations = 100, invalid = -1, invalidSequence = -1, numStates, numSymbols;
+	double tolerance = 1.0, lastProb, logLikelihood = 0;
+	PyObject* object;
+	PyObject* list;
+	Py_ssize_t numSequences;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwargs, "O|id", (char**)keywords, &object, &iterations, &tolerance) || !_getDimensions(self, numStates, numSymbols)){
+		return NULL;
+	}
+
+	//a single buffer, or a sequence of them
+	list = PyObject_CheckBuffer(object) ? PyTuple_Pack(1, object) : PySequence_Fast(object, "sequences must be an observation buffer or a sequence of them");
+	if(list == NULL){
+		return NULL;
+	}
+	numSequences = PySequence_Fast_GET_SIZE(list);
+	unique_ptr<ObservationBuffer[]> observations(new ObservationBuffer[numSequences]);
+	for(s = 0; s < numSequences; s++){
+		if(!observations[s].Acquire(PySequence_Fast_GET_ITEM(list, s))){
+			Py_DECREF(list);
+			return NULL;
+		}
+	}
+
+	WITHOUT_GIL(self,
+		for(s = 0; s < numSequences && invalid < 0; s++){
+			invalid = observations[s].FindInvalid(numSymbols);
+			invalidSequence = s;
+		}
+		if(invalid < 0){
+			HmmCounts counts;
+			lastProb = -numeric_limits<double>::infinity();
+			for(i = 0; i < iterations; i++){
+				counts.Clear();
+				counts.Resize(numStates, numSymbols);
+				for(s = 0; s < numSequences; s++){
+					self->hmm->AccumulateExpectedCounts(observations[s].View, counts);
+				}
+				self->hmm->MaximizeExpectedCounts(counts);
+				logLikelihood = counts.LogLikelihood;
+				if(logLikelihood - lastProb < tolerance){
+					break;
+				}
+				lastProb = logLikelihood;
+			}
+		}
+	);
+	if(invalid >= 0){
+		_invalidObservation(observations[invalidSequence], invalid, numSymbols);
+		Py_DECREF(list);
+		return NULL;
+	}
+	Py_DECREF(list);
+
+	return PyFloat_FromDouble(logLikelihood);
+}
+
+/*
+parameters(): the ln-probabilities of the model as (initial[N], transitions[N x N], emissions[N x M]) Buffers.
+*/
+static PyObject* _hmmParameters(PyHmm* self, PyObject* unused)
+{
+	int numStates, numSymbols;
+	vector<double> initial, transitions, emissions;
+	PyObject* buffers[3];
+
+	if(!_getDimensions(self, numStates, numSymbols)){
+		return NULL;
+	}
+	WITHOUT_GIL(self,
+		initial.resize(numStates);
+		transitions.resize(numStates * numStates);
+		emissions.resize(numStates * numSymbols);
+		self->hmm->CopyParameters(initial.data(), transitions.data(), emissions.data());
+	);
+
+	buffers[0] = _newBuffer(initial, numStates, 0);
+	buffers[1] = _newBuffer(transitions, numStates, numStates);
+	buffers[2] = _newBuffer(emissions, numStates, numSymbols);
+	if(buffers[0] == NULL || buffers[1] == NULL || buffers[2] == NULL){
+		Py_XDECREF(buffers[0]);
+		Py_XDECREF(buffers[1]);
+		Py_XDECREF(buffers[2]);
+		return NULL;
+	}
+	return Py_BuildValue("(NNN)", buffers[0], buffers[1], buffers[2]);
+}
+
+static PyMethodDef _hmmMethods[] = {
+	{"read", (PyCFunction)_hmmRead, METH_VARARGS, "read(path): reads a model file"},
+	{"write", (PyCFunction)_hmmWrite, METH_VARARGS, "write(path): writes the model file"},
+	{"init_random", (PyCFunction)_hmmInitRandom, METH_VARARGS, "init_random(symbols, num_states): a random model over the symbol names"},
+	{"num_states", (PyCFunction)_hmmNumStates, METH_NOARGS, "num_states(): the number of hidden states"},
+	{"num_symbols", (PyCFunction)_hmmNumSymbols, METH_NOARGS, "num_symbols(): the number of emission symbols"},
+	{"symbol_name", (PyCFunction)_hmmSymbolName, METH_VARARGS, "symbol_name(id): the name of a symbol"},
+	{"state_name", (PyCFunction)_hmmStateName, METH_VARARGS, "state_name(id): the name of a state"},
+	{"encode", (PyCFunction)_hmmEncode, METH_VARARGS, "encode(symbols): an int32 Buffer of symbol ids"},
+	{"forward", (PyCFunction)_hmmForward, METH_VARARGS | METH_KEYWORDS, "forward(observations, lattice=False): ln P(observations) [, alpha lattice]"},
+	{"backward", (PyCFunction)_hmmBackward, METH_VARARGS | METH_KEYWORDS, "backward(observations, lattice=False): log-sum of beta_0 [, beta lattice]"},
+	{"viterbi", (PyCFunction)_hmmViterbi, METH_VARARGS, "viterbi(observations): (ln P(best path), path)"},
+	{"baum_welch", (PyCFunction)_hmmBaumWelch, METH_VARARGS | METH_KEYWORDS, "baum_welch(sequences, iterations=100, tolerance=1.0): trains the model, returns the log-likelihood"},
+	{"parameters", (PyCFunction)_hmmParameters, METH_NOARGS, "parameters(): (initial, transitions, emissions) ln-probabilities"},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyModuleDef _module = {
+	PyModuleDef_HEAD_INIT,
+	"pyhmm",
+	"Discrete hidden Markov models over int32 observation buffers.",
+	-1,
+	NULL
+};
+
+PyMODINIT_FUNC PyInit_pyhmm()
+{
+	PyObject* module;
+
+	PyHmmBufferType.tp_name = "pyhmm.Buffer";
+	PyHmmBufferType.tp_basicsize = sizeof(PyHmmBuffer);
+	PyHmmBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+	PyHmmBufferType.tp_doc = "A result array, exported through the buffer protocol.";
+	PyHmmBufferType.tp_dealloc = (destructor)_bufferDealloc;
+	PyHmmBufferType.tp_as_buffer = &_bufferProcs;
+	PyHmmBufferType.tp_as_sequence = &_bufferSequence;
+	PyHmmBufferType.tp_repr = (reprfunc)_bufferRepr;
+
+	PyHmmType.tp_name = "pyhmm.Hmm";
+	PyHmmType.tp_basicsize = sizeof(PyHmm);
+	PyHmmType.tp_flags = Py_TPFLAGS_DEFAULT;
+	PyHmmType.tp_doc = "Hmm(path=None): a discrete hidden Markov model; see pyhmm.cpp.";
+	PyHmmType.tp_new = _hmmNew;
+	PyHmmType.tp_init = (initproc)_hmmInit;
+	PyHmmType.tp_dealloc = (destructor)_hmmDealloc;
+	PyHmmType.tp_methods = _hmmMethods;
+
+	if(PyType_Ready(&PyHmmBufferType) < 0 || PyType_Ready(&PyHmmType) < 0){
+		return NULL;
+	}
+	module = PyModule_Create(&_module);
+	if(module == NULL){
+		return NULL;
+	}
+	Py_INCREF(&PyHmmBufferType);
+	Py_INCREF(&PyHmmType);
+	PyModule_AddObject(module, "Buffer", (PyObject*)&PyHmmBufferType);
+	PyModule_AddObject(module, "Hmm", (PyObject*)&PyHmmType);
+
+	return module;
+}
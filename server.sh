@@ -0,0 +1,4 @@
+#!/bin/bash
+echo compiling scoring server and load generator...
+g++ hmmServer.cpp HmmServer.cpp SocketUtil.cpp Hmm.cpp Matrix.cpp ColumnMatrix.cpp DiscreteHmmDataset.cpp Flyweight.cpp PackedSequence.cpp ShardedCounter.cpp HmmCounts.cpp Profiler.cpp LogMath.cpp DatasetReader.cpp QuantizedHmm.cpp PrefixCache.cpp --std=c++11 -pthread -O2 -o hmmServer
+g++ hmmLoadGen.cpp SocketUtil.cpp --std=c++11 -O2 -pthread -o hmmLoadGen
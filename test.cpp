@@ -1,7 +1,143 @@
 #include "Hmm.hpp"
 
+#include <fstream>
+#include <sstream>
+
+/*
+Returns the parameters of @hmm by state and symbol name, so models whose ids were assigned in a different
+order can be compared: pi[state], A[state][state] and B[state][symbol].
+*/
+void namedParameters(DiscreteHmm& hmm, map<string,double>& pi, map<string,map<string,double> >& A, map<string,map<string,double> >& B)
+{
+	int i, j, n, m;
+	vector<double> initial, transitions, emissions;
+
+	n = hmm.NumStates();
+	m = hmm.NumSymbols();
+	initial.resize(n);
+	transitions.resize(n * n);
+	emissions.resize(n * m);
+	hmm.CopyParameters(initial.data(), transitions.data(), emissions.data());
+	pi.clear();
+	A.clear();
+	B.clear();
+	for(i = 0; i < n; i++){
+		pi[hmm.GetStateName(i)] = initial[i];
+		for(j = 0; j < n; j++){
+			A[hmm.GetStateName(i)][hmm.GetStateName(j)] = transitions[i * n + j];
+		}
+		for(j = 0; j < m; j++){
+			B[hmm.GetStateName(i)][hmm.GetSymbolName(j)] = emissions[i * m + j];
+		}
+	}
+}
+
+/*
+Models trained on the same counts must have identical parameters, whatever the order of their ids.
+*/
+int checkSameModel(DiscreteHmm& expected, DiscreteHmm& result, const string& description)
+{
+	map<string,double> expectedPi, resultPi;
+	map<string,map<string,double> > expectedA, resultA, expectedB, resultB;
+
+	namedParameters(expected, expectedPi, expectedA, expectedB);
+	namedParameters(result, resultPi, resultA, resultB);
+	if(expectedPi.empty() || expectedPi != resultPi || expectedA != resultA || expectedB != resultB){
+		cout << "FAIL " << description << ": models differ" << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+string readFile(const string& path)
+{
+	ifstream file(path.c_str());
+	ostringstream contents;
+
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+/*
+Splits the labelled file @path into its first @numLines lines (@pathA) and the rest (@pathB), and writes both
+to @pathAB as two sequences separated by a blank line.
+*/
+void splitLabeledFile(const string& path, const int numLines, const string& pathA, const string& pathB, const string& pathAB)
+{
+	int i;
+	string line;
+	ifstream in(path.c_str());
+	ofstream a(pathA.c_str()), b(pathB.c_str()), ab(pathAB.c_str());
+
+	for(i = 0; getline(in, line); i++){
+		if(i == numLines){
+			ab << "\n";
+		}
+		(i < numLines ? a : b) << line << "\n";
+		ab << line << "\n";
+	}
+}
+
+/*
+Incremental direct training, and counts written by separate jobs and merged, must give the model trained on all
+the data at once; and counts must survive a WriteCounts()/ReadCounts() round trip exactly.
+*/
+int checkIncrementalTraining(const string& path)
+{
+	int failures = 0;
+	DiscreteHmmDataset dataset;
+	DiscreteHmm all, parts, merged, reread;
+
+	splitLabeledFile(path, 40000, "testA.txt", "testB.txt", "testAB.txt");
+	dataset.BuildLabeledDataset("testAB.txt");
+	all.DirectTrain(dataset);
+
+	dataset.Clear();
+	dataset.BuildLabeledDataset("testA.txt");
+	parts.DirectTrain(dataset);
+	parts.WriteCounts("testA.counts");
+	dataset.Clear();
+	dataset.BuildLabeledDataset("testB.txt");
+	parts.UpdateDirectTrain(dataset);
+	failures += checkSameModel(all, parts, "DirectTrain(A) + UpdateDirectTrain(B)");
+
+	//a second job counts B alone
+	merged.DirectTrain(dataset);
+	merged.WriteCounts("testB.counts");
+	dataset.Clear();
+	if(!merged.ReadCounts("testA.counts") || !merged.MergeCounts("testB.counts")){
+		cout << "FAIL could not read the counts files" << endl;
+		failures++;
+	}
+	failures += checkSameModel(all, merged, "ReadCounts(A) + MergeCounts(B)");
+
+	all.WriteCounts("testAB.counts");
+	if(!reread.ReadCounts("testAB.counts")){
+		cout << "FAIL could not read testAB.counts" << endl;
+		failures++;
+	}
+	failures += checkSameModel(all, reread, "WriteCounts()/ReadCounts()");
+	reread.WriteCounts("testAB2.counts");
+	if(readFile("testAB.counts") != readFile("testAB2.counts")){
+		cout << "FAIL counts differ after a WriteCounts()/ReadCounts() round trip" << endl;
+		failures++;
+	}
+
+	remove("testA.txt");
+	remove("testB.txt");
+	remove("testAB.txt");
+	remove("testA.counts");
+	remove("testB.counts");
+	remove("testAB.counts");
+	remove("testAB2.counts");
+
+	return failures;
+}
+
 int main(int argc, char** argv)
 {
+	int failures = 0;
 	DiscreteHmm hmm("test.hmm");
 
 	//Verify model can be written
@@ -18,15 +154,27 @@ int main(int argc, char** argv)
 
 	//Build hidden and emission models directly from a labelled dataset
 	hmm.DirectTrain(dataset);
-	hmm.Clear();
 	dataset.Clear();
 
+	//Build the same models by streaming the labelled file through the sharded counter: with small chunks, so
+	//many transitions span chunk boundaries, and with more threads than cores
+	DiscreteHmm streamed;
+	streamed.StreamingDirectTrain("./data/data_100000_Points.txt", 3, 997);
+	failures += checkSameModel(hmm, streamed, "StreamingDirectTrain, 3 threads");
+	streamed.StreamingDirectTrain("./data/data_100000_Points.txt", 1, 1 << 16);
+	failures += checkSameModel(hmm, streamed, "StreamingDirectTrain, 1 thread");
+	hmm.Clear();
+
+	failures += checkIncrementalTraining("./data/data_100000_Points.txt");
+
 
 	//test BaumWelch on unlabeled data
 	dataset.BuildUnlabeledDataset("./data/unlabeled_100000_Points.txt");
 	hmm.BaumWelch(dataset,2);
 
+	if(failures == 0){
+		cout << "PASS all training tests" << endl;
+	}
 
-	return 0;
+	return failures;
 }
-
@@ -0,0 +1,213 @@
+#include "DistributedBaumWelch.hpp"
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+Verifies distributed Baum-Welch against the same iterations run in one process: workers are forked on a Unix
+socket, and the coordinator's model must be that of AccumulateExpectedCounts() over every shard (each shard an
+independent sequence) followed by MaximizeExpectedCounts(). The shards list their symbols in different orders, and
+one has a symbol the other lacks, so every worker's symbols must be remapped to the coordinator's ids. A worker
+whose shard is over its memory budget must fail the training, rather than leave its shard out of the counts.
+*/
+
+static const int numStates = 3;
+static const int numIterations = 4;
+
+void writeShard(const string& path, const string& symbols, const int length)
+{
+	ofstream out(path.c_str());
+
+	for(int i = 0; i < length; i++){
+		out << symbols[ rand() % symbols.size() ] << "\n";
+	}
+}
+
+/*
+Runs the training in this process, from the model in @initialPath.
+*/
+void trainLocally(const string& initialPath, const vector<string>& shards, DiscreteHmm& hmm)
+{
+	int i, j, iteration;
+	HmmCounts counts;
+	vector<vector<int> > observations(shards.size());
+
+	hmm.SetVerbose(false);
+	hmm.ReadModel(initialPath);
+	for(i = 0; i < shards.size(); i++){
+		DiscreteHmmDataset dataset(shards[i], false);
+		for(j = 0; j < dataset.UnlabeledDataSequence.size(); j++){
+			observations[i].push_back(hmm.GetSymbolId(dataset.GetSymbol(dataset.UnlabeledDataSequence[j])));
+		}
+	}
+	for(iteration = 0; iteration < numIterations; iteration++){
+		counts.Clear();
+		counts.Resize(hmm.NumStates(), hmm.NumSymbols());
+		for(i = 0; i < observations.size(); i++){
+			hmm.AccumulateExpectedCounts(observations[i], counts);
+		}
+		hmm.MaximizeExpectedCounts(counts);
+	}
+}
+
+/*
+Runs a coordinator in this process and a forked worker per shard, then compares the trained model with the
+local one. The coordinator writes its model to six significant digits, which bounds the agreement.
+*/
+int checkDistributed(const string& initialPath, const vector<string>& shards, const string& description)
+{
+	int i, j, status, failures = 0;
+	double expected, result;
+	string socketPath, outputPath;
+	vector<pid_t> workers;
+	vector<double> expectedParams[3], resultParams[3];
+	DiscreteHmm local, trained;
+
+	socketPath = "/tmp/distributedTest." + to_string(getpid()) + ".sock";
+	outputPath = "distributedTest.hmm";
+	cout.flush();
+	for(i = 0; i < shards.size(); i++){
+		pid_t pid = fork();
+		if(pid == 0){
+			DistributedBaumWelch worker;
+			_exit(worker.RunWorker(socketPath, shards[i]) ? 0 : 1);
+		}
+		workers.push_back(pid);
+	}
+
+	DistributedBaumWelch coordinator;
+	coordinator.SetMaxIterations(numIterations);
+	coordinator.SetConvergence(-numeric_limits<double>::infinity());
+	coordinator.SetInitialModel(initialPath);
+	if(!coordinator.RunCoordinator(socketPath, shards.size(), numStates, outputPath)){
+		cout << "FAIL distributed " << description << ": coordinator failed" << endl;
+		failures++;
+	}
+	for(i = 0; i < workers.size(); i++){
+		if(waitpid(workers[i], &status, 0) != workers[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+			cout << "FAIL distributed " << description << ": worker " << i << " failed" << endl;
+			failures++;
+		}
+	}
+	if(failures > 0){
+		return failures;
+	}
+
+	trainLocally(initialPath, shards, local);
+	trained.SetVerbose(false);
+	trained.ReadModel(outputPath);
+	remove(outputPath.c_str());
+	if(trained.NumStates() != local.NumStates() || trained.NumSymbols() != local.NumSymbols()){
+		cout << "FAIL distributed " << description << ": model dimensions differ" << endl;
+		return 1;
+	}
+	for(i = 0; i < local.NumSymbols(); i++){
+		if(trained.GetSymbolName(i) != local.GetSymbolName(i)){
+			cout << "FAIL distributed " << description << ": symbol " << i << " is " << trained.GetSymbolName(i) << ", not " << local.GetSymbolName(i) << endl;
+			return 1;
+		}
+	}
+
+	for(i = 0; i < 3; i++){
+		expectedParams[i].resize(numStates * max(numStates, local.NumSymbols()));
+		resultParams[i].resize(expectedParams[i].size());
+	}
+	local.CopyParameters(expectedParams[0].data(), expectedParams[1].data(), expectedParams[2].data());
+	trained.CopyParameters(resultParams[0].data(), resultParams[1].data(), resultParams[2].data());
+	for(i = 0; i < 3; i++){
+		for(j = 0; j < expectedParams[i].size(); j++){
+			expected = exp(expectedParams[i][j]);
+			result = exp(resultParams[i][j]);
+			if(fabs(expected - result) > 1E-5 * expected + 1E-12){
+				cout << "FAIL distributed " << description << ", parameter " << i << "," << j << ": " << result << " != " << expected << endl;
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+/*
+Runs a coordinator with a worker per shard, the last of which has too small a memory budget for its E-step:
+the coordinator must fail, and write no model.
+*/
+int checkWorkerFailure(const string& initialPath, const vector<string>& shards)
+{
+	int i, status, failures = 0;
+	string socketPath, outputPath;
+	vector<pid_t> workers;
+
+	socketPath = "/tmp/distributedTest." + to_string(getpid()) + ".sock";
+	outputPath = "distributedTestFailed.hmm";
+	remove(outputPath.c_str());
+	cout.flush();
+	for(i = 0; i < shards.size(); i++){
+		pid_t pid = fork();
+		if(pid == 0){
+			DistributedBaumWelch worker;
+			if(i == shards.size() - 1){
+				worker.SetMemoryBudget(1);
+			}
+			_exit(worker.RunWorker(socketPath, shards[i]) ? 0 : 1);
+		}
+		workers.push_back(pid);
+	}
+
+	DistributedBaumWelch coordinator;
+	coordinator.SetMaxIterations(numIterations);
+	coordinator.SetInitialModel(initialPath);
+	if(coordinator.RunCoordinator(socketPath, shards.size(), numStates, outputPath)){
+		cout << "FAIL distributed training succeeded with a failed worker" << endl;
+		failures++;
+	}
+	for(i = 0; i < workers.size(); i++){
+		waitpid(workers[i], &status, 0);
+		if(i == workers.size() - 1 && (!WIFEXITED(status) || WEXITSTATUS(status) == 0)){
+			cout << "FAIL worker over its memory budget did not report a failure" << endl;
+			failures++;
+		}
+	}
+	if(ifstream(outputPath.c_str()).good()){
+		cout << "FAIL a model was written despite a failed worker" << endl;
+		remove(outputPath.c_str());
+		failures++;
+	}
+
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	int failures = 0;
+	vector<string> symbols, shards;
+	DiscreteHmm initial;
+
+	srand(12345);
+	writeShard("distributedTest0.dat", "abc", 400);
+	writeShard("distributedTest1.dat", "dbbd", 250);
+	//the initial model's symbol order differs from both shards'
+	symbols.push_back("c");
+	symbols.push_back("d");
+	symbols.push_back("a");
+	symbols.push_back("b");
+	initial.SetVerbose(false);
+	initial.InitRandomModel(symbols, numStates);
+	initial.WriteModel("distributedTestInitial.hmm", false);
+
+	shards.push_back("distributedTest1.dat");
+	failures += checkDistributed("distributedTestInitial.hmm", shards, "1 worker");
+	shards.push_back("distributedTest0.dat");
+	failures += checkDistributed("distributedTestInitial.hmm", shards, "2 workers");
+	failures += checkWorkerFailure("distributedTestInitial.hmm", shards);
+
+	remove("distributedTest0.dat");
+	remove("distributedTest1.dat");
+	remove("distributedTestInitial.hmm");
+
+	if(failures == 0){
+		cout << "PASS all distributed training tests" << endl;
+	}
+
+	return failures;
+}
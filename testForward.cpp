@@ -0,0 +1,634 @@
+#include "Hmm.hpp"
+
+#include <sstream>
+
+/*
+Verifies the variants of the forward algorithm against ForwardAlgorithm():
+	-batched forward over ragged batches of sequences, on test.hmm and on random models
+	-sliding-window scores against the forward algorithm on each window, for both the block and per-window paths
+	-incremental forward, one observation at a time and in batches, against the forward algorithm at every length
+	-prefix-cached forward against the uncached algorithm, across evictions, a model update and a log-math switch
+	-emission-pruned forward, backward, Viterbi, posterior decoding and E-step against the full recurrences, on a
+	 model where each symbol is emitted by few states
+	-Baum-Welch with the fused E-step against the original one, on data drawn from test.hmm and a many-symbol model
+	-accelerated Baum-Welch: the likelihood never decreases from cycle to cycle, and converges at least as high as
+	 plain EM's, from several random starts
+	-Viterbi training improves on its random start, and Baum-Welch refinement does not undo that; decoding failures
+	 are reported rather than trained on
+*/
+
+void randomSequence(vector<int>& observations, int length, int numSymbols)
+{
+	observations.resize(length);
+	for(int i = 0; i < length; i++){
+		observations[i] = rand() % numSymbols;
+	}
+}
+
+//the batched forward computes in scaled linear space, so agreement is to rounding, relative to the magnitude
+bool closeEnough(double expected, double result)
+{
+	if(isinf(expected) || isinf(result)){
+		return expected == result;
+	}
+	return fabs(expected - result) <= 1E-9 * max(1.0, fabs(expected));
+}
+
+int checkBatchForward(DiscreteHmm& hmm, int numSequences, int maxLength, int batchWidth, const string& description)
+{
+	int i, failures = 0;
+	double expected;
+	vector<vector<int> > sequences(numSequences);
+	vector<double> output;
+
+	for(i = 0; i < numSequences; i++){
+		randomSequence(sequences[i], rand() % (maxLength + 1), hmm.NumSymbols());
+	}
+	hmm.BatchForward(sequences, output, batchWidth);
+	for(i = 0; i < numSequences; i++){
+		expected = sequences[i].size() > 0 ? hmm.ForwardAlgorithm(sequences[i], sequences[i].size()-1) : 0;
+		if(!closeEnough(expected, output[i])){
+			cout << "FAIL batch forward " << description << ", sequence " << i << " length " << sequences[i].size() << ": " << output[i] << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+int checkSlidingWindow(DiscreteHmm& hmm, int length, int windowLength, const string& description)
+{
+	int s, failures = 0;
+	double expected;
+	vector<int> observations, window;
+	vector<double> output;
+
+	randomSequence(observations, length, hmm.NumSymbols());
+	hmm.SlidingWindowForward(observations, windowLength, output);
+	if(output.size() != max(0, length - windowLength + 1)){
+		cout << "FAIL sliding window " << description << ": " << output.size() << " windows" << endl;
+		return 1;
+	}
+	for(s = 0; s < output.size(); s++){
+		window.assign(observations.begin() + s, observations.begin() + s + windowLength);
+		expected = hmm.ForwardAlgorithm(window, window.size()-1);
+		if(!closeEnough(expected, output[s])){
+			cout << "FAIL sliding window " << description << ", window " << s << " of length " << windowLength << ": " << output[s] << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+/*
+Extends a sequence one observation at a time and in random batches; after every call, the score must be that of
+ForwardAlgorithm() on the observations so far. Retraining the model in between must make ExtendForward() refuse
+to continue until ResetForward().
+*/
+int checkExtendForward(DiscreteHmm& hmm, int length, const string& description)
+{
+	int i, n, failures = 0;
+	double expected, result;
+	vector<int> observations, batch;
+	DiscreteHmm incremental = hmm;
+	HmmCounts counts;
+
+	randomSequence(observations, length, hmm.NumSymbols());
+	incremental.ResetForward();
+	for(i = 0; i < length; i++){
+		result = incremental.ExtendForward(observations[i]);
+		expected = hmm.ForwardAlgorithm(observations, i);
+		if(!closeEnough(expected, result) || incremental.ForwardLength() != i + 1){
+			cout << "FAIL extend forward " << description << ", one at a time, length " << i + 1 << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	incremental.ResetForward();
+	for(i = 0; i < length; i += n){
+		n = min(length - i, 1 + rand() % 50);
+		batch.assign(observations.begin() + i, observations.begin() + i + n);
+		result = incremental.ExtendForward(batch);
+		expected = hmm.ForwardAlgorithm(observations, i + n - 1);
+		if(!closeEnough(expected, result) || incremental.ForwardLength() != i + n){
+			cout << "FAIL extend forward " << description << ", batches, length " << i + n << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	counts.Resize(hmm.NumStates(), hmm.NumSymbols());
+	incremental.AccumulateExpectedCounts(observations, counts);
+	incremental.MaximizeExpectedCounts(counts);
+	if(incremental.ExtendForward(observations[0]) != 1){
+		cout << "FAIL extend forward " << description << ": continued after the model was retrained" << endl;
+		failures++;
+	}
+	incremental.ResetForward();
+	result = incremental.ExtendForward(observations);
+	expected = incremental.ForwardAlgorithm(observations, length - 1);
+	if(!closeEnough(expected, result)){
+		cout << "FAIL extend forward " << description << ", after retraining and reset: " << result << " != " << expected << endl;
+		failures++;
+	}
+
+	return failures;
+}
+
+/*
+Queries built from a few shared prefixes and random tails must score bit-identically with and without the cache.
+Halfway through, both models are updated with the same counts, which must invalidate the cached columns.
+*/
+int checkPrefixCache(DiscreteHmm& hmm, unsigned long long budgetBytes, const string& description)
+{
+	int i, t, failures = 0;
+	double expected, result;
+	vector<int> observations, tail;
+	vector<vector<int> > prefixes(5);
+	DiscreteHmm cached = hmm;
+	HmmCounts counts;
+
+	counts.Resize(hmm.NumStates(), hmm.NumSymbols());
+	cached.SetPrefixCache(budgetBytes, 64);
+	for(i = 0; i < prefixes.size(); i++){
+		randomSequence(prefixes[i], rand() % 100, hmm.NumSymbols());
+	}
+	for(i = 0; i < 400; i++){
+		if(i == 200){
+			//every symbol is seen, so none gets probability zero
+			randomSequence(observations, 50 + hmm.NumSymbols(), hmm.NumSymbols());
+			for(t = 0; t < hmm.NumSymbols(); t++){
+				observations[t] = t;
+			}
+			expected = hmm.ForwardAlgorithm(observations, observations.size()-1);
+			hmm.AccumulateExpectedCounts(observations, counts);
+			hmm.MaximizeExpectedCounts(counts);
+			cached.MaximizeExpectedCounts(counts);
+			//otherwise the stale columns would give the right answer, and invalidation would go untested
+			if(hmm.NumStates() > 1 && hmm.ForwardAlgorithm(observations, observations.size()-1) == expected){
+				cout << "FAIL prefix cache " << description << ": the model update did not change the model" << endl;
+				failures++;
+			}
+		}
+		observations = prefixes[rand() % prefixes.size()];
+		randomSequence(tail, 1 + rand() % 30, hmm.NumSymbols());
+		observations.insert(observations.end(), tail.begin(), tail.end());
+		t = rand() % 4 == 0 ? rand() % observations.size() : observations.size() - 1;
+		expected = hmm.ForwardAlgorithm(observations, t);
+		result = cached.ForwardAlgorithm(observations, t);
+		if(expected != result){
+			cout << "FAIL prefix cache " << description << ", query " << i << " t=" << t << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+/*
+Columns cached in one log-math mode must not be reused in another: after switching from the fast mode back to the
+exact one, a cached model must score bit-identically to an uncached one, and incremental forward must restart.
+*/
+int checkLogMathSwitch(DiscreteHmm& hmm, int length, const string& description)
+{
+	int failures = 0;
+	double expected, result;
+	vector<int> observations;
+	DiscreteHmm cached = hmm;
+
+	randomSequence(observations, length, hmm.NumSymbols());
+	cached.SetPrefixCache(1ULL << 28, length);
+	cached.SetLogMath(LOGMATH_FAST, 1E-3);
+	cached.ForwardAlgorithm(observations, length - 1);
+	cached.ResetForward();
+	cached.ExtendForward(observations);
+	cached.SetLogMath(LOGMATH_EXACT);
+
+	expected = hmm.ForwardAlgorithm(observations, length - 1);
+	result = cached.ForwardAlgorithm(observations, length - 1);
+	if(expected != result){
+		cout << "FAIL log math switch " << description << ", prefix cache: " << result << " != " << expected << endl;
+		failures++;
+	}
+	if(cached.ExtendForward(observations[0]) != 1){
+		cout << "FAIL log math switch " << description << ": incremental forward continued after the switch" << endl;
+		failures++;
+	}
+
+	return failures;
+}
+
+/*
+Builds a random model (via ReadParameters()) in which each symbol can only be emitted by the states congruent
+to it modulo @stride, like a tagging model's dictionary.
+*/
+void sparseEmissionModel(DiscreteHmm& hmm, int numStates, int numSymbols, int stride)
+{
+	int i, j;
+	double sum;
+	vector<double> row;
+	stringstream params;
+
+	params.precision(17);
+	params << numStates << " " << numSymbols << "\n";
+	for(i = 0; i < numStates; i++){
+		params << log(1.0 / numStates) << " ";
+	}
+	params << "\n";
+	for(i = 0; i < numStates; i++){
+		row.resize(numStates);
+		for(j = 0, sum = 0; j < numStates; j++){
+			row[j] = 1 + rand() % 100;
+			sum += row[j];
+		}
+		for(j = 0; j < numStates; j++){
+			params << log(row[j] / sum) << " ";
+		}
+		params << "\n";
+	}
+	for(i = 0; i < numStates; i++){
+		row.assign(numSymbols, 0);
+		for(j = i % stride, sum = 0; j < numSymbols; j += stride){
+			row[j] = 1 + rand() % 100;
+			sum += row[j];
+		}
+		for(j = 0; j < numSymbols; j++){
+			params << (row[j] > 0 ? log(row[j] / sum) : -numeric_limits<double>::infinity()) << " ";
+		}
+		params << "\n";
+	}
+	hmm.ReadParameters(params);
+}
+
+/*
+Pruning must not change any probability, Viterbi path or expected count: the pruned terms are exactly zero.
+*/
+int checkEmissionPruning(int numStates, int numSymbols, int stride, const string& description)
+{
+	int i, failures = 0;
+	double full, pruned;
+	vector<int> observations, fullPath, prunedPath;
+	vector<double> fullLattice, prunedLattice;
+	DiscreteHmm hmm;
+	HmmCounts fullCounts, prunedCounts;
+
+	hmm.SetVerbose(false);
+	sparseEmissionModel(hmm, numStates, numSymbols, stride);
+	fullCounts.Resize(numStates, numSymbols);
+	prunedCounts.Resize(numStates, numSymbols);
+	for(i = 0; i < 50; i++){
+		randomSequence(observations, 1 + rand() % 200, numSymbols);
+
+		hmm.SetEmissionPruning(false);
+		full = hmm.ForwardAlgorithm(observations, observations.size()-1);
+		hmm.SetEmissionPruning(true);
+		pruned = hmm.ForwardAlgorithm(observations, observations.size()-1);
+		if(full != pruned){
+			cout << "FAIL emission pruning " << description << ", forward, length " << observations.size() << ": " << pruned << " != " << full << endl;
+			failures++;
+		}
+
+		//the whole beta lattice, including the states which cannot emit their observation
+		fullLattice.resize(observations.size() * numStates);
+		prunedLattice.resize(fullLattice.size());
+		hmm.SetEmissionPruning(false);
+		full = hmm.BackwardAlgorithm(observations, 0);
+		hmm.CopyBackwardLattice(fullLattice.data(), observations.size());
+		hmm.SetEmissionPruning(true);
+		pruned = hmm.BackwardAlgorithm(observations, 0);
+		hmm.CopyBackwardLattice(prunedLattice.data(), observations.size());
+		if(full != pruned || fullLattice != prunedLattice){
+			cout << "FAIL emission pruning " << description << ", backward, length " << observations.size() << ": " << pruned << " != " << full << endl;
+			failures++;
+		}
+
+		hmm.SetEmissionPruning(false);
+		full = hmm.Viterbi(observations, observations.size(), fullPath);
+		hmm.SetEmissionPruning(true);
+		pruned = hmm.Viterbi(observations, observations.size(), prunedPath);
+		if(full != pruned || fullPath != prunedPath){
+			cout << "FAIL emission pruning " << description << ", Viterbi, length " << observations.size() << ": " << pruned << " != " << full << endl;
+			failures++;
+		}
+
+		hmm.SetEmissionPruning(false);
+		hmm.PosteriorDecode(observations, fullPath);
+		hmm.AccumulateExpectedCounts(observations, fullCounts);
+		hmm.SetEmissionPruning(true);
+		hmm.PosteriorDecode(observations, prunedPath);
+		hmm.AccumulateExpectedCounts(observations, prunedCounts);
+		if(fullPath != prunedPath){
+			cout << "FAIL emission pruning " << description << ", posterior decoding, length " << observations.size() << endl;
+			failures++;
+		}
+	}
+	if(fullCounts.Initial != prunedCounts.Initial || fullCounts.Transitions != prunedCounts.Transitions || fullCounts.Emissions != prunedCounts.Emissions || fullCounts.LogLikelihood != prunedCounts.LogLikelihood){
+		cout << "FAIL emission pruning " << description << ", expected counts" << endl;
+		failures++;
+	}
+
+	return failures;
+}
+
+/*
+Draws @length observations from @hmm.
+*/
+void sampleSequence(DiscreteHmm& hmm, int length, vector<int>& observations)
+{
+	int t, state, n, m;
+	vector<double> initial, transitions, emissions;
+
+	n = hmm.NumStates();
+	m = hmm.NumSymbols();
+	initial.resize(n);
+	transitions.resize(n * n);
+	emissions.resize(n * m);
+	hmm.CopyParameters(initial.data(), transitions.data(), emissions.data());
+	//picks an index of a row of n ln-probabilities
+	auto draw = [](const double* row, int n){
+		int i;
+		double r = (double)rand() / ((double)RAND_MAX + 1);
+		for(i = 0; i < n - 1 && (r -= exp(row[i])) >= 0; i++);
+		return i;
+	};
+
+	observations.resize(length);
+	state = draw(initial.data(), n);
+	for(t = 0; t < length; t++){
+		if(t > 0){
+			state = draw(transitions.data() + state * n, n);
+		}
+		observations[t] = draw(emissions.data() + state * m, m);
+	}
+}
+
+/*
+An unlabelled dataset of @length observations drawn from @hmm, with its symbols in the model's order.
+*/
+void sampleDataset(DiscreteHmm& hmm, int length, DiscreteHmmDataset& dataset)
+{
+	dataset.Clear();
+	for(int i = 0; i < hmm.NumSymbols(); i++){
+		dataset.AddSymbol(hmm.GetSymbolName(i));
+	}
+	sampleSequence(hmm, length, dataset.UnlabeledDataSequence);
+}
+
+/*
+Models which should have the same parameters, to within @tolerance relative in ln-space.
+*/
+int checkSameParameters(DiscreteHmm& expected, DiscreteHmm& result, double tolerance, const string& description)
+{
+	int i, j, n, m, failures = 0;
+	vector<double> expectedParams[3], resultParams[3];
+
+	n = expected.NumStates();
+	m = expected.NumSymbols();
+	if(result.NumStates() != n || result.NumSymbols() != m){
+		cout << "FAIL " << description << ": model dimensions differ" << endl;
+		return 1;
+	}
+	for(i = 0; i < 3; i++){
+		expectedParams[i].resize(n * max(n, m));
+		resultParams[i].resize(n * max(n, m));
+	}
+	expected.CopyParameters(expectedParams[0].data(), expectedParams[1].data(), expectedParams[2].data());
+	result.CopyParameters(resultParams[0].data(), resultParams[1].data(), resultParams[2].data());
+	for(i = 0; i < 3; i++){
+		for(j = 0; j < expectedParams[i].size(); j++){
+			if(fabs(expectedParams[i][j] - resultParams[i][j]) > tolerance * max(1.0, fabs(expectedParams[i][j]))){
+				cout << "FAIL " << description << ", parameter " << i << "," << j << ": " << resultParams[i][j] << " != " << expectedParams[i][j] << endl;
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+/*
+The fused E-step and the original one (beta lattice and xi matrices, bucketed M-step) must train the same model
+from the same random start, to rounding. Every iteration is run, so both take the same number.
+*/
+int checkFusedEStep(DiscreteHmm& source, int numStates, int length, const string& description)
+{
+	DiscreteHmmDataset dataset;
+	DiscreteHmm fused, original;
+
+	sampleDataset(source, length, dataset);
+	fused.SetVerbose(false);
+	fused.SetRandomSeed(7);
+	fused.SetTrainingLimits(5, -numeric_limits<double>::infinity());
+	original = fused;
+	original.SetFusedEStep(false);
+	fused.BaumWelch(dataset, numStates);
+	original.BaumWelch(dataset, numStates);
+
+	return checkSameParameters(original, fused, 1E-9, "fused E-step " + description);
+}
+
+/*
+The safeguards of accelerated EM: from each random start, the likelihood after every cycle is at least that after
+the previous one (observed by running the same deterministic training for more and more passes), and at convergence
+the model is at least as likely as the one plain EM converges to from the same start.
+*/
+int checkAcceleratedEM(DiscreteHmm& source, int numStates, int length, const string& description)
+{
+	int seed, passes, failures = 0;
+	double previous, likelihood, plain, accelerated;
+	DiscreteHmmDataset dataset;
+	DiscreteHmm hmm;
+	const vector<int>& observations = dataset.UnlabeledDataSequence;
+
+	sampleDataset(source, length, dataset);
+	hmm.SetVerbose(false);
+	for(seed = 1; seed <= 4; seed++){
+		hmm.SetRandomSeed(seed);
+		hmm.SetAcceleratedEM(true);
+		previous = -numeric_limits<double>::infinity();
+		for(passes = 1; passes <= 30; passes++){
+			hmm.SetTrainingLimits(passes, -numeric_limits<double>::infinity());
+			likelihood = hmm.BaumWelch(dataset, numStates);
+			if(likelihood < previous - 1E-9 * fabs(previous)){
+				cout << "FAIL accelerated EM " << description << ", seed " << seed << ": likelihood fell from " << previous << " to " << likelihood << " at " << passes << " passes" << endl;
+				failures++;
+			}
+			previous = likelihood;
+		}
+
+		hmm.SetTrainingLimits(2000, 1E-9);
+		hmm.BaumWelch(dataset, numStates);
+		accelerated = hmm.ForwardAlgorithm(observations, observations.size()-1);
+		hmm.SetAcceleratedEM(false);
+		hmm.BaumWelch(dataset, numStates);
+		plain = hmm.ForwardAlgorithm(observations, observations.size()-1);
+		if(accelerated < plain - 1E-6 * fabs(plain)){
+			cout << "FAIL accelerated EM " << description << ", seed " << seed << ": converged to " << accelerated << ", plain EM to " << plain << endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+/*
+ViterbiTrain() must end more likely than the random model it starts from (the same one InitRandomModel() draws
+for the seed), with and without Baum-Welch refinement, and report an error if the path cannot be decoded, or if
+the budget fits the checkpointed decoding but not the alpha lattice the refinement needs.
+*/
+int checkViterbiTrain(DiscreteHmm& source, int numStates, int length, const string& description)
+{
+	int seed, failures = 0;
+	double initial, trained, refined;
+	vector<string> symbols;
+	DiscreteHmmDataset dataset;
+	DiscreteHmm hmm;
+	const vector<int>& observations = dataset.UnlabeledDataSequence;
+
+	sampleDataset(source, length, dataset);
+	for(seed = 0; seed < source.NumSymbols(); seed++){
+		symbols.push_back(source.GetSymbolName(seed));
+	}
+	hmm.SetVerbose(false);
+	for(seed = 1; seed <= 4; seed++){
+		hmm.SetRandomSeed(seed);
+		hmm.InitRandomModel(symbols, numStates);
+		initial = hmm.ForwardAlgorithm(observations, observations.size()-1);
+		trained = hmm.ViterbiTrain(dataset, numStates);
+		refined = hmm.ViterbiTrain(dataset, numStates, 10);
+		if(!(trained > initial && refined >= trained - 1E-9 * fabs(trained))){
+			cout << "FAIL Viterbi training " << description << ", seed " << seed << ": ln P from " << initial << " to " << trained << ", refined " << refined << endl;
+			failures++;
+		}
+	}
+
+	//room for the checkpointed decoding, but not for a full alpha lattice
+	hmm.SetMemoryBudget(hmm.EstimateMemory(MEMORY_FORWARD, numStates, source.NumSymbols(), length) / 2);
+	trained = hmm.ViterbiTrain(dataset, numStates);
+	if(!(trained <= 0 && isfinite(trained))){
+		cout << "FAIL Viterbi training " << description << ": ln P " << trained << " with a checkpointed decoding" << endl;
+		failures++;
+	}
+	for(seed = 0; seed < 2; seed++){
+		hmm.SetAcceleratedEM(seed == 1);
+		if(hmm.ViterbiTrain(dataset, numStates, 3) != 1){
+			cout << "FAIL Viterbi training " << description << ": no error for a refinement over the memory budget" << endl;
+			failures++;
+		}
+	}
+	hmm.SetAcceleratedEM(false);
+	hmm.SetMemoryBudget(0);
+	if(!isfinite(hmm.ForwardAlgorithm(observations, observations.size()-1))){
+		cout << "FAIL Viterbi training " << description << ": model not left finite after a failed refinement" << endl;
+		failures++;
+	}
+
+	//too small a budget for any decoding
+	hmm.SetMemoryBudget(1);
+	if(hmm.ViterbiTrain(dataset, numStates) != 1){
+		cout << "FAIL Viterbi training " << description << ": no error for a failed decoding" << endl;
+		failures++;
+	}
+
+	return failures;
+}
+
+/*
+StreamingBaumWelch() must train on a file of short sequences and a long one, and fail, rather than train on the
+rest, once the long one no longer fits the memory budget.
+*/
+int checkStreamingBudget(DiscreteHmm& source, int numStates, int longLength, const string& description)
+{
+	int i, t, failures = 0;
+	double pObs;
+	vector<int> observations;
+	DiscreteHmm hmm;
+
+	ofstream out("forwardTestStream.txt");
+	for(i = 0; i < 20; i++){
+		sampleSequence(source, i < 19 ? 50 : longLength, observations);
+		for(t = 0; t < observations.size(); t++){
+			out << source.GetSymbolName(observations[t]) << "\n";
+		}
+		out << "\n";
+	}
+	out.close();
+
+	hmm.SetVerbose(false);
+	hmm.SetTrainingLimits(3, -numeric_limits<double>::infinity());
+	pObs = hmm.StreamingBaumWelch("forwardTestStream.txt", numStates, 8);
+	if(!(pObs <= 0 && isfinite(pObs))){
+		cout << "FAIL streaming Baum-Welch " << description << ": ln P " << pObs << endl;
+		failures++;
+	}
+	//room for the short sequences' lattices, but not the long one's
+	hmm.SetMemoryBudget(hmm.EstimateMemory(MEMORY_FORWARD, numStates, source.NumSymbols(), longLength) / 2);
+	for(i = 0; i < 2; i++){
+		hmm.SetAcceleratedEM(i == 1);
+		if(hmm.StreamingBaumWelch("forwardTestStream.txt", numStates, 8) != 1){
+			cout << "FAIL streaming Baum-Welch " << description << (i == 1 ? ", accelerated" : "") << ": no error for a sequence over the memory budget" << endl;
+			failures++;
+		}
+	}
+	remove("forwardTestStream.txt");
+
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	int i, failures = 0;
+	vector<string> symbols;
+	DiscreteHmm hmm("test.hmm");
+
+	srand(12345);
+	hmm.SetVerbose(false);
+
+	failures += checkBatchForward(hmm, 500, 200, 64, "test.hmm");
+	failures += checkBatchForward(hmm, 37, 3000, 8, "test.hmm long sequences");
+	//window lengths which do and do not divide the sequence, a single window, no windows, and windows of one
+	failures += checkSlidingWindow(hmm, 1000, 50, "test.hmm");
+	failures += checkSlidingWindow(hmm, 1003, 7, "test.hmm");
+	failures += checkSlidingWindow(hmm, 40, 40, "test.hmm");
+	failures += checkSlidingWindow(hmm, 10, 11, "test.hmm");
+	failures += checkSlidingWindow(hmm, 100, 1, "test.hmm");
+	failures += checkExtendForward(hmm, 300, "test.hmm");
+	failures += checkPrefixCache(hmm, 1 << 20, "test.hmm");
+	failures += checkLogMathSwitch(hmm, 2000, "test.hmm");
+
+	//each symbol emitted by half of the states, the least sparse model that is pruned, and by a sixteenth of them
+	failures += checkEmissionPruning(12, 30, 2, "12 states, 6 per symbol");
+	failures += checkEmissionPruning(64, 500, 16, "64 states, 4 per symbol");
+
+	failures += checkFusedEStep(hmm, 2, 1000, "test.hmm");
+	failures += checkAcceleratedEM(hmm, 2, 500, "test.hmm");
+	failures += checkViterbiTrain(hmm, 2, 2000, "test.hmm");
+	failures += checkStreamingBudget(hmm, 2, 2000, "test.hmm");
+
+	//random models, with state counts that are not a multiple of the GEMM tile
+	int numStates[] = {1, 5, 70};
+	for(i = 0; i < 20; i++){
+		symbols.push_back(to_string(i));
+	}
+	for(i = 0; i < 3; i++){
+		DiscreteHmm random;
+		random.SetVerbose(false);
+		random.InitRandomModel(symbols, numStates[i]);
+		failures += checkBatchForward(random, 100, 300, 32, "random model, " + to_string(numStates[i]) + " states");
+		failures += checkSlidingWindow(random, 500, 3, "random model, " + to_string(numStates[i]) + " states");
+		failures += checkSlidingWindow(random, 500, 150, "random model, " + to_string(numStates[i]) + " states");
+		failures += checkExtendForward(random, 200, "random model, " + to_string(numStates[i]) + " states");
+		//a budget of a few dozen columns forces constant eviction
+		failures += checkPrefixCache(random, 40 * numStates[i] * sizeof(double) + 8192, "random model, " + to_string(numStates[i]) + " states");
+	}
+	DiscreteHmm manySymbols;
+	manySymbols.SetVerbose(false);
+	manySymbols.InitRandomModel(symbols, 4);
+	failures += checkFusedEStep(manySymbols, 4, 1000, "random model, 4 states, 20 symbols");
+
+	if(failures == 0){
+		cout << "PASS all forward tests" << endl;
+	}
+
+	return failures;
+}
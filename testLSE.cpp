@@ -1,11 +1,128 @@
 #include "Hmm.hpp"
 
-int main(int argc, char** argv)
+#include <sstream>
+
+/*
+Verifies the log-space arithmetic:
+	-_logSumExp() against scipy's logsumexp, in exact and fast log math
+	-LogMath's fast Exp, Log, LogAdd and LogSumExp against the exact functions, for several error bounds
+	-the forward algorithm and the fused E-step with fast log math against exact log math
+*/
+
+double uniform(double lo, double hi)
 {
-	DiscreteHmm hmm;
+	return lo + (hi - lo) * (double)rand() / (double)RAND_MAX;
+}
 
-	hmm.TestLogSumExp();
+string describe(const string& name, double bound)
+{
+	ostringstream out;
+	out << name << ", bound " << bound;
+	return out.str();
+}
 
+int checkBound(const string& description, double worst, double bound)
+{
+	if(worst > bound){
+		cout << "FAIL " << description << ": error " << worst << " exceeds " << bound << endl;
+		return 1;
+	}
+	cout << description << ": max error " << worst << " (bound " << bound << ")" << endl;
 	return 0;
 }
 
+int main(int argc, char** argv)
+{
+	int i, j, k, failures = 0;
+	double a, b, x, maxX, worstExp, worstLog, worstAdd, worstLse, exact, bound;
+	double bounds[] = {1E-3, 1E-6, 1E-9};
+	vector<double> vec;
+	LogMath logMath;
+	DiscreteHmm hmm;
+
+	srand(12345);
+	hmm.SetVerbose(false);
+
+	if(!hmm.TestLogSumExp()){
+		cout << "FAIL exact _logSumExp()" << endl;
+		failures++;
+	}
+
+	for(k = 0; k < 3; k++){
+		bound = bounds[k];
+		logMath.SetMode(LOGMATH_FAST, bound);
+		worstExp = worstLog = worstAdd = worstLse = 0;
+		for(i = 0; i < 200000; i++){
+			//Exp: relative error, over the range seen in lattices (shifted log-probabilities)
+			x = uniform(-700, 0);
+			worstExp = max(worstExp, fabs(logMath.Exp(x) / exp(x) - 1));
+			//Log: absolute error, over many magnitudes
+			x = exp(uniform(-700, 700));
+			worstLog = max(worstLog, fabs(logMath.Log(x) - log(x)));
+			//LogAdd: absolute error, including differences past the end of the table
+			a = uniform(-50, 0);
+			b = a - uniform(0, 40);
+			if(rand() % 2){
+				swap(a, b);
+			}
+			exact = max(a,b) + log1p(exp(-fabs(a - b)));
+			worstAdd = max(worstAdd, fabs(logMath.LogAdd(a, b) - exact));
+		}
+		for(i = 0; i < 2000; i++){
+			vec.resize(1 + rand() % 64);
+			maxX = -numeric_limits<double>::infinity();
+			for(j = 0; j < vec.size(); j++){
+				vec[j] = rand() % 10 == 0 ? -numeric_limits<double>::infinity() : uniform(-100, 0);
+				maxX = max(maxX, vec[j]);
+			}
+			if(isinf(maxX)){
+				continue;
+			}
+			exact = maxX;
+			for(j = 0, x = 0; j < vec.size(); j++){
+				x += exp(vec[j] - maxX);
+			}
+			exact += log(x);
+			worstLse = max(worstLse, fabs(logMath.LogSumExp(vec, maxX) - exact));
+		}
+		failures += checkBound(describe("Exp (relative)", bound), worstExp, bound);
+		failures += checkBound(describe("Log", bound), worstLog, bound);
+		failures += checkBound(describe("LogAdd", bound), worstAdd, bound);
+		failures += checkBound(describe("LogSumExp", bound), worstLse, 2 * bound);
+
+		hmm.SetLogMath(LOGMATH_FAST, bound);
+		if(!hmm.TestLogSumExp()){
+			cout << "FAIL fast _logSumExp(), bound " << bound << endl;
+			failures++;
+		}
+	}
+
+	//the special values behave as in exact math
+	logMath.SetMode(LOGMATH_FAST, 1E-6);
+	if(logMath.LogAdd(-numeric_limits<double>::infinity(), -numeric_limits<double>::infinity()) != -numeric_limits<double>::infinity()
+		|| logMath.LogAdd(-numeric_limits<double>::infinity(), -3.0) != -3.0
+		|| logMath.Exp(-numeric_limits<double>::infinity()) != 0
+		|| logMath.Log(0) != -numeric_limits<double>::infinity()){
+		cout << "FAIL special values in fast log math" << endl;
+		failures++;
+	}
+
+	//whole algorithms: the forward log-likelihood of a sequence accumulates one LogSumExp error per step
+	DiscreteHmm exactHmm("test.hmm"), fastHmm("test.hmm");
+	vector<int> observations(1000);
+	exactHmm.SetVerbose(false);
+	fastHmm.SetVerbose(false);
+	fastHmm.SetLogMath(LOGMATH_FAST, 1E-9);
+	for(i = 0; i < observations.size(); i++){
+		observations[i] = rand() % 3;
+	}
+	exact = exactHmm.ForwardAlgorithm(observations, observations.size()-1);
+	x = fastHmm.ForwardAlgorithm(observations, observations.size()-1);
+	failures += checkBound("forward ln P, 1000 steps at bound 1e-9", fabs(x - exact), 2E-9 * observations.size());
+
+	if(failures == 0){
+		cout << "PASS all log math tests" << endl;
+	}
+
+	return failures;
+}
@@ -0,0 +1,106 @@
+#Tests the python bindings against brute force and against themselves; build them first with ./pyhmm.sh.
+#Prints PASS or a FAIL line per failed check. Uses only the standard library, so numpy is not needed.
+import array
+import itertools
+import math
+import os
+import random
+import tempfile
+import threading
+
+import pyhmm
+
+failures = 0
+
+def check(ok, message):
+	global failures
+	if not ok:
+		print("FAIL " + message)
+		failures += 1
+
+def logSumExp(values):
+	m = max(values)
+	if m == float("-inf"):
+		return m
+	return m + math.log(sum(math.exp(v - m) for v in values))
+
+def randomSequence(length, numSymbols):
+	return array.array("i", [random.randrange(numSymbols) for _ in range(length)])
+
+random.seed(7)
+symbols = ["a", "b", "c"]
+hmm = pyhmm.Hmm()
+hmm.init_random(symbols, 4)
+n, m = hmm.num_states(), hmm.num_symbols()
+initial, transitions, emissions = hmm.parameters()
+pi = memoryview(initial).tolist()
+A = memoryview(transitions).tolist()
+B = memoryview(emissions).tolist()
+check(memoryview(transitions).shape == (n, n) and memoryview(emissions).shape == (n, m), "parameter shapes")
+
+#brute force over every state sequence of short observation sequences
+for length in range(1, 6):
+	obs = randomSequence(length, m)
+	scores = []
+	best, bestPath = float("-inf"), None
+	for path in itertools.product(range(n), repeat=length):
+		score = pi[path[0]] + B[path[0]][obs[0]]
+		for t in range(1, length):
+			score += A[path[t-1]][path[t]] + B[path[t]][obs[t]]
+		scores.append(score)
+		if score > best:
+			best, bestPath = score, list(path)
+	forward = hmm.forward(obs)
+	check(abs(forward - logSumExp(scores)) < 1e-9, "forward vs brute force, length %d: %f" % (length, forward))
+	score, path = hmm.viterbi(obs)
+	check(abs(score - best) < 1e-9 and memoryview(path).tolist() == bestPath, "viterbi vs brute force, length %d" % length)
+
+#the lattices agree with the scores and with each other
+obs = randomSequence(500, m)
+forward, alpha = hmm.forward(obs, lattice=True)
+backward, beta = hmm.backward(obs, lattice=True)
+alpha, beta = memoryview(alpha), memoryview(beta)
+check(alpha.shape == (500, n) and alpha.format == "d", "alpha lattice shape")
+check(abs(logSumExp([alpha[499, i] for i in range(n)]) - forward) < 1e-9, "alpha lattice last column")
+#BackwardAlgorithm() returns the sum of beta_0; P(observations) also needs pi and the first emission
+check(abs(backward - logSumExp([beta[0, i] for i in range(n)])) < 1e-9, "backward score")
+check(abs(logSumExp([pi[i] + B[i][obs[0]] + beta[0, i] for i in range(n)]) - forward) < 1e-6, "backward vs forward")
+for t in (0, 250, 499):
+	check(abs(logSumExp([alpha[t, i] + beta[t, i] for i in range(n)]) - forward) < 1e-6, "alpha * beta at t=%d" % t)
+
+#encoded buffers are valid input, and bad input is refused
+check(memoryview(hmm.encode(["a", "c", "b"])).tolist() == [0, 2, 1], "encode")
+for bad, error in ((array.array("q", [0, 1]), TypeError), (array.array("i", [0, 3]), ValueError), (array.array("i"), ValueError), ("abc", TypeError)):
+	try:
+		hmm.forward(bad)
+		check(False, "accepted bad observations %r" % (bad,))
+	except error:
+		pass
+
+#threads: one model each, and a shared one, give the serial results
+path = os.path.join(tempfile.mkdtemp(), "pyhmm.hmm")
+hmm.write(path)
+sequences = [randomSequence(2000, m) for _ in range(16)]
+reloaded = pyhmm.Hmm(path)
+expected = [reloaded.forward(s) for s in sequences]
+#model files hold 6 significant digits
+check(all(abs(e - hmm.forward(s)) < 1e-4 * abs(e) for e, s in zip(expected, sequences)), "written and read model scores")
+results = {}
+def score(model, indices):
+	for i in indices:
+		results[i] = model.forward(sequences[i])
+threads = [threading.Thread(target=score, args=(pyhmm.Hmm(path), range(k, 16, 4))) for k in range(4)]
+threads += [threading.Thread(target=score, args=(reloaded, range(k, 16, 4))) for k in range(4)]
+for thread in threads:
+	thread.start()
+for thread in threads:
+	thread.join()
+check([results[i] for i in range(16)] == expected, "threaded scores")
+
+#training never lowers the likelihood
+before = sum(hmm.forward(s) for s in sequences[:4])
+after = hmm.baum_welch(sequences[:4], iterations=5, tolerance=0)
+check(after >= before - 1e-6 and sum(hmm.forward(s) for s in sequences[:4]) >= after - 1e-6, "baum welch likelihood: %f %f" % (before, after))
+
+if failures == 0:
+	print("PASS all python binding tests")
@@ -0,0 +1,164 @@
+#include "QuantizedHmm.hpp"
+
+/*
+Verifies the quantized engine against the double one:
+	-the AVX2 Viterbi kernel against the scalar loop, for both widths, on random models of various sizes
+	-path agreement and score error bounds on test.hmm and random models
+	-a written and re-read quantized model decodes identically
+	-observations impossible under the model score -inf
+*/
+
+void randomSequence(vector<int>& observations, int length, int numSymbols)
+{
+	observations.resize(length);
+	for(int i = 0; i < length; i++){
+		observations[i] = rand() % numSymbols;
+	}
+}
+
+template<typename T>
+int checkSimd(DiscreteHmm& hmm, const string& description)
+{
+	int i, failures = 0;
+	double expected, result;
+	vector<int> observations, expectedPath, path;
+	QuantizedHmm<T> quantized;
+
+	quantized.Build(hmm);
+	for(i = 0; i < 20; i++){
+		randomSequence(observations, 1 + rand() % 2000, hmm.NumSymbols());
+		quantized.SetSimd(false);
+		expected = quantized.Viterbi(observations, expectedPath);
+		quantized.SetSimd(true);
+		result = quantized.Viterbi(observations, path);
+		if(expected != result || expectedPath != path){
+			cout << "FAIL " << 8 * sizeof(T) << "-bit simd Viterbi " << description << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+/*
+Every step of either recurrence adds a few rounded values, each off by at most half a unit, so the score error of a
+sequence of length t is bounded by a small multiple of t / scale.
+*/
+template<typename T>
+int checkAccuracy(DiscreteHmm& hmm, int numSequences, int maxLength, double minAgreement, const string& description)
+{
+	int i, failures = 0;
+	double expected, result, bound;
+	vector<int> path;
+	vector<vector<int> > sequences(numSequences);
+	QuantizedHmm<T> quantized;
+
+	quantized.Build(hmm);
+	for(i = 0; i < numSequences; i++){
+		randomSequence(sequences[i], 1 + rand() % maxLength, hmm.NumSymbols());
+		bound = 4.0 * sequences[i].size() / quantized.Scale();
+		expected = hmm.Viterbi(sequences[i], sequences[i].size(), path);
+		result = quantized.Viterbi(sequences[i], path);
+		if(fabs(expected - result) > bound){
+			cout << "FAIL " << 8 * sizeof(T) << "-bit Viterbi score " << description << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+		expected = hmm.ForwardAlgorithm(sequences[i], sequences[i].size()-1);
+		result = quantized.Forward(sequences[i]);
+		if(fabs(expected - result) > bound){
+			cout << "FAIL " << 8 * sizeof(T) << "-bit forward score " << description << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	string report = quantized.Report(hmm, sequences);
+	cout << description << " " << report << endl;
+	if(atof(report.substr(report.find("path_agreement=") + 15).c_str()) < minAgreement){
+		cout << "FAIL " << 8 * sizeof(T) << "-bit path agreement " << description << endl;
+		failures++;
+	}
+
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	int i, failures = 0;
+	double expected, result;
+	vector<int> observations, expectedPath, path;
+	vector<string> symbols;
+	DiscreteHmm hmm("test.hmm");
+
+	srand(12345);
+	hmm.SetVerbose(false);
+
+	int numStates[] = {1, 3, 8, 16, 17, 40};
+	for(i = 0; i < 20; i++){
+		symbols.push_back(to_string(i));
+	}
+	for(i = 0; i < 6; i++){
+		DiscreteHmm random;
+		random.SetVerbose(false);
+		random.InitRandomModel(symbols, numStates[i]);
+		failures += checkSimd<int16_t>(random, to_string(numStates[i]) + " states");
+		failures += checkSimd<int32_t>(random, to_string(numStates[i]) + " states");
+	}
+
+	failures += checkAccuracy<int16_t>(hmm, 300, 200, 0.95, "test.hmm");
+	failures += checkAccuracy<int32_t>(hmm, 300, 200, 0.99, "test.hmm");
+	{
+		DiscreteHmm random;
+		random.SetVerbose(false);
+		random.InitRandomModel(symbols, 40);
+		failures += checkAccuracy<int16_t>(random, 100, 500, 0.5, "random 40 states");
+		failures += checkAccuracy<int32_t>(random, 100, 500, 0.9, "random 40 states");
+	}
+
+	//round trip through a quantized model file
+	QuantizedHmm<int16_t> written, read;
+	written.Build(hmm);
+	written.Write("test.qhmm");
+	if(!read.Read("test.qhmm")){
+		cout << "FAIL reading test.qhmm" << endl;
+		failures++;
+	}
+	for(i = 0; i < 50; i++){
+		randomSequence(observations, 1 + rand() % 100, hmm.NumSymbols());
+		expected = written.Viterbi(observations, expectedPath);
+		result = read.Viterbi(observations, path);
+		if(expected != result || expectedPath != path || written.Forward(observations) != read.Forward(observations)){
+			cout << "FAIL re-read quantized model: " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+	remove("test.qhmm");
+
+	//a symbol no state emits, and a transition which never occurs
+	ofstream model("impossible.hmm");
+	model << "Z=H,C\nX=S,M,L\nA=1.0,0.0;0.4,0.6\nB=0.0,0.5,0.5;0.0,0.2,0.8\nPi=1.0,0.0\n";
+	model.close();
+	DiscreteHmm impossible("impossible.hmm");
+	QuantizedHmm<int16_t> quantized;
+	impossible.SetVerbose(false);
+	quantized.Build(impossible);
+	remove("impossible.hmm");
+	observations.assign(5, 1);
+	observations[2] = 0;
+	if(!isinf(quantized.Viterbi(observations, path)) || !isinf(quantized.Forward(observations))){
+		cout << "FAIL quantized scores of an impossible sequence are not -inf" << endl;
+		failures++;
+	}
+	observations.assign(5, 2);
+	expected = impossible.Viterbi(observations, observations.size(), expectedPath);
+	result = quantized.Viterbi(observations, path);
+	if(expectedPath != path || fabs(expected - result) > 20.0 / quantized.Scale()){
+		cout << "FAIL quantized Viterbi with zero probability transitions: " << result << " != " << expected << endl;
+		failures++;
+	}
+
+	if(failures == 0){
+		cout << "PASS all quantized tests" << endl;
+	}
+
+	return failures;
+}
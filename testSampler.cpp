@@ -0,0 +1,292 @@
+#include "SequenceSampler.hpp"
+
+#include <fstream>
+#include <sstream>
+
+/*
+Verifies the sequence sampler:
+	-the frequencies of initial states, transitions and emissions match the model, on test.hmm and a random model
+	-Generate() writes the same bytes for any number of threads, in every format, for sequences shorter than a
+	 block and longer than one
+	-binary output reads back through DatasetReader, and labelled text back as its lines, as the sequences Sample() draws
+	-a model trained directly on generated labelled text has exactly the frequencies of the sampled sequences, each
+	 blank line ending a sequence, and those frequencies match the generating model
+*/
+
+/*
+Compares the frequencies of @counts (by row) with the ln-probabilities @logProbs, within five standard deviations.
+*/
+int checkFrequencies(const vector<vector<double> >& counts, const vector<double>& logProbs, const string& description)
+{
+	int i, j, n, failures = 0;
+	double total, p, error;
+
+	n = counts[0].size();
+	for(i = 0; i < counts.size(); i++){
+		total = 0;
+		for(j = 0; j < n; j++){
+			total += counts[i][j];
+		}
+		for(j = 0; j < n && total > 0; j++){
+			p = exp(logProbs[i * n + j]);
+			error = 5 * sqrt(p * (1 - p) / total) + 1E-9;
+			if(fabs(counts[i][j] / total - p) > error){
+				cout << "FAIL " << description << " frequency of " << i << "," << j << ": " << counts[i][j] / total << " != " << p << endl;
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+int checkDistribution(DiscreteHmm& hmm, const string& description)
+{
+	int i, t, failures = 0, numStates, numSymbols;
+	vector<int> symbols, states;
+	vector<double> initial, transitions, emissions;
+	SequenceSampler sampler;
+
+	sampler.Build(hmm);
+	numStates = hmm.NumStates();
+	numSymbols = hmm.NumSymbols();
+	initial.resize(numStates);
+	transitions.resize(numStates * numStates);
+	emissions.resize(numStates * numSymbols);
+	hmm.CopyParameters(initial.data(), transitions.data(), emissions.data());
+
+	vector<vector<double> > initialCounts(1, vector<double>(numStates, 0));
+	vector<vector<double> > transitionCounts(numStates, vector<double>(numStates, 0));
+	vector<vector<double> > emissionCounts(numStates, vector<double>(numSymbols, 0));
+	for(i = 0; i < 20000; i++){
+		sampler.Sample(99, i, 50, symbols, states);
+		initialCounts[0][ states[0] ]++;
+		for(t = 0; t < symbols.size(); t++){
+			emissionCounts[ states[t] ][ symbols[t] ]++;
+			if(t > 0){
+				transitionCounts[ states[t-1] ][ states[t] ]++;
+			}
+		}
+	}
+	failures += checkFrequencies(initialCounts, initial, description + " initial state");
+	failures += checkFrequencies(transitionCounts, transitions, description + " transition");
+	failures += checkFrequencies(emissionCounts, emissions, description + " emission");
+
+	return failures;
+}
+
+string readFile(const string& path)
+{
+	ifstream file(path.c_str(), ios::in | ios::binary);
+	ostringstream contents;
+
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+int checkGenerate(DiscreteHmm& hmm, const int numSequences, const int length)
+{
+	int i, t, failures = 0;
+	string line, expected;
+	vector<int> symbols, states;
+	vector<vector<int> > batch;
+	vector<string> names;
+	SampleFormat formats[] = {SAMPLE_TEXT, SAMPLE_LABELED_TEXT, SAMPLE_BINARY};
+	SequenceSampler sampler;
+
+	sampler.Build(hmm);
+	for(i = 0; i < 3; i++){
+		sampler.Generate("samplerTest1.dat", formats[i], numSequences, length, 7, 1);
+		sampler.Generate("samplerTest3.dat", formats[i], numSequences, length, 7, 3);
+		if(readFile("samplerTest1.dat") != readFile("samplerTest3.dat")){
+			cout << "FAIL output differs by number of threads, format " << formats[i] << ", length " << length << endl;
+			failures++;
+		}
+	}
+
+	//binary, through the reader
+	for(i = 0; i < hmm.NumSymbols(); i++){
+		names.push_back(hmm.GetSymbolName(i));
+	}
+	DatasetReader reader;
+	reader.Open("samplerTest1.dat", names);
+	i = 0;
+	while(reader.NextBatch(batch)){
+		for(t = 0; t < batch.size(); t++, i++){
+			sampler.Sample(7, i, length, symbols, states);
+			if(batch[t] != symbols){
+				cout << "FAIL binary sequence " << i << " differs from Sample(), length " << length << endl;
+				failures++;
+			}
+		}
+	}
+	if(i != numSequences){
+		cout << "FAIL read " << i << " of " << numSequences << " binary sequences" << endl;
+		failures++;
+	}
+
+	//labelled text, line by line
+	sampler.Generate("samplerTest1.dat", SAMPLE_LABELED_TEXT, numSequences, length, 7, 2);
+	ifstream labelled("samplerTest1.dat");
+	for(i = 0; i < numSequences; i++){
+		sampler.Sample(7, i, length, symbols, states);
+		for(t = 0; t <= length; t++){
+			expected = t < length ? hmm.GetSymbolName(symbols[t]) + "\t" + hmm.GetStateName(states[t]) : "";
+			if(!getline(labelled, line) || line != expected){
+				cout << "FAIL labelled sequence " << i << " line " << t << ": " << line << " != " << expected << endl;
+				failures++;
+				i = numSequences;
+				break;
+			}
+		}
+	}
+
+	remove("samplerTest1.dat");
+	remove("samplerTest3.dat");
+
+	return failures;
+}
+
+/*
+Compares the ln-probabilities of @trained with the frequencies of @counts, indexed by the ids of @hmm: they must
+agree to rounding, whatever the order of the trained model's ids.
+*/
+int checkTrained(DiscreteHmm& hmm, DiscreteHmm& trained, const vector<vector<double> >& counts, const string& description)
+{
+	int i, j, k, n, m, failures = 0;
+	double total, expected, result;
+	map<string,int> stateIds, symbolIds;
+	vector<double> initial, transitions, emissions;
+
+	n = trained.NumStates();
+	m = trained.NumSymbols();
+	if(n != hmm.NumStates() || m != hmm.NumSymbols()){
+		cout << "FAIL " << description << ": trained model has " << n << " states and " << m << " symbols" << endl;
+		return 1;
+	}
+	initial.resize(n);
+	transitions.resize(n * n);
+	emissions.resize(n * m);
+	trained.CopyParameters(initial.data(), transitions.data(), emissions.data());
+	for(i = 0; i < n; i++){
+		stateIds[trained.GetStateName(i)] = i;
+	}
+	for(i = 0; i < m; i++){
+		symbolIds[trained.GetSymbolName(i)] = i;
+	}
+
+	//counts holds the initial row, then the transition rows, then the emission rows, by the ids of hmm
+	for(k = 0; k < counts.size(); k++){
+		total = 0;
+		for(j = 0; j < counts[k].size(); j++){
+			total += counts[k][j];
+		}
+		i = k - 1 - (k > n ? n : 0);
+		for(j = 0; j < counts[k].size(); j++){
+			expected = counts[k][j] / total;
+			if(k == 0){
+				result = exp(initial[ stateIds[hmm.GetStateName(j)] ]);
+			}
+			else if(k <= n){
+				result = exp(transitions[ stateIds[hmm.GetStateName(i)] * n + stateIds[hmm.GetStateName(j)] ]);
+			}
+			else{
+				result = exp(emissions[ stateIds[hmm.GetStateName(i)] * m + symbolIds[hmm.GetSymbolName(j)] ]);
+			}
+			if(fabs(result - expected) > 1E-12){
+				cout << "FAIL " << description << ", row " << k << " column " << j << ": " << result << " != " << expected << endl;
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+/*
+Generates labelled text from @hmm and trains on it, in memory and streamed in small chunks, so that many chunks
+begin or end at a blank line. Each sequence gives an initial state count, and no transition is counted from one
+sequence into the next.
+*/
+int checkLabeledRoundTrip(DiscreteHmm& hmm, const int numSequences, const int length, const string& description)
+{
+	int i, t, failures = 0, numStates, numSymbols;
+	vector<int> symbols, states;
+	vector<double> initial, transitions, emissions;
+	SequenceSampler sampler;
+	DiscreteHmmDataset dataset;
+	DiscreteHmm trained;
+
+	sampler.Build(hmm);
+	numStates = hmm.NumStates();
+	numSymbols = hmm.NumSymbols();
+	initial.resize(numStates);
+	transitions.resize(numStates * numStates);
+	emissions.resize(numStates * numSymbols);
+	hmm.CopyParameters(initial.data(), transitions.data(), emissions.data());
+
+	vector<vector<double> > initialCounts(1, vector<double>(numStates, 0));
+	vector<vector<double> > transitionCounts(numStates, vector<double>(numStates, 0));
+	vector<vector<double> > emissionCounts(numStates, vector<double>(numSymbols, 0));
+	for(i = 0; i < numSequences; i++){
+		sampler.Sample(11, i, length, symbols, states);
+		initialCounts[0][ states[0] ]++;
+		for(t = 0; t < symbols.size(); t++){
+			emissionCounts[ states[t] ][ symbols[t] ]++;
+			if(t > 0){
+				transitionCounts[ states[t-1] ][ states[t] ]++;
+			}
+		}
+	}
+	failures += checkFrequencies(initialCounts, initial, description + " round trip initial state");
+	failures += checkFrequencies(transitionCounts, transitions, description + " round trip transition");
+	failures += checkFrequencies(emissionCounts, emissions, description + " round trip emission");
+
+	vector<vector<double> > counts(initialCounts);
+	counts.insert(counts.end(), transitionCounts.begin(), transitionCounts.end());
+	counts.insert(counts.end(), emissionCounts.begin(), emissionCounts.end());
+
+	sampler.Generate("samplerTest1.dat", SAMPLE_LABELED_TEXT, numSequences, length, 11, 2);
+	trained.SetVerbose(false);
+	dataset.BuildLabeledDataset("samplerTest1.dat");
+	trained.DirectTrain(dataset);
+	failures += checkTrained(hmm, trained, counts, description + " DirectTrain");
+	dataset.Clear();
+	dataset.SetCompactStorage(true);
+	dataset.BuildLabeledDataset("samplerTest1.dat");
+	trained.DirectTrain(dataset);
+	failures += checkTrained(hmm, trained, counts, description + " DirectTrain, compact");
+	trained.StreamingDirectTrain("samplerTest1.dat", 3, 997);
+	failures += checkTrained(hmm, trained, counts, description + " StreamingDirectTrain");
+	remove("samplerTest1.dat");
+
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	int i, failures = 0;
+	vector<string> symbols;
+	DiscreteHmm hmm("test.hmm");
+	DiscreteHmm random;
+
+	hmm.SetVerbose(false);
+	random.SetVerbose(false);
+	for(i = 0; i < 7; i++){
+		symbols.push_back(to_string(i));
+	}
+	random.InitRandomModel(symbols, 5);
+
+	failures += checkDistribution(hmm, "test.hmm");
+	failures += checkDistribution(random, "random");
+	failures += checkGenerate(hmm, 3, 70000);
+	failures += checkGenerate(random, 5000, 7);
+	failures += checkLabeledRoundTrip(hmm, 4000, 25, "test.hmm");
+	failures += checkLabeledRoundTrip(random, 4000, 25, "random");
+
+	if(failures == 0){
+		cout << "PASS all sampler tests" << endl;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+#include "Hmm.hpp"
+
+/*
+Verifies Viterbi decoding against test.hmm (Mark Stamp's example model):
+	-brute force enumeration of all state sequences for short observation sequences
+	-the checkpointed (low memory) variant against the full-lattice variant on long sequences
+	-bit-packed observation sequences against int vectors
+	-the vectorized max-plus kernel against the scalar loop, on random models of various sizes
+	-k-best decoding against a sorted enumeration of all state sequences
+	-prefix-cached decoding against the uncached lattice, with shared prefixes and a budget small enough to evict
+*/
+
+//Stamp's model, as in test.hmm
+static const double A[2][2] = {{0.7,0.3},{0.4,0.6}};
+static const double B[2][3] = {{0.1,0.4,0.5},{0.7,0.2,0.1}};
+static const double Pi[2] = {0.6,0.4};
+
+//Returns the ln-probability of the best state sequence by enumerating all of them
+double bruteForceViterbi(const vector<int>& observations, vector<int>& output)
+{
+	int i, path, numPaths, state, prev;
+	double score, best;
+
+	numPaths = 1 << observations.size();
+	best = -numeric_limits<double>::infinity();
+	output.resize(observations.size());
+	for(path = 0; path < numPaths; path++){
+		prev = path & 1;
+		score = log(Pi[prev]) + log(B[prev][observations[0]]);
+		for(i = 1; i < observations.size(); i++){
+			state = (path >> i) & 1;
+			score += log(A[prev][state]) + log(B[state][observations[i]]);
+			prev = state;
+		}
+		if(score > best){
+			best = score;
+			for(i = 0; i < observations.size(); i++){
+				output[i] = (path >> i) & 1;
+			}
+		}
+	}
+
+	return best;
+}
+
+//Scores every state sequence, best first
+void bruteForceKBest(const vector<int>& observations, vector<double>& scores)
+{
+	int i, path, state, prev;
+	double score;
+
+	scores.clear();
+	for(path = 0; path < (1 << observations.size()); path++){
+		prev = path & 1;
+		score = log(Pi[prev]) + log(B[prev][observations[0]]);
+		for(i = 1; i < observations.size(); i++){
+			state = (path >> i) & 1;
+			score += log(A[prev][state]) + log(B[state][observations[i]]);
+			prev = state;
+		}
+		scores.push_back(score);
+	}
+	sort(scores.rbegin(), scores.rend());
+}
+
+//The ln-probability of one state sequence
+double pathScore(const vector<int>& observations, const vector<int>& path)
+{
+	double score = log(Pi[path[0]]) + log(B[path[0]][observations[0]]);
+
+	for(int i = 1; i < observations.size(); i++){
+		score += log(A[path[i-1]][path[i]]) + log(B[path[i]][observations[i]]);
+	}
+
+	return score;
+}
+
+void randomSequence(vector<int>& observations, int length)
+{
+	observations.resize(length);
+	for(int i = 0; i < length; i++){
+		observations[i] = rand() % 3;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int i, failures = 0;
+	double expected, result;
+	vector<int> observations, expectedPath, path;
+	DiscreteHmm hmm("test.hmm");
+
+	srand(12345);
+
+	//brute force comparison on short sequences
+	for(i = 0; i < 200; i++){
+		randomSequence(observations, 1 + rand() % 10);
+		expected = bruteForceViterbi(observations, expectedPath);
+		result = hmm.Viterbi(observations, observations.size(), path);
+		if(fabs(expected - result) > 1E-9 || path != expectedPath){
+			cout << "FAIL brute force comparison, length " << observations.size() << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	//checkpointed vs. full lattice on long sequences; a budget one byte short of the full lattices forces the
+	//checkpointed variant, which must stay within it
+	for(i = 0; i < 20; i++){
+		randomSequence(observations, 100 + rand() % 20000);
+		hmm.SetMemoryBudget(0);
+		expected = hmm.Viterbi(observations, observations.size(), expectedPath);
+		hmm.SetMemoryBudget(hmm.EstimateMemory(MEMORY_VITERBI, hmm.NumStates(), hmm.NumSymbols(), observations.size()) - 1);
+		hmm.ResetPeakMemory();
+		result = hmm.Viterbi(observations, observations.size(), path);
+		if(expected != result || path != expectedPath){
+			cout << "FAIL checkpointed comparison, length " << observations.size() << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+		if(hmm.PeakMemory() - hmm.CurrentMemory() > hmm.EstimateMemory(MEMORY_VITERBI, hmm.NumStates(), hmm.NumSymbols(), observations.size())){
+			cout << "FAIL checkpointed Viterbi used " << hmm.PeakMemory() - hmm.CurrentMemory() << " bytes, over its estimate" << endl;
+			failures++;
+		}
+	}
+	//a budget too small for any variant fails before allocating
+	hmm.SetMemoryBudget(1);
+	if(hmm.Viterbi(observations, observations.size(), path) != 1.0){
+		cout << "FAIL Viterbi() ran over the memory budget" << endl;
+		failures++;
+	}
+	hmm.SetMemoryBudget(0);
+
+	//bit-packed observations decode identically to the int vector
+	for(i = 0; i < 5; i++){
+		PackedSequence packed;
+		randomSequence(observations, 1 + rand() % 5000);
+		packed.Pack(observations, PackedSequence::WidthFor(3));
+		expected = hmm.Viterbi(observations, observations.size(), expectedPath);
+		result = hmm.Viterbi(packed, packed.size(), path);
+		if(expected != result || path != expectedPath){
+			cout << "FAIL packed sequence comparison, length " << observations.size() << endl;
+			failures++;
+		}
+	}
+
+	//vectorized vs. scalar kernel: paths and scores must be bit-identical. State counts that are not a multiple
+	//of the vector width exercise the scalar tail. Random models have integer-valued weights, so ties occur.
+	int numStates[] = {1, 3, 4, 7, 13, 32};
+	vector<string> symbols;
+	symbols.push_back("x"); symbols.push_back("y"); symbols.push_back("z");
+	for(i = 0; i < 6; i++){
+		DiscreteHmm random;
+		random.SetVerbose(false);
+		random.InitRandomModel(symbols, numStates[i]);
+		for(int budget = 0; budget < 2; budget++){
+			randomSequence(observations, 100 + rand() % 5000);
+			random.SetMemoryBudget(0);
+			random.SetMemoryBudget(budget * (random.EstimateMemory(MEMORY_VITERBI, numStates[i], 3, observations.size()) - 1));
+			random.SetSimd(false);
+			expected = random.Viterbi(observations, observations.size(), expectedPath);
+			random.SetSimd(true);
+			result = random.Viterbi(observations, observations.size(), path);
+			if(expected != result || path != expectedPath){
+				cout << "FAIL vectorized kernel comparison, " << numStates[i] << " states, length " << observations.size() << ": " << result << " != " << expected << endl;
+				failures++;
+			}
+		}
+	}
+
+	//k-best: the scores must be the k best of the enumeration, each path must have its score, and no path may repeat.
+	//k = 1 is Viterbi, and k beyond the number of paths returns all of them.
+	int ks[] = {1, 2, 5, 17, 2000};
+	vector<double> kScores, allScores;
+	vector<vector<int> > kPaths;
+	for(i = 0; i < 100; i++){
+		randomSequence(observations, 1 + rand() % 10);
+		int k = ks[i % 5];
+		bruteForceKBest(observations, allScores);
+		result = hmm.KBestViterbi(observations, k, kPaths, kScores);
+		expected = hmm.Viterbi(observations, observations.size(), expectedPath);
+		bool ok = kScores.size() == min((size_t)k, allScores.size()) && result == expected && kPaths[0] == expectedPath;
+		for(int j = 0; ok && j < kScores.size(); j++){
+			ok = fabs(kScores[j] - allScores[j]) < 1E-9 && fabs(pathScore(observations, kPaths[j]) - kScores[j]) < 1E-9;
+			for(int m = 0; ok && m < j; m++){
+				ok = kPaths[m] != kPaths[j];
+			}
+		}
+		if(!ok){
+			cout << "FAIL k-best comparison, k = " << k << ", length " << observations.size() << endl;
+			failures++;
+		}
+	}
+
+	//prefix cache: queries sharing prefixes decode bit-identically with and without it
+	DiscreteHmm cached("test.hmm");
+	vector<int> prefix, tail;
+	cached.SetVerbose(false);
+	cached.SetPrefixCache(16384, 32);
+	randomSequence(prefix, 40);
+	for(i = 0; i < 200; i++){
+		observations.assign(prefix.begin(), prefix.begin() + rand() % prefix.size());
+		randomSequence(tail, 1 + rand() % 20);
+		observations.insert(observations.end(), tail.begin(), tail.end());
+		expected = hmm.Viterbi(observations, observations.size(), expectedPath);
+		result = cached.Viterbi(observations, observations.size(), path);
+		if(expected != result || path != expectedPath){
+			cout << "FAIL prefix cache comparison, length " << observations.size() << ": " << result << " != " << expected << endl;
+			failures++;
+		}
+	}
+
+	if(failures == 0){
+		cout << "PASS all Viterbi tests" << endl;
+	}
+
+	return failures;
+}